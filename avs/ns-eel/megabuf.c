@@ -30,14 +30,16 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "megabuf.h"
 #include "../ns-eel/ns-eel-int.h"
 #include "../ns-eel/ns-eel.h"
-#include "../platform_shim_redirect.h"
+#include "platform_shim_redirect.h"
 
+#ifndef NSEEL_JIT
 void megabuf_ppproc(void* data, int data_size, void** userfunc_data)
 {
     if (data_size > 5 && *(int*)((char*)data + 1) == 0xFFFFFFFF) {
         *(int*)((char*)data + 1) = (int)(userfunc_data + 0);
     }
 }
+#endif
 
 void megabuf_cleanup(NSEEL_VMCTX ctx)
 {
@@ -57,7 +59,12 @@ void megabuf_cleanup(NSEEL_VMCTX ctx)
     }
 }
 
+#ifdef NSEEL_JIT
+// registered with NSEEL_PFUNC_WANTCTX, blocks is &userfunc_data[0]
+double* megabuf_(double*** blocks, double* which)
+#else
 static double* NSEEL_CGEN_CALL megabuf_(double*** blocks, double* which)
+#endif
 {
     static double error;
     int w = (int)(*which + 0.0001);
@@ -81,6 +88,7 @@ static double* NSEEL_CGEN_CALL megabuf_(double*** blocks, double* which)
     return &error;
 }
 
+#ifndef NSEEL_JIT
 static double*(NSEEL_CGEN_CALL* __megabuf)(double***, double*) = &megabuf_;
 __declspec(naked) void _asm_megabuf(void)
 {
@@ -98,3 +106,4 @@ __declspec(naked) void _asm_megabuf(void)
     __asm { mov esp, ebp }
 }
 __declspec(naked) void _asm_megabuf_end(void) { }
+#endif
@@ -30,6 +30,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _MEGABUF_H_
 #define _MEGABUF_H_
 
+#include "ns-eel.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -37,9 +39,13 @@ extern "C" {
 #define MEGABUF_BLOCKS 64
 #define MEGABUF_ITEMSPERBLOCK 16384
 
+#ifdef NSEEL_JIT
+double* megabuf_(double*** blocks, double* which);
+#else
 void _asm_megabuf(void);
 void _asm_megabuf_end(void);
 void megabuf_ppproc(void* data, int data_size, void** userfunc_data);
+#endif
 void megabuf_cleanup(NSEEL_VMCTX);
 
 #ifdef __cplusplus
@@ -85,6 +85,10 @@ be sure to preserve edi, too.
     __asm { add esi, 8 }   \
     __asm { mov esp, ebp }
 
+#ifdef _M_IX86
 #define NSEEL_CGEN_CALL __fastcall
+#else
+#define NSEEL_CGEN_CALL
+#endif
 
 #endif //__NS_EEL_ADDFUNCS_H__
\ No newline at end of file
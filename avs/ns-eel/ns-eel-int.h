@@ -33,6 +33,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ns-eel-addfuncs.h"
 #include "ns-eel.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,7 +53,7 @@ extern "C" {
 #define MATH_SIMPLE 0
 #define MATH_FN 1
 
-#define YYSTYPE int
+#define YYSTYPE intptr_t // code block or tree node pointer
 
 typedef struct
 {
@@ -62,7 +63,7 @@ typedef struct
 
     int errVar;
     int colCount;
-    int result;
+    YYSTYPE result;
     char last_error_string[256];
     YYSTYPE yylval;
     int yychar; /*  the lookahead symbol		*/
@@ -92,14 +93,113 @@ typedef struct {
     void* func_e;
     int nParams;
     NSEEL_PPPROC pProc;
+    int flags; // NSEEL_PFUNC_*
 } functionType;
 
 extern functionType* nseel_getFunctionFromTable(int idx);
 
-int nseel_createCompiledValue(compileContext* ctx, double value, double* addrValue);
-int nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, int code);
-int nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, int code1, int code2);
-int nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, int code1, int code2, int code3);
+YYSTYPE nseel_createCompiledValue(compileContext* ctx, double value, double* addrValue);
+YYSTYPE nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, YYSTYPE code);
+YYSTYPE nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2);
+YYSTYPE nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2, YYSTYPE code3);
+
+#ifdef NSEEL_JIT
+// fnTable1 order, so the code generator can tell the builtins apart
+enum {
+    FNIDX_IF,
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+    FNIDX_LOOP,
+#endif
+    FNIDX_SIN,
+    FNIDX_COS,
+    FNIDX_TAN,
+    FNIDX_ASIN,
+    FNIDX_ACOS,
+    FNIDX_ATAN,
+    FNIDX_ATAN2,
+    FNIDX_SQR,
+    FNIDX_SQRT,
+    FNIDX_POW,
+    FNIDX_EXP,
+    FNIDX_LOG,
+    FNIDX_LOG10,
+    FNIDX_ABS,
+    FNIDX_MIN,
+    FNIDX_MAX,
+    FNIDX_SIGMOID,
+    FNIDX_SIGN,
+    FNIDX_RAND,
+    FNIDX_BAND,
+    FNIDX_BOR,
+    FNIDX_BNOT,
+    FNIDX_EQUAL,
+    FNIDX_BELOW,
+    FNIDX_ABOVE,
+    FNIDX_FLOOR,
+    FNIDX_CEIL,
+    FNIDX_INVSQRT,
+    FNIDX_ASSIGN,
+    FNIDX_EXEC2,
+    FNIDX_EXEC3,
+    FNIDX_USER // first NSEEL_addfunc_c function
+};
+
+#define OPCODE_DIRECTVALUE 0
+#define OPCODE_VARPTR 1
+#define OPCODE_FUNC1 2
+#define OPCODE_FUNC2 3
+#define OPCODE_FUNC3 4
+
+// what the parser produces for the code generator, one tree per statement
+typedef struct _opcodeRec {
+    int opcodeType;
+    int fntype; // MATH_SIMPLE or MATH_FN
+    int fn;
+    double value; // OPCODE_DIRECTVALUE
+    double* valuePtr; // OPCODE_VARPTR
+    struct _opcodeRec* parms[3];
+} opcodeRec;
+
+// scalar semantics of the x86 snippets, shared by both backends and the constant folder
+#define NSEEL_CLOSEFACT 0.00001
+#define NSEEL_LESS(a, b) (!((a) >= (b)) ? 1.0 : 0.0) // unordered counts as less, like fcomp
+#define NSEEL_ISFALSE(c) (!(fabs(c) >= NSEEL_CLOSEFACT)) // if() takes the else branch
+#define NSEEL_MIN(a, b) ((((a)-fabs((b) - (a))) + (b)) * 0.5)
+#define NSEEL_MAX(a, b) ((((a) + fabs((b) - (a))) + (b)) * 0.5)
+#define NSEEL_EQUAL(a, b) NSEEL_LESS(fabs((b) - (a)), NSEEL_CLOSEFACT)
+#define NSEEL_BNOT(a) NSEEL_LESS(fabs(a), NSEEL_CLOSEFACT)
+
+// nseel-cfunc.c
+int nseel_f_fistp32(double v);
+double nseel_f_mod(double a, double b);
+double nseel_f_and(double a, double b);
+double nseel_f_or(double a, double b);
+double nseel_f_band(double a, double b);
+double nseel_f_bor(double a, double b);
+double nseel_f_sig(double x, double constraint);
+double nseel_f_sign(double x);
+double nseel_f_invsqrt(double x);
+double nseel_f_rand(double* x);
+
+// returns executable code for the statements, run in order, or NULL
+void* nseel_jit_compile(compileContext* ctx, opcodeRec** stmts, int nstmts, int* codesize);
+void nseel_jit_free(void* code, int codesize);
+
+// bytecode for the same trees, for targets without the code generator or
+// when executable memory is not available
+void* nseel_vm_compile(compileContext* ctx, opcodeRec** stmts, int nstmts, int* codesize);
+void nseel_vm_execute(void* code);
+void nseel_vm_free(void* code);
+
+// structure-of-arrays version for NSEEL_code_execute_batch(), or NULL when
+// the code can't run that way. execute returns 0 if this batch can't
+#define NSEEL_BATCH_LANES 16
+#define NSEEL_BATCH_MAXVARS 256
+void* nseel_batch_compile(compileContext* ctx, opcodeRec** stmts, int nstmts);
+int nseel_batch_execute(void* code, NSEEL_LANEVAR* vars, int nvars, int n);
+int nseel_batch_independent(void* code, NSEEL_LANEVAR* vars, int nvars);
+void nseel_batch_free(void* code);
+#endif
 
 extern double nseel_globalregs[100];
 
@@ -110,7 +210,7 @@ double* nseel_registerVar(compileContext* ctx, char* varName);
 // other shat
 
 int nseel_setVar(compileContext* ctx, int varNum);
-int nseel_getVar(compileContext* ctx, int varNum);
+YYSTYPE nseel_getVar(compileContext* ctx, int varNum);
 void* nseel_compileExpression(compileContext* ctx, char* txt);
 
 #define VALUE 258
@@ -121,7 +221,7 @@ void* nseel_compileExpression(compileContext* ctx, char* txt);
 #define UMINUS 263
 #define UPLUS 264
 
-int nseel_translate(compileContext* ctx, int type);
+YYSTYPE nseel_translate(compileContext* ctx, int type);
 void nseel_count(compileContext* ctx);
 void nseel_setLastVar(compileContext* ctx);
 int nseel_lookup(compileContext* ctx, int* typeOfObject);
@@ -35,9 +35,32 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 extern "C" {
 #endif
 
+// the original compiler pastes together 32-bit x86 snippets (nseel-cfunc.c).
+// on every other target nseel-jit.c generates native code from an expression tree
+#if !defined(_M_IX86) && !defined(NSEEL_JIT)
+#define NSEEL_JIT
+#endif
+
 int NSEEL_init(); // returns 0 on success
 #define NSEEL_addfunction(name, nparms, code, len) NSEEL_addfunctionex((name), (nparms), (code), (len), 0)
 void NSEEL_addfunctionex(char* name, int nparms, int code_startaddr, int code_len, void* pproc);
+#ifdef NSEEL_JIT
+// registers a plain C function: it gets nparms double* arguments (left to right)
+// and returns a double, or a double* lvalue with NSEEL_PFUNC_RETPTR.
+// with NSEEL_PFUNC_WANTCTX the VM's userfunc_data block is passed first.
+#define NSEEL_PFUNC_RETPTR 1
+#define NSEEL_PFUNC_WANTCTX 2
+#define NSEEL_PFUNC_PURE 4 // no side effects, lets per-point code run batched
+void NSEEL_addfunc_c(char* name, int nparms, void* fptr, int flags);
+
+// code compiled afterwards runs as native code when possible (the default) or
+// always in the bytecode interpreter, which needs no executable memory.
+// NSEEL_init() picks the interpreter when the environment has NSEEL_BACKEND=bytecode
+#define NSEEL_BACKEND_NATIVE 0
+#define NSEEL_BACKEND_BYTECODE 1
+void NSEEL_setbackend(int backend);
+int NSEEL_getbackend();
+#endif
 void NSEEL_quit();
 int* NSEEL_getstats(); // returns a pointer to 5 ints... source bytes, static code bytes, call code bytes, data bytes, number of code handles
 double* NSEEL_getglobalregs();
@@ -50,6 +73,8 @@ void NSEEL_VM_free(NSEEL_VMCTX ctx); // free when done with a VM and ALL of its
 
 void NSEEL_VM_resetvars(NSEEL_VMCTX ctx);
 double* NSEEL_VM_regvar(NSEEL_VMCTX ctx, char* name);
+// calls func for every variable of the VM until it returns 0
+void NSEEL_VM_enumallvars(NSEEL_VMCTX ctx, int (*func)(char* name, double* value, void* userctx), void* userctx);
 
 NSEEL_CODEHANDLE NSEEL_code_compile(NSEEL_VMCTX ctx, char* code);
 char* NSEEL_code_getcodeerror(NSEEL_VMCTX ctx);
@@ -57,6 +82,22 @@ void NSEEL_code_execute(NSEEL_CODEHANDLE code);
 void NSEEL_code_free(NSEEL_CODEHANDLE code);
 int* NSEEL_code_getstats(NSEEL_CODEHANDLE code); // 4 ints...source bytes, static code bytes, call code bytes, data bytes
 
+// runs code once per point for n points. before each point the NSEEL_LANE_IN
+// variables are loaded from lanes[point], afterwards the NSEEL_LANE_OUT ones
+// are stored there. when the code allows it several points run at once.
+#define NSEEL_LANE_IN 1
+#define NSEEL_LANE_OUT 2
+typedef struct {
+    double* var; // from NSEEL_VM_regvar()
+    double* lanes; // n values
+    int flags;
+} NSEEL_LANEVAR;
+void NSEEL_code_execute_batch(NSEEL_CODEHANDLE code, NSEEL_LANEVAR* vars, int nvars, int n);
+// nonzero when every point only depends on its NSEEL_LANE_IN variables and
+// nothing the code writes is shared between VMs (reg00-reg99, gmegabuf), so
+// ranges of points can run on copies of the VM at the same time
+int NSEEL_code_independent(NSEEL_CODEHANDLE code, NSEEL_LANEVAR* vars, int nvars);
+
 // configuration:
 
 //#define NSEEL_REENTRANT_EXECUTION
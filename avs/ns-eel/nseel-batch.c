@@ -0,0 +1,826 @@
+// Structure-of-arrays evaluation of per-point code for ns-eel.
+//
+// Effects run the same handle once per point (SuperScope), grid vertex
+// (Dynamic Movement) or table entry (Color Modifier). When the code carries
+// nothing from one point to the next, NSEEL_code_execute_batch() runs it on
+// NSEEL_BATCH_LANES points at a time instead: every register holds one value
+// per lane and every instruction is a short loop over the lanes, which the
+// compiler turns into SSE2/AVX2/NEON code. if() evaluates both branches and
+// selects per lane, assignments inside a branch only land in its lanes.
+//
+// Code is compiled for this along with the scalar version when it only uses
+// operators, builtins other than rand() and loop(), plain variables as
+// assignment targets and functions registered with NSEEL_PFUNC_PURE. Whether
+// a given batch can use it depends on which variables the caller loads per
+// point: a variable written by the code must either be loaded per point or
+// be assigned on every path before it is read, otherwise points depend on
+// each other and the batch runs the scalar code point by point.
+
+#include "ns-eel-int.h"
+#include <math.h>
+#include <string.h>
+#include "platform_shim_redirect.h"
+
+#ifdef NSEEL_JIT
+
+#define LANES NSEEL_BATCH_LANES
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+// picked once at load time by the dynamic linker
+#define BATCH_KERNEL __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef BATCH_KERNEL
+#define BATCH_KERNEL
+#endif
+
+enum {
+    B_MOV,
+    B_ADD,
+    B_SUB,
+    B_MUL,
+    B_DIV,
+    B_NEG,
+    B_ABS,
+    B_SQR,
+    B_SQRT,
+    B_MIN,
+    B_MAX,
+    B_EQUAL,
+    B_BELOW,
+    B_ABOVE,
+    B_BNOT,
+    B_TRUTH, // 1 where if() would take the first branch
+    B_SEL, // d = c ? a : b
+    B_CALL1,
+    B_CALL2,
+    B_UCALL,
+};
+
+typedef struct {
+    int op;
+    int d, a, b, c;
+    union {
+        double (*f1)(double);
+        double (*f2)(double, double);
+        void* fn;
+    } x;
+    int flags, nargs; // B_UCALL
+} bInsn;
+
+typedef struct {
+    double* ptr;
+    int written;
+    int readBeforeDef;
+    int carried; // written, and read on some path before being assigned
+} bVar;
+
+typedef struct {
+    bInsn* insns;
+    int ninsns;
+    bVar* vars; // variable i lives in register i
+    int nvars;
+    int nregs;
+    double (*regs)[LANES];
+    void* regs_alloc;
+    void* ctx;
+} batchProgram;
+
+typedef struct {
+    compileContext* ctx;
+    batchProgram* prog;
+    int insns_alloc, vars_alloc;
+    double* consts;
+    int nconsts, consts_alloc;
+    int maxtemp;
+    char* def; // per variable: assigned on every path so far
+    int error;
+} batchState;
+
+//---------------------------------------------------------------------------------------------------------------
+// registers: variables first, then constants, then temporaries. the counts
+// are only known at the end, so constants and temporaries are encoded and
+// fixed up once everything is generated.
+
+#define REG_CONST(i) (0x10000000 | (i))
+#define REG_TEMP(i) (0x20000000 | (i))
+
+static int varIndex(batchState* s, double* p)
+{
+    batchProgram* prog = s->prog;
+    int i;
+    for (i = 0; i < prog->nvars; i++)
+        if (prog->vars[i].ptr == p)
+            return i;
+    if (prog->nvars >= s->vars_alloc) {
+        int na = s->vars_alloc + 32;
+        bVar* nv = (bVar*)realloc(prog->vars, na * sizeof(bVar));
+        char* nd = (char*)realloc(s->def, na);
+        if (nd)
+            s->def = nd;
+        if (!nv || !nd) {
+            if (nv)
+                prog->vars = nv;
+            s->error = 1;
+            return 0;
+        }
+        prog->vars = nv;
+        s->vars_alloc = na;
+    }
+    memset(prog->vars + prog->nvars, 0, sizeof(bVar));
+    prog->vars[prog->nvars].ptr = p;
+    s->def[prog->nvars] = 0;
+    return prog->nvars++;
+}
+
+static int readVar(batchState* s, double* p)
+{
+    int i = varIndex(s, p);
+    if (!s->error && !s->def[i])
+        s->prog->vars[i].readBeforeDef = 1;
+    return i;
+}
+
+static int constant(batchState* s, double v)
+{
+    int i;
+    for (i = 0; i < s->nconsts; i++)
+        if (!memcmp(&s->consts[i], &v, sizeof(v)))
+            return REG_CONST(i);
+    if (s->nconsts >= s->consts_alloc) {
+        int na = s->consts_alloc + 32;
+        double* nc = (double*)realloc(s->consts, na * sizeof(double));
+        if (!nc) {
+            s->error = 1;
+            return REG_CONST(0);
+        }
+        s->consts = nc;
+        s->consts_alloc = na;
+    }
+    s->consts[s->nconsts] = v;
+    return REG_CONST(s->nconsts++);
+}
+
+static int temp(batchState* s, int r)
+{
+    if (r > s->maxtemp)
+        s->maxtemp = r;
+    return REG_TEMP(r);
+}
+
+static bInsn* emit(batchState* s, int op, int d, int a, int b, int c)
+{
+    static bInsn dummy;
+    batchProgram* prog = s->prog;
+    bInsn* in;
+    if (prog->ninsns >= s->insns_alloc) {
+        int na = s->insns_alloc ? s->insns_alloc * 2 : 64;
+        bInsn* ni = (bInsn*)realloc(prog->insns, na * sizeof(bInsn));
+        if (!ni) {
+            s->error = 1;
+            return &dummy;
+        }
+        prog->insns = ni;
+        s->insns_alloc = na;
+    }
+    in = prog->insns + prog->ninsns++;
+    memset(in, 0, sizeof(bInsn));
+    in->op = op;
+    in->d = d;
+    in->a = a;
+    in->b = b;
+    in->c = c;
+    return in;
+}
+
+static int isVarReg(int reg)
+{
+    return !(reg & (REG_CONST(0) | REG_TEMP(0)));
+}
+
+// whether evaluating op can change a variable
+static int writesVars(opcodeRec* op)
+{
+    int i, np;
+    if (op->opcodeType == OPCODE_DIRECTVALUE || op->opcodeType == OPCODE_VARPTR)
+        return 0;
+    if (op->fntype == MATH_SIMPLE ? op->fn == FN_ASSIGN : op->fn == FNIDX_ASSIGN)
+        return 1;
+    np = op->opcodeType - OPCODE_FUNC1 + 1;
+    for (i = 0; i < np; i++)
+        if (writesVars(op->parms[i]))
+            return 1;
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// code generation. genValue() returns the register holding the value of op,
+// using temporaries r and above. m is the register holding the lanes that
+// take the current if() branches (1.0 or 0.0), or -1 when all of them do.
+
+static int genValue(batchState* s, opcodeRec* op, int r, int m);
+
+static int genOp1(batchState* s, int bop, opcodeRec* op, int r, int m)
+{
+    int a = genValue(s, op->parms[0], r, m);
+    emit(s, bop, temp(s, r), a, 0, 0);
+    return temp(s, r);
+}
+
+static bInsn* genArgs2(batchState* s, int bop, opcodeRec* op, int r, int m)
+{
+    opcodeRec *l = op->parms[0], *rt = op->parms[1];
+    int a, b;
+    if (l->opcodeType == OPCODE_VARPTR) {
+        // read when the instruction runs, after the right side
+        b = genValue(s, rt, r + 1, m);
+        a = readVar(s, l->valuePtr);
+    } else {
+        a = genValue(s, l, r, m);
+        if (isVarReg(a) && writesVars(rt)) {
+            // a is the variable an assignment returned, keep its value
+            emit(s, B_MOV, temp(s, r), a, 0, 0);
+            a = temp(s, r);
+        }
+        b = genValue(s, rt, r + 1, m);
+    }
+    return emit(s, bop, temp(s, r), a, b, 0);
+}
+
+static int genOp2(batchState* s, int bop, opcodeRec* op, int r, int m)
+{
+    genArgs2(s, bop, op, r, m);
+    return temp(s, r);
+}
+
+static int genCall1(batchState* s, double (*fn)(double), opcodeRec* op, int r, int m)
+{
+    int a = genValue(s, op->parms[0], r, m);
+    emit(s, B_CALL1, temp(s, r), a, 0, 0)->x.f1 = fn;
+    return temp(s, r);
+}
+
+static int genCall2(batchState* s, double (*fn)(double, double), opcodeRec* op, int r, int m)
+{
+    genArgs2(s, B_CALL2, op, r, m)->x.f2 = fn;
+    return temp(s, r);
+}
+
+// evaluates everything but the part of op that ends up as its address, like
+// exec2(a, b) passing b itself
+static opcodeRec* lvalueTail(batchState* s, opcodeRec* op, int r, int m)
+{
+    for (;;) {
+        if (op->opcodeType == OPCODE_DIRECTVALUE || op->opcodeType == OPCODE_VARPTR)
+            return op;
+        if (op->fntype == MATH_SIMPLE && op->fn == FN_UPLUS)
+            op = op->parms[0];
+        else if (op->fntype != MATH_SIMPLE && (op->fn == FNIDX_EXEC2 || op->fn == FNIDX_EXEC3)) {
+            int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+            for (i = 0; i < np - 1; i++)
+                genValue(s, op->parms[i], r, m);
+            op = op->parms[np - 1];
+        } else
+            return op;
+    }
+}
+
+static int genUserCall(batchState* s, opcodeRec* op, int r, int m)
+{
+    functionType* f = nseel_getFunctionFromTable(op->fn);
+    int args[3] = { 0, 0, 0 };
+    opcodeRec* late[3] = { NULL, NULL, NULL };
+    int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+    bInsn* in;
+
+    if (!f || !f->afunc || f->func_e || f->nParams != np || !(f->flags & NSEEL_PFUNC_PURE) || (f->flags & NSEEL_PFUNC_RETPTR)) {
+        s->error = 1;
+        return temp(s, r);
+    }
+    // arguments are pointers, so variables are read during the call
+    for (i = 0; i < np; i++) {
+        opcodeRec* a = lvalueTail(s, op->parms[i], r + i, m);
+        if (a->opcodeType == OPCODE_VARPTR) {
+            late[i] = a;
+            continue;
+        }
+        if (a->opcodeType != OPCODE_DIRECTVALUE && a->fntype != MATH_SIMPLE && a->fn == FNIDX_IF && i < np - 1) {
+            // the pointer if() picks would be read late as well
+            int j;
+            for (j = i + 1; j < np; j++)
+                if (writesVars(op->parms[j]))
+                    s->error = 1;
+        }
+        args[i] = genValue(s, a, r + i, m);
+        if (isVarReg(args[i]) && i < np - 1) {
+            emit(s, B_MOV, temp(s, r + i), args[i], 0, 0);
+            args[i] = temp(s, r + i);
+        }
+    }
+    for (i = 0; i < np; i++)
+        if (late[i])
+            args[i] = readVar(s, late[i]->valuePtr);
+
+    in = emit(s, B_UCALL, temp(s, r), args[0], args[1], args[2]);
+    in->x.fn = f->afunc;
+    in->flags = f->flags;
+    in->nargs = np;
+    return temp(s, r);
+}
+
+static int genAssign(batchState* s, opcodeRec* dest, opcodeRec* src, int r, int m)
+{
+    int v, d;
+    while (dest->opcodeType == OPCODE_FUNC1 && dest->fntype == MATH_SIMPLE && dest->fn == FN_UPLUS)
+        dest = dest->parms[0];
+    if (dest->opcodeType != OPCODE_VARPTR) {
+        // if(), exec2() and pointer functions as targets stay scalar
+        s->error = 1;
+        return 0;
+    }
+    v = genValue(s, src, r, m);
+    d = varIndex(s, dest->valuePtr);
+    if (s->error)
+        return d;
+    if (m < 0)
+        emit(s, B_MOV, d, v, 0, 0);
+    else {
+        // lanes on the other branch keep their value, which is a read
+        if (!s->def[d])
+            s->prog->vars[d].readBeforeDef = 1;
+        emit(s, B_SEL, d, v, d, m);
+    }
+    s->def[d] = 1;
+    s->prog->vars[d].written = 1;
+    return d;
+}
+
+static char* saveDef(batchState* s)
+{
+    char* d = (char*)malloc(s->prog->nvars + 1);
+    if (!d)
+        s->error = 1;
+    else
+        memcpy(d, s->def, s->prog->nvars);
+    return d;
+}
+
+static int genIf(batchState* s, opcodeRec* op, int r, int m)
+{
+    // r: condition, r + 1: lanes of the first branch, r + 2: lanes of the
+    // second, r + 3: value of the first, the second is evaluated from r + 4
+    int t = temp(s, r), mt = t, me = temp(s, r + 2), a, b, i;
+    int n0, n1;
+    char *def0, *def1;
+
+    emit(s, B_TRUTH, t, genValue(s, op->parms[0], r, m), 0, 0);
+    emit(s, B_BNOT, me, t, 0, 0);
+    if (m >= 0) {
+        mt = temp(s, r + 1);
+        emit(s, B_MUL, mt, m, t, 0);
+        emit(s, B_MUL, me, me, m, 0);
+    }
+
+    n0 = s->prog->nvars;
+    def0 = saveDef(s);
+    a = genValue(s, op->parms[1], r + 3, mt);
+    n1 = s->prog->nvars;
+    def1 = saveDef(s);
+    if (s->error) {
+        free(def0);
+        free(def1);
+        return t;
+    }
+    // the second branch starts from what was assigned before the if(),
+    // afterwards only what both branches assigned counts
+    memcpy(s->def, def0, n0);
+    memset(s->def + n0, 0, n1 - n0);
+    b = genValue(s, op->parms[2], r + 4, me);
+    if (!s->error)
+        for (i = 0; i < s->prog->nvars; i++)
+            s->def[i] = s->def[i] && i < n1 && def1[i];
+    free(def0);
+    free(def1);
+
+    emit(s, B_SEL, t, a, b, t);
+    return t;
+}
+
+static int genValue(batchState* s, opcodeRec* op, int r, int m)
+{
+    int i;
+
+    if (s->error)
+        return 0;
+
+    switch (op->opcodeType) {
+    case OPCODE_DIRECTVALUE:
+        return constant(s, op->value);
+    case OPCODE_VARPTR:
+        return readVar(s, op->valuePtr);
+    }
+
+    if (op->fntype == MATH_SIMPLE) {
+        switch (op->fn) {
+        case FN_ASSIGN:
+            return genAssign(s, op->parms[0], op->parms[1], r, m);
+        case FN_ADD:
+            return genOp2(s, B_ADD, op, r, m);
+        case FN_SUB:
+            return genOp2(s, B_SUB, op, r, m);
+        case FN_MULTIPLY:
+            return genOp2(s, B_MUL, op, r, m);
+        case FN_DIVIDE:
+            return genOp2(s, B_DIV, op, r, m);
+        case FN_MODULO:
+            return genCall2(s, nseel_f_mod, op, r, m);
+        case FN_AND:
+            return genCall2(s, nseel_f_and, op, r, m);
+        case FN_OR:
+            return genCall2(s, nseel_f_or, op, r, m);
+        case FN_UMINUS:
+            return genOp1(s, B_NEG, op, r, m);
+        case FN_UPLUS:
+            return genValue(s, op->parms[0], r, m);
+        }
+        s->error = 1;
+        return 0;
+    }
+
+    switch (op->fn) {
+    case FNIDX_IF:
+        return genIf(s, op, r, m);
+    case FNIDX_SIN:
+        return genCall1(s, sin, op, r, m);
+    case FNIDX_COS:
+        return genCall1(s, cos, op, r, m);
+    case FNIDX_TAN:
+        return genCall1(s, tan, op, r, m);
+    case FNIDX_ASIN:
+        return genCall1(s, asin, op, r, m);
+    case FNIDX_ACOS:
+        return genCall1(s, acos, op, r, m);
+    case FNIDX_ATAN:
+        return genCall1(s, atan, op, r, m);
+    case FNIDX_ATAN2:
+        return genCall2(s, atan2, op, r, m);
+    case FNIDX_SQR:
+        return genOp1(s, B_SQR, op, r, m);
+    case FNIDX_SQRT:
+        return genOp1(s, B_SQRT, op, r, m);
+    case FNIDX_POW:
+        return genCall2(s, pow, op, r, m);
+    case FNIDX_EXP:
+        return genCall1(s, exp, op, r, m);
+    case FNIDX_LOG:
+        return genCall1(s, log, op, r, m);
+    case FNIDX_LOG10:
+        return genCall1(s, log10, op, r, m);
+    case FNIDX_ABS:
+        return genOp1(s, B_ABS, op, r, m);
+    case FNIDX_MIN:
+        return genOp2(s, B_MIN, op, r, m);
+    case FNIDX_MAX:
+        return genOp2(s, B_MAX, op, r, m);
+    case FNIDX_SIGMOID:
+        return genCall2(s, nseel_f_sig, op, r, m);
+    case FNIDX_SIGN:
+        return genCall1(s, nseel_f_sign, op, r, m);
+    case FNIDX_BAND:
+        return genCall2(s, nseel_f_band, op, r, m);
+    case FNIDX_BOR:
+        return genCall2(s, nseel_f_bor, op, r, m);
+    case FNIDX_BNOT:
+        return genOp1(s, B_BNOT, op, r, m);
+    case FNIDX_EQUAL:
+        return genOp2(s, B_EQUAL, op, r, m);
+    case FNIDX_BELOW:
+        return genOp2(s, B_BELOW, op, r, m);
+    case FNIDX_ABOVE:
+        return genOp2(s, B_ABOVE, op, r, m);
+    case FNIDX_FLOOR:
+        return genCall1(s, floor, op, r, m);
+    case FNIDX_CEIL:
+        return genCall1(s, ceil, op, r, m);
+    case FNIDX_INVSQRT:
+        return genCall1(s, nseel_f_invsqrt, op, r, m);
+    case FNIDX_ASSIGN:
+        return genAssign(s, op->parms[0], op->parms[1], r, m);
+    case FNIDX_EXEC2:
+    case FNIDX_EXEC3: {
+        int np = op->opcodeType - OPCODE_FUNC1 + 1;
+        for (i = 0; i < np - 1; i++)
+            genValue(s, op->parms[i], r, m);
+        return genValue(s, op->parms[np - 1], r, m);
+    }
+    }
+
+    if (op->fn >= FNIDX_USER)
+        return genUserCall(s, op, r, m);
+    // rand() and loop(): the order of their effects across points matters
+    s->error = 1;
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+#if defined(__clang__)
+#define FOR_LANES(k) _Pragma("clang loop vectorize(assume_safety)") for (k = 0; k < LANES; k++)
+#elif defined(__GNUC__)
+#define FOR_LANES(k) _Pragma("GCC ivdep") for (k = 0; k < LANES; k++)
+#else
+#define FOR_LANES(k) for (k = 0; k < LANES; k++)
+#endif
+
+// the context pointer goes through a double* parameter like in nseel-vm.c
+typedef double (*ucall1)(double*);
+typedef double (*ucall2)(double*, double*);
+typedef double (*ucall3)(double*, double*, double*);
+typedef double (*ucall4)(double*, double*, double*, double*);
+
+static void callLanes(const bInsn* in, double* d, double* a, double* b, double* c, void* ctx)
+{
+    int k;
+    if (in->flags & NSEEL_PFUNC_WANTCTX) {
+        double* x = (double*)ctx;
+        for (k = 0; k < LANES; k++)
+            switch (in->nargs) {
+            case 1:
+                d[k] = ((ucall2)in->x.fn)(x, a + k);
+                break;
+            case 2:
+                d[k] = ((ucall3)in->x.fn)(x, a + k, b + k);
+                break;
+            default:
+                d[k] = ((ucall4)in->x.fn)(x, a + k, b + k, c + k);
+                break;
+            }
+    } else {
+        for (k = 0; k < LANES; k++)
+            switch (in->nargs) {
+            case 1:
+                d[k] = ((ucall1)in->x.fn)(a + k);
+                break;
+            case 2:
+                d[k] = ((ucall2)in->x.fn)(a + k, b + k);
+                break;
+            default:
+                d[k] = ((ucall3)in->x.fn)(a + k, b + k, c + k);
+                break;
+            }
+    }
+}
+
+// every operand is a full row of lanes; d may be any of the sources, which is
+// fine for lane-wise loops
+BATCH_KERNEL static void runBatch(const batchProgram* p)
+{
+    double(*R)[LANES] = p->regs;
+    const bInsn* in = p->insns;
+    const bInsn* end = in + p->ninsns;
+    int k;
+
+    for (; in < end; in++) {
+        double* d = R[in->d];
+        double* a = R[in->a];
+        double* b = R[in->b];
+        double* c = R[in->c];
+        switch (in->op) {
+        case B_MOV:
+            FOR_LANES(k)
+            d[k] = a[k];
+            break;
+        case B_ADD:
+            FOR_LANES(k)
+            d[k] = a[k] + b[k];
+            break;
+        case B_SUB:
+            FOR_LANES(k)
+            d[k] = a[k] - b[k];
+            break;
+        case B_MUL:
+            FOR_LANES(k)
+            d[k] = a[k] * b[k];
+            break;
+        case B_DIV:
+            FOR_LANES(k)
+            d[k] = a[k] / b[k];
+            break;
+        case B_NEG:
+            FOR_LANES(k)
+            d[k] = -a[k];
+            break;
+        case B_ABS:
+            FOR_LANES(k)
+            d[k] = fabs(a[k]);
+            break;
+        case B_SQR:
+            FOR_LANES(k)
+            d[k] = a[k] * a[k];
+            break;
+        case B_SQRT:
+            FOR_LANES(k)
+            d[k] = sqrt(fabs(a[k]));
+            break;
+        case B_MIN:
+            FOR_LANES(k)
+            d[k] = NSEEL_MIN(a[k], b[k]);
+            break;
+        case B_MAX:
+            FOR_LANES(k)
+            d[k] = NSEEL_MAX(a[k], b[k]);
+            break;
+        case B_EQUAL:
+            FOR_LANES(k)
+            d[k] = NSEEL_EQUAL(a[k], b[k]);
+            break;
+        case B_BELOW:
+            FOR_LANES(k)
+            d[k] = NSEEL_LESS(a[k], b[k]);
+            break;
+        case B_ABOVE:
+            FOR_LANES(k)
+            d[k] = NSEEL_LESS(b[k], a[k]);
+            break;
+        case B_BNOT:
+            FOR_LANES(k)
+            d[k] = NSEEL_BNOT(a[k]);
+            break;
+        case B_TRUTH:
+            FOR_LANES(k)
+            d[k] = NSEEL_ISFALSE(a[k]) ? 0.0 : 1.0;
+            break;
+        case B_SEL:
+            FOR_LANES(k)
+            d[k] = c[k] != 0.0 ? a[k] : b[k];
+            break;
+        case B_CALL1:
+            for (k = 0; k < LANES; k++)
+                d[k] = in->x.f1(a[k]);
+            break;
+        case B_CALL2:
+            for (k = 0; k < LANES; k++)
+                d[k] = in->x.f2(a[k], b[k]);
+            break;
+        case B_UCALL:
+            callLanes(in, d, a, b, c, p->ctx);
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+static int fixReg(batchState* s, int reg)
+{
+    if (reg & REG_TEMP(0))
+        return s->prog->nvars + s->nconsts + (reg & 0x0fffffff);
+    if (reg & REG_CONST(0))
+        return s->prog->nvars + (reg & 0x0fffffff);
+    return reg;
+}
+
+void* nseel_batch_compile(compileContext* ctx, opcodeRec** stmts, int nstmts)
+{
+    batchState s;
+    batchProgram* prog;
+    int i, k;
+
+    memset(&s, 0, sizeof(s));
+    prog = (batchProgram*)calloc(1, sizeof(batchProgram));
+    if (!prog)
+        return 0;
+    s.ctx = ctx;
+    s.prog = prog;
+    prog->ctx = ctx->userfunc_data;
+
+    for (i = 0; i < nstmts && !s.error; i++)
+        genValue(&s, stmts[i], 0, -1);
+
+    if (!s.error) {
+        // a variable assigned on only some paths keeps the previous point's
+        // value on the others
+        for (i = 0; i < prog->nvars; i++)
+            prog->vars[i].carried = prog->vars[i].written && (prog->vars[i].readBeforeDef || !s.def[i]);
+
+        prog->nregs = prog->nvars + s.nconsts + s.maxtemp + 1;
+        prog->regs_alloc = malloc(prog->nregs * sizeof(prog->regs[0]) + 63);
+        if (!prog->regs_alloc)
+            s.error = 1;
+    }
+    if (s.error) {
+        free(s.consts);
+        free(s.def);
+        nseel_batch_free(prog);
+        return 0;
+    }
+
+    prog->regs = (double(*)[LANES])(((uintptr_t)prog->regs_alloc + 63) & ~(uintptr_t)63);
+    for (i = 0; i < s.nconsts; i++)
+        for (k = 0; k < LANES; k++)
+            prog->regs[prog->nvars + i][k] = s.consts[i];
+    for (i = 0; i < prog->ninsns; i++) {
+        bInsn* in = prog->insns + i;
+        in->d = fixReg(&s, in->d);
+        in->a = fixReg(&s, in->a);
+        in->b = fixReg(&s, in->b);
+        in->c = fixReg(&s, in->c);
+    }
+
+    free(s.consts);
+    free(s.def);
+    return prog;
+}
+
+int nseel_batch_independent(void* code, NSEEL_LANEVAR* lv, int nlv)
+{
+    batchProgram* p = (batchProgram*)code;
+    int i, j;
+    for (i = 0; i < p->nvars; i++) {
+        int in = 0;
+        if (p->vars[i].written && p->vars[i].ptr >= nseel_globalregs && p->vars[i].ptr < nseel_globalregs + 100)
+            return 0;
+        for (j = 0; j < nlv; j++)
+            if (lv[j].var == p->vars[i].ptr && (lv[j].flags & NSEEL_LANE_IN))
+                in = 1;
+        if (!in && p->vars[i].carried)
+            return 0;
+    }
+    return 1;
+}
+
+int nseel_batch_execute(void* code, NSEEL_LANEVAR* lv, int nlv, int n)
+{
+    batchProgram* p = (batchProgram*)code;
+    double(*R)[LANES] = p->regs;
+    int src[NSEEL_BATCH_MAXVARS]; // program variable -> lane array loaded per point
+    int dst[NSEEL_BATCH_MAXVARS]; // lane variable -> program variable
+    int i, j, k, k0, cnt = 0;
+
+    if (p->nvars > NSEEL_BATCH_MAXVARS || nlv > NSEEL_BATCH_MAXVARS)
+        return 0;
+    for (i = 0; i < p->nvars; i++) {
+        src[i] = -1;
+        for (j = 0; j < nlv; j++)
+            if (lv[j].var == p->vars[i].ptr && (lv[j].flags & NSEEL_LANE_IN))
+                src[i] = j;
+        if (src[i] < 0 && p->vars[i].carried)
+            return 0; // one point would see what the previous one left
+    }
+    for (j = 0; j < nlv; j++) {
+        dst[j] = -1;
+        for (i = 0; i < p->nvars; i++)
+            if (lv[j].var == p->vars[i].ptr)
+                dst[j] = i;
+    }
+
+    // nothing writes the other variables, they are the same for every point
+    for (i = 0; i < p->nvars; i++)
+        if (src[i] < 0)
+            for (k = 0; k < LANES; k++)
+                R[i][k] = *p->vars[i].ptr;
+
+    for (k0 = 0; k0 < n; k0 += LANES) {
+        cnt = n - k0 < LANES ? n - k0 : LANES;
+        for (i = 0; i < p->nvars; i++)
+            if (src[i] >= 0) {
+                const double* l = lv[src[i]].lanes + k0;
+                for (k = 0; k < LANES; k++)
+                    R[i][k] = l[k < cnt ? k : cnt - 1];
+            }
+
+        runBatch(p);
+
+        for (j = 0; j < nlv; j++) {
+            double* l = lv[j].lanes + k0;
+            if (!(lv[j].flags & NSEEL_LANE_OUT))
+                continue;
+            if (dst[j] >= 0)
+                memcpy(l, R[dst[j]], cnt * sizeof(double));
+            else if (!(lv[j].flags & NSEEL_LANE_IN))
+                for (k = 0; k < cnt; k++)
+                    l[k] = *lv[j].var;
+        }
+    }
+
+    // leave the variables as the last point did
+    for (i = 0; i < p->nvars; i++)
+        if (src[i] >= 0 || p->vars[i].written)
+            *p->vars[i].ptr = R[i][cnt - 1];
+    for (j = 0; j < nlv; j++)
+        if (dst[j] < 0 && (lv[j].flags & NSEEL_LANE_IN))
+            *lv[j].var = lv[j].lanes[n - 1];
+    return 1;
+}
+
+void nseel_batch_free(void* code)
+{
+    batchProgram* p = (batchProgram*)code;
+    if (p) {
+        free(p->insns);
+        free(p->vars);
+        free(p->regs_alloc);
+        free(p);
+    }
+}
+
+#endif // NSEEL_JIT
@@ -37,7 +37,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define FUNCTION3 262
 #define UMINUS 263
 #define UPLUS 264
-#define YYSTYPE int
 
 #define YYERROR(x) nseel_yyerror(ctx)
 
@@ -329,9 +328,9 @@ yyreduce:
         {
             {
                 int i = (int)nseel_setVar(ctx, (int)yyvsp[-2]);
-                int v = nseel_getVar(ctx, i);
+                YYSTYPE v = nseel_getVar(ctx, i);
 
-                yyval = nseel_createCompiledFunction2(ctx, MATH_SIMPLE, FN_ASSIGN, v, (int)yyvsp[0]);
+                yyval = nseel_createCompiledFunction2(ctx, MATH_SIMPLE, FN_ASSIGN, v, yyvsp[0]);
                 ctx->result = yyval;
             };
             break;
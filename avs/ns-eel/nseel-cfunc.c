@@ -30,7 +30,10 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ns-eel-int.h"
 #include <math.h>
-#include "../platform_shim_redirect.h"
+#include <string.h>
+#include "platform_shim_redirect.h"
+
+#ifndef NSEEL_JIT // the code generator in nseel-jit.c replaces these snippets
 
 // these are used by our assembly code
 static float g_cmpaddtab[2] = { 0.0, 1.0 };
@@ -756,3 +759,93 @@ __declspec(naked) void nseel_asm_max(void)
     }
 }
 __declspec(naked) void nseel_asm_max_end(void) { }
+
+#else // NSEEL_JIT
+
+// the snippets above that are more than a few instructions, as plain C for
+// the code generator and the bytecode interpreter
+
+//---------------------------------------------------------------------------------------------------------------
+int nseel_f_fistp32(double v)
+{
+    // fistp: round to nearest, "integer indefinite" when out of range
+    if (!(v > -2147483648.5 && v < 2147483647.5))
+        return (int)0x80000000;
+    return (int)rint(v);
+}
+
+static int64_t fistp64(double v)
+{
+    if (!(v >= -9223372036854775808.0 && v < 9223372036854775808.0))
+        return INT64_MIN;
+    return (int64_t)rint(v);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_mod(double a, double b)
+{
+    unsigned int d = (unsigned int)nseel_f_fistp32((fabs(b - 1.0) + b + 1.0) * 0.5);
+    unsigned int n = (unsigned int)nseel_f_fistp32(a);
+    return d ? (double)(int)(n % d) : 0.0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_and(double a, double b)
+{
+    return (double)(fistp64(a) & fistp64(b));
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_or(double a, double b)
+{
+    return (double)(fistp64(a) | fistp64(b));
+}
+
+#define isnonzero(x) (fabs(x) > NSEEL_CLOSEFACT)
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_band(double a, double b)
+{
+    return isnonzero(a) && isnonzero(b) ? 1 : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_bor(double a, double b)
+{
+    return isnonzero(a) || isnonzero(b) ? 1 : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_sig(double x, double constraint)
+{
+    double t = (1 + exp(-x * constraint));
+    return isnonzero(t) ? 1.0 / t : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_sign(double x)
+{
+    if (x == 0.0)
+        return x;
+    return signbit(x) ? -1.0 : 1.0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_invsqrt(double x)
+{
+    float y = (float)x;
+    int32_t i;
+    memcpy(&i, &y, sizeof(i));
+    i = 0x5f3759df - (i >> 1);
+    memcpy(&y, &i, sizeof(y));
+    return (x * -0.5 * y * y + 1.5) * y;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+double nseel_f_rand(double* x)
+{
+    if (*x < 1.0)
+        *x = 1.0;
+    return (double)(rand() % (int)max(*x, 1.0));
+}
+#endif
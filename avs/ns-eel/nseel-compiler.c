@@ -29,7 +29,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "ns-eel-int.h"
-#include "../platform_shim_redirect.h"
+#include <math.h>
+#include "platform_shim_redirect.h"
 
 #ifdef NSEEL_REENTRANT_EXECUTION
 #include <malloc.h>
@@ -48,7 +49,7 @@ double* NSEEL_getglobalregs()
 #define LLB_DSIZE (65536 - 64)
 typedef struct _llBlock {
     struct _llBlock* next;
-    int sizeused;
+    intptr_t sizeused; // keeps block[] 8-byte aligned on 64-bit
     char block[LLB_DSIZE];
 } llBlock;
 
@@ -62,6 +63,9 @@ typedef struct {
 
     llBlock* blocks;
     void* code;
+    int code_size; // generated code lives outside of blocks with NSEEL_JIT
+    void* vmcode; // bytecode, when the code generator wasn't used
+    void* batchcode; // NSEEL_code_execute_batch() version, if there is one
     int code_stats[4];
 } codeHandleType;
 
@@ -76,9 +80,16 @@ static void* __newBlock(llBlock** start, int size);
 
 static void freeBlocks(llBlock* start);
 
+#ifdef NSEEL_JIT
+// no snippets, nseel-jit.c generates the builtins from their table index
+#define DECL_ASMFUNC(x)
+#define NSEEL_FUNC(x) 0, 0
+#else
 #define DECL_ASMFUNC(x)         \
     void nseel_asm_##x##(void); \
     void nseel_asm_##x##_end(void);
+#define NSEEL_FUNC(x) nseel_asm_##x, nseel_asm_##x##_end
+#endif
 
 DECL_ASMFUNC(sin)
 DECL_ASMFUNC(cos)
@@ -124,41 +135,41 @@ DECL_ASMFUNC(invsqrt)
 DECL_ASMFUNC(exec2)
 
 static functionType fnTable1[] = {
-    { "if", nseel_asm_if, nseel_asm_if_end, 3 },
+    { "if", NSEEL_FUNC(if), 3 },
 #ifdef NSEEL_LOOPFUNC_SUPPORT
-    { "loop", nseel_asm_repeat, nseel_asm_repeat_end, 2 },
+    { "loop", NSEEL_FUNC(repeat), 2 },
 #endif
-    { "sin", nseel_asm_sin, nseel_asm_sin_end, 1 },
-    { "cos", nseel_asm_cos, nseel_asm_cos_end, 1 },
-    { "tan", nseel_asm_tan, nseel_asm_tan_end, 1 },
-    { "asin", nseel_asm_asin, nseel_asm_asin_end, 1 },
-    { "acos", nseel_asm_acos, nseel_asm_acos_end, 1 },
-    { "atan", nseel_asm_atan, nseel_asm_atan_end, 1 },
-    { "atan2", nseel_asm_atan2, nseel_asm_atan2_end, 2 },
-    { "sqr", nseel_asm_sqr, nseel_asm_sqr_end, 1 },
-    { "sqrt", nseel_asm_sqrt, nseel_asm_sqrt_end, 1 },
-    { "pow", nseel_asm_pow, nseel_asm_pow_end, 2 },
-    { "exp", nseel_asm_exp, nseel_asm_exp_end, 1 },
-    { "log", nseel_asm_log, nseel_asm_log_end, 1 },
-    { "log10", nseel_asm_log10, nseel_asm_log10_end, 1 },
-    { "abs", nseel_asm_abs, nseel_asm_abs_end, 1 },
-    { "min", nseel_asm_min, nseel_asm_min_end, 2 },
-    { "max", nseel_asm_max, nseel_asm_max_end, 2 },
-    { "sigmoid", nseel_asm_sig, nseel_asm_sig_end, 2 },
-    { "sign", nseel_asm_sign, nseel_asm_sign_end, 1 },
-    { "rand", nseel_asm_rand, nseel_asm_rand_end, 1 },
-    { "band", nseel_asm_band, nseel_asm_band_end, 2 },
-    { "bor", nseel_asm_bor, nseel_asm_bor_end, 2 },
-    { "bnot", nseel_asm_bnot, nseel_asm_bnot_end, 1 },
-    { "equal", nseel_asm_equal, nseel_asm_equal_end, 2 },
-    { "below", nseel_asm_below, nseel_asm_below_end, 2 },
-    { "above", nseel_asm_above, nseel_asm_above_end, 2 },
-    { "floor", nseel_asm_floor, nseel_asm_floor_end, 1 },
-    { "ceil", nseel_asm_ceil, nseel_asm_ceil_end, 1 },
-    { "invsqrt", nseel_asm_invsqrt, nseel_asm_invsqrt_end, 1 },
-    { "assign", nseel_asm_assign, nseel_asm_assign_end, 2 },
-    { "exec2", nseel_asm_exec2, nseel_asm_exec2_end, 2 },
-    { "exec3", nseel_asm_exec2, nseel_asm_exec2_end, 3 },
+    { "sin", NSEEL_FUNC(sin), 1 },
+    { "cos", NSEEL_FUNC(cos), 1 },
+    { "tan", NSEEL_FUNC(tan), 1 },
+    { "asin", NSEEL_FUNC(asin), 1 },
+    { "acos", NSEEL_FUNC(acos), 1 },
+    { "atan", NSEEL_FUNC(atan), 1 },
+    { "atan2", NSEEL_FUNC(atan2), 2 },
+    { "sqr", NSEEL_FUNC(sqr), 1 },
+    { "sqrt", NSEEL_FUNC(sqrt), 1 },
+    { "pow", NSEEL_FUNC(pow), 2 },
+    { "exp", NSEEL_FUNC(exp), 1 },
+    { "log", NSEEL_FUNC(log), 1 },
+    { "log10", NSEEL_FUNC(log10), 1 },
+    { "abs", NSEEL_FUNC(abs), 1 },
+    { "min", NSEEL_FUNC(min), 2 },
+    { "max", NSEEL_FUNC(max), 2 },
+    { "sigmoid", NSEEL_FUNC(sig), 2 },
+    { "sign", NSEEL_FUNC(sign), 1 },
+    { "rand", NSEEL_FUNC(rand), 1 },
+    { "band", NSEEL_FUNC(band), 2 },
+    { "bor", NSEEL_FUNC(bor), 2 },
+    { "bnot", NSEEL_FUNC(bnot), 1 },
+    { "equal", NSEEL_FUNC(equal), 2 },
+    { "below", NSEEL_FUNC(below), 2 },
+    { "above", NSEEL_FUNC(above), 2 },
+    { "floor", NSEEL_FUNC(floor), 1 },
+    { "ceil", NSEEL_FUNC(ceil), 1 },
+    { "invsqrt", NSEEL_FUNC(invsqrt), 1 },
+    { "assign", NSEEL_FUNC(assign), 2 },
+    { "exec2", NSEEL_FUNC(exec2), 2 },
+    { "exec3", NSEEL_FUNC(exec2), 3 },
 };
 
 static functionType* fnTableUser;
@@ -177,9 +188,30 @@ functionType* nseel_getFunctionFromTable(int idx)
     return fnTable1 + idx;
 }
 
+#ifdef NSEEL_JIT
+static int nseel_backend = NSEEL_BACKEND_NATIVE;
+
+void NSEEL_setbackend(int backend)
+{
+    nseel_backend = backend;
+}
+
+int NSEEL_getbackend()
+{
+    return nseel_backend;
+}
+#endif
+
 int NSEEL_init() // returns 0 on success
 {
     NSEEL_quit();
+#ifdef NSEEL_JIT
+    {
+        const char* b = getenv("NSEEL_BACKEND");
+        if (b && !strcmpi(b, "bytecode"))
+            nseel_backend = NSEEL_BACKEND_BYTECODE;
+    }
+#endif
     return 0;
 }
 
@@ -191,13 +223,32 @@ void NSEEL_addfunctionex(char* name, int nparms, int code_startaddr, int code_le
     if (fnTableUser) {
         fnTableUser[fnTableUser_size].nParams = nparms;
         fnTableUser[fnTableUser_size].name = name;
-        fnTableUser[fnTableUser_size].afunc = (void*)code_startaddr;
-        fnTableUser[fnTableUser_size].func_e = (void*)(code_startaddr + code_len);
+        fnTableUser[fnTableUser_size].afunc = (void*)(intptr_t)code_startaddr;
+        fnTableUser[fnTableUser_size].func_e = (void*)(intptr_t)(code_startaddr + code_len);
         fnTableUser[fnTableUser_size].pProc = (NSEEL_PPPROC)pproc;
+        fnTableUser[fnTableUser_size].flags = 0;
         fnTableUser_size++;
     }
 }
 
+#ifdef NSEEL_JIT
+void NSEEL_addfunc_c(char* name, int nparms, void* fptr, int flags)
+{
+    if (!fnTableUser || !(fnTableUser_size & 7)) {
+        fnTableUser = (functionType*)realloc(fnTableUser, (fnTableUser_size + 8) * sizeof(functionType));
+    }
+    if (fnTableUser) {
+        fnTableUser[fnTableUser_size].nParams = nparms;
+        fnTableUser[fnTableUser_size].name = name;
+        fnTableUser[fnTableUser_size].afunc = fptr;
+        fnTableUser[fnTableUser_size].func_e = 0; // not an x86 snippet
+        fnTableUser[fnTableUser_size].pProc = 0;
+        fnTableUser[fnTableUser_size].flags = flags;
+        fnTableUser_size++;
+    }
+}
+#endif
+
 void NSEEL_quit()
 {
     free(fnTableUser);
@@ -205,6 +256,7 @@ void NSEEL_quit()
     fnTableUser = 0;
 }
 
+#ifndef NSEEL_JIT
 //---------------------------------------------------------------------------------------------------------------
 static void* realAddress(void* fn, void* fn_e, int* size)
 {
@@ -223,6 +275,7 @@ static void* realAddress(void* fn, void* fn_e, int* size)
     return fn;
 #endif
 }
+#endif
 
 //---------------------------------------------------------------------------------------------------------------
 static void freeBlocks(llBlock* start)
@@ -255,6 +308,7 @@ static void* __newBlock(llBlock** start, int size)
     return llb->block;
 }
 
+#ifndef NSEEL_JIT
 #define X86_MOV_EAX_DIRECTVALUE 0xB8
 #define X86_MOV_ESI_DIRECTVALUE 0xBE
 #define X86_MOV_ESI_DIRECTMEMVALUE 0x358B
@@ -277,7 +331,7 @@ static int* findFBlock(char* p)
 }
 
 //---------------------------------------------------------------------------------------------------------------
-int nseel_createCompiledValue(compileContext* ctx, double value, double* addrValue)
+YYSTYPE nseel_createCompiledValue(compileContext* ctx, double value, double* addrValue)
 {
     unsigned char* block;
     double* dupValue;
@@ -341,7 +395,7 @@ static int nseel_getFunctionAddress(int fntype, int fn, int* size, NSEEL_PPPROC*
 }
 
 //---------------------------------------------------------------------------------------------------------------
-int nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, int code1, int code2, int code3)
+YYSTYPE nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2, YYSTYPE code3)
 {
     int sizes1 = ((int*)code1)[0];
     int sizes2 = ((int*)code2)[0];
@@ -418,7 +472,7 @@ int nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, int c
 }
 
 //---------------------------------------------------------------------------------------------------------------
-int nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, int code1, int code2)
+YYSTYPE nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2)
 {
     int size2;
     unsigned char* block;
@@ -484,7 +538,7 @@ int nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, int c
 }
 
 //---------------------------------------------------------------------------------------------------------------
-int nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, int code)
+YYSTYPE nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, YYSTYPE code)
 {
     NSEEL_PPPROC preProc;
     int size, size2;
@@ -510,6 +564,226 @@ int nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, int c
     return ((int)(block));
 }
 
+#else // NSEEL_JIT
+
+//---------------------------------------------------------------------------------------------------------------
+static opcodeRec* newOpcode(compileContext* ctx, int type, int fntype, int fn)
+{
+    opcodeRec* op = (opcodeRec*)newTmpBlock(sizeof(opcodeRec));
+    memset(op, 0, sizeof(opcodeRec));
+    op->opcodeType = type;
+    op->fntype = fntype;
+    op->fn = fn;
+    return op;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+YYSTYPE nseel_createCompiledValue(compileContext* ctx, double value, double* addrValue)
+{
+    opcodeRec* op = newOpcode(ctx, addrValue ? OPCODE_VARPTR : OPCODE_DIRECTVALUE, 0, 0);
+    op->value = value;
+    op->valuePtr = addrValue;
+    return (YYSTYPE)op;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+YYSTYPE nseel_createCompiledFunction3(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2, YYSTYPE code3)
+{
+    opcodeRec* op = newOpcode(ctx, OPCODE_FUNC3, fntype, fn);
+    op->parms[0] = (opcodeRec*)code1;
+    op->parms[1] = (opcodeRec*)code2;
+    op->parms[2] = (opcodeRec*)code3;
+    ctx->computTableTop++;
+    return (YYSTYPE)op;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+YYSTYPE nseel_createCompiledFunction2(compileContext* ctx, int fntype, int fn, YYSTYPE code1, YYSTYPE code2)
+{
+    opcodeRec* op = newOpcode(ctx, OPCODE_FUNC2, fntype, fn);
+    op->parms[0] = (opcodeRec*)code1;
+    op->parms[1] = (opcodeRec*)code2;
+    ctx->computTableTop++;
+    return (YYSTYPE)op;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+YYSTYPE nseel_createCompiledFunction1(compileContext* ctx, int fntype, int fn, YYSTYPE code)
+{
+    opcodeRec* op = newOpcode(ctx, OPCODE_FUNC1, fntype, fn);
+    op->parms[0] = (opcodeRec*)code;
+    ctx->computTableTop++;
+    return (YYSTYPE)op;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// constant folding, shared by both backends. only operators and builtins
+// without side effects fold; if() and exec2() drop what a constant makes dead.
+
+static int foldValue(opcodeRec* op, double* v)
+{
+    double a = op->parms[0]->value;
+    double b = op->opcodeType >= OPCODE_FUNC2 ? op->parms[1]->value : 0.0;
+
+    if (op->fntype == MATH_SIMPLE) {
+        switch (op->fn) {
+        case FN_MULTIPLY:
+            *v = a * b;
+            return 1;
+        case FN_DIVIDE:
+            *v = a / b;
+            return 1;
+        case FN_MODULO:
+            *v = nseel_f_mod(a, b);
+            return 1;
+        case FN_ADD:
+            *v = a + b;
+            return 1;
+        case FN_SUB:
+            *v = a - b;
+            return 1;
+        case FN_AND:
+            *v = nseel_f_and(a, b);
+            return 1;
+        case FN_OR:
+            *v = nseel_f_or(a, b);
+            return 1;
+        case FN_UMINUS:
+            *v = -a;
+            return 1;
+        case FN_UPLUS:
+            *v = a;
+            return 1;
+        }
+        return 0;
+    }
+
+    switch (op->fn) {
+    case FNIDX_SIN:
+        *v = sin(a);
+        return 1;
+    case FNIDX_COS:
+        *v = cos(a);
+        return 1;
+    case FNIDX_TAN:
+        *v = tan(a);
+        return 1;
+    case FNIDX_ASIN:
+        *v = asin(a);
+        return 1;
+    case FNIDX_ACOS:
+        *v = acos(a);
+        return 1;
+    case FNIDX_ATAN:
+        *v = atan(a);
+        return 1;
+    case FNIDX_ATAN2:
+        *v = atan2(a, b);
+        return 1;
+    case FNIDX_SQR:
+        *v = a * a;
+        return 1;
+    case FNIDX_SQRT:
+        *v = sqrt(fabs(a));
+        return 1;
+    case FNIDX_POW:
+        *v = pow(a, b);
+        return 1;
+    case FNIDX_EXP:
+        *v = exp(a);
+        return 1;
+    case FNIDX_LOG:
+        *v = log(a);
+        return 1;
+    case FNIDX_LOG10:
+        *v = log10(a);
+        return 1;
+    case FNIDX_ABS:
+        *v = fabs(a);
+        return 1;
+    case FNIDX_MIN:
+        *v = NSEEL_MIN(a, b);
+        return 1;
+    case FNIDX_MAX:
+        *v = NSEEL_MAX(a, b);
+        return 1;
+    case FNIDX_SIGMOID:
+        *v = nseel_f_sig(a, b);
+        return 1;
+    case FNIDX_SIGN:
+        *v = nseel_f_sign(a);
+        return 1;
+    case FNIDX_BAND:
+        *v = nseel_f_band(a, b);
+        return 1;
+    case FNIDX_BOR:
+        *v = nseel_f_bor(a, b);
+        return 1;
+    case FNIDX_BNOT:
+        *v = NSEEL_BNOT(a);
+        return 1;
+    case FNIDX_EQUAL:
+        *v = NSEEL_EQUAL(a, b);
+        return 1;
+    case FNIDX_BELOW:
+        *v = NSEEL_LESS(a, b);
+        return 1;
+    case FNIDX_ABOVE:
+        *v = NSEEL_LESS(b, a);
+        return 1;
+    case FNIDX_FLOOR:
+        *v = floor(a);
+        return 1;
+    case FNIDX_CEIL:
+        *v = ceil(a);
+        return 1;
+    case FNIDX_INVSQRT:
+        *v = nseel_f_invsqrt(a);
+        return 1;
+    }
+    return 0;
+}
+
+static opcodeRec* foldConstants(opcodeRec* op)
+{
+    int i, np, allconst = 1;
+    double v;
+
+    if (op->opcodeType == OPCODE_DIRECTVALUE || op->opcodeType == OPCODE_VARPTR)
+        return op;
+    np = op->opcodeType - OPCODE_FUNC1 + 1;
+    for (i = 0; i < np; i++) {
+        op->parms[i] = foldConstants(op->parms[i]);
+        if (op->parms[i]->opcodeType != OPCODE_DIRECTVALUE)
+            allconst = 0;
+    }
+
+    if (op->fntype == MATH_FN) {
+        if (op->fn == FNIDX_IF && op->parms[0]->opcodeType == OPCODE_DIRECTVALUE)
+            return op->parms[NSEEL_ISFALSE(op->parms[0]->value) ? 2 : 1];
+        if (op->fn == FNIDX_EXEC2 || op->fn == FNIDX_EXEC3) {
+            // leading constants do nothing
+            while (np > 1 && op->parms[0]->opcodeType == OPCODE_DIRECTVALUE) {
+                for (i = 1; i < np; i++)
+                    op->parms[i - 1] = op->parms[i];
+                op->opcodeType--;
+                op->fn = FNIDX_EXEC2;
+                np--;
+            }
+            if (np == 1)
+                return op->parms[0];
+        }
+    }
+
+    if (allconst && foldValue(op, &v)) {
+        op->opcodeType = OPCODE_DIRECTVALUE;
+        op->value = v;
+    }
+    return op;
+}
+
+#endif // NSEEL_JIT
+
 static char* preprocessCode(compileContext* ctx, char* expression)
 {
     int len = 0;
@@ -664,6 +938,37 @@ NSEEL_CODEHANDLE NSEEL_code_compile(NSEEL_VMCTX _ctx, char* _expression)
         }
     }
 
+#ifdef NSEEL_JIT
+    if (scode) {
+        opcodeRec** stmts;
+        int nstmts = 0;
+        startPtr* p;
+        for (p = startpts; p; p = p->next)
+            nstmts++;
+        stmts = (opcodeRec**)newTmpBlock(nstmts * sizeof(opcodeRec*));
+        nstmts = 0;
+        for (p = startpts; p; p = p->next)
+            stmts[nstmts++] = foldConstants((opcodeRec*)p->startptr);
+
+        if (nseel_backend == NSEEL_BACKEND_NATIVE)
+            handle->code = nseel_jit_compile(ctx, stmts, nstmts, &handle->code_size);
+        if (!handle->code) // no code generator, no executable memory, or asked not to
+            handle->vmcode = nseel_vm_compile(ctx, stmts, nstmts, &handle->code_size);
+        if (handle->code || handle->vmcode)
+            handle->batchcode = nseel_batch_compile(ctx, stmts, nstmts);
+        if (!handle->code && !handle->vmcode) {
+            lstrcpyn(ctx->last_error_string, "code generation failed", sizeof(ctx->last_error_string));
+            scode = NULL;
+        } else {
+            ctx->l_stats[1] = handle->code_size;
+            handle->blocks = ctx->blocks_head;
+        }
+    }
+    if (!scode) {
+        freeBlocks((llBlock*)ctx->blocks_head); // free blocks
+        handle = NULL; // return NULL (after resetting blocks_head)
+    }
+#else
     // check to see if failed on the first startingCode
     if (!scode) {
         freeBlocks((llBlock*)ctx->blocks_head); // free blocks
@@ -698,6 +1003,7 @@ NSEEL_CODEHANDLE NSEEL_code_compile(NSEEL_VMCTX _ctx, char* _expression)
         handle->blocks = ctx->blocks_head;
         handle->workTablePtr_size = (computable_size) * sizeof(double);
     }
+#endif
     freeBlocks((llBlock*)ctx->tmpblocks_head); // free blocks
     ctx->tmpblocks_head = 0;
 
@@ -721,6 +1027,15 @@ NSEEL_CODEHANDLE NSEEL_code_compile(NSEEL_VMCTX _ctx, char* _expression)
 //------------------------------------------------------------------------------
 void NSEEL_code_execute(NSEEL_CODEHANDLE code)
 {
+#ifdef NSEEL_JIT
+    // native code keeps temporaries on the machine stack and is reentrant,
+    // bytecode keeps them in the handle
+    codeHandleType* h = (codeHandleType*)code;
+    if (h && h->code)
+        ((void (*)(void))h->code)();
+    else if (h && h->vmcode)
+        nseel_vm_execute(h->vmcode);
+#else
 #ifdef NSEEL_REENTRANT_EXECUTION
     int baseptr;
 #else
@@ -750,6 +1065,42 @@ void NSEEL_code_execute(NSEEL_CODEHANDLE code)
       popad
         }
     }
+#endif
+}
+
+//------------------------------------------------------------------------------
+void NSEEL_code_execute_batch(NSEEL_CODEHANDLE code, NSEEL_LANEVAR* vars, int nvars, int n)
+{
+    int i, k;
+#ifdef NSEEL_JIT
+    codeHandleType* h = (codeHandleType*)code;
+    if (!h || n <= 0)
+        return;
+    if (h->batchcode && nseel_batch_execute(h->batchcode, vars, nvars, n))
+        return;
+#else
+    if (!code)
+        return;
+#endif
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < nvars; i++)
+            if (vars[i].flags & NSEEL_LANE_IN)
+                *vars[i].var = vars[i].lanes[k];
+        NSEEL_code_execute(code);
+        for (i = 0; i < nvars; i++)
+            if (vars[i].flags & NSEEL_LANE_OUT)
+                vars[i].lanes[k] = *vars[i].var;
+    }
+}
+
+int NSEEL_code_independent(NSEEL_CODEHANDLE code, NSEEL_LANEVAR* vars, int nvars)
+{
+#ifdef NSEEL_JIT
+    codeHandleType* h = (codeHandleType*)code;
+    return h && h->batchcode && nseel_batch_independent(h->batchcode, vars, nvars);
+#else
+    return 0;
+#endif
 }
 
 char* NSEEL_code_getcodeerror(NSEEL_VMCTX ctx)
@@ -770,6 +1121,11 @@ void NSEEL_code_free(NSEEL_CODEHANDLE code)
         nseel_evallib_stats[2] -= h->code_stats[2];
         nseel_evallib_stats[3] -= h->code_stats[3];
         nseel_evallib_stats[4]--;
+#ifdef NSEEL_JIT
+        nseel_jit_free(h->code, h->code_size);
+        nseel_vm_free(h->vmcode);
+        nseel_batch_free(h->batchcode);
+#endif
         freeBlocks(h->blocks);
     }
 }
@@ -28,7 +28,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include "ns-eel-int.h"
-#include "../platform_shim_redirect.h"
+#include "platform_shim_redirect.h"
 
 #define NSEEL_VARS_PER_BLOCK 64
 #define NSEEL_VARS_MALLOC_CHUNKSIZE 8
@@ -143,7 +143,7 @@ int nseel_setVar(compileContext* ctx, int varNum)
 }
 
 //------------------------------------------------------------------------------
-int nseel_getVar(compileContext* ctx, int i)
+YYSTYPE nseel_getVar(compileContext* ctx, int i)
 {
     if (i >= 0 && i < (NSEEL_VARS_PER_BLOCK * ctx->varTable_numBlocks))
         return nseel_createCompiledValue(ctx, 0, ctx->varTable_Values[i / NSEEL_VARS_PER_BLOCK] + i % NSEEL_VARS_PER_BLOCK);
@@ -174,7 +174,28 @@ double* NSEEL_VM_regvar(NSEEL_VMCTX _ctx, char* var)
 }
 
 //------------------------------------------------------------------------------
-int nseel_translate(compileContext* ctx, int type)
+void NSEEL_VM_enumallvars(NSEEL_VMCTX _ctx, int (*func)(char* name, double* value, void* userctx), void* userctx)
+{
+    compileContext* ctx = (compileContext*)_ctx;
+    int wb, ti;
+    if (!ctx)
+        return;
+    for (wb = 0; wb < ctx->varTable_numBlocks; wb++)
+        for (ti = 0; ti < NSEEL_VARS_PER_BLOCK; ti++) {
+            char name[NSEEL_MAX_VARIABLE_NAMELEN + 1];
+            char* p = ctx->varTable_Names[wb] + ti * NSEEL_MAX_VARIABLE_NAMELEN;
+            if (!p[0])
+                return;
+            // names fill their slot without a terminator when they're long
+            memcpy(name, p, NSEEL_MAX_VARIABLE_NAMELEN);
+            name[NSEEL_MAX_VARIABLE_NAMELEN] = 0;
+            if (!func(name, ctx->varTable_Values[wb] + ti, userctx))
+                return;
+        }
+}
+
+//------------------------------------------------------------------------------
+YYSTYPE nseel_translate(compileContext* ctx, int type)
 {
     int v;
     int n;
@@ -0,0 +1,1492 @@
+// Native code generator for ns-eel on x86-64 and AArch64.
+//
+// nseel-compiler.c hands over one expression tree per statement and they are
+// compiled into a single function using SSE2 (x86-64) or scalar FP (AArch64)
+// instructions. Intermediate values live on a small stack of FP registers,
+// the most used variables of a handle stay in registers for the whole run
+// (loaded on entry, written back on exit and around calls that can see them),
+// and library functions are plain C calls. Code is assembled into a heap
+// buffer and then copied to pages that are mapped executable.
+//
+// Semantics follow the x87 snippets in nseel-cfunc.c, including the
+// 0.00001 tolerance used by if/equal/bnot and the (a+b-|a-b|)/2 min/max.
+
+#include "ns-eel-int.h"
+#include <math.h>
+#include <string.h>
+#include "platform_shim_redirect.h"
+
+#ifdef NSEEL_JIT
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X64
+#ifdef _WIN64
+#define JIT_WIN64
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define JIT_ARM64
+#endif
+
+#if defined(JIT_X64) || defined(JIT_ARM64)
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#ifndef MAP_ANON
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#if defined(__APPLE__) && defined(JIT_ARM64)
+#include <libkern/OSCacheControl.h>
+#include <pthread.h>
+#endif
+#endif
+
+#ifndef NSEEL_LOOPFUNC_SUPPORT_MAXLEN
+#define NSEEL_LOOPFUNC_SUPPORT_MAXLEN (4096)
+#endif
+
+#define JIT_MAX_PROMOTED 8
+#define JIT_MAX_FRAME 4080 // keeps every frame offset encodable as an immediate
+
+#ifdef JIT_X64
+// xmm0-xmm5 are the temp stack, xmm6/xmm7 scratch, xmm8-xmm15 hold variables
+#define JIT_NUM_TEMPS 6
+#define TEMP(i) (i)
+#define SCR 6
+#define SCR2 7
+#define PVAR(i) (8 + (i))
+#ifdef JIT_WIN64
+#define FRAME_BASE 32 // callee home space
+#else
+#define FRAME_BASE 0
+// SysV has no callee-saved xmm registers, so variables held in registers
+// have to be written back and reloaded around every call
+#define JIT_PROMOTED_CALLER_SAVED
+#endif
+#else
+// v16-v29 are the temp stack, v30/v31 scratch, d8-d15 (callee-saved) hold variables
+#define JIT_NUM_TEMPS 14
+#define TEMP(i) (16 + (i))
+#define SCR 30
+#define SCR2 31
+#define PVAR(i) (8 + (i))
+#define FRAME_BASE 0
+#endif
+
+// frame layout: [home space] [one save slot per temp] [dynamic slots]
+#define SAVE_SLOT(i) (FRAME_BASE + (i)*8)
+#define DYN_SLOT(k) (FRAME_BASE + (JIT_NUM_TEMPS + (k)) * 8)
+
+#define JOP_ADD 0
+#define JOP_SUB 1
+#define JOP_MUL 2
+#define JOP_DIV 3
+
+// what genAddr() produced
+#define ADDR_STATIC 0 // a known variable, nothing emitted
+#define ADDR_DYNAMIC 1 // pointer in the result register
+#define ADDR_SLOT 2 // not an lvalue, value parked in a frame slot
+
+typedef struct {
+    double* ptr;
+    int uses;
+    int written;
+    int escaped; // address taken through if()/exec2(), has to stay in memory
+} jitVar;
+
+typedef struct {
+    unsigned char* buf;
+    int size, alloc;
+    int error;
+
+    jitVar* vars;
+    int nvars, vars_alloc;
+    int ncalls;
+
+    double* promoted[JIT_MAX_PROMOTED];
+    int promotedWritten[JIT_MAX_PROMOTED];
+    int npromoted;
+
+    int slotTop, slotMax;
+    void** userfunc_data;
+} jitState;
+
+//---------------------------------------------------------------------------------------------------------------
+static void emitBytes(jitState* s, const void* p, int len)
+{
+    if (s->size + len > s->alloc) {
+        int na = s->alloc ? s->alloc * 2 : 4096;
+        unsigned char* nb;
+        while (na < s->size + len)
+            na *= 2;
+        nb = (unsigned char*)realloc(s->buf, na);
+        if (!nb) {
+            s->error = 1;
+            return;
+        }
+        s->buf = nb;
+        s->alloc = na;
+    }
+    memcpy(s->buf + s->size, p, len);
+    s->size += len;
+}
+
+static void emit4(jitState* s, unsigned int v)
+{
+    emitBytes(s, &v, 4);
+}
+
+static uint64_t doubleBits(double v)
+{
+    uint64_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+#ifdef JIT_X64
+//---------------------------------------------------------------------------------------------------------------
+// x86-64
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RSP 4
+#define RSI 6
+#define RDI 7
+#define R8 8
+#define R9 9
+#define R11 11
+
+static void emit1(jitState* s, int b)
+{
+    unsigned char c = (unsigned char)b;
+    emitBytes(s, &c, 1);
+}
+
+static void emit8(jitState* s, uint64_t v)
+{
+    emitBytes(s, &v, 8);
+}
+
+#ifdef JIT_WIN64
+static const int g_argregs[4] = { RCX, RDX, R8, R9 };
+#else
+static const int g_argregs[4] = { RDI, RSI, RDX, RCX };
+#endif
+
+// op reg, reg with an sse prefix (f2 = scalar double, 66 = packed/ucomisd)
+static void sseRR(jitState* s, int prefix, int op, int reg, int rm)
+{
+    emit1(s, prefix);
+    if ((reg | rm) & 8)
+        emit1(s, 0x40 | ((reg & 8) >> 1) | ((rm & 8) >> 3));
+    emit1(s, 0x0f);
+    emit1(s, op);
+    emit1(s, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void modrmDisp32(jitState* s, int reg, int base, int disp)
+{
+    emit1(s, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit1(s, 0x24);
+    emit4(s, (unsigned int)disp);
+}
+
+// op xmm, [base+disp32]
+static void sseMem(jitState* s, int prefix, int op, int reg, int base, int disp)
+{
+    emit1(s, prefix);
+    if ((reg | base) & 8)
+        emit1(s, 0x40 | ((reg & 8) >> 1) | ((base & 8) >> 3));
+    emit1(s, 0x0f);
+    emit1(s, op);
+    modrmDisp32(s, reg, base, disp);
+}
+
+// 64-bit op gpr, [base+disp32]
+static void gprMem(jitState* s, int op, int reg, int base, int disp)
+{
+    emit1(s, 0x48 | ((reg & 8) >> 1) | ((base & 8) >> 3));
+    emit1(s, op);
+    modrmDisp32(s, reg, base, disp);
+}
+
+static void movImm64(jitState* s, int reg, uint64_t v)
+{
+    emit1(s, 0x48 | ((reg & 8) >> 3));
+    emit1(s, 0xb8 + (reg & 7));
+    emit8(s, v);
+}
+
+// movq xmm, gpr (op 6e) or movq gpr, xmm (op 7e)
+static void movqXG(jitState* s, int op, int xmm, int gpr)
+{
+    emit1(s, 0x66);
+    emit1(s, 0x48 | ((xmm & 8) >> 1) | ((gpr & 8) >> 3));
+    emit1(s, 0x0f);
+    emit1(s, op);
+    emit1(s, 0xc0 | ((xmm & 7) << 3) | (gpr & 7));
+}
+
+static void emitMov(jitState* s, int d, int n)
+{
+    if (d != n)
+        sseRR(s, 0xf2, 0x10, d, n);
+}
+
+static void emitConst(jitState* s, int d, double v)
+{
+    uint64_t b = doubleBits(v);
+    if (!b) {
+        sseRR(s, 0x66, 0x57, d, d); // xorpd
+        return;
+    }
+    movImm64(s, R11, b);
+    movqXG(s, 0x6e, d, R11);
+}
+
+static void emitLoadAbs(jitState* s, int d, const double* p)
+{
+    movImm64(s, R11, (uint64_t)(uintptr_t)p);
+    sseMem(s, 0xf2, 0x10, d, R11, 0);
+}
+
+static void emitStoreAbs(jitState* s, double* p, int n)
+{
+    movImm64(s, R11, (uint64_t)(uintptr_t)p);
+    sseMem(s, 0xf2, 0x11, n, R11, 0);
+}
+
+static void emitLoadSlot(jitState* s, int d, int off)
+{
+    sseMem(s, 0xf2, 0x10, d, RSP, off);
+}
+
+static void emitStoreSlot(jitState* s, int off, int n)
+{
+    sseMem(s, 0xf2, 0x11, n, RSP, off);
+}
+
+static void emitOp(jitState* s, int op, int d, int n)
+{
+    static const unsigned char ops[4] = { 0x58, 0x5c, 0x59, 0x5e };
+    sseRR(s, 0xf2, ops[op], d, n);
+}
+
+static void emitSignBit(jitState* s, int d, int btop)
+{
+    movqXG(s, 0x7e, d, RAX);
+    emit1(s, 0x48); // btr/btc rax, 63
+    emit1(s, 0x0f);
+    emit1(s, 0xba);
+    emit1(s, btop);
+    emit1(s, 63);
+    movqXG(s, 0x6e, d, RAX);
+}
+
+static void emitAbs(jitState* s, int d)
+{
+    emitSignBit(s, d, 0xf0);
+}
+
+static void emitNeg(jitState* s, int d)
+{
+    emitSignBit(s, d, 0xf8);
+}
+
+static void emitSqrt(jitState* s, int d)
+{
+    sseRR(s, 0xf2, 0x51, d, d);
+}
+
+// d = (a < b || unordered) ? 1.0 : 0.0, the same test as fcomp + C0
+static void emitLess(jitState* s, int d, int a, int b)
+{
+    sseRR(s, 0x66, 0x2e, a, b); // ucomisd
+    emit1(s, 0x0f); // setb al
+    emit1(s, 0x92);
+    emit1(s, 0xc0);
+    emit1(s, 0x0f); // movzx eax, al
+    emit1(s, 0xb6);
+    emit1(s, 0xc0);
+    sseRR(s, 0xf2, 0x2a, d, RAX); // cvtsi2sd d, eax
+}
+
+// jump if a < b (or unordered), returns the fixup
+static int emitJumpLess(jitState* s, int a, int b)
+{
+    sseRR(s, 0x66, 0x2e, a, b);
+    emit1(s, 0x0f);
+    emit1(s, 0x82);
+    emit4(s, 0);
+    return s->size - 4;
+}
+
+static int emitJump(jitState* s)
+{
+    emit1(s, 0xe9);
+    emit4(s, 0);
+    return s->size - 4;
+}
+
+static void patchJump(jitState* s, int fixup, int target)
+{
+    unsigned int rel = (unsigned int)(target - (fixup + 4));
+    if (!s->error)
+        memcpy(s->buf + fixup, &rel, 4);
+}
+
+static void emitCall(jitState* s, void* fn)
+{
+    movImm64(s, R11, (uint64_t)(uintptr_t)fn);
+    emit1(s, 0x41); // call r11
+    emit1(s, 0xff);
+    emit1(s, 0xd3);
+}
+
+static void emitFloatArg(jitState* s, int idx, int n)
+{
+    emitMov(s, idx, n);
+}
+
+static void emitFloatResult(jitState* s, int d)
+{
+    emitMov(s, d, 0);
+}
+
+static void emitPtrArgAbs(jitState* s, int idx, void* p)
+{
+    movImm64(s, g_argregs[idx], (uint64_t)(uintptr_t)p);
+}
+
+static void emitPtrArgSlotAddr(jitState* s, int idx, int off)
+{
+    gprMem(s, 0x8d, g_argregs[idx], RSP, off); // lea
+}
+
+static void emitPtrArgSlotLoad(jitState* s, int idx, int off)
+{
+    gprMem(s, 0x8b, g_argregs[idx], RSP, off);
+}
+
+// the "result register" holding dynamic addresses is rax, where calls return them
+static void emitResultAbs(jitState* s, void* p)
+{
+    movImm64(s, RAX, (uint64_t)(uintptr_t)p);
+}
+
+static void emitResultSlotAddr(jitState* s, int off)
+{
+    gprMem(s, 0x8d, RAX, RSP, off);
+}
+
+static void emitResultToSlot(jitState* s, int off)
+{
+    gprMem(s, 0x89, RAX, RSP, off);
+}
+
+static void emitLoadResultPtr(jitState* s, int d)
+{
+    sseMem(s, 0xf2, 0x10, d, RAX, 0);
+}
+
+static void emitStoreThroughSlot(jitState* s, int off, int n)
+{
+    gprMem(s, 0x8b, R11, RSP, off);
+    sseMem(s, 0xf2, 0x11, n, R11, 0);
+}
+
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+// loop count from n into [rsp+off]; returns the fixup of the skip branch
+static int emitLoopBegin(jitState* s, int n, int off)
+{
+    int skip;
+    sseRR(s, 0xf2, 0x2d, RAX, n); // cvtsd2si eax, n
+    emit1(s, 0x83); // cmp eax, 1
+    emit1(s, 0xf8);
+    emit1(s, 1);
+    emit1(s, 0x0f); // jl skip
+    emit1(s, 0x8c);
+    emit4(s, 0);
+    skip = s->size - 4;
+    emit1(s, 0xb9); // mov ecx, max
+    emit4(s, NSEEL_LOOPFUNC_SUPPORT_MAXLEN);
+    emit1(s, 0x39); // cmp eax, ecx
+    emit1(s, 0xc8);
+    emit1(s, 0x0f); // cmovg eax, ecx
+    emit1(s, 0x4f);
+    emit1(s, 0xc1);
+    gprMem(s, 0x89, RAX, RSP, off);
+    return skip;
+}
+
+static void emitLoopEnd(jitState* s, int off, int top)
+{
+    gprMem(s, 0xff, 1, RSP, off); // dec qword [rsp+off]
+    emit1(s, 0x0f); // jnz top
+    emit1(s, 0x85);
+    emit4(s, (unsigned int)(top - (s->size + 4)));
+}
+#endif
+
+static void emitPrologue(jitState* s, int frame, int npromoted)
+{
+#ifdef JIT_WIN64
+    int i;
+#endif
+    emit1(s, 0x55); // push rbp
+    emit1(s, 0x48); // mov rbp, rsp
+    emit1(s, 0x89);
+    emit1(s, 0xe5);
+#ifdef JIT_WIN64
+    // xmm6-xmm15 are callee-saved here
+    emit1(s, 0x48);
+    emit1(s, 0x81);
+    emit1(s, 0xec);
+    emit4(s, 160);
+    for (i = 0; i < 10; i++)
+        sseMem(s, 0xf3, 0x7f, 6 + i, RSP, i * 16); // movdqu
+#endif
+    emit1(s, 0x48); // sub rsp, frame
+    emit1(s, 0x81);
+    emit1(s, 0xec);
+    emit4(s, frame);
+    (void)npromoted;
+}
+
+static void emitEpilogue(jitState* s, int frame, int npromoted)
+{
+#ifdef JIT_WIN64
+    int i;
+#endif
+    emit1(s, 0x48); // add rsp, frame
+    emit1(s, 0x81);
+    emit1(s, 0xc4);
+    emit4(s, frame);
+#ifdef JIT_WIN64
+    for (i = 0; i < 10; i++)
+        sseMem(s, 0xf3, 0x6f, 6 + i, RSP, i * 16);
+    emit1(s, 0x48);
+    emit1(s, 0x81);
+    emit1(s, 0xc4);
+    emit4(s, 160);
+#endif
+    emit1(s, 0x5d); // pop rbp
+    emit1(s, 0xc3); // ret
+    (void)npromoted;
+}
+
+#else
+//---------------------------------------------------------------------------------------------------------------
+// AArch64
+
+#define XSP 31
+#define X16 16 // ip0, address and constant scratch
+#define COND_NE 1
+#define COND_LT 11
+#define COND_GT 12
+
+static void movImm64(jitState* s, int rd, uint64_t v)
+{
+    int hw, first = 1;
+    if (!v) {
+        emit4(s, 0xd2800000 | rd); // movz rd, #0
+        return;
+    }
+    for (hw = 0; hw < 4; hw++) {
+        unsigned int part = (unsigned int)(v >> (hw * 16)) & 0xffff;
+        if (!part)
+            continue;
+        emit4(s, (first ? 0xd2800000 : 0xf2800000) | (hw << 21) | (part << 5) | rd); // movz / movk
+        first = 0;
+    }
+}
+
+// ldr/str with a scaled unsigned 12-bit offset
+static void ldst(jitState* s, unsigned int op, int rt, int rn, int off)
+{
+    emit4(s, op | ((off / 8) << 10) | (rn << 5) | rt);
+}
+
+#define LDR_D 0xfd400000
+#define STR_D 0xfd000000
+#define LDR_X 0xf9400000
+#define STR_X 0xf9000000
+
+static void emitMov(jitState* s, int d, int n)
+{
+    if (d != n)
+        emit4(s, 0x1e604000 | (n << 5) | d);
+}
+
+static void emitConst(jitState* s, int d, double v)
+{
+    uint64_t b = doubleBits(v);
+    if (!b) {
+        emit4(s, 0x9e6703e0 | d); // fmov d, xzr
+        return;
+    }
+    movImm64(s, X16, b);
+    emit4(s, 0x9e670000 | (X16 << 5) | d); // fmov d, x16
+}
+
+static void emitLoadAbs(jitState* s, int d, const double* p)
+{
+    movImm64(s, X16, (uint64_t)(uintptr_t)p);
+    ldst(s, LDR_D, d, X16, 0);
+}
+
+static void emitStoreAbs(jitState* s, double* p, int n)
+{
+    movImm64(s, X16, (uint64_t)(uintptr_t)p);
+    ldst(s, STR_D, n, X16, 0);
+}
+
+static void emitLoadSlot(jitState* s, int d, int off)
+{
+    ldst(s, LDR_D, d, XSP, off);
+}
+
+static void emitStoreSlot(jitState* s, int off, int n)
+{
+    ldst(s, STR_D, n, XSP, off);
+}
+
+static void emitOp(jitState* s, int op, int d, int n)
+{
+    static const unsigned int ops[4] = { 0x1e602800, 0x1e603800, 0x1e600800, 0x1e601800 };
+    emit4(s, ops[op] | (n << 16) | (d << 5) | d);
+}
+
+static void emitAbs(jitState* s, int d)
+{
+    emit4(s, 0x1e60c000 | (d << 5) | d);
+}
+
+static void emitNeg(jitState* s, int d)
+{
+    emit4(s, 0x1e614000 | (d << 5) | d);
+}
+
+static void emitSqrt(jitState* s, int d)
+{
+    emit4(s, 0x1e61c000 | (d << 5) | d);
+}
+
+static void emitFloor(jitState* s, int d)
+{
+    emit4(s, 0x1e654000 | (d << 5) | d); // frintm
+}
+
+static void emitCeil(jitState* s, int d)
+{
+    emit4(s, 0x1e64c000 | (d << 5) | d); // frintp
+}
+
+// d = (a < b || unordered) ? 1.0 : 0.0; fcmp leaves N!=V for both
+static void emitLess(jitState* s, int d, int a, int b)
+{
+    emit4(s, 0x1e602000 | (b << 16) | (a << 5)); // fcmp a, b
+    emit4(s, 0x1e6e1000 | SCR); // fmov scr, #1.0
+    emit4(s, 0x9e6703e0 | d); // fmov d, xzr
+    emit4(s, 0x1e600c00 | (d << 16) | (COND_LT << 12) | (SCR << 5) | d); // fcsel d, scr, d, lt
+}
+
+static int emitJumpLess(jitState* s, int a, int b)
+{
+    emit4(s, 0x1e602000 | (b << 16) | (a << 5));
+    emit4(s, 0x54000000 | COND_LT); // b.lt
+    return s->size - 4;
+}
+
+static int emitJump(jitState* s)
+{
+    emit4(s, 0x14000000); // b
+    return s->size - 4;
+}
+
+static void patchJump(jitState* s, int fixup, int target)
+{
+    unsigned int inst;
+    int rel = (target - fixup) / 4;
+    if (s->error)
+        return;
+    memcpy(&inst, s->buf + fixup, 4);
+    if ((inst & 0xfc000000) == 0x14000000)
+        inst |= rel & 0x3ffffff;
+    else
+        inst |= (rel & 0x7ffff) << 5;
+    memcpy(s->buf + fixup, &inst, 4);
+}
+
+static void emitCall(jitState* s, void* fn)
+{
+    movImm64(s, X16, (uint64_t)(uintptr_t)fn);
+    emit4(s, 0xd63f0000 | (X16 << 5)); // blr x16
+}
+
+static void emitFloatArg(jitState* s, int idx, int n)
+{
+    emitMov(s, idx, n);
+}
+
+static void emitFloatResult(jitState* s, int d)
+{
+    emitMov(s, d, 0);
+}
+
+static void emitPtrArgAbs(jitState* s, int idx, void* p)
+{
+    movImm64(s, idx, (uint64_t)(uintptr_t)p);
+}
+
+static void emitPtrArgSlotAddr(jitState* s, int idx, int off)
+{
+    emit4(s, 0x91000000 | (off << 10) | (XSP << 5) | idx); // add xN, sp, #off
+}
+
+static void emitPtrArgSlotLoad(jitState* s, int idx, int off)
+{
+    ldst(s, LDR_X, idx, XSP, off);
+}
+
+// the "result register" holding dynamic addresses is x0, where calls return them
+static void emitResultAbs(jitState* s, void* p)
+{
+    movImm64(s, 0, (uint64_t)(uintptr_t)p);
+}
+
+static void emitResultSlotAddr(jitState* s, int off)
+{
+    emitPtrArgSlotAddr(s, 0, off);
+}
+
+static void emitResultToSlot(jitState* s, int off)
+{
+    ldst(s, STR_X, 0, XSP, off);
+}
+
+static void emitLoadResultPtr(jitState* s, int d)
+{
+    ldst(s, LDR_D, d, 0, 0);
+}
+
+static void emitStoreThroughSlot(jitState* s, int off, int n)
+{
+    ldst(s, LDR_X, X16, XSP, off);
+    ldst(s, STR_D, n, X16, 0);
+}
+
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+static int emitLoopBegin(jitState* s, int n, int off)
+{
+    int skip;
+    emit4(s, 0x1e644000 | (n << 5) | SCR); // frintn scr, n (fistp rounding)
+    emit4(s, 0x1e780000 | (SCR << 5) | 9); // fcvtzs w9, scr
+    emit4(s, 0x7100041f | (9 << 5)); // cmp w9, #1
+    emit4(s, 0x54000000 | COND_LT); // b.lt skip
+    skip = s->size - 4;
+    emit4(s, 0x52800000 | ((NSEEL_LOOPFUNC_SUPPORT_MAXLEN & 0xffff) << 5) | 10); // movz w10, #max
+    emit4(s, 0x6b000000 | (10 << 16) | (9 << 5) | 31); // cmp w9, w10
+    emit4(s, 0x1a800000 | (9 << 16) | (COND_GT << 12) | (10 << 5) | 9); // csel w9, w10, w9, gt
+    ldst(s, STR_X, 9, XSP, off);
+    return skip;
+}
+
+static void emitLoopEnd(jitState* s, int off, int top)
+{
+    ldst(s, LDR_X, 9, XSP, off);
+    emit4(s, 0xf1000400 | (9 << 5) | 9); // subs x9, x9, #1
+    ldst(s, STR_X, 9, XSP, off);
+    emit4(s, 0x54000000 | ((((top - s->size) / 4) & 0x7ffff) << 5) | COND_NE); // b.ne top
+}
+#endif
+
+static void emitPrologue(jitState* s, int frame, int npromoted)
+{
+    int i;
+    emit4(s, 0xa9bf7bfd); // stp x29, x30, [sp, #-16]!
+    emit4(s, 0x910003fd); // mov x29, sp
+    if (npromoted)
+        for (i = 8; i < 16; i += 2)
+            emit4(s, 0x6dbf0000 | ((i + 1) << 10) | (XSP << 5) | i); // stp d(i), d(i+1), [sp, #-16]!
+    emit4(s, 0xd10003ff | (frame << 10)); // sub sp, sp, #frame
+}
+
+static void emitEpilogue(jitState* s, int frame, int npromoted)
+{
+    int i;
+    emit4(s, 0x910003ff | (frame << 10)); // add sp, sp, #frame
+    if (npromoted)
+        for (i = 14; i >= 8; i -= 2)
+            emit4(s, 0x6cc10000 | ((i + 1) << 10) | (XSP << 5) | i); // ldp d(i), d(i+1), [sp], #16
+    emit4(s, 0xa8c17bfd); // ldp x29, x30, [sp], #16
+    emit4(s, 0xd65f03c0); // ret
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------
+// variable usage, decides which variables get a register
+
+static jitVar* findVar(jitState* s, double* p)
+{
+    int i;
+    for (i = 0; i < s->nvars; i++)
+        if (s->vars[i].ptr == p)
+            return s->vars + i;
+    if (s->nvars >= s->vars_alloc) {
+        jitVar* nv = (jitVar*)realloc(s->vars, (s->vars_alloc + 64) * sizeof(jitVar));
+        if (!nv) {
+            s->error = 1;
+            return NULL;
+        }
+        s->vars = nv;
+        s->vars_alloc += 64;
+    }
+    memset(s->vars + s->nvars, 0, sizeof(jitVar));
+    s->vars[s->nvars].ptr = p;
+    return s->vars + s->nvars++;
+}
+
+static int isCall(opcodeRec* op)
+{
+    if (op->fntype == MATH_SIMPLE)
+        return op->fn == FN_MODULO || op->fn == FN_AND || op->fn == FN_OR;
+    switch (op->fn) {
+    case FNIDX_IF:
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+    case FNIDX_LOOP:
+#endif
+    case FNIDX_SQR:
+    case FNIDX_SQRT:
+    case FNIDX_ABS:
+    case FNIDX_MIN:
+    case FNIDX_MAX:
+    case FNIDX_BNOT:
+    case FNIDX_EQUAL:
+    case FNIDX_BELOW:
+    case FNIDX_ABOVE:
+    case FNIDX_ASSIGN:
+    case FNIDX_EXEC2:
+    case FNIDX_EXEC3:
+        return 0;
+#ifdef JIT_ARM64
+    case FNIDX_FLOOR:
+    case FNIDX_CEIL:
+        return 0;
+#endif
+    }
+    return 1;
+}
+
+// lvalue: 0 for a plain value, 1 when the address is taken directly (assignment
+// target, argument of a C function), 2 when it is taken through if()/exec2()
+static void scanTree(jitState* s, opcodeRec* op, int weight, int lvalue)
+{
+    int nested = lvalue ? 2 : 0;
+    int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+
+    if (s->error || op->opcodeType == OPCODE_DIRECTVALUE)
+        return;
+    if (op->opcodeType == OPCODE_VARPTR) {
+        jitVar* v = findVar(s, op->valuePtr);
+        if (v) {
+            v->uses += weight;
+            if (lvalue)
+                v->written = 1;
+            if (lvalue == 2)
+                v->escaped = 1;
+        }
+        return;
+    }
+
+    if (isCall(op))
+        s->ncalls += weight;
+
+    if (op->fntype == MATH_SIMPLE) {
+        if (op->fn == FN_ASSIGN) {
+            scanTree(s, op->parms[0], weight, 1);
+            scanTree(s, op->parms[1], weight, 0);
+        } else if (op->fn == FN_UPLUS)
+            scanTree(s, op->parms[0], weight, nested);
+        else
+            for (i = 0; i < np; i++)
+                scanTree(s, op->parms[i], weight, 0);
+        return;
+    }
+
+    switch (op->fn) {
+    case FNIDX_IF:
+        scanTree(s, op->parms[0], weight, 0);
+        scanTree(s, op->parms[1], weight, nested);
+        scanTree(s, op->parms[2], weight, nested);
+        return;
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+    case FNIDX_LOOP:
+        scanTree(s, op->parms[0], weight, 0);
+        scanTree(s, op->parms[1], weight * 16, 0);
+        return;
+#endif
+    case FNIDX_ASSIGN:
+        scanTree(s, op->parms[0], weight, 1);
+        scanTree(s, op->parms[1], weight, 0);
+        return;
+    case FNIDX_EXEC2:
+    case FNIDX_EXEC3:
+        for (i = 0; i < np - 1; i++)
+            scanTree(s, op->parms[i], weight, 0);
+        scanTree(s, op->parms[np - 1], weight, nested);
+        return;
+    case FNIDX_RAND:
+        scanTree(s, op->parms[0], weight, 1);
+        return;
+    }
+    for (i = 0; i < np; i++)
+        scanTree(s, op->parms[i], weight, op->fn >= FNIDX_USER ? 1 : 0);
+}
+
+static void choosePromoted(jitState* s)
+{
+    while (s->npromoted < JIT_MAX_PROMOTED) {
+        jitVar* best = NULL;
+        int i;
+        for (i = 0; i < s->nvars; i++) {
+            jitVar* v = s->vars + i;
+            if (v->escaped || v->uses < 2)
+                continue;
+#ifdef JIT_PROMOTED_CALLER_SAVED
+            // every call costs a reload, not worth it for rarely used variables
+            if (v->uses <= s->ncalls)
+                continue;
+#endif
+            if (!best || v->uses > best->uses)
+                best = v;
+        }
+        if (!best)
+            break;
+        s->promoted[s->npromoted] = best->ptr;
+        s->promotedWritten[s->npromoted] = best->written;
+        s->npromoted++;
+        best->uses = 0; // taken
+    }
+}
+
+static int promotedIndex(jitState* s, double* p)
+{
+    int i;
+    for (i = 0; i < s->npromoted; i++)
+        if (s->promoted[i] == p)
+            return i;
+    return -1;
+}
+
+static void storePromoted(jitState* s)
+{
+    int i;
+    for (i = 0; i < s->npromoted; i++)
+        if (s->promotedWritten[i])
+            emitStoreAbs(s, s->promoted[i], PVAR(i));
+}
+
+static void loadPromoted(jitState* s)
+{
+    int i;
+    for (i = 0; i < s->npromoted; i++)
+        emitLoadAbs(s, PVAR(i), s->promoted[i]);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// code generation. genValue() leaves the value of op in TEMP(r) and may use
+// TEMP(r) and above; TEMP(0..r-1) are preserved.
+
+static void genValue(jitState* s, opcodeRec* op, int r);
+
+static int allocSlot(jitState* s)
+{
+    int k = s->slotTop++;
+    if (s->slotTop > s->slotMax)
+        s->slotMax = s->slotTop;
+    return DYN_SLOT(k);
+}
+
+static void freeSlot(jitState* s)
+{
+    s->slotTop--;
+}
+
+static void genLoadVar(jitState* s, double* p, int d)
+{
+    int i = promotedIndex(s, p);
+    if (i >= 0)
+        emitMov(s, d, PVAR(i));
+    else
+        emitLoadAbs(s, d, p);
+}
+
+static void genStoreVar(jitState* s, double* p, int n)
+{
+    int i = promotedIndex(s, p);
+    if (i >= 0)
+        emitMov(s, PVAR(i), n);
+    else
+        emitStoreAbs(s, p, n);
+}
+
+// live temps go to their save slots across a call
+static void callBegin(jitState* s, int r)
+{
+    int i;
+#ifdef JIT_PROMOTED_CALLER_SAVED
+    storePromoted(s);
+#endif
+    for (i = 0; i < r; i++)
+        emitStoreSlot(s, SAVE_SLOT(i), TEMP(i));
+}
+
+static void callEnd(jitState* s, int r)
+{
+    int i;
+    for (i = 0; i < r; i++)
+        emitLoadSlot(s, TEMP(i), SAVE_SLOT(i));
+#ifdef JIT_PROMOTED_CALLER_SAVED
+    loadPromoted(s);
+#endif
+}
+
+// evaluates two operands; ra may be clobbered by the caller
+static void genArgs2(jitState* s, opcodeRec* a, opcodeRec* b, int r, int* ra, int* rb)
+{
+    int pi = b->opcodeType == OPCODE_VARPTR ? promotedIndex(s, b->valuePtr) : -1;
+    if (pi >= 0) {
+        // read in place, a may have assigned it but that wrote the register too
+        genValue(s, a, r);
+        *ra = TEMP(r);
+        *rb = PVAR(pi);
+    } else if (a->opcodeType == OPCODE_VARPTR) {
+        // the snippets dereference both operands after evaluating them, so a
+        // variable on the left sees what the right side assigned to it
+        genValue(s, b, r);
+        genLoadVar(s, a->valuePtr, SCR2);
+        *ra = SCR2;
+        *rb = TEMP(r);
+    } else if (r + 1 < JIT_NUM_TEMPS) {
+        genValue(s, a, r);
+        genValue(s, b, r + 1);
+        *ra = TEMP(r);
+        *rb = TEMP(r + 1);
+    } else {
+        // out of temps, park a in the frame while b is computed
+        int slot = allocSlot(s);
+        genValue(s, a, r);
+        emitStoreSlot(s, slot, TEMP(r));
+        genValue(s, b, r);
+        emitLoadSlot(s, SCR2, slot);
+        freeSlot(s);
+        *ra = SCR2;
+        *rb = TEMP(r);
+    }
+}
+
+static void genCallValue(jitState* s, void* fn, int nargs, int r, int ra, int rb)
+{
+    callBegin(s, r);
+    if (nargs > 1 && rb == 0) {
+        // b already sits in the first argument register (xmm0)
+        emitFloatArg(s, 1, rb);
+        emitFloatArg(s, 0, ra);
+    } else {
+        emitFloatArg(s, 0, ra);
+        if (nargs > 1)
+            emitFloatArg(s, 1, rb);
+    }
+    emitCall(s, fn);
+    emitFloatResult(s, TEMP(r));
+    callEnd(s, r);
+}
+
+static void genCall1(jitState* s, opcodeRec* op, void* fn, int r)
+{
+    genValue(s, op->parms[0], r);
+    genCallValue(s, fn, 1, r, TEMP(r), 0);
+}
+
+static void genCall2(jitState* s, opcodeRec* op, void* fn, int r)
+{
+    int ra, rb;
+    genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+    genCallValue(s, fn, 2, r, ra, rb);
+}
+
+static int genAddr(jitState* s, opcodeRec* op, int r, int slot, double** p);
+
+// materializes whatever genAddr() produced in the result register
+static void genAddrDynamic(jitState* s, opcodeRec* op, int r, int slot)
+{
+    double* p;
+    switch (genAddr(s, op, r, slot, &p)) {
+    case ADDR_STATIC:
+        emitResultAbs(s, p);
+        break;
+    case ADDR_SLOT:
+        emitResultSlotAddr(s, slot);
+        break;
+    }
+}
+
+// calls a C function taking double* arguments. the pointers are those of the
+// variables themselves, so the function may write to them (rand() does).
+// with wantAddr a returned pointer is left in the result register.
+static void genPtrCall(jitState* s, opcodeRec* op, void* fn, int flags, int r, int wantAddr)
+{
+    int kinds[3], slots[3], pslots[3];
+    double* ptrs[3];
+    int i, argi = 0;
+    int np = op->opcodeType - OPCODE_FUNC1 + 1;
+
+    // a dynamic address may point at the value slot (if() with a value
+    // branch), so the pointer gets a slot of its own
+    for (i = 0; i < np; i++) {
+        slots[i] = allocSlot(s);
+        pslots[i] = allocSlot(s);
+        kinds[i] = genAddr(s, op->parms[i], r, slots[i], &ptrs[i]);
+        if (kinds[i] == ADDR_DYNAMIC)
+            emitResultToSlot(s, pslots[i]);
+    }
+
+    callBegin(s, r);
+#ifndef JIT_PROMOTED_CALLER_SAVED
+    for (i = 0; i < np; i++) {
+        int pi = kinds[i] == ADDR_STATIC ? promotedIndex(s, ptrs[i]) : -1;
+        if (pi >= 0)
+            emitStoreAbs(s, ptrs[i], PVAR(pi));
+    }
+#endif
+    if (flags & NSEEL_PFUNC_WANTCTX)
+        emitPtrArgAbs(s, argi++, s->userfunc_data);
+    for (i = 0; i < np; i++, argi++) {
+        if (kinds[i] == ADDR_STATIC)
+            emitPtrArgAbs(s, argi, ptrs[i]);
+        else if (kinds[i] == ADDR_SLOT)
+            emitPtrArgSlotAddr(s, argi, slots[i]);
+        else
+            emitPtrArgSlotLoad(s, argi, pslots[i]);
+    }
+    emitCall(s, fn);
+    if (!wantAddr) {
+        if (flags & NSEEL_PFUNC_RETPTR)
+            emitLoadResultPtr(s, TEMP(r));
+        else
+            emitFloatResult(s, TEMP(r));
+    }
+    callEnd(s, r);
+#ifndef JIT_PROMOTED_CALLER_SAVED
+    for (i = 0; i < np; i++) {
+        int pi = kinds[i] == ADDR_STATIC ? promotedIndex(s, ptrs[i]) : -1;
+        if (pi >= 0)
+            emitLoadAbs(s, PVAR(pi), ptrs[i]);
+    }
+#endif
+    for (i = 0; i < np * 2; i++)
+        freeSlot(s);
+}
+
+static functionType* userFunction(jitState* s, opcodeRec* op)
+{
+    functionType* f = nseel_getFunctionFromTable(op->fn);
+    // functions registered as x86 snippets can't be called from here
+    if (!f || !f->afunc || f->func_e || f->nParams != op->opcodeType - OPCODE_FUNC1 + 1) {
+        s->error = 1;
+        return NULL;
+    }
+    return f;
+}
+
+static void genIf(jitState* s, opcodeRec* op, int r, int wantAddr, int slot)
+{
+    int jelse, jend;
+    genValue(s, op->parms[0], r);
+    emitAbs(s, TEMP(r));
+    emitConst(s, SCR, NSEEL_CLOSEFACT);
+    jelse = emitJumpLess(s, TEMP(r), SCR);
+    if (wantAddr)
+        genAddrDynamic(s, op->parms[1], r, slot);
+    else
+        genValue(s, op->parms[1], r);
+    jend = emitJump(s);
+    patchJump(s, jelse, s->size);
+    if (wantAddr)
+        genAddrDynamic(s, op->parms[2], r, slot);
+    else
+        genValue(s, op->parms[2], r);
+    patchJump(s, jend, s->size);
+}
+
+// address of op for assignment or as a C function argument. like the x86
+// snippets, if(), exec2() and functions returning pointers yield lvalues.
+static int genAddr(jitState* s, opcodeRec* op, int r, int slot, double** p)
+{
+    if (op->opcodeType == OPCODE_VARPTR) {
+        *p = op->valuePtr;
+        return ADDR_STATIC;
+    }
+    if (op->opcodeType != OPCODE_DIRECTVALUE) {
+        if (op->fntype == MATH_SIMPLE) {
+            if (op->fn == FN_UPLUS)
+                return genAddr(s, op->parms[0], r, slot, p);
+        } else if (op->fn == FNIDX_IF) {
+            genIf(s, op, r, 1, slot);
+            return ADDR_DYNAMIC;
+        } else if (op->fn == FNIDX_EXEC2 || op->fn == FNIDX_EXEC3) {
+            int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+            for (i = 0; i < np - 1; i++)
+                genValue(s, op->parms[i], r);
+            return genAddr(s, op->parms[np - 1], r, slot, p);
+        } else if (op->fn >= FNIDX_USER) {
+            functionType* f = userFunction(s, op);
+            if (f && (f->flags & NSEEL_PFUNC_RETPTR)) {
+                genPtrCall(s, op, f->afunc, f->flags, r, 1);
+                return ADDR_DYNAMIC;
+            }
+        }
+    }
+    genValue(s, op, r);
+    emitStoreSlot(s, slot, TEMP(r));
+    return ADDR_SLOT;
+}
+
+static void genAssign(jitState* s, opcodeRec* dest, opcodeRec* src, int r)
+{
+    double* p;
+    int slot = allocSlot(s);
+    int pslot = allocSlot(s);
+    int kind = genAddr(s, dest, r, slot, &p);
+    if (kind == ADDR_STATIC) {
+        genValue(s, src, r);
+        genStoreVar(s, p, TEMP(r));
+    } else if (kind == ADDR_DYNAMIC) {
+        emitResultToSlot(s, pslot);
+        genValue(s, src, r);
+        emitStoreThroughSlot(s, pslot, TEMP(r));
+    } else {
+        // assigning to a temporary, nothing would ever see the store
+        genValue(s, src, r);
+    }
+    freeSlot(s);
+    freeSlot(s);
+}
+
+static void genMinMax(jitState* s, opcodeRec* op, int r, int ismax)
+{
+    int ra, rb;
+    genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+    emitMov(s, SCR, rb);
+    emitOp(s, JOP_SUB, SCR, ra);
+    emitAbs(s, SCR);
+    emitOp(s, ismax ? JOP_ADD : JOP_SUB, ra, SCR);
+    emitOp(s, JOP_ADD, ra, rb);
+    emitConst(s, SCR, 0.5);
+    emitOp(s, JOP_MUL, ra, SCR);
+    emitMov(s, TEMP(r), ra);
+}
+
+static void genValue(jitState* s, opcodeRec* op, int r)
+{
+    int ra, rb, i;
+
+    if (s->error)
+        return;
+
+    switch (op->opcodeType) {
+    case OPCODE_DIRECTVALUE:
+        emitConst(s, TEMP(r), op->value);
+        return;
+    case OPCODE_VARPTR:
+        genLoadVar(s, op->valuePtr, TEMP(r));
+        return;
+    }
+
+    if (op->fntype == MATH_SIMPLE) {
+        switch (op->fn) {
+        case FN_ASSIGN:
+            genAssign(s, op->parms[0], op->parms[1], r);
+            return;
+        case FN_ADD:
+        case FN_SUB:
+        case FN_MULTIPLY:
+        case FN_DIVIDE:
+            genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+            emitOp(s, op->fn == FN_ADD ? JOP_ADD : op->fn == FN_SUB ? JOP_SUB
+                    : op->fn == FN_MULTIPLY                          ? JOP_MUL
+                                                                     : JOP_DIV,
+                ra, rb);
+            emitMov(s, TEMP(r), ra);
+            return;
+        case FN_MODULO:
+            genCall2(s, op, (void*)nseel_f_mod, r);
+            return;
+        case FN_AND:
+            genCall2(s, op, (void*)nseel_f_and, r);
+            return;
+        case FN_OR:
+            genCall2(s, op, (void*)nseel_f_or, r);
+            return;
+        case FN_UMINUS:
+            genValue(s, op->parms[0], r);
+            emitNeg(s, TEMP(r));
+            return;
+        case FN_UPLUS:
+            genValue(s, op->parms[0], r);
+            return;
+        }
+        s->error = 1;
+        return;
+    }
+
+    switch (op->fn) {
+    case FNIDX_IF:
+        genIf(s, op, r, 0, 0);
+        return;
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+    case FNIDX_LOOP: {
+        int slot = allocSlot(s);
+        int skip, top;
+        genValue(s, op->parms[0], r);
+        skip = emitLoopBegin(s, TEMP(r), slot);
+        top = s->size;
+        genValue(s, op->parms[1], r);
+        emitLoopEnd(s, slot, top);
+        patchJump(s, skip, s->size);
+        freeSlot(s);
+        return;
+    }
+#endif
+    case FNIDX_SIN:
+        genCall1(s, op, (void*)sin, r);
+        return;
+    case FNIDX_COS:
+        genCall1(s, op, (void*)cos, r);
+        return;
+    case FNIDX_TAN:
+        genCall1(s, op, (void*)tan, r);
+        return;
+    case FNIDX_ASIN:
+        genCall1(s, op, (void*)asin, r);
+        return;
+    case FNIDX_ACOS:
+        genCall1(s, op, (void*)acos, r);
+        return;
+    case FNIDX_ATAN:
+        genCall1(s, op, (void*)atan, r);
+        return;
+    case FNIDX_ATAN2:
+        genCall2(s, op, (void*)atan2, r);
+        return;
+    case FNIDX_SQR:
+        genValue(s, op->parms[0], r);
+        emitOp(s, JOP_MUL, TEMP(r), TEMP(r));
+        return;
+    case FNIDX_SQRT:
+        genValue(s, op->parms[0], r);
+        emitAbs(s, TEMP(r));
+        emitSqrt(s, TEMP(r));
+        return;
+    case FNIDX_POW:
+        genCall2(s, op, (void*)pow, r);
+        return;
+    case FNIDX_EXP:
+        genCall1(s, op, (void*)exp, r);
+        return;
+    case FNIDX_LOG:
+        genCall1(s, op, (void*)log, r);
+        return;
+    case FNIDX_LOG10:
+        genCall1(s, op, (void*)log10, r);
+        return;
+    case FNIDX_ABS:
+        genValue(s, op->parms[0], r);
+        emitAbs(s, TEMP(r));
+        return;
+    case FNIDX_MIN:
+    case FNIDX_MAX:
+        genMinMax(s, op, r, op->fn == FNIDX_MAX);
+        return;
+    case FNIDX_SIGMOID:
+        genCall2(s, op, (void*)nseel_f_sig, r);
+        return;
+    case FNIDX_SIGN:
+        genCall1(s, op, (void*)nseel_f_sign, r);
+        return;
+    case FNIDX_RAND:
+        genPtrCall(s, op, (void*)nseel_f_rand, 0, r, 0);
+        return;
+    case FNIDX_BAND:
+        genCall2(s, op, (void*)nseel_f_band, r);
+        return;
+    case FNIDX_BOR:
+        genCall2(s, op, (void*)nseel_f_bor, r);
+        return;
+    case FNIDX_BNOT:
+        genValue(s, op->parms[0], r);
+        emitAbs(s, TEMP(r));
+        emitConst(s, SCR, NSEEL_CLOSEFACT);
+        emitLess(s, TEMP(r), TEMP(r), SCR);
+        return;
+    case FNIDX_EQUAL:
+        genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+        emitOp(s, JOP_SUB, ra, rb);
+        emitAbs(s, ra);
+        emitConst(s, SCR, NSEEL_CLOSEFACT);
+        emitLess(s, TEMP(r), ra, SCR);
+        return;
+    case FNIDX_BELOW:
+        genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+        emitLess(s, TEMP(r), ra, rb);
+        return;
+    case FNIDX_ABOVE:
+        genArgs2(s, op->parms[0], op->parms[1], r, &ra, &rb);
+        emitLess(s, TEMP(r), rb, ra);
+        return;
+    case FNIDX_FLOOR:
+#ifdef JIT_ARM64
+        genValue(s, op->parms[0], r);
+        emitFloor(s, TEMP(r));
+#else
+        genCall1(s, op, (void*)floor, r);
+#endif
+        return;
+    case FNIDX_CEIL:
+#ifdef JIT_ARM64
+        genValue(s, op->parms[0], r);
+        emitCeil(s, TEMP(r));
+#else
+        genCall1(s, op, (void*)ceil, r);
+#endif
+        return;
+    case FNIDX_INVSQRT:
+        genCall1(s, op, (void*)nseel_f_invsqrt, r);
+        return;
+    case FNIDX_ASSIGN:
+        genAssign(s, op->parms[0], op->parms[1], r);
+        return;
+    case FNIDX_EXEC2:
+    case FNIDX_EXEC3:
+        for (i = 0; i <= op->opcodeType - OPCODE_FUNC1; i++)
+            genValue(s, op->parms[i], r);
+        return;
+    }
+
+    if (op->fn >= FNIDX_USER) {
+        functionType* f = userFunction(s, op);
+        if (f)
+            genPtrCall(s, op, f->afunc, f->flags, r, 0);
+        return;
+    }
+    s->error = 1;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+static void* allocExec(const void* code, int size)
+{
+#ifdef _WIN32
+    DWORD old;
+    void* p = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!p)
+        return 0;
+    memcpy(p, code, size);
+    if (!VirtualProtect(p, size, PAGE_EXECUTE_READ, &old)) {
+        VirtualFree(p, 0, MEM_RELEASE);
+        return 0;
+    }
+    FlushInstructionCache(GetCurrentProcess(), p, size);
+    return p;
+#elif defined(__APPLE__) && defined(JIT_ARM64)
+    // hardened runtime: MAP_JIT pages flip between writable and executable per thread
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANON | MAP_JIT, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    pthread_jit_write_protect_np(0);
+    memcpy(p, code, size);
+    pthread_jit_write_protect_np(1);
+    sys_icache_invalidate(p, size);
+    return p;
+#else
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    memcpy(p, code, size);
+    if (mprotect(p, size, PROT_READ | PROT_EXEC)) {
+        munmap(p, size);
+        return 0;
+    }
+    __builtin___clear_cache((char*)p, (char*)p + size);
+    return p;
+#endif
+}
+
+void nseel_jit_free(void* code, int codesize)
+{
+    if (!code)
+        return;
+#ifdef _WIN32
+    (void)codesize;
+    VirtualFree(code, 0, MEM_RELEASE);
+#else
+    munmap(code, codesize);
+#endif
+}
+
+void* nseel_jit_compile(compileContext* ctx, opcodeRec** stmts, int nstmts, int* codesize)
+{
+    jitState body, pro;
+    void* code = NULL;
+    int i, frame;
+
+    memset(&body, 0, sizeof(body));
+    memset(&pro, 0, sizeof(pro));
+    body.userfunc_data = ctx->userfunc_data;
+
+    for (i = 0; i < nstmts; i++)
+        scanTree(&body, stmts[i], 1, 0);
+    choosePromoted(&body);
+
+    for (i = 0; i < nstmts; i++)
+        genValue(&body, stmts[i], 0);
+
+    frame = (FRAME_BASE + (JIT_NUM_TEMPS + body.slotMax) * 8 + 15) & ~15;
+    if (frame > JIT_MAX_FRAME)
+        body.error = 1;
+
+    storePromoted(&body);
+    emitEpilogue(&body, frame, body.npromoted);
+
+    // the prologue depends on the frame size, so it goes in front afterwards
+    pro.npromoted = body.npromoted;
+    memcpy(pro.promoted, body.promoted, sizeof(pro.promoted));
+    emitPrologue(&pro, frame, pro.npromoted);
+    loadPromoted(&pro);
+    emitBytes(&pro, body.buf, body.size);
+
+    if (!body.error && !pro.error) {
+        code = allocExec(pro.buf, pro.size);
+        *codesize = pro.size;
+    }
+
+    free(body.buf);
+    free(body.vars);
+    free(pro.buf);
+    return code;
+}
+
+#else // no code generator for this target
+
+void* nseel_jit_compile(compileContext* ctx, opcodeRec** stmts, int nstmts, int* codesize)
+{
+    return 0;
+}
+
+void nseel_jit_free(void* code, int codesize)
+{
+}
+
+#endif
+#endif // NSEEL_JIT
@@ -0,0 +1,781 @@
+// Bytecode interpreter for ns-eel, the fallback for nseel-jit.c.
+//
+// Used on targets the code generator doesn't know, where pages can't be made
+// executable (W^X policies, some sandboxes and consoles), or when selected
+// with NSEEL_setbackend(). The same trees are flattened into an array of
+// three-address instructions whose operands are plain pointers: variables
+// are used in place, constants sit in a pool and intermediate values in a
+// register file, all owned by the program. Dispatch is threaded through
+// computed gotos where the compiler has them and a switch otherwise.
+//
+// Like the x86 snippets, operands are read when an instruction runs, so a
+// variable on the left of an operator sees assignments made on the right.
+// The registers belong to the handle, so one handle can't run on two threads
+// at the same time (neither can the snippets, which share one work table).
+
+#include "ns-eel-int.h"
+#include <math.h>
+#include <string.h>
+#include "platform_shim_redirect.h"
+
+#ifdef NSEEL_JIT
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_THREADED
+#endif
+
+#ifndef NSEEL_LOOPFUNC_SUPPORT_MAXLEN
+#define NSEEL_LOOPFUNC_SUPPORT_MAXLEN (4096)
+#endif
+
+enum {
+    VM_END,
+    VM_MOV,
+    VM_ADD,
+    VM_SUB,
+    VM_MUL,
+    VM_DIV,
+    VM_NEG,
+    VM_ABS,
+    VM_SQR,
+    VM_SQRT,
+    VM_MIN,
+    VM_MAX,
+    VM_EQUAL,
+    VM_BELOW,
+    VM_ABOVE,
+    VM_BNOT,
+    VM_CALL1,
+    VM_CALL2,
+    VM_UCALL,
+    VM_JZ,
+    VM_JMP,
+    VM_LOOPINIT,
+    VM_LOOPNEXT,
+    VM_ADDR,
+    VM_LOADI,
+    VM_STOREI,
+    VM_NUM_OPS
+};
+
+typedef union {
+    double v;
+    double* p;
+} vmReg;
+
+// a C function taking pointers (rand() and NSEEL_addfunc_c functions)
+typedef struct {
+    void* fn;
+    int flags;
+    int nargs;
+    int indirect; // bit i: args[i] holds the address of the pointer to pass
+    void* ctx;
+    double* args[3];
+    double** ret; // RETPTR called for its address: the pointer goes here
+} vmCall;
+
+typedef struct {
+#ifdef VM_THREADED
+    const void* op;
+#else
+    int op;
+#endif
+    double* d;
+    double* a;
+    double* b;
+    union {
+        double (*f1)(double);
+        double (*f2)(double, double);
+        const vmCall* call;
+        double** pd;
+        int target;
+    } x;
+} vmInsn;
+
+typedef struct {
+    vmInsn* insns;
+    vmReg* regs;
+    double* consts;
+    vmCall* calls;
+} vmProgram;
+
+typedef struct {
+    compileContext* ctx;
+    vmProgram* prog;
+    int ninsns, insns_alloc;
+    int nregs, nconsts, ncalls;
+    int maxregs, maxconsts, maxcalls;
+    int error;
+} vmState;
+
+//---------------------------------------------------------------------------------------------------------------
+static void callUser(const vmCall* c, double* d)
+{
+    // the context pointer goes through the same double* slot, all data pointers
+    // are passed alike
+    double* a[4];
+    int i, n = 0;
+    if (c->flags & NSEEL_PFUNC_WANTCTX)
+        a[n++] = (double*)c->ctx;
+    for (i = 0; i < c->nargs; i++)
+        a[n++] = (c->indirect & (1 << i)) ? *(double**)c->args[i] : c->args[i];
+
+    if (c->flags & NSEEL_PFUNC_RETPTR) {
+        double* p;
+        switch (n) {
+        case 1:
+            p = ((double* (*)(double*))c->fn)(a[0]);
+            break;
+        case 2:
+            p = ((double* (*)(double*, double*))c->fn)(a[0], a[1]);
+            break;
+        case 3:
+            p = ((double* (*)(double*, double*, double*))c->fn)(a[0], a[1], a[2]);
+            break;
+        default:
+            p = ((double* (*)(double*, double*, double*, double*))c->fn)(a[0], a[1], a[2], a[3]);
+            break;
+        }
+        if (c->ret)
+            *c->ret = p;
+        else
+            *d = *p;
+    } else {
+        switch (n) {
+        case 1:
+            *d = ((double (*)(double*))c->fn)(a[0]);
+            break;
+        case 2:
+            *d = ((double (*)(double*, double*))c->fn)(a[0], a[1]);
+            break;
+        case 3:
+            *d = ((double (*)(double*, double*, double*))c->fn)(a[0], a[1], a[2]);
+            break;
+        default:
+            *d = ((double (*)(double*, double*, double*, double*))c->fn)(a[0], a[1], a[2], a[3]);
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// with table set, only hands out the label addresses for the threaded dispatch
+static void vmRun(const vmInsn* code, const void*** table)
+{
+    const vmInsn* ip = code;
+
+#ifdef VM_THREADED
+    static const void* labels[VM_NUM_OPS] = {
+        &&op_END, &&op_MOV, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_NEG,
+        &&op_ABS, &&op_SQR, &&op_SQRT, &&op_MIN, &&op_MAX, &&op_EQUAL, &&op_BELOW,
+        &&op_ABOVE, &&op_BNOT, &&op_CALL1, &&op_CALL2, &&op_UCALL, &&op_JZ,
+        &&op_JMP, &&op_LOOPINIT, &&op_LOOPNEXT, &&op_ADDR, &&op_LOADI, &&op_STOREI
+    };
+#define VM_CASE(x) op_##x:
+#define VM_NEXT goto* (++ip)->op
+#define VM_JUMP(t)          \
+    {                       \
+        ip = code + (t);    \
+        goto* ip->op;       \
+    }
+    if (table) {
+        *table = labels;
+        return;
+    }
+    goto* ip->op;
+#else
+#define VM_CASE(x) case VM_##x:
+#define VM_NEXT \
+    ++ip;       \
+    continue
+#define VM_JUMP(t)       \
+    {                    \
+        ip = code + (t); \
+        continue;        \
+    }
+    (void)table;
+    for (;;)
+        switch (ip->op) {
+#endif
+
+    VM_CASE(END)
+    return;
+    VM_CASE(MOV)
+    *ip->d = *ip->a;
+    VM_NEXT;
+    VM_CASE(ADD)
+    *ip->d = *ip->a + *ip->b;
+    VM_NEXT;
+    VM_CASE(SUB)
+    *ip->d = *ip->a - *ip->b;
+    VM_NEXT;
+    VM_CASE(MUL)
+    *ip->d = *ip->a * *ip->b;
+    VM_NEXT;
+    VM_CASE(DIV)
+    *ip->d = *ip->a / *ip->b;
+    VM_NEXT;
+    VM_CASE(NEG)
+    *ip->d = -*ip->a;
+    VM_NEXT;
+    VM_CASE(ABS)
+    *ip->d = fabs(*ip->a);
+    VM_NEXT;
+    VM_CASE(SQR)
+    {
+        double a = *ip->a;
+        *ip->d = a * a;
+    }
+    VM_NEXT;
+    VM_CASE(SQRT)
+    *ip->d = sqrt(fabs(*ip->a));
+    VM_NEXT;
+    VM_CASE(MIN)
+    {
+        double a = *ip->a, b = *ip->b;
+        *ip->d = NSEEL_MIN(a, b);
+    }
+    VM_NEXT;
+    VM_CASE(MAX)
+    {
+        double a = *ip->a, b = *ip->b;
+        *ip->d = NSEEL_MAX(a, b);
+    }
+    VM_NEXT;
+    VM_CASE(EQUAL)
+    {
+        double a = *ip->a, b = *ip->b;
+        *ip->d = NSEEL_EQUAL(a, b);
+    }
+    VM_NEXT;
+    VM_CASE(BELOW)
+    *ip->d = NSEEL_LESS(*ip->a, *ip->b);
+    VM_NEXT;
+    VM_CASE(ABOVE)
+    *ip->d = NSEEL_LESS(*ip->b, *ip->a);
+    VM_NEXT;
+    VM_CASE(BNOT)
+    *ip->d = NSEEL_BNOT(*ip->a);
+    VM_NEXT;
+    VM_CASE(CALL1)
+    *ip->d = ip->x.f1(*ip->a);
+    VM_NEXT;
+    VM_CASE(CALL2)
+    *ip->d = ip->x.f2(*ip->a, *ip->b);
+    VM_NEXT;
+    VM_CASE(UCALL)
+    callUser(ip->x.call, ip->d);
+    VM_NEXT;
+    VM_CASE(JZ)
+    if (NSEEL_ISFALSE(*ip->a))
+        VM_JUMP(ip->x.target);
+    VM_NEXT;
+    VM_CASE(JMP)
+    VM_JUMP(ip->x.target);
+    VM_CASE(LOOPINIT)
+    {
+        // a: count, d: remaining iterations
+        int n = nseel_f_fistp32(*ip->a);
+        if (n < 1)
+            VM_JUMP(ip->x.target);
+        *ip->d = n > NSEEL_LOOPFUNC_SUPPORT_MAXLEN ? NSEEL_LOOPFUNC_SUPPORT_MAXLEN : n;
+    }
+    VM_NEXT;
+    VM_CASE(LOOPNEXT)
+    if ((*ip->d -= 1.0) > 0.0)
+        VM_JUMP(ip->x.target);
+    VM_NEXT;
+    VM_CASE(ADDR)
+    *ip->x.pd = ip->a;
+    VM_NEXT;
+    VM_CASE(LOADI)
+    *ip->d = **ip->x.pd;
+    VM_NEXT;
+    VM_CASE(STOREI)
+    {
+        double v = *ip->a;
+        **ip->x.pd = v;
+        *ip->d = v;
+    }
+    VM_NEXT;
+
+#ifndef VM_THREADED
+        default:
+            return;
+        }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// register file and pools are sized up front from the trees, so the pointers
+// handed to instructions stay valid
+
+static void countTree(vmState* s, opcodeRec* op)
+{
+    int i, np;
+    s->maxconsts++;
+    if (op->opcodeType == OPCODE_DIRECTVALUE || op->opcodeType == OPCODE_VARPTR)
+        return;
+    s->maxcalls++;
+    np = op->opcodeType - OPCODE_FUNC1 + 1;
+    for (i = 0; i < np; i++)
+        countTree(s, op->parms[i]);
+}
+
+static vmInsn* emit(vmState* s, int op, double* d, double* a, double* b)
+{
+    static vmInsn dummy;
+    vmInsn* in;
+    if (s->ninsns >= s->insns_alloc) {
+        int na = s->insns_alloc ? s->insns_alloc * 2 : 64;
+        vmInsn* ni = (vmInsn*)realloc(s->prog->insns, na * sizeof(vmInsn));
+        if (!ni) {
+            s->error = 1;
+            return &dummy;
+        }
+        s->prog->insns = ni;
+        s->insns_alloc = na;
+    }
+    in = s->prog->insns + s->ninsns++;
+    memset(in, 0, sizeof(vmInsn));
+#ifdef VM_THREADED
+    in->op = (const void*)(intptr_t)op; // becomes a label address once compiled
+#else
+    in->op = op;
+#endif
+    in->d = d;
+    in->a = a;
+    in->b = b;
+    return in;
+}
+
+static double* reg(vmState* s, int r)
+{
+    if (r >= s->maxregs) {
+        s->error = 1;
+        r = 0;
+    }
+    if (r >= s->nregs)
+        s->nregs = r + 1;
+    return &s->prog->regs[r].v;
+}
+
+static double* constant(vmState* s, double v)
+{
+    if (s->nconsts >= s->maxconsts) {
+        s->error = 1;
+        return s->prog->consts;
+    }
+    s->prog->consts[s->nconsts] = v;
+    return s->prog->consts + s->nconsts++;
+}
+
+static int isTemp(vmState* s, double* p)
+{
+    return p >= &s->prog->regs[0].v && p < &s->prog->regs[s->maxregs].v;
+}
+
+static int isConst(vmState* s, double* p)
+{
+    return p >= s->prog->consts && p < s->prog->consts + s->maxconsts;
+}
+
+// whether evaluating op can change a variable
+static int writesVars(opcodeRec* op)
+{
+    int i, np;
+    if (op->opcodeType == OPCODE_DIRECTVALUE || op->opcodeType == OPCODE_VARPTR)
+        return 0;
+    if (op->fntype == MATH_SIMPLE ? op->fn == FN_ASSIGN : (op->fn == FNIDX_ASSIGN || op->fn == FNIDX_RAND || op->fn >= FNIDX_USER))
+        return 1;
+    np = op->opcodeType - OPCODE_FUNC1 + 1;
+    for (i = 0; i < np; i++)
+        if (writesVars(op->parms[i]))
+            return 1;
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// code generation. genValue() returns where the value of op ends up: a
+// variable, a constant, want or register r. it may use registers r and
+// above, and only its last instruction writes to want.
+
+static double* genValue(vmState* s, opcodeRec* op, int r, double* want);
+
+static void genInto(vmState* s, opcodeRec* op, int r, double* d)
+{
+    double* v = genValue(s, op, r, d);
+    if (v != d)
+        emit(s, VM_MOV, d, v, 0);
+}
+
+static double* genOp1(vmState* s, int vop, opcodeRec* op, int r, double* want)
+{
+    double* a = genValue(s, op->parms[0], r, 0);
+    double* d = want ? want : reg(s, r);
+    emit(s, vop, d, a, 0);
+    return d;
+}
+
+static vmInsn* genOp2(vmState* s, int vop, opcodeRec* op, int r, double* d)
+{
+    double* a = genValue(s, op->parms[0], r, 0);
+    double* b;
+    if (!isTemp(s, a) && !isConst(s, a) && op->parms[0]->opcodeType != OPCODE_VARPTR && writesVars(op->parms[1])) {
+        // a is the variable an assignment returned; only a plain variable on
+        // the left is read late
+        emit(s, VM_MOV, reg(s, r), a, 0);
+        a = reg(s, r);
+    }
+    b = genValue(s, op->parms[1], r + 1, 0);
+    return emit(s, vop, d, a, b);
+}
+
+static double* genBinary(vmState* s, int vop, opcodeRec* op, int r, double* want)
+{
+    double* d = want ? want : reg(s, r);
+    genOp2(s, vop, op, r, d);
+    return d;
+}
+
+static double* genCall1(vmState* s, double (*fn)(double), opcodeRec* op, int r, double* want)
+{
+    double* a = genValue(s, op->parms[0], r, 0);
+    double* d = want ? want : reg(s, r);
+    emit(s, VM_CALL1, d, a, 0)->x.f1 = fn;
+    return d;
+}
+
+static double* genCall2(vmState* s, double (*fn)(double, double), opcodeRec* op, int r, double* want)
+{
+    double* d = want ? want : reg(s, r);
+    genOp2(s, VM_CALL2, op, r, d)->x.f2 = fn;
+    return d;
+}
+
+static functionType* userFunction(vmState* s, opcodeRec* op)
+{
+    functionType* f = nseel_getFunctionFromTable(op->fn);
+    // functions registered as x86 snippets can't be called from here
+    if (!f || !f->afunc || f->func_e || f->nParams != op->opcodeType - OPCODE_FUNC1 + 1) {
+        s->error = 1;
+        return NULL;
+    }
+    return f;
+}
+
+// address of op for assignment or as a C function argument. returns the
+// address, or NULL when it is only known at run time and was left in register
+// r. uses registers r and r + 1, like the x86 snippets if(), exec2() and
+// functions returning pointers yield lvalues, anything else is copied to r + 1.
+static double* genAddr(vmState* s, opcodeRec* op, int r);
+
+static double* genPtrCall(vmState* s, opcodeRec* op, void* fn, int flags, int r, double* want, int wantAddr)
+{
+    vmCall* c;
+    double* d = 0;
+    int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+
+    if (s->ncalls >= s->maxcalls) {
+        s->error = 1;
+        return reg(s, r);
+    }
+    c = s->prog->calls + s->ncalls++;
+    c->fn = fn;
+    c->flags = flags;
+    c->nargs = np;
+    c->ctx = s->ctx->userfunc_data;
+    for (i = 0; i < np; i++) {
+        double* p = genAddr(s, op->parms[i], r + 2 * i);
+        if (p) {
+            c->args[i] = p;
+        } else {
+            c->args[i] = (double*)&s->prog->regs[r + 2 * i].p;
+            c->indirect |= 1 << i;
+        }
+    }
+    if (wantAddr)
+        c->ret = &s->prog->regs[r].p;
+    else
+        d = want ? want : reg(s, r);
+    emit(s, VM_UCALL, d, 0, 0)->x.call = c;
+    return d;
+}
+
+static double* genIf(vmState* s, opcodeRec* op, int r, double* want, int wantAddr)
+{
+    vmInsn* in;
+    int jz, jmp;
+    double* d = want ? want : reg(s, r);
+    double* c = genValue(s, op->parms[0], r, 0);
+
+    jz = s->ninsns;
+    emit(s, VM_JZ, 0, c, 0);
+    if (wantAddr) {
+        double* p = genAddr(s, op->parms[1], r);
+        if (p)
+            emit(s, VM_ADDR, 0, p, 0)->x.pd = &s->prog->regs[r].p;
+    } else {
+        genInto(s, op->parms[1], r, d);
+    }
+    jmp = s->ninsns;
+    emit(s, VM_JMP, 0, 0, 0);
+    s->prog->insns[jz].x.target = s->ninsns;
+    if (wantAddr) {
+        double* p = genAddr(s, op->parms[2], r);
+        if (p)
+            emit(s, VM_ADDR, 0, p, 0)->x.pd = &s->prog->regs[r].p;
+    } else {
+        genInto(s, op->parms[2], r, d);
+    }
+    in = s->prog->insns + jmp;
+    in->x.target = s->ninsns;
+    return wantAddr ? 0 : d;
+}
+
+static double* genAddr(vmState* s, opcodeRec* op, int r)
+{
+    if (op->opcodeType == OPCODE_VARPTR)
+        return op->valuePtr;
+    if (op->opcodeType != OPCODE_DIRECTVALUE) {
+        if (op->fntype == MATH_SIMPLE) {
+            if (op->fn == FN_UPLUS)
+                return genAddr(s, op->parms[0], r);
+        } else if (op->fn == FNIDX_IF) {
+            return genIf(s, op, r, 0, 1);
+        } else if (op->fn == FNIDX_EXEC2 || op->fn == FNIDX_EXEC3) {
+            int i, np = op->opcodeType - OPCODE_FUNC1 + 1;
+            for (i = 0; i < np - 1; i++)
+                genValue(s, op->parms[i], r, 0);
+            return genAddr(s, op->parms[np - 1], r);
+        } else if (op->fn >= FNIDX_USER) {
+            functionType* f = userFunction(s, op);
+            if (f && (f->flags & NSEEL_PFUNC_RETPTR))
+                return genPtrCall(s, op, f->afunc, f->flags, r, 0, 1);
+        }
+    }
+    // a private copy, the callee may write to it
+    genInto(s, op, r, reg(s, r + 1));
+    return reg(s, r + 1);
+}
+
+static double* genAssign(vmState* s, opcodeRec* dest, opcodeRec* src, int r, double* want)
+{
+    double* p = genAddr(s, dest, r);
+    double* d;
+    if (!p) {
+        double* v = genValue(s, src, r + 1, 0);
+        d = want ? want : reg(s, r);
+        emit(s, VM_STOREI, d, v, 0)->x.pd = &s->prog->regs[r].p;
+        return d;
+    }
+    if (isTemp(s, p)) // assigning to a temporary, nothing would ever see the store
+        return genValue(s, src, r, want);
+    genInto(s, src, r, p);
+    return p;
+}
+
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+static double* genLoop(vmState* s, opcodeRec* op, int r)
+{
+    // register r holds the value (the count when the body never runs), r + 1
+    // the iterations left. the body runs repeatedly, so it never gets want
+    int init, top;
+    double* d = reg(s, r);
+    double* n = reg(s, r + 1);
+    genInto(s, op->parms[0], r, d);
+    init = s->ninsns;
+    emit(s, VM_LOOPINIT, n, d, 0);
+    top = s->ninsns;
+    genInto(s, op->parms[1], r + 2, d);
+    emit(s, VM_LOOPNEXT, n, 0, 0)->x.target = top;
+    s->prog->insns[init].x.target = s->ninsns;
+    return d;
+}
+#endif
+
+static double* genValue(vmState* s, opcodeRec* op, int r, double* want)
+{
+    int i;
+
+    if (s->error)
+        return reg(s, 0);
+
+    switch (op->opcodeType) {
+    case OPCODE_DIRECTVALUE:
+        return constant(s, op->value);
+    case OPCODE_VARPTR:
+        return op->valuePtr;
+    }
+
+    if (op->fntype == MATH_SIMPLE) {
+        switch (op->fn) {
+        case FN_ASSIGN:
+            return genAssign(s, op->parms[0], op->parms[1], r, want);
+        case FN_ADD:
+            return genBinary(s, VM_ADD, op, r, want);
+        case FN_SUB:
+            return genBinary(s, VM_SUB, op, r, want);
+        case FN_MULTIPLY:
+            return genBinary(s, VM_MUL, op, r, want);
+        case FN_DIVIDE:
+            return genBinary(s, VM_DIV, op, r, want);
+        case FN_MODULO:
+            return genCall2(s, nseel_f_mod, op, r, want);
+        case FN_AND:
+            return genCall2(s, nseel_f_and, op, r, want);
+        case FN_OR:
+            return genCall2(s, nseel_f_or, op, r, want);
+        case FN_UMINUS:
+            return genOp1(s, VM_NEG, op, r, want);
+        case FN_UPLUS:
+            return genValue(s, op->parms[0], r, want);
+        }
+        s->error = 1;
+        return reg(s, r);
+    }
+
+    switch (op->fn) {
+    case FNIDX_IF:
+        return genIf(s, op, r, want, 0);
+#ifdef NSEEL_LOOPFUNC_SUPPORT
+    case FNIDX_LOOP:
+        return genLoop(s, op, r);
+#endif
+    case FNIDX_SIN:
+        return genCall1(s, sin, op, r, want);
+    case FNIDX_COS:
+        return genCall1(s, cos, op, r, want);
+    case FNIDX_TAN:
+        return genCall1(s, tan, op, r, want);
+    case FNIDX_ASIN:
+        return genCall1(s, asin, op, r, want);
+    case FNIDX_ACOS:
+        return genCall1(s, acos, op, r, want);
+    case FNIDX_ATAN:
+        return genCall1(s, atan, op, r, want);
+    case FNIDX_ATAN2:
+        return genCall2(s, atan2, op, r, want);
+    case FNIDX_SQR:
+        return genOp1(s, VM_SQR, op, r, want);
+    case FNIDX_SQRT:
+        return genOp1(s, VM_SQRT, op, r, want);
+    case FNIDX_POW:
+        return genCall2(s, pow, op, r, want);
+    case FNIDX_EXP:
+        return genCall1(s, exp, op, r, want);
+    case FNIDX_LOG:
+        return genCall1(s, log, op, r, want);
+    case FNIDX_LOG10:
+        return genCall1(s, log10, op, r, want);
+    case FNIDX_ABS:
+        return genOp1(s, VM_ABS, op, r, want);
+    case FNIDX_MIN:
+        return genBinary(s, VM_MIN, op, r, want);
+    case FNIDX_MAX:
+        return genBinary(s, VM_MAX, op, r, want);
+    case FNIDX_SIGMOID:
+        return genCall2(s, nseel_f_sig, op, r, want);
+    case FNIDX_SIGN:
+        return genCall1(s, nseel_f_sign, op, r, want);
+    case FNIDX_RAND:
+        return genPtrCall(s, op, (void*)nseel_f_rand, 0, r, want, 0);
+    case FNIDX_BAND:
+        return genCall2(s, nseel_f_band, op, r, want);
+    case FNIDX_BOR:
+        return genCall2(s, nseel_f_bor, op, r, want);
+    case FNIDX_BNOT:
+        return genOp1(s, VM_BNOT, op, r, want);
+    case FNIDX_EQUAL:
+        return genBinary(s, VM_EQUAL, op, r, want);
+    case FNIDX_BELOW:
+        return genBinary(s, VM_BELOW, op, r, want);
+    case FNIDX_ABOVE:
+        return genBinary(s, VM_ABOVE, op, r, want);
+    case FNIDX_FLOOR:
+        return genCall1(s, floor, op, r, want);
+    case FNIDX_CEIL:
+        return genCall1(s, ceil, op, r, want);
+    case FNIDX_INVSQRT:
+        return genCall1(s, nseel_f_invsqrt, op, r, want);
+    case FNIDX_ASSIGN:
+        return genAssign(s, op->parms[0], op->parms[1], r, want);
+    case FNIDX_EXEC2:
+    case FNIDX_EXEC3: {
+        int np = op->opcodeType - OPCODE_FUNC1 + 1;
+        for (i = 0; i < np - 1; i++)
+            genValue(s, op->parms[i], r, 0);
+        return genValue(s, op->parms[np - 1], r, want);
+    }
+    }
+
+    if (op->fn >= FNIDX_USER) {
+        functionType* f = userFunction(s, op);
+        if (f)
+            return genPtrCall(s, op, f->afunc, f->flags, r, want, 0);
+        return reg(s, r);
+    }
+    s->error = 1;
+    return reg(s, r);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+void* nseel_vm_compile(compileContext* ctx, opcodeRec** stmts, int nstmts, int* codesize)
+{
+    vmState s;
+    vmProgram* prog;
+    int i;
+
+    memset(&s, 0, sizeof(s));
+    s.ctx = ctx;
+    for (i = 0; i < nstmts; i++)
+        countTree(&s, stmts[i]);
+    // every node takes at most two registers more than its parent, loop() three
+    s.maxregs = 3 * s.maxconsts + 4;
+
+    prog = (vmProgram*)calloc(1, sizeof(vmProgram) + s.maxregs * sizeof(vmReg) + s.maxconsts * sizeof(double) + s.maxcalls * sizeof(vmCall));
+    if (!prog)
+        return 0;
+    prog->regs = (vmReg*)(prog + 1);
+    prog->consts = (double*)(prog->regs + s.maxregs);
+    prog->calls = (vmCall*)(prog->consts + s.maxconsts);
+    s.prog = prog;
+
+    for (i = 0; i < nstmts && !s.error; i++)
+        genValue(&s, stmts[i], 0, 0);
+    emit(&s, VM_END, 0, 0, 0);
+
+    if (s.error) {
+        nseel_vm_free(prog);
+        return 0;
+    }
+
+#ifdef VM_THREADED
+    {
+        const void** labels;
+        vmRun(0, &labels);
+        for (i = 0; i < s.ninsns; i++)
+            prog->insns[i].op = labels[(intptr_t)prog->insns[i].op];
+    }
+#endif
+    *codesize = s.ninsns * (int)sizeof(vmInsn);
+    return prog;
+}
+
+void nseel_vm_execute(void* code)
+{
+    vmRun(((vmProgram*)code)->insns, 0);
+}
+
+void nseel_vm_free(void* code)
+{
+    if (code) {
+        free(((vmProgram*)code)->insns);
+        free(code);
+    }
+}
+
+#endif // NSEEL_JIT
@@ -1,3 +1,29 @@
 // Local shim redirect for ns-eel sources relative include convenience.
 #pragma once
-#include "../../platform_shim.h"
\ No newline at end of file
+#if defined(_WIN32) || defined(__cplusplus)
+#include "../../platform_shim.h"
+#else
+// the full shim is C++ only; the C sources here just need the allocator and
+// string helpers
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef void* HGLOBAL;
+#define GMEM_FIXED 0
+#define GPTR 0x40
+#define GlobalAlloc(flags, size) (((flags) & GPTR) ? calloc(1, (size)) : malloc(size))
+#define GlobalFree(p) free(p)
+
+#define strnicmp strncasecmp
+#define strcmpi strcasecmp
+#define lstrcpyn(dest, src, n) (strncpy((dest), (src), (n) - 1), (dest)[(n) - 1] = 0, (dest))
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#endif
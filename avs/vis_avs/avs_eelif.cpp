@@ -30,14 +30,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "avs_eelif.h"
 #include "../../platform_shim.h"
 #include "../ns-eel/ns-eel-addfuncs.h"
+#include "visdata_ex.h"
 
 #ifdef AVS_MEGABUF_SUPPORT
 #include "../ns-eel/megabuf.h"
 #endif
 
 static void gmegabuf_cleanup();
+#ifdef NSEEL_JIT
+static double* gmegabuf_(double* which);
+#else
 void _asm_gmegabuf(void);
 void _asm_gmegabuf_end(void);
+#endif
 
 char last_error_string[1024];
 int g_log_errors;
@@ -120,6 +125,24 @@ static double NSEEL_CGEN_CALL setmousepos_(double* x, double* y)
     return 0.0;
 }
 
+// 0 bpm, 1 beat phase, 2 confidence, 3 onset strength, 4 beat count
+static double NSEEL_CGEN_CALL gettempo_(double* which)
+{
+    switch ((int)(*which + 0.5)) {
+    case 0:
+        return g_vis_tempo.bpm;
+    case 1:
+        return g_vis_tempo.phase;
+    case 2:
+        return g_vis_tempo.confidence;
+    case 3:
+        return g_vis_tempo.onset;
+    case 4:
+        return g_vis_tempo.beats;
+    }
+    return 0.0;
+}
+
 extern double DDraw_translatePoint(POINT p, int isY);
 
 static double NSEEL_CGEN_CALL getmouse_(double* which)
@@ -143,6 +166,7 @@ static double NSEEL_CGEN_CALL getmouse_(double* which)
     return 0.0;
 }
 
+#ifndef NSEEL_JIT
 static double(NSEEL_CGEN_CALL* __getosc)(double*, double*, double*) = &getosc_;
 __declspec(naked) void _asm_getosc(void)
 {
@@ -187,6 +211,17 @@ __declspec(naked) void _asm_getmouse(void)
 }
 __declspec(naked) void _asm_getmouse_end(void) { }
 
+static double(NSEEL_CGEN_CALL* __gettempo)(double*) = &gettempo_;
+__declspec(naked) void _asm_gettempo(void)
+{
+    FUNC1_ENTER
+
+    *__nextBlock = __gettempo(parm_a);
+
+    FUNC_LEAVE
+}
+__declspec(naked) void _asm_gettempo_end(void) { }
+
 static double(NSEEL_CGEN_CALL* __setmousepos)(double*, double*) = &setmousepos_;
 __declspec(naked) void _asm_setmousepos(void)
 {
@@ -197,6 +232,7 @@ __declspec(naked) void _asm_setmousepos(void)
     FUNC_LEAVE
 }
 __declspec(naked) void _asm_setmousepos_end(void) { }
+#endif
 
 /////////////////////// end AVS specific script functions
 
@@ -204,15 +240,32 @@ void AVS_EEL_IF_init()
 {
     InitializeCriticalSection(&g_eval_cs);
     NSEEL_init();
+#ifdef NSEEL_JIT
+    // the generated code calls these directly, arguments in script order
+    // the readers have no side effects, so per-point code using them can
+    // still run batched
+    NSEEL_addfunc_c("getosc", 3, (void*)getosc_, NSEEL_PFUNC_PURE);
+    NSEEL_addfunc_c("getspec", 3, (void*)getspec_, NSEEL_PFUNC_PURE);
+    NSEEL_addfunc_c("gettime", 1, (void*)gettime_, 0);
+    NSEEL_addfunc_c("getkbmouse", 1, (void*)getmouse_, NSEEL_PFUNC_PURE);
+    NSEEL_addfunc_c("setmousepos", 2, (void*)setmousepos_, 0);
+    NSEEL_addfunc_c("gettempo", 1, (void*)gettempo_, NSEEL_PFUNC_PURE);
+#ifdef AVS_MEGABUF_SUPPORT
+    NSEEL_addfunc_c("megabuf", 1, (void*)megabuf_, NSEEL_PFUNC_RETPTR | NSEEL_PFUNC_WANTCTX);
+    NSEEL_addfunc_c("gmegabuf", 1, (void*)gmegabuf_, NSEEL_PFUNC_RETPTR);
+#endif
+#else
     NSEEL_addfunction("getosc", 3, (int)_asm_getosc, (int)_asm_getosc_end - (int)_asm_getosc);
     NSEEL_addfunction("getspec", 3, (int)_asm_getspec, (int)_asm_getspec_end - (int)_asm_getspec);
     NSEEL_addfunction("gettime", 1, (int)_asm_gettime, (int)_asm_gettime_end - (int)_asm_gettime);
     NSEEL_addfunction("getkbmouse", 1, (int)_asm_getmouse, (int)_asm_getmouse_end - (int)_asm_getmouse);
     NSEEL_addfunction("setmousepos", 2, (int)_asm_setmousepos, (int)_asm_setmousepos_end - (int)_asm_setmousepos);
+    NSEEL_addfunction("gettempo", 1, (int)_asm_gettempo, (int)_asm_gettempo_end - (int)_asm_gettempo);
 #ifdef AVS_MEGABUF_SUPPORT
     NSEEL_addfunctionex("megabuf", 1, (int)_asm_megabuf, (int)_asm_megabuf_end - (int)_asm_megabuf, megabuf_ppproc);
     NSEEL_addfunction("gmegabuf", 1, (int)_asm_gmegabuf, (int)_asm_gmegabuf_end - (int)_asm_gmegabuf);
 #endif
+#endif
 }
 void AVS_EEL_IF_quit()
 {
@@ -239,7 +292,7 @@ static void movestringover(char* str, int amount)
     memcpy(str + amount, tmp, l + 1);
 }
 
-int AVS_EEL_IF_Compile(int context, char* code)
+intptr_t AVS_EEL_IF_Compile(intptr_t context, char* code)
 {
     NSEEL_CODEHANDLE ret;
     EnterCriticalSection(&g_eval_cs);
@@ -259,7 +312,7 @@ int AVS_EEL_IF_Compile(int context, char* code)
         }
     }
     LeaveCriticalSection(&g_eval_cs);
-    return (int)ret;
+    return (intptr_t)ret;
 }
 
 void AVS_EEL_IF_Execute(void* handle, char visdata[2][2][576])
@@ -273,7 +326,30 @@ void AVS_EEL_IF_Execute(void* handle, char visdata[2][2][576])
     }
 }
 
-void AVS_EEL_IF_Free(int handle)
+void AVS_EEL_IF_ExecuteBatch(void* handle, char visdata[2][2][576], NSEEL_LANEVAR* vars, int nvars, int n)
+{
+    if (handle) {
+        EnterCriticalSection(&g_eval_cs);
+        g_evallib_visdata = (char*)visdata;
+        NSEEL_code_execute_batch((NSEEL_CODEHANDLE)handle, vars, nvars, n);
+        g_evallib_visdata = NULL;
+        LeaveCriticalSection(&g_eval_cs);
+    }
+}
+
+void AVS_EEL_IF_BeginExecute(char visdata[2][2][576])
+{
+    EnterCriticalSection(&g_eval_cs);
+    g_evallib_visdata = (char*)visdata;
+}
+
+void AVS_EEL_IF_EndExecute()
+{
+    g_evallib_visdata = NULL;
+    LeaveCriticalSection(&g_eval_cs);
+}
+
+void AVS_EEL_IF_Free(intptr_t handle)
 {
     NSEEL_code_free((NSEEL_CODEHANDLE)handle);
 }
@@ -294,6 +370,62 @@ void AVS_EEL_IF_VM_free(NSEEL_VMCTX ctx)
     NSEEL_VM_free(ctx);
 }
 
+static int addSyncVar(char* name, double* value, void* ctx)
+{
+    void** p = (void**)ctx;
+    AVS_EEL_CLONE* c = (AVS_EEL_CLONE*)p[1];
+    if (c->nsync * 2 + 2 > c->sync_alloc) {
+        int na = c->sync_alloc + 64;
+        double** ns = (double**)realloc(c->sync, na * sizeof(double*));
+        if (!ns)
+            return 0;
+        c->sync = ns;
+        c->sync_alloc = na;
+    }
+    c->sync[c->nsync * 2] = NSEEL_VM_regvar((NSEEL_VMCTX)p[0], name);
+    c->sync[c->nsync * 2 + 1] = value;
+    c->nsync++;
+    return 1;
+}
+
+int AVS_EEL_IF_MakeClone(AVS_EEL_CLONE* c, intptr_t context, char* code)
+{
+    void* p[2] = { (void*)context, c };
+    if (!c->vm)
+        c->vm = (intptr_t)NSEEL_VM_alloc();
+    if (!c->vm)
+        return 0;
+    c->code = AVS_EEL_IF_Compile(c->vm, code);
+    if (!c->code)
+        return 0;
+    c->nsync = 0;
+    NSEEL_VM_enumallvars((NSEEL_VMCTX)c->vm, addSyncVar, p);
+    return 1;
+}
+
+void AVS_EEL_IF_FreeClone(AVS_EEL_CLONE* c)
+{
+    if (c->code)
+        NSEEL_code_free((NSEEL_CODEHANDLE)c->code);
+    if (c->vm) {
+        NSEEL_VM_resetvars((NSEEL_VMCTX)c->vm);
+        AVS_EEL_IF_VM_free((NSEEL_VMCTX)c->vm);
+    }
+    free(c->sync);
+    memset(c, 0, sizeof(AVS_EEL_CLONE));
+}
+
+void AVS_EEL_IF_SyncClone(AVS_EEL_CLONE* c, int to_original)
+{
+    int k;
+    if (to_original)
+        for (k = 0; k < c->nsync; k++)
+            *c->sync[k * 2] = *c->sync[k * 2 + 1];
+    else
+        for (k = 0; k < c->nsync; k++)
+            *c->sync[k * 2 + 1] = *c->sync[k * 2];
+}
+
 //////////////////////////////
 static double* gmb_blocks[MEGABUF_BLOCKS];
 
@@ -325,6 +457,7 @@ static double* NSEEL_CGEN_CALL gmegabuf_(double* which)
     return &error;
 }
 
+#ifndef NSEEL_JIT
 static double*(NSEEL_CGEN_CALL* __gmegabuf)(double*) = &gmegabuf_;
 __declspec(naked) void _asm_gmegabuf(void)
 {
@@ -341,3 +474,4 @@ __declspec(naked) void _asm_gmegabuf(void)
     __asm { mov esp, ebp }
 }
 __declspec(naked) void _asm_gmegabuf_end(void) { }
+#endif
@@ -30,7 +30,9 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _AVS_EEL_IF_H_
 #define _AVS_EEL_IF_H_
 
+#include "../../platform_shim.h"
 #include "../ns-eel/ns-eel.h"
+#include <stdint.h>
 #ifdef AVS_MEGABUF_SUPPORT
 #include "../ns-eel/megabuf.h"
 #endif
@@ -38,10 +40,32 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 void AVS_EEL_IF_init();
 void AVS_EEL_IF_quit();
 
-int AVS_EEL_IF_Compile(int context, char* code);
+intptr_t AVS_EEL_IF_Compile(intptr_t context, char* code);
 void AVS_EEL_IF_Execute(void* handle, char visdata[2][2][576]);
+void AVS_EEL_IF_ExecuteBatch(void* handle, char visdata[2][2][576], NSEEL_LANEVAR* vars, int nvars, int n);
+// in between, code may run directly through NSEEL_code_execute*() on any
+// thread, as long as each handle only runs on one at a time
+void AVS_EEL_IF_BeginExecute(char visdata[2][2][576]);
+void AVS_EEL_IF_EndExecute();
 void AVS_EEL_IF_resetvars(NSEEL_VMCTX ctx);
 void AVS_EEL_IF_VM_free(NSEEL_VMCTX ctx);
+
+// a second VM running the same code, so points that don't depend on each
+// other (see NSEEL_code_independent) can be evaluated on several threads.
+// sync holds pairs of (variable of the original VM, same variable in vm).
+typedef struct {
+    intptr_t vm; // usable as an AVS_EEL_CONTEXTNAME
+    intptr_t code;
+    double** sync;
+    int nsync, sync_alloc;
+} AVS_EEL_CLONE;
+// c must be zeroed, or have c->vm allocated already with the variables
+// the caller wants to reach registered. on failure, c still needs
+// AVS_EEL_IF_FreeClone()
+int AVS_EEL_IF_MakeClone(AVS_EEL_CLONE* c, intptr_t context, char* code);
+void AVS_EEL_IF_FreeClone(AVS_EEL_CLONE* c);
+// copies every variable from the original VM to the clone, or back
+void AVS_EEL_IF_SyncClone(AVS_EEL_CLONE* c, int to_original);
 extern char last_error_string[1024];
 extern int g_log_errors;
 extern CRITICAL_SECTION g_eval_cs;
@@ -49,12 +73,13 @@ extern CRITICAL_SECTION g_eval_cs;
 // our old-style interface
 #define compileCode(exp) AVS_EEL_IF_Compile(AVS_EEL_CONTEXTNAME, (exp))
 #define executeCode(x, y) AVS_EEL_IF_Execute((void*)(x), (y))
+#define executeCodeBatch(x, y, v, nv, n) AVS_EEL_IF_ExecuteBatch((void*)(x), (y), (v), (nv), (n))
 #define freeCode(h) NSEEL_code_free((NSEEL_CODEHANDLE)(h))
 #define resetVars(x) FIXME++ ++ ++ ++ +
 #define registerVar(x) NSEEL_VM_regvar((NSEEL_VMCTX)AVS_EEL_CONTEXTNAME, (x))
 #define clearVars() AVS_EEL_IF_resetvars((NSEEL_VMCTX)AVS_EEL_CONTEXTNAME)
 
-#define AVS_EEL_INITINST() AVS_EEL_CONTEXTNAME = (int)NSEEL_VM_alloc()
+#define AVS_EEL_INITINST() AVS_EEL_CONTEXTNAME = (intptr_t)NSEEL_VM_alloc()
 
 #define AVS_EEL_QUITINST() AVS_EEL_IF_VM_free((NSEEL_VMCTX)AVS_EEL_CONTEXTNAME)
 
@@ -0,0 +1,761 @@
+// Whole-buffer blend kernels, dispatched at startup on the CPU's features.
+// Each level processes 4 (SSE2, NEON) or 8 (AVX2) pixels per step with
+// saturating byte ops and finishes the tail with the scalar inline.
+//
+// BLEND_MUL, BLEND_ADJ and the BLEND4 samplers go through g_blendtable,
+// which the vector code can only reproduce when it holds the rounded
+// (x * w + 127) / 255 ramp (portable_minimal.cpp). The table in render.cpp
+// truncates a float product instead, which is floor(x * w / 255) except
+// where the float lands just under a whole number (12 entries, e.g.
+// [147][85] is 48 rather than 49), so with that one those stay scalar.
+//
+// The samplers fetch their 2x2 blocks with AVX2 gathers, or with 64 bit
+// loads (a pixel and its right neighbour) and unpacks on SSE2. The four
+// weights of a BLEND4 never add up to more than 255, so the per-channel sums
+// fit a byte and packing them back with saturation is exact.
+
+#include "../../platform_shim.h"
+#include "r_defs.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BLEND_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BLEND_SIMD_NEON_AVAILABLE
+#include <arm_neon.h>
+#endif
+
+typedef void (*blendProc)(int* out, const int* a, const int* b, int n);
+typedef void (*blendAdjProc)(int* out, const int* a, const int* b, int n, int v);
+typedef void (*blend4TransProc)(int* out, const int* src, int w, const int* tab, int n);
+typedef void (*blend4LineProc)(int* out, const int* src, int w, int x, int y, int dx, int dy, int n);
+
+typedef struct {
+    blendProc add, sub, max_, min_, avg, xor_, mul;
+    blendAdjProc adj;
+    blend4TransProc blend4_trans;
+    blend4LineProc blend4_16_line;
+} blendKernels;
+
+// offset bits of a Trans / Movement table entry (OFFSET_MASK in r_trans.cpp)
+#define TRANS_OFFSET_MASK ((1 << 22) - 1)
+
+/* scalar reference */
+
+#define SCALAR_KERNEL(name, expr)                                   \
+    static void name(int* out, const int* a, const int* b, int n)   \
+    {                                                               \
+        int i;                                                      \
+        for (i = 0; i < n; i++) {                                   \
+            unsigned int x = (unsigned int)a[i], y = (unsigned int)b[i]; \
+            out[i] = (int)(expr);                                   \
+        }                                                           \
+    }
+
+SCALAR_KERNEL(scalar_add, BLEND(x, y))
+SCALAR_KERNEL(scalar_sub, BLEND_SUB(x, y))
+SCALAR_KERNEL(scalar_max, BLEND_MAX(x, y))
+SCALAR_KERNEL(scalar_min, BLEND_MIN(x, y))
+SCALAR_KERNEL(scalar_avg, BLEND_AVG(x, y))
+SCALAR_KERNEL(scalar_xor, x ^ y)
+SCALAR_KERNEL(scalar_mul, BLEND_MUL(x, y))
+
+static void scalar_adj(int* out, const int* a, const int* b, int n, int v)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        out[i] = (int)BLEND_ADJ_NOMMX((unsigned int)a[i], (unsigned int)b[i], v);
+}
+
+static void scalar_blend4_trans(int* out, const int* src, int w, const int* tab, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        int t = tab[i];
+        out[i] = (int)BLEND4((unsigned int*)src + (t & TRANS_OFFSET_MASK), w, (t >> 24) & (31 << 3), (t >> 19) & (31 << 3));
+    }
+}
+
+static void scalar_blend4_16_line(int* out, const int* src, int w, int x, int y, int dx, int dy, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        out[i] = (int)BLEND4_16((unsigned int*)src + (x >> 16) + (y >> 16) * w, w, x, y);
+        x += dx;
+        y += dy;
+    }
+}
+
+static const blendKernels scalar_kernels = {
+    scalar_add, scalar_sub, scalar_max, scalar_min, scalar_avg, scalar_xor, scalar_mul, scalar_adj,
+    scalar_blend4_trans, scalar_blend4_16_line
+};
+
+// 1 once g_blendtable is known to be the rounded ramp, 0 if it isn't, -1
+// before the first look (it is filled at startup, after static init, and
+// blend_simd_set_level() resets it)
+static volatile int g_table_rounded = -1;
+
+static int table_rounded()
+{
+    int r = g_table_rounded;
+    if (r < 0) {
+        int x, w;
+        r = 1;
+        for (x = 0; x < 256 && r; x++)
+            for (w = 0; w < 256; w++)
+                if (g_blendtable[x][w] != (unsigned char)((x * w + 127) / 255)) {
+                    r = 0;
+                    break;
+                }
+        g_table_rounded = r;
+    }
+    return r;
+}
+
+#ifdef BLEND_SIMD_X86
+
+/* SSE2, 4 pixels per step */
+
+/* BLEND and BLEND_SUB compute alpha in the top bits of a 32 bit word, so it
+   wraps instead of saturating: BLEND keeps (a + b) & 0xff, BLEND_SUB keeps
+   (a - b) & 0xff only while that has its top bit clear. the kernels match
+   that rather than the MMX paddusb / psubusb behaviour */
+#define SSE2_ADD(x, y) _mm_or_si128(_mm_and_si128(_mm_adds_epu8(x, y), rgb), _mm_andnot_si128(rgb, _mm_add_epi8(x, y)))
+#define SSE2_SUB(x, y) _mm_or_si128(_mm_and_si128(_mm_subs_epu8(x, y), rgb), _mm_andnot_si128(rgb, sse2_sub_alpha(_mm_sub_epi8(x, y))))
+
+static inline __m128i sse2_sub_alpha(__m128i d)
+{
+    return _mm_andnot_si128(_mm_srai_epi32(d, 31), d);
+}
+
+#define SSE2_KERNEL(name, fallback, op)                                              \
+    static void name(int* out, const int* a, const int* b, int n)                    \
+    {                                                                                \
+        const __m128i rgb = _mm_set1_epi32(0xffffff);                                \
+        const __m128i lo7 = _mm_set1_epi8(0x7f);                                     \
+        int i = 0;                                                                   \
+        (void)rgb;                                                                   \
+        (void)lo7;                                                                   \
+        for (; i + 4 <= n; i += 4) {                                                 \
+            __m128i x = _mm_loadu_si128((const __m128i*)(a + i));                    \
+            __m128i y = _mm_loadu_si128((const __m128i*)(b + i));                    \
+            _mm_storeu_si128((__m128i*)(out + i), op);                               \
+        }                                                                            \
+        fallback(out + i, a + i, b + i, n - i);                                      \
+    }
+
+SSE2_KERNEL(sse2_add, scalar_add, SSE2_ADD(x, y))
+SSE2_KERNEL(sse2_sub, scalar_sub, SSE2_SUB(x, y))
+SSE2_KERNEL(sse2_max, scalar_max, _mm_and_si128(_mm_max_epu8(x, y), rgb))
+SSE2_KERNEL(sse2_min, scalar_min, _mm_and_si128(_mm_min_epu8(x, y), rgb))
+SSE2_KERNEL(sse2_avg, scalar_avg, _mm_add_epi8(_mm_and_si128(_mm_srli_epi16(x, 1), lo7), _mm_and_si128(_mm_srli_epi16(y, 1), lo7)))
+SSE2_KERNEL(sse2_xor, scalar_xor, _mm_xor_si128(x, y))
+
+// (t + 127) / 255 for t = x * w in [0, 65025], on 16 bit lanes
+static inline __m128i sse2_div255(__m128i t)
+{
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void sse2_mul(int* out, const int* a, const int* b, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set1_epi32(0xffffff);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_mul(out, a, b, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero)));
+        __m128i hi = sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero)));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(_mm_packus_epi16(lo, hi), rgb));
+    }
+    scalar_mul(out + i, a + i, b + i, n - i);
+}
+
+static void sse2_adj(int* out, const int* a, const int* b, int n, int v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set1_epi32(0xffffff);
+    const __m128i va = _mm_set1_epi16((short)v);
+    const __m128i vb = _mm_set1_epi16((short)(255 - v));
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_adj(out, a, b, n, v);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_add_epi16(sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), va)),
+            sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(y, zero), vb)));
+        __m128i hi = _mm_add_epi16(sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), va)),
+            sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(y, zero), vb)));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(_mm_packus_epi16(lo, hi), rgb));
+    }
+    scalar_adj(out + i, a + i, b + i, n - i, v);
+}
+
+// adds one BLEND4 tap, pixels p weighted by a (0..255 in 32 bit lanes), to
+// the per-channel sums of pixels 0-1 (lo) and 2-3 (hi)
+static inline void sse2_blend4_tap(__m128i& lo, __m128i& hi, __m128i p, __m128i a)
+{
+    const __m128i zero = _mm_setzero_si128();
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    lo = _mm_add_epi16(lo, sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi32(a, a))));
+    hi = _mm_add_epi16(hi, sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi32(a, a))));
+}
+
+// BLEND4 of the 2x2 blocks at src + o[0..3], x / y fractions in 32 bit lanes
+static inline __m128i sse2_blend4(const int* src, int w, const int* o, __m128i xf, __m128i yf)
+{
+    const __m128i c255 = _mm_set1_epi32(255);
+    __m128i ix = _mm_sub_epi32(c255, xf);
+    __m128i iy = _mm_sub_epi32(c255, yf);
+    __m128i t0 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)(src + o[0])), _mm_loadl_epi64((const __m128i*)(src + o[1])));
+    __m128i t1 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)(src + o[2])), _mm_loadl_epi64((const __m128i*)(src + o[3])));
+    __m128i b0 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)(src + o[0] + w)), _mm_loadl_epi64((const __m128i*)(src + o[1] + w)));
+    __m128i b1 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)(src + o[2] + w)), _mm_loadl_epi64((const __m128i*)(src + o[3] + w)));
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    sse2_blend4_tap(lo, hi, _mm_unpacklo_epi64(t0, t1), sse2_div255(_mm_mullo_epi16(ix, iy)));
+    sse2_blend4_tap(lo, hi, _mm_unpackhi_epi64(t0, t1), sse2_div255(_mm_mullo_epi16(xf, iy)));
+    sse2_blend4_tap(lo, hi, _mm_unpacklo_epi64(b0, b1), sse2_div255(_mm_mullo_epi16(ix, yf)));
+    sse2_blend4_tap(lo, hi, _mm_unpackhi_epi64(b0, b1), sse2_div255(_mm_mullo_epi16(xf, yf)));
+    return _mm_and_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32(0xffffff));
+}
+
+static void sse2_blend4_trans(int* out, const int* src, int w, const int* tab, int n)
+{
+    const __m128i f8 = _mm_set1_epi32(31 << 3);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_trans(out, src, w, tab, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128i t = _mm_loadu_si128((const __m128i*)(tab + i));
+        int o[4] = { tab[i] & TRANS_OFFSET_MASK, tab[i + 1] & TRANS_OFFSET_MASK, tab[i + 2] & TRANS_OFFSET_MASK, tab[i + 3] & TRANS_OFFSET_MASK };
+        __m128i xf = _mm_and_si128(_mm_srli_epi32(t, 24), f8);
+        __m128i yf = _mm_and_si128(_mm_srli_epi32(t, 19), f8);
+        _mm_storeu_si128((__m128i*)(out + i), sse2_blend4(src, w, o, xf, yf));
+    }
+    scalar_blend4_trans(out + i, src, w, tab + i, n - i);
+}
+
+static void sse2_blend4_16_line(int* out, const int* src, int w, int x, int y, int dx, int dy, int n)
+{
+    const __m128i ff = _mm_set1_epi32(0xff);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_16_line(out, src, w, x, y, dx, dy, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        int o[4], xs[4], ys[4], k;
+        for (k = 0; k < 4; k++) {
+            xs[k] = x;
+            ys[k] = y;
+            o[k] = (x >> 16) + (y >> 16) * w;
+            x += dx;
+            y += dy;
+        }
+        __m128i xf = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i*)xs), 8), ff);
+        __m128i yf = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i*)ys), 8), ff);
+        _mm_storeu_si128((__m128i*)(out + i), sse2_blend4(src, w, o, xf, yf));
+    }
+    scalar_blend4_16_line(out + i, src, w, x, y, dx, dy, n - i);
+}
+
+static const blendKernels sse2_kernels = {
+    sse2_add, sse2_sub, sse2_max, sse2_min, sse2_avg, sse2_xor, sse2_mul, sse2_adj,
+    sse2_blend4_trans, sse2_blend4_16_line
+};
+
+/* AVX2, 8 pixels per step. the unpack/pack pairs both work within 128 bit
+   lanes, so pixels come back out in order */
+
+#define AVX2_ADD(x, y) _mm256_or_si256(_mm256_and_si256(_mm256_adds_epu8(x, y), rgb), _mm256_andnot_si256(rgb, _mm256_add_epi8(x, y)))
+#define AVX2_SUB(x, y) _mm256_or_si256(_mm256_and_si256(_mm256_subs_epu8(x, y), rgb), _mm256_andnot_si256(rgb, avx2_sub_alpha(_mm256_sub_epi8(x, y))))
+
+AVX2_TARGET static inline __m256i avx2_sub_alpha(__m256i d)
+{
+    return _mm256_andnot_si256(_mm256_srai_epi32(d, 31), d);
+}
+
+#define AVX2_KERNEL(name, fallback, op)                                              \
+    AVX2_TARGET static void name(int* out, const int* a, const int* b, int n)        \
+    {                                                                                \
+        const __m256i rgb = _mm256_set1_epi32(0xffffff);                             \
+        const __m256i lo7 = _mm256_set1_epi8(0x7f);                                  \
+        int i = 0;                                                                   \
+        (void)rgb;                                                                   \
+        (void)lo7;                                                                   \
+        for (; i + 8 <= n; i += 8) {                                                 \
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));                 \
+            __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));                 \
+            _mm256_storeu_si256((__m256i*)(out + i), op);                            \
+        }                                                                            \
+        fallback(out + i, a + i, b + i, n - i);                                      \
+    }
+
+AVX2_KERNEL(avx2_add, sse2_add, AVX2_ADD(x, y))
+AVX2_KERNEL(avx2_sub, sse2_sub, AVX2_SUB(x, y))
+AVX2_KERNEL(avx2_max, sse2_max, _mm256_and_si256(_mm256_max_epu8(x, y), rgb))
+AVX2_KERNEL(avx2_min, sse2_min, _mm256_and_si256(_mm256_min_epu8(x, y), rgb))
+AVX2_KERNEL(avx2_avg, sse2_avg, _mm256_add_epi8(_mm256_and_si256(_mm256_srli_epi16(x, 1), lo7), _mm256_and_si256(_mm256_srli_epi16(y, 1), lo7)))
+AVX2_KERNEL(avx2_xor, sse2_xor, _mm256_xor_si256(x, y))
+
+AVX2_TARGET static inline __m256i avx2_div255(__m256i t)
+{
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+AVX2_TARGET static void avx2_mul(int* out, const int* a, const int* b, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rgb = _mm256_set1_epi32(0xffffff);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_mul(out, a, b, n);
+        return;
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i lo = avx2_div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero)));
+        __m256i hi = avx2_div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(_mm256_packus_epi16(lo, hi), rgb));
+    }
+    sse2_mul(out + i, a + i, b + i, n - i);
+}
+
+AVX2_TARGET static void avx2_adj(int* out, const int* a, const int* b, int n, int v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rgb = _mm256_set1_epi32(0xffffff);
+    const __m256i va = _mm256_set1_epi16((short)v);
+    const __m256i vb = _mm256_set1_epi16((short)(255 - v));
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_adj(out, a, b, n, v);
+        return;
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i lo = _mm256_add_epi16(avx2_div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), va)),
+            avx2_div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(y, zero), vb)));
+        __m256i hi = _mm256_add_epi16(avx2_div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), va)),
+            avx2_div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(y, zero), vb)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(_mm256_packus_epi16(lo, hi), rgb));
+    }
+    sse2_adj(out + i, a + i, b + i, n - i, v);
+}
+
+// see sse2_blend4_tap. lo holds pixels 0-1 / 4-5, hi 2-3 / 6-7
+AVX2_TARGET static inline void avx2_blend4_tap(__m256i& lo, __m256i& hi, __m256i p, __m256i a)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+    lo = _mm256_add_epi16(lo, avx2_div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), _mm256_unpacklo_epi32(a, a))));
+    hi = _mm256_add_epi16(hi, avx2_div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), _mm256_unpackhi_epi32(a, a))));
+}
+
+// BLEND4 of the 2x2 blocks at src + o, gathered
+AVX2_TARGET static inline __m256i avx2_blend4(const int* src, int w, __m256i o, __m256i xf, __m256i yf)
+{
+    const __m256i c255 = _mm256_set1_epi32(255);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i ow = _mm256_add_epi32(o, _mm256_set1_epi32(w));
+    __m256i ix = _mm256_sub_epi32(c255, xf);
+    __m256i iy = _mm256_sub_epi32(c255, yf);
+    __m256i lo = _mm256_setzero_si256();
+    __m256i hi = _mm256_setzero_si256();
+    avx2_blend4_tap(lo, hi, _mm256_i32gather_epi32(src, o, 4), avx2_div255(_mm256_mullo_epi16(ix, iy)));
+    avx2_blend4_tap(lo, hi, _mm256_i32gather_epi32(src, _mm256_add_epi32(o, one), 4), avx2_div255(_mm256_mullo_epi16(xf, iy)));
+    avx2_blend4_tap(lo, hi, _mm256_i32gather_epi32(src, ow, 4), avx2_div255(_mm256_mullo_epi16(ix, yf)));
+    avx2_blend4_tap(lo, hi, _mm256_i32gather_epi32(src, _mm256_add_epi32(ow, one), 4), avx2_div255(_mm256_mullo_epi16(xf, yf)));
+    return _mm256_and_si256(_mm256_packus_epi16(lo, hi), _mm256_set1_epi32(0xffffff));
+}
+
+AVX2_TARGET static void avx2_blend4_trans(int* out, const int* src, int w, const int* tab, int n)
+{
+    const __m256i mask = _mm256_set1_epi32(TRANS_OFFSET_MASK);
+    const __m256i f8 = _mm256_set1_epi32(31 << 3);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_trans(out, src, w, tab, n);
+        return;
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i t = _mm256_loadu_si256((const __m256i*)(tab + i));
+        __m256i xf = _mm256_and_si256(_mm256_srli_epi32(t, 24), f8);
+        __m256i yf = _mm256_and_si256(_mm256_srli_epi32(t, 19), f8);
+        _mm256_storeu_si256((__m256i*)(out + i), avx2_blend4(src, w, _mm256_and_si256(t, mask), xf, yf));
+    }
+    sse2_blend4_trans(out + i, src, w, tab + i, n - i);
+}
+
+// positions advance by a constant step, so they are stepped in registers and
+// only the fetches are gathered
+AVX2_TARGET static void avx2_blend4_16_line(int* out, const int* src, int w, int x, int y, int dx, int dy, int n)
+{
+    const __m256i ff = _mm256_set1_epi32(0xff);
+    const __m256i vw = _mm256_set1_epi32(w);
+    const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i vx = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_mullo_epi32(_mm256_set1_epi32(dx), steps));
+    __m256i vy = _mm256_add_epi32(_mm256_set1_epi32(y), _mm256_mullo_epi32(_mm256_set1_epi32(dy), steps));
+    const __m256i vdx = _mm256_set1_epi32(dx * 8);
+    const __m256i vdy = _mm256_set1_epi32(dy * 8);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_16_line(out, src, w, x, y, dx, dy, n);
+        return;
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i o = _mm256_add_epi32(_mm256_srai_epi32(vx, 16), _mm256_mullo_epi32(_mm256_srai_epi32(vy, 16), vw));
+        __m256i xf = _mm256_and_si256(_mm256_srli_epi32(vx, 8), ff);
+        __m256i yf = _mm256_and_si256(_mm256_srli_epi32(vy, 8), ff);
+        _mm256_storeu_si256((__m256i*)(out + i), avx2_blend4(src, w, o, xf, yf));
+        vx = _mm256_add_epi32(vx, vdx);
+        vy = _mm256_add_epi32(vy, vdy);
+    }
+    sse2_blend4_16_line(out + i, src, w, x + i * dx, y + i * dy, dx, dy, n - i);
+}
+
+static const blendKernels avx2_kernels = {
+    avx2_add, avx2_sub, avx2_max, avx2_min, avx2_avg, avx2_xor, avx2_mul, avx2_adj,
+    avx2_blend4_trans, avx2_blend4_16_line
+};
+
+static int cpu_best()
+{
+    int sse2 = 0, avx2 = 0;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 0);
+    int nids = r[0];
+    __cpuid(r, 1);
+    sse2 = (r[3] >> 26) & 1;
+    // AVX2 also needs the OS to save the ymm registers (OSXSAVE + XCR0)
+    if (nids >= 7 && ((r[2] >> 27) & 1) && ((r[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(r, 7, 0);
+        avx2 = (r[1] >> 5) & 1;
+    }
+#else
+    __builtin_cpu_init();
+    sse2 = __builtin_cpu_supports("sse2");
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return BLEND_SIMD_AVX2;
+    if (sse2)
+        return BLEND_SIMD_SSE2;
+    return BLEND_SIMD_SCALAR;
+}
+
+#elif defined(BLEND_SIMD_NEON_AVAILABLE)
+
+/* NEON, 4 pixels per step */
+
+/* alpha wraps like the scalar inlines, see SSE2_ADD */
+#define NEON_ADD(x, y) vbslq_u8(rgb, vqaddq_u8(x, y), vaddq_u8(x, y))
+#define NEON_SUB(x, y) vbslq_u8(rgb, vqsubq_u8(x, y), neon_sub_alpha(vsubq_u8(x, y)))
+
+static inline uint8x16_t neon_sub_alpha(uint8x16_t d)
+{
+    int32x4_t s = vreinterpretq_s32_u8(d);
+    return vreinterpretq_u8_s32(vbicq_s32(s, vshrq_n_s32(s, 31)));
+}
+
+#define NEON_KERNEL(name, fallback, op)                                              \
+    static void name(int* out, const int* a, const int* b, int n)                    \
+    {                                                                                \
+        const uint8x16_t rgb = vreinterpretq_u8_u32(vdupq_n_u32(0xffffff));          \
+        int i = 0;                                                                   \
+        (void)rgb;                                                                   \
+        for (; i + 4 <= n; i += 4) {                                                 \
+            uint8x16_t x = vld1q_u8((const uint8_t*)(a + i));                        \
+            uint8x16_t y = vld1q_u8((const uint8_t*)(b + i));                        \
+            vst1q_u8((uint8_t*)(out + i), op);                                       \
+        }                                                                            \
+        fallback(out + i, a + i, b + i, n - i);                                      \
+    }
+
+NEON_KERNEL(neon_add, scalar_add, NEON_ADD(x, y))
+NEON_KERNEL(neon_sub, scalar_sub, NEON_SUB(x, y))
+NEON_KERNEL(neon_max, scalar_max, vandq_u8(vmaxq_u8(x, y), rgb))
+NEON_KERNEL(neon_min, scalar_min, vandq_u8(vminq_u8(x, y), rgb))
+NEON_KERNEL(neon_avg, scalar_avg, vaddq_u8(vshrq_n_u8(x, 1), vshrq_n_u8(y, 1)))
+NEON_KERNEL(neon_xor, scalar_xor, veorq_u8(x, y))
+
+// (t + 127) / 255 for t = x * w in [0, 65025], narrowed to bytes
+static inline uint8x8_t neon_div255(uint16x8_t t)
+{
+    t = vaddq_u16(t, vdupq_n_u16(128));
+    return vshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+static void neon_mul(int* out, const int* a, const int* b, int n)
+{
+    const uint8x16_t rgb = vreinterpretq_u8_u32(vdupq_n_u32(0xffffff));
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_mul(out, a, b, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t x = vld1q_u8((const uint8_t*)(a + i));
+        uint8x16_t y = vld1q_u8((const uint8_t*)(b + i));
+        uint8x8_t lo = neon_div255(vmull_u8(vget_low_u8(x), vget_low_u8(y)));
+        uint8x8_t hi = neon_div255(vmull_u8(vget_high_u8(x), vget_high_u8(y)));
+        vst1q_u8((uint8_t*)(out + i), vandq_u8(vcombine_u8(lo, hi), rgb));
+    }
+    scalar_mul(out + i, a + i, b + i, n - i);
+}
+
+static void neon_adj(int* out, const int* a, const int* b, int n, int v)
+{
+    const uint8x16_t rgb = vreinterpretq_u8_u32(vdupq_n_u32(0xffffff));
+    const uint8x8_t va = vdup_n_u8((uint8_t)v);
+    const uint8x8_t vb = vdup_n_u8((uint8_t)(255 - v));
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_adj(out, a, b, n, v);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t x = vld1q_u8((const uint8_t*)(a + i));
+        uint8x16_t y = vld1q_u8((const uint8_t*)(b + i));
+        uint8x8_t lo = vadd_u8(neon_div255(vmull_u8(vget_low_u8(x), va)), neon_div255(vmull_u8(vget_low_u8(y), vb)));
+        uint8x8_t hi = vadd_u8(neon_div255(vmull_u8(vget_high_u8(x), va)), neon_div255(vmull_u8(vget_high_u8(y), vb)));
+        vst1q_u8((uint8_t*)(out + i), vandq_u8(vcombine_u8(lo, hi), rgb));
+    }
+    scalar_adj(out + i, a + i, b + i, n - i, v);
+}
+
+// (t + 127) / 255 as in neon_div255, copied into every byte of its lane
+static inline uint8x16_t neon_blend4_weight(uint32x4_t t)
+{
+    t = vaddq_u32(t, vdupq_n_u32(128));
+    t = vshrq_n_u32(vsraq_n_u32(t, t, 8), 8);
+    return vreinterpretq_u8_u32(vmulq_n_u32(t, 0x01010101));
+}
+
+// BLEND4 of the 2x2 blocks at src + o[0..3]
+static inline uint8x16_t neon_blend4(const int* src, int w, const int* o, uint32x4_t xf, uint32x4_t yf)
+{
+    const uint32x4_t c255 = vdupq_n_u32(255);
+    uint32x4_t ix = vsubq_u32(c255, xf);
+    uint32x4_t iy = vsubq_u32(c255, yf);
+    uint8x16_t a[4] = {
+        neon_blend4_weight(vmulq_u32(ix, iy)),
+        neon_blend4_weight(vmulq_u32(xf, iy)),
+        neon_blend4_weight(vmulq_u32(ix, yf)),
+        neon_blend4_weight(vmulq_u32(xf, yf)),
+    };
+    int p[4][4], k;
+    for (k = 0; k < 4; k++) {
+        p[0][k] = src[o[k]];
+        p[1][k] = src[o[k] + 1];
+        p[2][k] = src[o[k] + w];
+        p[3][k] = src[o[k] + w + 1];
+    }
+    uint8x8_t lo = vdup_n_u8(0);
+    uint8x8_t hi = vdup_n_u8(0);
+    for (k = 0; k < 4; k++) {
+        uint8x16_t x = vld1q_u8((const uint8_t*)p[k]);
+        lo = vadd_u8(lo, neon_div255(vmull_u8(vget_low_u8(x), vget_low_u8(a[k]))));
+        hi = vadd_u8(hi, neon_div255(vmull_u8(vget_high_u8(x), vget_high_u8(a[k]))));
+    }
+    return vandq_u8(vcombine_u8(lo, hi), vreinterpretq_u8_u32(vdupq_n_u32(0xffffff)));
+}
+
+static void neon_blend4_trans(int* out, const int* src, int w, const int* tab, int n)
+{
+    const uint32x4_t f8 = vdupq_n_u32(31 << 3);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_trans(out, src, w, tab, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t t = vld1q_u32((const uint32_t*)(tab + i));
+        int o[4] = { tab[i] & TRANS_OFFSET_MASK, tab[i + 1] & TRANS_OFFSET_MASK, tab[i + 2] & TRANS_OFFSET_MASK, tab[i + 3] & TRANS_OFFSET_MASK };
+        uint32x4_t xf = vandq_u32(vshrq_n_u32(t, 24), f8);
+        uint32x4_t yf = vandq_u32(vshrq_n_u32(t, 19), f8);
+        vst1q_u8((uint8_t*)(out + i), neon_blend4(src, w, o, xf, yf));
+    }
+    scalar_blend4_trans(out + i, src, w, tab + i, n - i);
+}
+
+static void neon_blend4_16_line(int* out, const int* src, int w, int x, int y, int dx, int dy, int n)
+{
+    const uint32x4_t ff = vdupq_n_u32(0xff);
+    int i = 0;
+    if (!table_rounded()) {
+        scalar_blend4_16_line(out, src, w, x, y, dx, dy, n);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        int o[4], xs[4], ys[4], k;
+        for (k = 0; k < 4; k++) {
+            xs[k] = x;
+            ys[k] = y;
+            o[k] = (x >> 16) + (y >> 16) * w;
+            x += dx;
+            y += dy;
+        }
+        uint32x4_t xf = vandq_u32(vshrq_n_u32(vld1q_u32((const uint32_t*)xs), 8), ff);
+        uint32x4_t yf = vandq_u32(vshrq_n_u32(vld1q_u32((const uint32_t*)ys), 8), ff);
+        vst1q_u8((uint8_t*)(out + i), neon_blend4(src, w, o, xf, yf));
+    }
+    scalar_blend4_16_line(out + i, src, w, x, y, dx, dy, n - i);
+}
+
+static const blendKernels neon_kernels = {
+    neon_add, neon_sub, neon_max, neon_min, neon_avg, neon_xor, neon_mul, neon_adj,
+    neon_blend4_trans, neon_blend4_16_line
+};
+
+static int cpu_best()
+{
+    return BLEND_SIMD_NEON;
+}
+
+#else
+
+static int cpu_best()
+{
+    return BLEND_SIMD_SCALAR;
+}
+
+#endif
+
+// starts out scalar (constant initialized, so usable during static init)
+// and is upgraded to the best level below
+static const blendKernels* g_kernels = &scalar_kernels;
+static int g_level = BLEND_SIMD_SCALAR;
+static int g_best = -1;
+
+int blend_simd_get_best()
+{
+    if (g_best < 0)
+        g_best = cpu_best();
+    return g_best;
+}
+
+int blend_simd_set_level(int level)
+{
+    int best = blend_simd_get_best();
+    if (level > best)
+        level = best;
+    g_table_rounded = -1; // look at g_blendtable again on the next mul / adj
+    switch (level) {
+#ifdef BLEND_SIMD_X86
+    case BLEND_SIMD_AVX2:
+        g_kernels = &avx2_kernels;
+        break;
+    case BLEND_SIMD_SSE2:
+        g_kernels = &sse2_kernels;
+        break;
+#elif defined(BLEND_SIMD_NEON_AVAILABLE)
+    case BLEND_SIMD_NEON:
+        g_kernels = &neon_kernels;
+        break;
+#endif
+    default:
+        level = BLEND_SIMD_SCALAR;
+        g_kernels = &scalar_kernels;
+        break;
+    }
+    g_level = level;
+    return level;
+}
+
+int blend_simd_get_level()
+{
+    return g_level;
+}
+
+const char* blend_simd_get_name(int level)
+{
+    switch (level) {
+    case BLEND_SIMD_SSE2:
+        return "sse2";
+    case BLEND_SIMD_AVX2:
+        return "avx2";
+    case BLEND_SIMD_NEON:
+        return "neon";
+    default:
+        return "scalar";
+    }
+}
+
+static struct BlendSimdInitializer {
+    BlendSimdInitializer() { blend_simd_set_level(blend_simd_get_best()); }
+} s_blendSimdInit;
+
+void blend_add_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->add(out, a, b, n);
+}
+
+void blend_sub_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->sub(out, a, b, n);
+}
+
+void blend_max_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->max_(out, a, b, n);
+}
+
+void blend_min_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->min_(out, a, b, n);
+}
+
+void blend_avg_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->avg(out, a, b, n);
+}
+
+void blend_xor_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->xor_(out, a, b, n);
+}
+
+void blend_mul_block(int* out, const int* a, const int* b, int n)
+{
+    g_kernels->mul(out, a, b, n);
+}
+
+void blend_adj_block(int* out, const int* a, const int* b, int n, int v)
+{
+    g_kernels->adj(out, a, b, n, v);
+}
+
+void blend4_trans_block(int* out, const int* src, int w, const int* tab, int n)
+{
+    g_kernels->blend4_trans(out, src, w, tab, n);
+}
+
+void blend4_16_line_block(int* out, const int* src, int w, int x, int y, int dx, int dy, int n)
+{
+    g_kernels->blend4_16_line(out, src, w, x, y, dx, dy, n);
+}
@@ -0,0 +1,59 @@
+// Whole-buffer blend kernels and bilinear samplers (SSE2 / AVX2 / NEON),
+// picked once at startup from the features of the CPU. Every kernel produces
+// exactly what the matching per-pixel BLEND_* inline in r_defs.h does.
+// out may alias either input of the blend kernels, but not a sampler's src.
+//
+// blend_mul_block, blend_adj_block and the BLEND4 samplers are only
+// vectorized while g_blendtable holds the rounded ramp of the portable build
+// (portable_minimal.cpp). The Winamp plugin fills it with a truncated float
+// product (render.cpp), which no integer formula matches, so in vis_avs.dll
+// those run the scalar code and only add / sub / max / min / avg / xor are
+// vectorized.
+
+#ifndef _BLEND_SIMD_H_
+#define _BLEND_SIMD_H_
+
+enum {
+    BLEND_SIMD_SCALAR = 0,
+    BLEND_SIMD_SSE2,
+    BLEND_SIMD_AVX2,
+    BLEND_SIMD_NEON,
+};
+
+void blend_add_block(int* out, const int* a, const int* b, int n); // BLEND(a, b)
+void blend_sub_block(int* out, const int* a, const int* b, int n); // BLEND_SUB(a, b)
+void blend_max_block(int* out, const int* a, const int* b, int n); // BLEND_MAX(a, b)
+void blend_min_block(int* out, const int* a, const int* b, int n); // BLEND_MIN(a, b)
+void blend_avg_block(int* out, const int* a, const int* b, int n); // BLEND_AVG(a, b)
+void blend_xor_block(int* out, const int* a, const int* b, int n); // a ^ b
+void blend_mul_block(int* out, const int* a, const int* b, int n); // BLEND_MUL(a, b)
+void blend_adj_block(int* out, const int* a, const int* b, int n, int v); // BLEND_ADJ_NOMMX(a, b, v)
+
+// BLEND4 at n entries of a Trans / Movement subpixel table: pixel offset into
+// src in the low 22 bits, 5 bit x / y fractions at bits 27 / 22
+void blend4_trans_block(int* out, const int* src, int w, const int* tab, int n);
+// BLEND4_16 along a line: sample i is at the 16.16 position
+// (x + i * dx, y + i * dy) of src. the caller keeps every sample, and the
+// pixels right of and below it, inside src
+void blend4_16_line_block(int* out, const int* src, int w, int x, int y, int dx, int dy, int n);
+
+// how many of pos, pos + step, pos + 2 * step, ... lie in [0, limit), given
+// that pos does. splits wrapping / clamping walks into line runs
+static inline int blend4_line_run(int pos, int step, int limit)
+{
+    if (step > 0)
+        return (limit - 1 - pos) / step + 1;
+    if (step < 0)
+        return pos / -step + 1;
+    return 0x7fffffff;
+}
+
+// the level in use, and the best one this CPU has
+int blend_simd_get_level();
+int blend_simd_get_best();
+// switches kernels (clamped to what the CPU has), for comparing modes.
+// returns the level actually selected
+int blend_simd_set_level(int level);
+const char* blend_simd_get_name(int level);
+
+#endif // _BLEND_SIMD_H_
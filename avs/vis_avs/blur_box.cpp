@@ -0,0 +1,265 @@
+#include "blur_box.h"
+#include "smp_pool.h"
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLUR_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BLUR_NEON 1
+#endif
+
+// rows go to threads in bands, columns in strips this many pixels wide,
+// walked top to bottom with the running sums for the whole strip
+#define BLUR_STRIP 64
+
+// a window sum holds one pixel's four channels as 32 bit lanes. averages
+// are sum * inv truncated, inv being 1 / (2 * radius + 1) nudged up just
+// enough that exact multiples don't land a hair under their quotient
+
+#if BLUR_SSE2
+typedef __m128i bx_px;
+typedef __m128 bx_inv;
+static inline bx_inv bx_make_inv(float f) { return _mm_set1_ps(f); }
+static inline bx_px bx_set(int v) { return _mm_set1_epi32(v); }
+static inline bx_px bx_add(bx_px a, bx_px b) { return _mm_add_epi32(a, b); }
+static inline bx_px bx_sub(bx_px a, bx_px b) { return _mm_sub_epi32(a, b); }
+static inline bx_px bx_load1(unsigned int p)
+{
+    const __m128i z = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p), z), z);
+}
+static inline void bx_load4(const unsigned int* p, bx_px* o)
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+    o[0] = _mm_unpacklo_epi16(lo, z);
+    o[1] = _mm_unpackhi_epi16(lo, z);
+    o[2] = _mm_unpacklo_epi16(hi, z);
+    o[3] = _mm_unpackhi_epi16(hi, z);
+}
+static inline __m128i bx_avg(bx_px s, bx_inv inv) { return _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s), inv)); }
+static inline unsigned int bx_store1(bx_px s, bx_inv inv)
+{
+    __m128i a = bx_avg(s, inv);
+    a = _mm_packs_epi32(a, a);
+    return (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(a, a));
+}
+static inline void bx_store4(unsigned int* p, const bx_px* s, bx_inv inv)
+{
+    __m128i lo = _mm_packs_epi32(bx_avg(s[0], inv), bx_avg(s[1], inv));
+    __m128i hi = _mm_packs_epi32(bx_avg(s[2], inv), bx_avg(s[3], inv));
+    _mm_storeu_si128((__m128i*)p, _mm_packus_epi16(lo, hi));
+}
+#elif BLUR_NEON
+typedef int32x4_t bx_px;
+typedef float32x4_t bx_inv;
+static inline bx_inv bx_make_inv(float f) { return vdupq_n_f32(f); }
+static inline bx_px bx_set(int v) { return vdupq_n_s32(v); }
+static inline bx_px bx_add(bx_px a, bx_px b) { return vaddq_s32(a, b); }
+static inline bx_px bx_sub(bx_px a, bx_px b) { return vsubq_s32(a, b); }
+static inline bx_px bx_widen(uint16x4_t v) { return vreinterpretq_s32_u32(vmovl_u16(v)); }
+static inline bx_px bx_load1(unsigned int p) { return bx_widen(vget_low_u16(vmovl_u8(vcreate_u8(p)))); }
+static inline void bx_load4(const unsigned int* p, bx_px* o)
+{
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v)), hi = vmovl_u8(vget_high_u8(v));
+    o[0] = bx_widen(vget_low_u16(lo));
+    o[1] = bx_widen(vget_high_u16(lo));
+    o[2] = bx_widen(vget_low_u16(hi));
+    o[3] = bx_widen(vget_high_u16(hi));
+}
+static inline uint16x4_t bx_avg(bx_px s, bx_inv inv) { return vqmovun_s32(vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(s), inv))); }
+static inline unsigned int bx_store1(bx_px s, bx_inv inv)
+{
+    uint16x4_t a = bx_avg(s, inv);
+    return vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(a, a))), 0);
+}
+static inline void bx_store4(unsigned int* p, const bx_px* s, bx_inv inv)
+{
+    uint16x8_t lo = vcombine_u16(bx_avg(s[0], inv), bx_avg(s[1], inv));
+    uint16x8_t hi = vcombine_u16(bx_avg(s[2], inv), bx_avg(s[3], inv));
+    vst1q_u8((uint8_t*)p, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+}
+#else
+typedef struct {
+    int c[4];
+} bx_px;
+typedef float bx_inv;
+static inline bx_inv bx_make_inv(float f) { return f; }
+static inline bx_px bx_set(int v)
+{
+    bx_px r = { { v, v, v, v } };
+    return r;
+}
+static inline bx_px bx_add(bx_px a, bx_px b)
+{
+    bx_px r = { { a.c[0] + b.c[0], a.c[1] + b.c[1], a.c[2] + b.c[2], a.c[3] + b.c[3] } };
+    return r;
+}
+static inline bx_px bx_sub(bx_px a, bx_px b)
+{
+    bx_px r = { { a.c[0] - b.c[0], a.c[1] - b.c[1], a.c[2] - b.c[2], a.c[3] - b.c[3] } };
+    return r;
+}
+static inline bx_px bx_load1(unsigned int p)
+{
+    bx_px r = { { (int)(p & 0xff), (int)((p >> 8) & 0xff), (int)((p >> 16) & 0xff), (int)(p >> 24) } };
+    return r;
+}
+static inline void bx_load4(const unsigned int* p, bx_px* o)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        o[i] = bx_load1(p[i]);
+}
+static inline unsigned int bx_store1(bx_px s, bx_inv inv)
+{
+    return (unsigned int)(s.c[0] * inv) | ((unsigned int)(s.c[1] * inv) << 8) | ((unsigned int)(s.c[2] * inv) << 16) | ((unsigned int)(s.c[3] * inv) << 24);
+}
+static inline void bx_store4(unsigned int* p, const bx_px* s, bx_inv inv)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        p[i] = bx_store1(s[i], inv);
+}
+#endif
+
+typedef struct {
+    unsigned int* dst;
+    const unsigned int* src;
+    int w, h;
+    int r;
+    bx_px bias;
+    bx_inv inv;
+} blurPass;
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : v > hi ? hi : v; }
+
+// pad is the row with r + 1 copies of each end pixel on either side, so
+// pad[x + 1 .. x + 2r + 1] is the window around x
+static void box_row(unsigned int* out, const unsigned int* pad, int w, int r, bx_px bias, bx_inv inv)
+{
+    bx_px s = bias;
+    int x;
+    for (x = 1; x <= 2 * r + 1; x++)
+        s = bx_add(s, bx_load1(pad[x]));
+    const unsigned int* enter = pad + 2 * r + 2;
+    const unsigned int* leave = pad + 1;
+    for (x = 0; x + 4 <= w; x += 4) {
+        bx_px a[4], b[4], o[4];
+        bx_load4(enter + x, a);
+        bx_load4(leave + x, b);
+        o[0] = s;
+        s = bx_add(s, bx_sub(a[0], b[0]));
+        o[1] = s;
+        s = bx_add(s, bx_sub(a[1], b[1]));
+        o[2] = s;
+        s = bx_add(s, bx_sub(a[2], b[2]));
+        o[3] = s;
+        s = bx_add(s, bx_sub(a[3], b[3]));
+        bx_store4(out + x, o, inv);
+    }
+    for (; x < w; x++) {
+        out[x] = bx_store1(s, inv);
+        s = bx_add(s, bx_sub(bx_load1(enter[x]), bx_load1(leave[x])));
+    }
+}
+
+static void rows_proc(void* ctx, int task, int ntasks)
+{
+    blurPass* p = (blurPass*)ctx;
+    const int w = p->w, r = p->r;
+    int y = (int)((long long)p->h * task / ntasks), y1 = (int)((long long)p->h * (task + 1) / ntasks);
+    std::vector<unsigned int> pad(w + 2 * r + 2);
+    for (; y < y1; y++) {
+        const unsigned int* in = p->src + y * w;
+        unsigned int l = in[0], rt = in[w - 1];
+        int i;
+        for (i = 0; i <= r; i++) {
+            pad[i] = l;
+            pad[w + r + 1 + i] = rt;
+        }
+        memcpy(&pad[r + 1], in, w * sizeof(int));
+        box_row(p->dst + y * w, pad.data(), w, r, p->bias, p->inv);
+    }
+}
+
+// one strip of columns, every row: the sums for the strip stay in cache
+// while a row leaves and a row enters each window
+static void cols_proc(void* ctx, int task, int ntasks)
+{
+    blurPass* p = (blurPass*)ctx;
+    const int w = p->w, h = p->h, r = p->r;
+    const int x0 = task * BLUR_STRIP, n = w - x0 < BLUR_STRIP ? w - x0 : BLUR_STRIP;
+    const unsigned int* src = p->src + x0;
+    unsigned int* dst = p->dst + x0;
+    bx_px acc[BLUR_STRIP];
+    int x, y;
+    for (x = 0; x < n; x++)
+        acc[x] = p->bias;
+    for (y = -r; y <= r; y++) {
+        const unsigned int* in = src + clampi(y, 0, h - 1) * w;
+        for (x = 0; x < n; x++)
+            acc[x] = bx_add(acc[x], bx_load1(in[x]));
+    }
+    for (y = 0; y < h; y++) {
+        const unsigned int* enter = src + clampi(y + r + 1, 0, h - 1) * w;
+        const unsigned int* leave = src + clampi(y - r, 0, h - 1) * w;
+        unsigned int* out = dst + y * w;
+        for (x = 0; x + 4 <= n; x += 4) {
+            bx_px s[4] = { acc[x], acc[x + 1], acc[x + 2], acc[x + 3] };
+            bx_px a[4], b[4];
+            bx_load4(enter + x, a);
+            bx_load4(leave + x, b);
+            bx_store4(out + x, s, p->inv);
+            acc[x] = bx_add(s[0], bx_sub(a[0], b[0]));
+            acc[x + 1] = bx_add(s[1], bx_sub(a[1], b[1]));
+            acc[x + 2] = bx_add(s[2], bx_sub(a[2], b[2]));
+            acc[x + 3] = bx_add(s[3], bx_sub(a[3], b[3]));
+        }
+        for (; x < n; x++) {
+            out[x] = bx_store1(acc[x], p->inv);
+            acc[x] = bx_add(acc[x], bx_sub(bx_load1(enter[x]), bx_load1(leave[x])));
+        }
+    }
+}
+
+static void run_pass(C_SmpPool::TaskProc proc, blurPass* p, int ntasks, int nthreads)
+{
+    if (nthreads > 1 && ntasks > 1)
+        C_SmpPool::get()->run(nthreads, ntasks, proc, p);
+    else {
+        int i;
+        for (i = 0; i < ntasks; i++)
+            proc(p, i, ntasks);
+    }
+}
+
+void blur_box(int* dst, const int* src, int* tmp, int w, int h, int radius, int passes, int round, int nthreads)
+{
+    if (w < 1 || h < 1)
+        return;
+    blurPass p;
+    p.w = w;
+    p.h = h;
+    p.r = clampi(radius, 1, BLUR_MAX_RADIUS);
+    // floor((sum + r) / n) is the nearest average for an odd n
+    p.bias = bx_set(round ? p.r : 0);
+    p.inv = bx_make_inv((1.0f + 1.0f / (1 << 20)) / (2 * p.r + 1));
+    const int row_tasks = nthreads > 1 ? (h < nthreads * 4 ? h : nthreads * 4) : 1;
+    const int col_tasks = (w + BLUR_STRIP - 1) / BLUR_STRIP;
+    int i;
+    passes = clampi(passes, 1, BLUR_MAX_PASSES);
+    for (i = 0; i < passes; i++) {
+        p.src = (const unsigned int*)(i ? dst : src);
+        p.dst = (unsigned int*)tmp;
+        run_pass(rows_proc, &p, row_tasks, nthreads);
+        p.src = (const unsigned int*)tmp;
+        p.dst = (unsigned int*)dst;
+        run_pass(cols_proc, &p, col_tasks, nthreads);
+    }
+}
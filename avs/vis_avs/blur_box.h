@@ -0,0 +1,18 @@
+// Separable running-sum blur: each pass is a horizontal then a vertical
+// box of 2 * radius + 1 pixels, at a cost per pixel that does not depend on
+// the radius. One pass is a box, two a tent, three are close to a gaussian
+// with sigma ~ radius * 0.58. Edges repeat their outermost pixel, and all
+// four channels are filtered.
+
+#ifndef _BLUR_BOX_H_
+#define _BLUR_BOX_H_
+
+#define BLUR_MAX_RADIUS 255 // keeps a window's channel sum exact in a float
+#define BLUR_MAX_PASSES 3
+
+// blurs src (w x h) into dst through tmp (w x h as well); dst may be src.
+// round = 0 truncates each average, 1 rounds it to nearest. nthreads > 1
+// spreads each half pass over the SMP pool
+void blur_box(int* dst, const int* src, int* tmp, int w, int h, int radius, int passes, int round, int nthreads);
+
+#endif // _BLUR_BOX_H_
@@ -0,0 +1,41 @@
+#include "color_lut.h"
+
+void clut_identity(unsigned char lut[4][256])
+{
+    int v;
+    for (v = 0; v < 256; v++)
+        lut[0][v] = lut[1][v] = lut[2][v] = lut[3][v] = (unsigned char)v;
+}
+
+void clut_then(unsigned char lut[4][256], const unsigned char next[4][256])
+{
+    int c, v;
+    for (c = 0; c < 4; c++)
+        for (v = 0; v < 256; v++)
+            lut[c][v] = next[c][lut[c][v]];
+}
+
+void clut_apply(int* fb, int n, const unsigned char lut[4][256])
+{
+    // a byte lookup per channel is as good as it gets without a gather; most
+    // effects keep alpha, which saves one of the four
+    unsigned int* p = (unsigned int*)fb;
+    const unsigned char *b = lut[0], *g = lut[1], *r = lut[2], *a = lut[3];
+    int v;
+    for (v = 0; v < 256 && a[v] == v; v++)
+        ;
+    if (v == 256) {
+        for (; n >= 2; n -= 2, p += 2) {
+            unsigned int p0 = p[0], p1 = p[1];
+            p[0] = b[p0 & 0xff] | (g[(p0 >> 8) & 0xff] << 8) | (r[(p0 >> 16) & 0xff] << 16) | (p0 & 0xff000000);
+            p[1] = b[p1 & 0xff] | (g[(p1 >> 8) & 0xff] << 8) | (r[(p1 >> 16) & 0xff] << 16) | (p1 & 0xff000000);
+        }
+        if (n)
+            p[0] = b[p[0] & 0xff] | (g[(p[0] >> 8) & 0xff] << 8) | (r[(p[0] >> 16) & 0xff] << 16) | (p[0] & 0xff000000);
+    } else {
+        while (n--) {
+            unsigned int p0 = *p;
+            *p++ = b[p0 & 0xff] | (g[(p0 >> 8) & 0xff] << 8) | (r[(p0 >> 16) & 0xff] << 16) | ((unsigned int)a[p0 >> 24] << 24);
+        }
+    }
+}
@@ -0,0 +1,16 @@
+// Per-byte colour tables: lut[c][v] is what byte c of a pixel (0 blue, 1
+// green, 2 red, 3 alpha) becomes when it was v. Effects that only map each
+// channel on its own (RTRAIT_LUT) hand theirs to the render list, which
+// folds a run of them into one table and one pass over the frame.
+
+#ifndef _COLOR_LUT_H_
+#define _COLOR_LUT_H_
+
+// lut = every byte unchanged
+void clut_identity(unsigned char lut[4][256]);
+// lut = lut, then next
+void clut_then(unsigned char lut[4][256], const unsigned char next[4][256]);
+// the n pixels at fb through lut
+void clut_apply(int* fb, int n, const unsigned char lut[4][256]);
+
+#endif // _COLOR_LUT_H_
@@ -0,0 +1,173 @@
+#include "fb_arena.h"
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// sits in the FBA_ALIGN bytes in front of every block
+struct fba_header {
+    size_t size; // usable bytes, a class size
+    size_t mapped; // length of the FBA_MAP_MIN aligned mapping it starts, 0 if it came from the heap
+};
+
+static std::mutex g_lock;
+static std::vector<void*> g_free; // least recently freed first
+static size_t g_free_bytes;
+static size_t g_budget = FBA_DEFAULT_BUDGET;
+
+static fba_header* header_of(void* p)
+{
+    return (fba_header*)((char*)p - FBA_ALIGN);
+}
+
+// 4 KB, then four classes per doubling, so a block wastes at most a quarter
+// and sizes a few rows apart share one
+static size_t class_size(size_t bytes)
+{
+    size_t top = 4096;
+    if (bytes <= top)
+        return top;
+    while (top * 2 < bytes)
+        top <<= 1;
+    size_t step = top / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+static void release(void* p)
+{
+    fba_header* hd = header_of(p);
+    if (hd->mapped) {
+#ifdef _WIN32
+        VirtualFree(hd, 0, MEM_RELEASE);
+#else
+        munmap(hd, hd->mapped);
+#endif
+    } else {
+#ifdef _WIN32
+        _aligned_free(hd);
+#else
+        free(hd);
+#endif
+    }
+}
+
+// length bytes starting on a FBA_MAP_MIN boundary, fresh from the system and
+// zeroed. the system only promises page alignment, so this maps FBA_MAP_MIN
+// more and gives back what lies outside the aligned range; release() then
+// unmaps exactly [start, start + length)
+static void* map_aligned(size_t length)
+{
+#ifdef _WIN32
+    // VirtualFree can't release part of a region: find an aligned address in
+    // a larger reservation, drop it and commit there. another thread can
+    // take the range in between, so try a few times
+    int tries;
+    for (tries = 0; tries < 8; tries++) {
+        char* r = (char*)VirtualAlloc(NULL, length + FBA_MAP_MIN, MEM_RESERVE, PAGE_NOACCESS);
+        if (!r)
+            return NULL;
+        char* a = (char*)(((uintptr_t)r + FBA_MAP_MIN - 1) & ~(uintptr_t)(FBA_MAP_MIN - 1));
+        VirtualFree(r, 0, MEM_RELEASE);
+        void* m = VirtualAlloc(a, length, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (m)
+            return m;
+    }
+    return VirtualAlloc(NULL, length, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    char* r = (char*)mmap(NULL, length + FBA_MAP_MIN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == (char*)MAP_FAILED)
+        return NULL;
+    char* a = (char*)(((uintptr_t)r + FBA_MAP_MIN - 1) & ~(uintptr_t)(FBA_MAP_MIN - 1));
+    if (a > r)
+        munmap(r, a - r);
+    munmap(a + length, r + FBA_MAP_MIN - a);
+#ifdef MADV_HUGEPAGE
+    madvise(a, length, MADV_HUGEPAGE);
+#endif
+    return a;
+#endif
+}
+
+// frees the least recently freed blocks until the pool fits the budget
+static void trim_to(size_t budget)
+{
+    size_t n = 0;
+    while (n < g_free.size() && g_free_bytes > budget) {
+        g_free_bytes -= header_of(g_free[n])->size;
+        release(g_free[n++]);
+    }
+    g_free.erase(g_free.begin(), g_free.begin() + n);
+}
+
+void* fba_alloc(size_t bytes, int zero)
+{
+    const size_t size = class_size(bytes);
+    {
+        std::lock_guard<std::mutex> l(g_lock);
+        size_t n = g_free.size();
+        while (n-- > 0) {
+            void* p = g_free[n];
+            if (header_of(p)->size == size) {
+                g_free.erase(g_free.begin() + n);
+                g_free_bytes -= size;
+                if (zero)
+                    memset(p, 0, size);
+                return p;
+            }
+        }
+    }
+
+    fba_header* hd;
+    size_t mapped = 0;
+    if (size + FBA_ALIGN >= FBA_MAP_MIN) {
+        // whole, aligned 2 MB pages, so the kernel can back all of it with
+        // huge ones. fresh mappings come zeroed
+        mapped = (size + FBA_ALIGN + FBA_MAP_MIN - 1) / FBA_MAP_MIN * FBA_MAP_MIN;
+        hd = (fba_header*)map_aligned(mapped);
+    } else {
+#ifdef _WIN32
+        hd = (fba_header*)_aligned_malloc(size + FBA_ALIGN, FBA_ALIGN);
+#else
+        void* m;
+        hd = posix_memalign(&m, FBA_ALIGN, size + FBA_ALIGN) ? NULL : (fba_header*)m;
+#endif
+        if (hd && zero)
+            memset(hd, 0, size + FBA_ALIGN);
+    }
+    if (!hd)
+        return NULL;
+    hd->size = size;
+    hd->mapped = mapped;
+    return (char*)hd + FBA_ALIGN;
+}
+
+void fba_free(void* p)
+{
+    if (!p)
+        return;
+    std::lock_guard<std::mutex> l(g_lock);
+    g_free.push_back(p);
+    g_free_bytes += header_of(p)->size;
+    trim_to(g_budget);
+}
+
+void fba_set_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> l(g_lock);
+    g_budget = bytes;
+    trim_to(g_budget);
+}
+
+void fba_trim()
+{
+    std::lock_guard<std::mutex> l(g_lock);
+    trim_to(0);
+}
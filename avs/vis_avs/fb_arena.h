@@ -0,0 +1,54 @@
+// Process-wide pool for frame sized scratch buffers (last frames, depth and
+// displacement tables, transition frames). Blocks are 64 byte aligned and
+// rounded up to a size class, and a freed block waits on a free list for
+// the next request of its class instead of going back to the heap, so
+// resizing the window or switching presets reuses what the last size left
+// behind. Blocks from FBA_MAP_MIN on are mapped straight from the system
+// (on Linux with transparent huge pages where the kernel allows), so the
+// big ones never fragment the heap at all.
+
+#ifndef _FB_ARENA_H_
+#define _FB_ARENA_H_
+
+#include <new>
+#include <stddef.h>
+
+#define FBA_ALIGN 64
+#define FBA_MAP_MIN (2 << 20)
+#define FBA_DEFAULT_BUDGET (64 << 20)
+
+// a block of at least bytes (0 is fine), cleared when zero is set as GPTR
+// would; NULL when out of memory
+void* fba_alloc(size_t bytes, int zero);
+// returns a block to the pool; NULL is ignored
+void fba_free(void* p);
+// bytes of free blocks the pool keeps, least recently freed go first
+void fba_set_budget(size_t bytes);
+// gives every free block back to the system
+void fba_trim();
+
+// for containers that hold a frame's worth of data
+template <class T>
+struct fba_allocator {
+    typedef T value_type;
+
+    fba_allocator() { }
+    template <class U>
+    fba_allocator(const fba_allocator<U>&) { }
+
+    T* allocate(size_t n)
+    {
+        void* p = fba_alloc(n * sizeof(T), 0);
+        if (!p)
+            throw std::bad_alloc();
+        return (T*)p;
+    }
+    void deallocate(T* p, size_t) { fba_free(p); }
+
+    template <class U>
+    bool operator==(const fba_allocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const fba_allocator<U>&) const { return false; }
+};
+
+#endif // _FB_ARENA_H_
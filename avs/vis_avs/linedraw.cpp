@@ -38,6 +38,12 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define ABS(x) ((x) < 0 ? -(x) : (x))
 
 void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int color, int lw)
+{
+    line_rows(fb, x1, y1, x2, y2, width, height, color, lw, 0, height);
+}
+
+// only touches rows [row0, row1), pixels there come out as line() draws them
+void line_rows(int* fb, int x1, int y1, int x2, int y2, int width, int height, int color, int lw, int row0, int row1)
 {
     int dy = ABS(y2 - y1);
     int dx = ABS(x2 - x1);
@@ -57,8 +63,8 @@ void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int co
     {
         x1 -= lw2;
         if (x1 + lw >= 0 && x1 < width) {
-            int d = max(min(y1, y2), 0);
-            int ye = min(max(y1, y2), height - 1);
+            int d = max(max(min(y1, y2), 0), row0);
+            int ye = min(min(max(y1, y2), height - 1), row1);
             if (x1 < 0) {
                 lw += x1;
                 x1 = 0;
@@ -92,10 +98,16 @@ void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int co
             }
             if (y1 + lw >= height)
                 lw = height - y1;
+            if (y1 + lw > row1)
+                lw = row1 - y1;
+            if (y1 < row0) {
+                lw -= row0 - y1;
+                y1 = row0;
+            }
             fb += y1 * width + d;
             width -= xe - d;
             int y = lw;
-            while (y--) {
+            while (y-- > 0) {
                 int lt = d;
                 while (lt++ < xe) {
                     BLEND_LINE(fb, color);
@@ -179,12 +191,12 @@ void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int co
                 int yp = y1;
                 int ype = y1 + lw;
                 int* newfb = fb + offs;
-                if (yp < 0) {
-                    newfb -= yp * width;
-                    yp = 0;
+                if (yp < row0) {
+                    newfb += (row0 - yp) * width;
+                    yp = row0;
                 }
-                if (ype > height)
-                    ype = height;
+                if (ype > row1)
+                    ype = row1;
                 while (yp++ < ype) {
                     BLEND_LINE(newfb, color);
                     newfb += width;
@@ -231,21 +243,23 @@ void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int co
                 offs += v - y1 * width;
                 y1 = 0;
             }
-            if (y2 > height)
-                y2 = height;
+            if (y2 > row1)
+                y2 = row1;
             while (y1 < y2) {
-                int xp = x1;
-                int xpe = x1 + lw;
-                int* newfb = fb + offs;
-                if (xp < 0) {
-                    newfb -= xp;
-                    xp = 0;
-                }
-                if (xpe > width)
-                    xpe = width;
-                while (xp++ < xpe) {
-                    BLEND_LINE(newfb, color);
-                    newfb++;
+                if (y1 >= row0) {
+                    int xp = x1;
+                    int xpe = x1 + lw;
+                    int* newfb = fb + offs;
+                    if (xp < 0) {
+                        newfb -= xp;
+                        xp = 0;
+                    }
+                    if (xpe > width)
+                        xpe = width;
+                    while (xp++ < xpe) {
+                        BLEND_LINE(newfb, color);
+                        newfb++;
+                    }
                 }
 
                 if (d < 0)
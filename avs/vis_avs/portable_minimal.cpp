@@ -4,12 +4,19 @@
 #include "../../platform_shim.h"
 #include "r_defs.h"
 #include <cstdio>
+#if AVS_WITH_EEL && !defined(_WIN32)
+#include "r_list.h"
+#include "r_transition.h"
+#include "rlib.h"
+#endif
 
 // Global variables expected by legacy headers
 char g_path[1024] = { 0 };
 unsigned char g_blendtable[256][256];
 int g_reset_vars_on_recompile = 0;
-int g_line_blend_mode = 0; // 0 = copy
+#if !AVS_WITH_EEL
+int g_line_blend_mode = 0; // 0 = copy; r_linemode.cpp owns it otherwise
+#endif
 
 // MMX-related constants (unused in NO_MMX path but must exist)
 unsigned int const mmx_blend4_revn[2] = { 0, 0 };
@@ -46,3 +53,30 @@ extern "C" void avs_portable_tick()
         (void)demo; // suppress unused in optimized builds
     }
 }
+
+#if AVS_WITH_EEL && !defined(_WIN32)
+// Globals the effects engine shares with render.cpp / main.cpp / wnd.cpp /
+// cfgwin.cpp / draw.cpp, none of which are built here. The host (e.g.
+// standalone/avs_standalone.cpp) creates the library and the render list.
+C_RLibrary* g_render_library;
+C_RenderListClass* g_render_effects;
+C_RenderListClass* g_render_effects2;
+C_RenderTransitionClass* g_render_transition;
+CRITICAL_SECTION g_render_cs;
+HINSTANCE g_hInstance;
+HWND hwnd_WinampParent;
+int g_config_smp_mt = 2, g_config_smp = 0, g_config_tiles = 1;
+int config_reuseonresize = 1;
+
+// no window, so getmouse() has nothing to report
+double DDraw_translatePoint(POINT p, int isY) { return 0.0; }
+
+// transitions (r_transition.cpp) are not built: undo / redo load straight
+// into the active list
+int C_RenderTransitionClass::LoadPreset(char* file, int which, C_UndoItem* item)
+{
+    if (!g_render_effects)
+        return 1;
+    return item ? g_render_effects->__LoadPresetFromUndo(*item, 1) : g_render_effects->__LoadPreset(file, 1);
+}
+#endif
@@ -0,0 +1,164 @@
+// Zone profiler: one fixed-size ring of finished zones per thread, written
+// only by its owner. The owner publishes each zone by bumping the ring's head
+// (release); the exporter reads head (acquire) and copies the newest
+// PROF_RING_SIZE entries. Threads register their ring once, under a lock, the
+// first time they record; rings outlive their threads so pool workers that
+// have been shut down still show up in the trace.
+
+#include "profiler.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define PROF_RING_SIZE (1 << 16) // zones kept per thread
+#define PROF_MAX_DEPTH 64
+
+std::atomic<int> g_prof_enabled(0);
+
+namespace {
+struct ProfEvent {
+    const char* name;
+    const void* inst;
+    int slot;
+    uint64_t start, end;
+};
+
+struct ProfRing {
+    ProfEvent events[PROF_RING_SIZE];
+    std::atomic<uint64_t> head { 0 };
+    std::atomic<uint64_t> base { 0 }; // head at the last prof_clear()
+    int tid;
+    std::string name;
+    // open zones, owner-only
+    ProfEvent open[PROF_MAX_DEPTH];
+    int depth = 0;
+};
+
+std::mutex g_rings_lock;
+std::vector<std::unique_ptr<ProfRing>> g_rings;
+thread_local ProfRing* t_ring;
+thread_local const char* t_name; // set before the thread's ring exists
+
+const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+ProfRing* ring()
+{
+    if (!t_ring) {
+        std::lock_guard<std::mutex> l(g_rings_lock);
+        g_rings.emplace_back(new ProfRing);
+        t_ring = g_rings.back().get();
+        t_ring->tid = (int)g_rings.size();
+        if (t_name)
+            t_ring->name = t_name;
+    }
+    return t_ring;
+}
+}
+
+void prof_enable(int on)
+{
+    g_prof_enabled.store(!!on, std::memory_order_relaxed);
+}
+
+uint64_t prof_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void prof_begin(const char* name, const void* inst, int slot)
+{
+    ProfRing* r = ring();
+    // past the depth limit zones still balance, they just aren't recorded
+    if (r->depth < PROF_MAX_DEPTH) {
+        ProfEvent& e = r->open[r->depth];
+        e.name = name;
+        e.inst = inst;
+        e.slot = slot;
+        e.start = prof_now_ns();
+    }
+    r->depth++;
+}
+
+void prof_end()
+{
+    ProfRing* r = ring();
+    if (r->depth <= 0)
+        return;
+    if (--r->depth >= PROF_MAX_DEPTH)
+        return;
+    ProfEvent e = r->open[r->depth];
+    e.end = prof_now_ns();
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    r->events[h % PROF_RING_SIZE] = e;
+    r->head.store(h + 1, std::memory_order_release);
+}
+
+void prof_set_thread_name(const char* name)
+{
+    // rings are big; threads that never record shouldn't get one for a name
+    t_name = name;
+    if (t_ring) {
+        std::lock_guard<std::mutex> l(g_rings_lock);
+        t_ring->name = name;
+    }
+}
+
+void prof_clear()
+{
+    std::lock_guard<std::mutex> l(g_rings_lock);
+    for (size_t x = 0; x < g_rings.size(); x++)
+        g_rings[x]->base.store(g_rings[x]->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+static void write_json_string(FILE* fp, const char* s)
+{
+    fputc('"', fp);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+bool prof_write_chrome_trace(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (!fp)
+        return false;
+    std::lock_guard<std::mutex> l(g_rings_lock);
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    for (size_t x = 0; x < g_rings.size(); x++) {
+        ProfRing* r = g_rings[x].get();
+        if (!r->name.empty()) {
+            fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", r->tid);
+            write_json_string(fp, r->name.c_str());
+            fprintf(fp, "}}");
+            first = 0;
+        }
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        uint64_t from = r->base.load(std::memory_order_relaxed);
+        if (head - from > PROF_RING_SIZE)
+            from = head - PROF_RING_SIZE;
+        for (uint64_t i = from; i < head; i++) {
+            const ProfEvent& e = r->events[i % PROF_RING_SIZE];
+            fprintf(fp, "%s{\"ph\":\"X\",\"cat\":\"avs\",\"name\":", first ? "" : ",\n");
+            write_json_string(fp, e.name);
+            fprintf(fp, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", r->tid, e.start / 1000.0, (e.end - e.start) / 1000.0);
+            if (e.inst || e.slot >= 0)
+                fprintf(fp, ",\"args\":{\"inst\":\"%p\",\"slot\":%d}", e.inst, e.slot);
+            fprintf(fp, "}");
+            first = 0;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
@@ -0,0 +1,61 @@
+// Zone profiler for the render path. Zones are timed in steady_clock
+// nanoseconds and appended to a ring buffer owned by the recording thread, so
+// recording takes no locks; prof_write_chrome_trace() gathers every thread's
+// ring into Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Recording
+// is off until prof_enable(1), and a disabled zone costs a load and a branch.
+// Replaces the rdtsc counters of TIMING.C.
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+#include <stdint.h>
+
+extern std::atomic<int> g_prof_enabled;
+
+static inline int prof_enabled() { return g_prof_enabled.load(std::memory_order_relaxed); }
+void prof_enable(int on);
+
+uint64_t prof_now_ns();
+
+// opens / closes a zone on the calling thread; zones nest. name must stay
+// valid until the trace is written (literals, effect descriptions). inst and
+// slot tell effect instances apart: the object and its index in its list
+void prof_begin(const char* name, const void* inst = 0, int slot = -1);
+void prof_end();
+
+// labels the calling thread in the trace (name must stay valid, as above)
+void prof_set_thread_name(const char* name);
+
+// drops everything recorded so far
+void prof_clear();
+
+// writes the zones still held in the rings (the newest ones per thread) as
+// Chrome trace JSON. exact while recording is paused; while it runs, zones
+// being overwritten as they are read may come out torn. false on an I/O error
+bool prof_write_chrome_trace(const char* path);
+
+// a zone for the rest of the enclosing scope
+class C_ProfZone {
+public:
+    C_ProfZone(const char* name, const void* inst = 0, int slot = -1)
+        : m_on(prof_enabled())
+    {
+        if (m_on)
+            prof_begin(name, inst, slot);
+    }
+    ~C_ProfZone()
+    {
+        if (m_on)
+            prof_end();
+    }
+
+private:
+    int m_on;
+};
+
+#define PROF_ZONE_CAT2(a, b) a##b
+#define PROF_ZONE_CAT(a, b) PROF_ZONE_CAT2(a, b)
+#define PROF_ZONE(name) C_ProfZone PROF_ZONE_CAT(_prof_zone_, __LINE__)(name)
+
+#endif // _PROFILER_H_
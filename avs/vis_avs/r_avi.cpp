@@ -28,6 +28,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
@@ -39,7 +40,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Render / AVI"
 #define C_THISCLASS C_AVIClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
@@ -48,6 +49,7 @@ public:
     void closeAvi(void);
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled && loaded ? RTRAIT_GLOBAL : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -109,7 +111,7 @@ C_THISCLASS::~C_THISCLASS()
     AVIFileExit();
     DrawDibClose(hDrawDib);
     if (old_image) {
-        GlobalFree(old_image);
+        fba_free(old_image);
         old_image = NULL;
         old_image_h = old_image_w = 0;
     }
@@ -248,7 +250,7 @@ void C_THISCLASS::reinit(int w, int h)
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     int *p, *d;
-    int i, j;
+    int i;
     static int persistCount = 0;
 
     if (!enabled || !loaded)
@@ -256,8 +258,8 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
 
     if (h != old_image_h || w != old_image_w) {
         if (old_image)
-            GlobalFree(old_image);
-        old_image = (int*)GlobalAlloc(GMEM_FIXED, sizeof(int) * w * h);
+            fba_free(old_image);
+        old_image = (int*)fba_alloc(sizeof(int) * w * h, 0);
         old_image_h = h;
         old_image_w = w;
     }
@@ -298,21 +300,15 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     d = framebuffer + w * (h - 1);
     if (blend || (adapt && (isBeat || persistCount)))
         for (i = 0; i < h; i++) {
-            for (j = 0; j < w; j++) {
-                *d = BLEND(*p, *d);
-                d++;
-                p++;
-            }
-            d -= w * 2;
+            blend_add_block(d, p, d, w);
+            p += w;
+            d -= w;
         }
     else if (blendavg || adapt)
         for (i = 0; i < h; i++) {
-            for (j = 0; j < w; j++) {
-                *d = BLEND_AVG(*p, *d);
-                d++;
-                p++;
-            }
-            d -= w * 2;
+            blend_avg_block(d, p, d, w);
+            p += w;
+            d -= w;
         }
     else
         for (i = 0; i < h; i++) {
@@ -35,7 +35,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -45,12 +44,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 static const unsigned int revn[2] = { 0xff00ff, 0xff00ff }; //{0x1000100,0x1000100}; <<- this is actually more correct, but we're going for consistency vs. the non-mmx ver-jf
 static const int zero = 0;
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_FBOUT; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -206,19 +206,12 @@ int C_THISCLASS::blitter_normal(int* framebuffer, int* fbout, int w, int h, int
             s_y += ds_x;
 #ifdef NO_MMX
             {
+                // the whole row shares one y fraction, handed to the line
+                // sampler as a 16.16 position inside the first source row
                 ypart = (ypart * 255) >> 8;
-                int x = w / 4;
-                while (x--) {
-                    fbout[0] = BLEND4(src + (s_x >> 16), w, (s_x >> 8) & 0xff, ypart);
-                    s_x += ds_x;
-                    fbout[1] = BLEND4(src + (s_x >> 16), w, (s_x >> 8) & 0xff, ypart);
-                    s_x += ds_x;
-                    fbout[2] = BLEND4(src + (s_x >> 16), w, (s_x >> 8) & 0xff, ypart);
-                    s_x += ds_x;
-                    fbout[3] = BLEND4(src + (s_x >> 16), w, (s_x >> 8) & 0xff, ypart);
-                    s_x += ds_x;
-                    fbout += 4;
-                }
+                int x = w & ~3;
+                blend4_16_line_block(fbout, (const int*)src, w, s_x, ypart << 8, ds_x, 0, x);
+                fbout += x;
             }
 #else
             {
@@ -30,17 +30,24 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // alphachannel safe 11/21/99
 
 #include "../../platform_shim.h"
+#include "blur_box.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
 #define C_THISCLASS C_BlurClass
 #define MOD_NAME "Trans / Blur"
 
+// enabled: 0 off, 1 medium, 2 light, 3 heavy, or custom, which runs the
+// radius / passes box blur from blur_box.cpp instead of the fixed kernels
+#define BLUR_CUSTOM 4
+
+extern int g_config_smp_mt;
+
 static const int zero = 0;
 
 class C_THISCLASS : public C_RBASE2 {
@@ -58,10 +65,20 @@ public:
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits()
+    {
+        if (!enabled)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return enabled == BLUR_CUSTOM ? RTRAIT_GLOBAL : RTRAIT_RADIUS(1) | RTRAIT_FBOUT;
+    }
 
     int enabled;
 
     int roundmode;
+    int radius, passes; // for BLUR_CUSTOM
+
+    int* tmpbuf;
+    int tmpbuf_len;
 };
 
 #define PUT_INT(y)                   \
@@ -82,6 +99,18 @@ void C_THISCLASS::load_config(unsigned char* data, int len)
         pos += 4;
     } else
         roundmode = 0;
+    if (len - pos >= 4) {
+        radius = GET_INT();
+        pos += 4;
+    }
+    if (len - pos >= 4) {
+        passes = GET_INT();
+        pos += 4;
+    }
+    if (radius < 1 || radius > BLUR_MAX_RADIUS)
+        radius = 4;
+    if (passes < 1 || passes > BLUR_MAX_PASSES)
+        passes = 3;
 }
 int C_THISCLASS::save_config(unsigned char* data)
 {
@@ -90,6 +119,10 @@ int C_THISCLASS::save_config(unsigned char* data)
     pos += 4;
     PUT_INT(roundmode);
     pos += 4;
+    PUT_INT(radius);
+    pos += 4;
+    PUT_INT(passes);
+    pos += 4;
     return pos;
 }
 
@@ -97,16 +130,22 @@ C_THISCLASS::C_THISCLASS()
 {
     roundmode = 0;
     enabled = 1;
+    radius = 4;
+    passes = 3;
+    tmpbuf = NULL;
+    tmpbuf_len = 0;
 }
 
 C_THISCLASS::~C_THISCLASS()
 {
+    if (tmpbuf)
+        fba_free(tmpbuf);
 }
 
-#define MASK_SH1 (~(((1 << 7) | (1 << 15) | (1 << 23)) << 1))
-#define MASK_SH2 (~(((3 << 6) | (3 << 14) | (3 << 22)) << 2))
-#define MASK_SH3 (~(((7 << 5) | (7 << 13) | (7 << 21)) << 3))
-#define MASK_SH4 (~(((15 << 4) | (15 << 12) | (15 << 20)) << 4))
+#define MASK_SH1 (~(((1u << 7) | (1u << 15) | (1u << 23)) << 1))
+#define MASK_SH2 (~(((3u << 6) | (3u << 14) | (3u << 22)) << 2))
+#define MASK_SH3 (~(((7u << 5) | (7u << 13) | (7u << 21)) << 3))
+#define MASK_SH4 (~(((15u << 4) | (15u << 12) | (15u << 20)) << 4))
 static unsigned int mmx_mask1[2] = { MASK_SH1, MASK_SH1 };
 static unsigned int mmx_mask2[2] = { MASK_SH2, MASK_SH2 };
 static unsigned int mmx_mask3[2] = { MASK_SH3, MASK_SH3 };
@@ -119,10 +158,9 @@ static unsigned int mmx_mask4[2] = { MASK_SH4, MASK_SH4 };
 
 void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
-    if (!enabled)
+    if (!enabled || enabled == BLUR_CUSTOM)
         return;
 
-    timingEnter(0);
 
     unsigned int* f = (unsigned int*)framebuffer;
     unsigned int* of = (unsigned int*)fbout;
@@ -199,7 +237,7 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
             if (roundmode) {
                 adj_tl1 = 0x04040404;
                 adj_tl2 = 0x05050505;
-                adj2 = 0x0505050505050505i64;
+                adj2 = 0x0505050505050505ull;
             }
             while (y--) {
                 int x;
@@ -438,7 +476,7 @@ mmx_light_blur_loop:
             if (roundmode) {
                 adj_tl1 = 0x02020202;
                 adj_tl2 = 0x03030303;
-                adj2 = 0x0303030303030303i64;
+                adj2 = 0x0303030303030303ull;
             }
 
             while (y--) {
@@ -659,7 +697,7 @@ mmx_heavy_blur_loop:
             if (roundmode) {
                 adj_tl1 = 0x03030303;
                 adj_tl2 = 0x04040404;
-                adj2 = 0x0404040404040404i64;
+                adj2 = 0x0404040404040404ull;
             }
             while (y--) {
                 int x;
@@ -846,19 +884,36 @@ mmx_normal_blur_loop:
     __asm emms;
 #endif
 
-    timingLeave(0);
 }
 
 int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (!enabled)
         return 0;
+    if (enabled == BLUR_CUSTOM) {
+        // the passes need every row done before the columns start, so they
+        // run here on the pool and leave no slices to the render list
+        if (isBeat & 0x80000000)
+            return 0;
+        if (!tmpbuf || tmpbuf_len != w * h) {
+            if (tmpbuf)
+                fba_free(tmpbuf);
+            tmpbuf_len = w * h;
+            tmpbuf = (int*)fba_alloc(w * h * sizeof(int), 0);
+        }
+        if (!tmpbuf) {
+            tmpbuf_len = 0;
+            return 0;
+        }
+        blur_box(framebuffer, framebuffer, tmpbuf, w, h, radius, passes, roundmode, max_threads > 1 ? g_config_smp_mt : 1);
+        return 0;
+    }
     return max_threads;
 }
 
 int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
 {
-    return !!enabled;
+    return enabled && enabled != BLUR_CUSTOM;
 }
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
@@ -882,6 +937,16 @@ C_RBASE* R_Blur(char* desc)
 
 static C_THISCLASS* g_this;
 
+static void update_custom(HWND hwndDlg)
+{
+    int en = g_this->enabled == BLUR_CUSTOM;
+    char buf[32];
+    wsprintf(buf, "Radius: %d", g_this->radius);
+    SetDlgItemText(hwndDlg, IDC_RADIUS_LABEL, buf);
+    EnableWindow(GetDlgItem(hwndDlg, IDC_SLIDER1), en);
+    EnableWindow(GetDlgItem(hwndDlg, IDC_COMBO1), en);
+}
+
 static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     switch (uMsg) {
@@ -890,6 +955,8 @@ static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
             CheckDlgButton(hwndDlg, IDC_RADIO3, BST_CHECKED);
         else if (g_this->enabled == 3)
             CheckDlgButton(hwndDlg, IDC_RADIO4, BST_CHECKED);
+        else if (g_this->enabled == BLUR_CUSTOM)
+            CheckDlgButton(hwndDlg, IDC_RADIO5, BST_CHECKED);
         else if (g_this->enabled)
             CheckDlgButton(hwndDlg, IDC_RADIO2, BST_CHECKED);
         else
@@ -898,7 +965,21 @@ static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
             CheckDlgButton(hwndDlg, IDC_ROUNDDOWN, BST_CHECKED);
         else
             CheckDlgButton(hwndDlg, IDC_ROUNDUP, BST_CHECKED);
+        SendDlgItemMessage(hwndDlg, IDC_SLIDER1, TBM_SETRANGEMIN, 0, 1);
+        SendDlgItemMessage(hwndDlg, IDC_SLIDER1, TBM_SETRANGEMAX, 0, BLUR_MAX_RADIUS);
+        SendDlgItemMessage(hwndDlg, IDC_SLIDER1, TBM_SETPOS, 1, g_this->radius);
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM) "Box");
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM) "Tent (2 passes)");
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM) "Gaussian (3 passes)");
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_SETCURSEL, g_this->passes - 1, 0);
+        update_custom(hwndDlg);
         return 1;
+    case WM_HSCROLL:
+        if ((HWND)lParam == GetDlgItem(hwndDlg, IDC_SLIDER1)) {
+            g_this->radius = (int)SendMessage((HWND)lParam, TBM_GETPOS, 0, 0);
+            update_custom(hwndDlg);
+        }
+        return 0;
     case WM_COMMAND:
         if (LOWORD(wParam) == IDC_RADIO1)
             if (IsDlgButtonChecked(hwndDlg, IDC_RADIO1))
@@ -912,6 +993,16 @@ static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
         if (LOWORD(wParam) == IDC_RADIO4)
             if (IsDlgButtonChecked(hwndDlg, IDC_RADIO4))
                 g_this->enabled = 3;
+        if (LOWORD(wParam) == IDC_RADIO5)
+            if (IsDlgButtonChecked(hwndDlg, IDC_RADIO5))
+                g_this->enabled = BLUR_CUSTOM;
+        if (LOWORD(wParam) == IDC_COMBO1 && HIWORD(wParam) == CBN_SELCHANGE) {
+            int sel = (int)SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_GETCURSEL, 0, 0);
+            if (sel >= 0)
+                g_this->passes = sel + 1;
+        }
+        if (LOWORD(wParam) == IDC_RADIO1 || LOWORD(wParam) == IDC_RADIO2 || LOWORD(wParam) == IDC_RADIO3 || LOWORD(wParam) == IDC_RADIO4 || LOWORD(wParam) == IDC_RADIO5)
+            update_custom(hwndDlg);
         if (LOWORD(wParam) == IDC_ROUNDUP)
             if (IsDlgButtonChecked(hwndDlg, IDC_ROUNDUP))
                 g_this->roundmode = 1;
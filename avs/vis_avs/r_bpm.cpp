@@ -42,12 +42,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define SET_BEAT 0x10000000
 #define CLR_BEAT 0x20000000
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_POINT | RTRAIT_BEAT : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -55,6 +55,8 @@ public:
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return enabled ? (exclude ? RTRAIT_POINT : RTRAIT_POINT | RTRAIT_LUT) : RTRAIT_POINT | RTRAIT_NOOP; }
+    virtual void get_lut(unsigned char lut[4][256]);
 
     int enabled;
     int redp, greenp, bluep;
@@ -187,6 +189,7 @@ static __inline int inRange(int color, int ref, int distance)
     return 1;
 }
 
+#ifndef NO_MMX
 static void mmx_brighten_block(int* p, int rm, int gm, int bm, int l)
 {
     int poo[2] = {
@@ -215,6 +218,7 @@ mmx_brightblock_loop:
     }
     ;
 }
+#endif
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
@@ -266,6 +270,26 @@ int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffe
     return 0;
 }
 
+// what smp_render() does without exclusion, byte by byte: BLEND() saturates
+// each channel and keeps alpha, BLEND_AVG() halves both sides, and
+// replacing leaves alpha at 0
+void C_THISCLASS::get_lut(unsigned char lut[4][256])
+{
+    int n;
+    for (n = 0; n < 256; n++) {
+        int c[3] = { blue_tab[n], green_tab[n] >> 8, red_tab[n] >> 16 };
+        int k;
+        for (k = 0; k < 3; k++) {
+            if (blend)
+                c[k] = n + c[k] > 255 ? 255 : n + c[k];
+            else if (blendavg)
+                c[k] = (n >> 1) + (c[k] >> 1);
+            lut[k][n] = (unsigned char)c[k];
+        }
+        lut[3][n] = (unsigned char)(blend ? n : blendavg ? n >> 1 : 0);
+    }
+}
+
 // render function
 // render should return 0 if it only used framebuffer, or 1 if the new output data is in fbout. this is
 // used when you want to do something that you'd otherwise need to make a copy of the framebuffer.
@@ -42,7 +42,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Bump"
 #define C_THISCLASS C_BumpClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
@@ -52,6 +52,12 @@ public:
     void CreateStar(int A);
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits()
+    {
+        if (!enabled)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return RTRAIT_GLOBAL | RTRAIT_FBOUT | RTRAIT_EEL | (buffern ? RTRAIT_BUFFER(buffern - 1) : 0);
+    }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -66,9 +72,9 @@ public:
     int blend;
     int blendavg;
     int nF;
-    int codeHandle;
-    int codeHandleBeat;
-    int codeHandleInit;
+    intptr_t codeHandle;
+    intptr_t codeHandleBeat;
+    intptr_t codeHandleInit;
     double* var_x;
     double* var_y;
     double* var_isBeat;
@@ -79,7 +85,7 @@ public:
     int showlight;
     int initted;
     int invert;
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     int oldstyle;
     int buffern;
     CRITICAL_SECTION rcs;
@@ -471,13 +477,13 @@ static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
             CheckDlgButton(hwndDlg, IDC_DOT, BST_CHECKED);
         if (!g_ConfigThis->blend && !g_ConfigThis->blendavg)
             CheckDlgButton(hwndDlg, IDC_REPLACE, BST_CHECKED);
-        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (int)"Current");
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM)"Current");
         {
             int i = 0;
             char txt[64];
             for (i = 0; i < NBUF; i++) {
                 wsprintf(txt, "Buffer %d", i + 1);
-                SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (int)txt);
+                SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM)txt);
             }
         }
         SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_SETCURSEL, (WPARAM)g_ConfigThis->buffern, 0);
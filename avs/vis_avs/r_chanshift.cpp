@@ -45,12 +45,22 @@ typedef struct {
     int onbeat;
 } apeconfig;
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_getflags() { return 1; }
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits()
+    {
+        if (config.mode == IDC_RGB && !config.onbeat)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return RTRAIT_POINT | (config.onbeat ? RTRAIT_RANDOM : 0);
+    }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual char* get_desc();
     virtual void load_config(unsigned char* data, int len);
@@ -109,212 +119,86 @@ C_THISCLASS::~C_THISCLASS()
 }
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h) < 1)
+        return 0;
+
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (isBeat & 0x80000000)
         return 0;
 
-    int c;
     int modes[] = { IDC_RGB, IDC_RBG, IDC_GBR, IDC_GRB, IDC_BRG, IDC_BGR };
 
     if (isBeat && config.onbeat) {
         config.mode = modes[rand() % 6];
     }
+    return config.mode == IDC_RGB ? 0 : max_threads;
+}
 
-    c = w * h;
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
+{
+    return 0;
+}
 
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (max_threads < 1)
+        max_threads = 1;
+
+    int start_l = (this_thread * h) / max_threads;
+    int end_l;
+
+    if (this_thread >= max_threads - 1)
+        end_l = h;
+    else
+        end_l = ((this_thread + 1) * h) / max_threads;
+
+    int c = w * (end_l - start_l);
+    if (c < 1)
+        return;
+
+    // the shuffles the old asm did, down to what ends up in the top byte
+    unsigned int* p = (unsigned int*)framebuffer + start_l * w;
     switch (config.mode) {
     default:
     case IDC_RGB:
-        return 0;
+        return;
     case IDC_RBG:
-        __asm {
-			mov ebx, framebuffer;
-			mov ecx, c;
-			lp1:
-			sub ecx, 4;
-
-			mov eax, dword ptr [ebx+ecx*4];
-			xchg ah, al;
-			mov [ebx+ecx*4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+4];
-			xchg ah, al;
-			mov [ebx+ecx*4+4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+8];
-			xchg ah, al;
-			mov [ebx+ecx*4+8], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+12];
-			xchg ah, al;
-			mov [ebx+ecx*4+12], eax;
-
-			test ecx, ecx;
-			jnz lp1;
+        while (c--) {
+            unsigned int v = *p;
+            *p++ = (v & 0xffff0000) | ((v & 0xff) << 8) | ((v >> 8) & 0xff);
         }
         break;
-
     case IDC_BRG:
-        __asm {
-			mov ebx, framebuffer;
-			mov ecx, c;
-			lp2:
-			sub ecx, 4;
-			
-			mov eax, dword ptr [ebx+ecx*4];
-			mov dl, al;
-			shr eax, 8;
-			bswap eax;
-			mov ah, dl;
-			bswap eax;
-			mov [ebx+ecx*4], eax;
-			
-			mov eax, dword ptr [ebx+ecx*4+4];
-			mov dl, al;
-			shr eax, 8;
-			bswap eax;
-			mov ah, dl;
-			bswap eax;
-			mov [ebx+ecx*4+4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+8];
-			mov dl, al;
-			shr eax, 8;
-			bswap eax;
-			mov ah, dl;
-			bswap eax;
-			mov [ebx+ecx*4+8], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+12];
-			mov dl, al;
-			shr eax, 8;
-			bswap eax;
-			mov ah, dl;
-			bswap eax;
-			mov [ebx+ecx*4+12], eax;
-
-			test ecx, ecx;
-			jnz lp2;
+        while (c--) {
+            unsigned int v = *p;
+            *p++ = ((v >> 8) & 0xffff) | ((v & 0xff) << 16);
         }
         break;
-
     case IDC_BGR:
-        __asm {
-			mov ebx, framebuffer;
-			mov ecx, c;
-			lp3:
-			sub ecx, 4;
-
-			mov eax, dword ptr [ebx+ecx*4];
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+4];
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+8];
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+8], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+12];
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+12], eax;
-
-			test ecx, ecx;
-			jnz lp3;
+        while (c--) {
+            unsigned int v = *p;
+            *p++ = ((v & 0xff) << 16) | (v & 0xff00) | ((v >> 16) & 0xff);
         }
         break;
-
     case IDC_GBR:
-        __asm {
-			mov ebx, framebuffer;
-			mov ecx, c;
-			lp4:
-			sub ecx, 4;
-
-			mov eax, dword ptr [ebx+ecx*4];
-			mov edx, eax;
-			bswap edx;
-			shl eax, 8;
-			mov al, dh;
-			mov [ebx+ecx*4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+4];
-			mov edx, eax;
-			bswap edx;
-			shl eax, 8;
-			mov al, dh;
-			mov [ebx+ecx*4+4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+8];
-			mov edx, eax;
-			bswap edx;
-			shl eax, 8;
-			mov al, dh;
-			mov [ebx+ecx*4+8], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+12];
-			mov edx, eax;
-			bswap edx;
-			shl eax, 8;
-			mov al, dh;
-			mov [ebx+ecx*4+12], eax;
-
-			test ecx, ecx;
-			jnz lp4;
+        while (c--) {
+            unsigned int v = *p;
+            *p++ = (v << 8) | ((v >> 16) & 0xff);
         }
         break;
-
     case IDC_GRB:
-        __asm {
-			mov ebx, framebuffer;
-			mov ecx, c;
-			lp5:
-			sub ecx, 4;
-
-			mov eax, dword ptr [ebx+ecx*4];
-			shl eax, 8;
-			bswap eax;
-			xchg ah, al;
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+4];
-			shl eax, 8;
-			bswap eax;
-			xchg ah, al;
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+4], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+8];
-			shl eax, 8;
-			bswap eax;
-			xchg ah, al;
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+8], eax;
-
-			mov eax, dword ptr [ebx+ecx*4+12];
-			shl eax, 8;
-			bswap eax;
-			xchg ah, al;
-			bswap eax;
-			shr eax, 8;
-			mov [ebx+ecx*4+12], eax;
-
-			test ecx, ecx;
-			jnz lp5;
+        while (c--) {
+            unsigned int v = *p;
+            *p++ = ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v & 0xff);
         }
         break;
     }
-    return 0;
 }
 
 HWND C_THISCLASS::conf(HINSTANCE hInstance, HWND hwndParent)
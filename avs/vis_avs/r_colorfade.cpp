@@ -33,7 +33,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -55,7 +54,13 @@ public:
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
-    static int ft[4][3];
+    virtual int get_traits()
+    {
+        if (!enabled)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return RTRAIT_POINT | ((enabled & 6) == 6 ? RTRAIT_RANDOM : 0);
+    }
+    int ft[4][3];
 
     int enabled;
     int faders[3];
@@ -64,7 +69,6 @@ public:
     unsigned char c_tab[512][512];
     unsigned char clip[256 + 40 + 40];
 };
-int C_THISCLASS::ft[4][3];
 
 #define PUT_INT(y)                   \
     data[pos] = (y) & 255;           \
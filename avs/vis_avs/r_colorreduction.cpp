@@ -43,18 +43,25 @@ typedef struct {
     int levels;
 } apeconfig;
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_getflags() { return 1; }
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return RTRAIT_POINT | RTRAIT_LUT; }
+    virtual void get_lut(unsigned char lut[4][256]);
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual char* get_desc();
     virtual void load_config(unsigned char* data, int len);
     virtual int save_config(unsigned char* data);
 
     apeconfig config;
+    int mask; // this frame's, from smp_begin()
 
     HWND hwndDlg;
 };
@@ -121,35 +128,63 @@ C_THISCLASS::~C_THISCLASS()
 }
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h) < 1)
+        return 0;
+
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (isBeat & 0x80000000)
         return 0;
 
-    int a, b, c;
+    int a, b;
     a = 8 - config.levels;
     b = 0xFF;
     while (a--)
         b = (b << 1) & 0xFF;
-    b |= (b << 16) | (b << 8);
-    c = w * h;
-    __asm {
-		mov ebx, framebuffer;
-		mov ecx, c;
-		mov edx, b;
-		lp:
-		sub ecx, 4;
-		test ecx, ecx;
-		jz end;
-		and dword ptr [ebx+ecx*4], edx;
-		and dword ptr [ebx+ecx*4+4], edx;
-		and dword ptr [ebx+ecx*4+8], edx;
-		and dword ptr [ebx+ecx*4+12], edx;
-		jmp lp;
-		end:
-    }
+    mask = b | (b << 16) | (b << 8);
+    return max_threads;
+}
+
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
+{
     return 0;
 }
 
+// the mask has no alpha bits, so alpha ends up 0
+void C_THISCLASS::get_lut(unsigned char lut[4][256])
+{
+    int x;
+    for (x = 0; x < 256; x++) {
+        lut[0][x] = lut[1][x] = lut[2][x] = x & mask;
+        lut[3][x] = 0;
+    }
+}
+
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (max_threads < 1)
+        max_threads = 1;
+
+    int start_l = (this_thread * h) / max_threads;
+    int end_l;
+
+    if (this_thread >= max_threads - 1)
+        end_l = h;
+    else
+        end_l = ((this_thread + 1) * h) / max_threads;
+
+    int* p = framebuffer + start_l * w;
+    int c = w * (end_l - start_l);
+    int b = mask;
+    while (c-- > 0)
+        *p++ &= b;
+}
+
 HWND C_THISCLASS::conf(HINSTANCE hInstance, HWND hwndParent)
 {
     g_ConfigThis = this;
@@ -34,19 +34,24 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <commctrl.h>
 #include <math.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
 #define C_THISCLASS C_DColorModClass
 #define MOD_NAME "Trans / Color Modifier"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_getflags() { return 1; }
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return RTRAIT_POINT | RTRAIT_EEL | RTRAIT_LUT; }
+    virtual void get_lut(unsigned char lut[4][256]);
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -57,10 +62,10 @@ public:
 
     int m_tab_valid;
     unsigned char m_tab[768];
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_r, *var_g, *var_b, *var_beat;
     int inited;
-    int codehandle[4];
+    intptr_t codehandle[4];
     int need_recompile;
     CRITICAL_SECTION rcs;
 };
@@ -142,6 +147,16 @@ C_THISCLASS::~C_THISCLASS()
 }
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h) < 1)
+        return 0;
+
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+// the scripts run here, once a frame; the slices only apply the table
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (need_recompile) {
         EnterCriticalSection(&rcs);
@@ -178,12 +193,19 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     if (m_recompute || !m_tab_valid) {
         int x;
         unsigned char* t = m_tab;
+        double pr[256], pg[256], pb[256];
+        NSEEL_LANEVAR lanes[] = {
+            { var_r, pr, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_g, pg, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_b, pb, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        };
+        for (x = 0; x < 256; x++)
+            pr[x] = pb[x] = pg[x] = x / 255.0;
+        executeCodeBatch(codehandle[0], visdata, lanes, 3, 256);
         for (x = 0; x < 256; x++) {
-            *var_r = *var_b = *var_g = x / 255.0;
-            executeCode(codehandle[0], visdata);
-            int r = (int)(*var_r * 255.0 + 0.5);
-            int g = (int)(*var_g * 255.0 + 0.5);
-            int b = (int)(*var_b * 255.0 + 0.5);
+            int r = (int)(pr[x] * 255.0 + 0.5);
+            int g = (int)(pg[x] * 255.0 + 0.5);
+            int b = (int)(pb[x] * 255.0 + 0.5);
             if (r < 0)
                 r = 0;
             else if (r > 255)
@@ -204,16 +226,43 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
         m_tab_valid = 1;
     }
 
-    unsigned char* fb = (unsigned char*)framebuffer;
-    int l = w * h;
-    while (l--) {
+    return max_threads;
+}
+
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
+{
+    return 0;
+}
+
+void C_THISCLASS::get_lut(unsigned char lut[4][256])
+{
+    int x;
+    memcpy(lut, m_tab, 768);
+    for (x = 0; x < 256; x++)
+        lut[3][x] = x;
+}
+
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (max_threads < 1)
+        max_threads = 1;
+
+    int start_l = (this_thread * h) / max_threads;
+    int end_l;
+
+    if (this_thread >= max_threads - 1)
+        end_l = h;
+    else
+        end_l = ((this_thread + 1) * h) / max_threads;
+
+    unsigned char* fb = (unsigned char*)(framebuffer + start_l * w);
+    int l = w * (end_l - start_l);
+    while (l-- > 0) {
         fb[0] = m_tab[fb[0]];
         fb[1] = m_tab[(int)fb[1] + 256];
         fb[2] = m_tab[(int)fb[2] + 512];
         fb += 4;
     }
-
-    return 0;
 }
 
 C_RBASE* R_DColorMod(char* desc)
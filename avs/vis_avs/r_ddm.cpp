@@ -36,7 +36,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <commctrl.h>
 #include <math.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -113,12 +112,13 @@ static __inline unsigned long isqrt(unsigned long n)
         return (sq_table[n >> 6] << 7);
 }
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_FBOUT | RTRAIT_EEL; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -130,11 +130,11 @@ public:
     int m_lastw, m_lasth;
     int* m_wmul;
     int* m_tab;
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_d, *var_b;
     double max_d;
     int inited;
-    int codehandle[4];
+    intptr_t codehandle[4];
     int need_recompile;
     int subpixel;
     CRITICAL_SECTION rcs;
@@ -31,6 +31,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _R_DEFS_H_
 
 #include "../../platform_shim.h"
+#include "blend_simd.h"
+#include "visdata_ex.h"
 
 // base class declaration, compatibility class
 class RString;
@@ -49,6 +51,22 @@ public:
     void save_string(unsigned char* data, int& pos, RString& text);
 };
 
+// get_traits() bits: what an effect does with the frame in its current
+// configuration. the low two bits say where a pixel's new value comes from
+#define RTRAIT_GLOBAL 0 // anywhere: warps, draws, or state across the frame
+#define RTRAIT_POINT 1 // the same pixel only, or the frame is left alone
+#define RTRAIT_ROW 2 // anywhere in the same row
+#define RTRAIT_RADIUS(r) (3 | ((r) << 8)) // up to r (1..255) pixels away
+#define RTRAIT_SPATIAL(t) ((t) & 3)
+#define RTRAIT_HALO(t) (((t) >> 8) & 0xff) // rows beyond its own a slice reads
+#define RTRAIT_FBOUT 0x04 // the result can end up in fbout (render() returns 1)
+#define RTRAIT_EEL 0x08 // runs EEL code
+#define RTRAIT_RANDOM 0x10 // uses rand(), so not a function of its input and state
+#define RTRAIT_BEAT 0x20 // can set or clear isBeat for the effects after it
+#define RTRAIT_NOOP 0x40 // does nothing at all: frame, own state and isBeat stay
+#define RTRAIT_LUT 0x80 // with RTRAIT_POINT: each byte of a pixel goes through a table of its own
+#define RTRAIT_BUFFER(n) (0x10000 << (n)) // reads or writes global buffer n
+
 class C_RBASE2 : public C_RBASE {
 public:
     C_RBASE2() { }
@@ -63,6 +81,33 @@ public:
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) { return 0; }
     virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) { };
     virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) { return 0; }; // return value is that of render() for fbstuff etc
+
+    // RTRAIT_* for the current configuration. render lists only ask the
+    // built-in effects (APEs built against older headers don't have it):
+    // they skip RTRAIT_NOOP ones, and run SMP effects with another spatial
+    // kind than RTRAIT_GLOBAL tile by tile with their neighbours. such an
+    // effect promises that smp_begin() and smp_finish() leave the frame
+    // alone, that a slice writes only its own rows, that any number of
+    // slices works whatever smp_begin() asked for, and that smp_finish()
+    // returns 1 exactly when RTRAIT_FBOUT is set
+    virtual int get_traits() { return RTRAIT_GLOBAL; }
+    // RTRAIT_LUT effects, after an smp_begin() that returned > 0: the tables
+    // smp_render() would put bytes 0 (blue) to 3 (alpha) of every pixel
+    // through this frame, so a list can fold neighbours into one pass
+    virtual void get_lut(unsigned char lut[4][256]) { }
+};
+
+class C_RBASE3 : public C_RBASE2 {
+public:
+    C_RBASE3() { }
+    virtual ~C_RBASE3() { };
+
+    int getRenderVer3() { return 3; }
+
+    // the list calls this before each render() / smp_begin() with the host's
+    // extended frame, or NULL when there is only the legacy visdata. valid
+    // until that render (or smp_finish) returns
+    virtual void set_visdata_ex(const VisDataEx* vd) { }
 };
 
 // defined in main.cpp, render.cpp
@@ -91,6 +136,7 @@ void matrixApply(float* m, float x, float y, float z, float* outx, float* outy,
 // linedraw.cpp
 extern int g_line_blend_mode;
 void line(int* fb, int x1, int y1, int x2, int y2, int width, int height, int color, int lw);
+void line_rows(int* fb, int x1, int y1, int x2, int y2, int width, int height, int color, int lw, int row0, int row1);
 
 // inlines
 static unsigned int __inline BLEND(unsigned int a, unsigned int b)
@@ -514,204 +560,26 @@ static __inline unsigned int BLEND4_16(unsigned int* p1, unsigned int w, int xp,
 
 #pragma warning(pop)
 
+// whole-buffer blends, see blend_simd.h. the names are from when these
+// were MMX loops; output = BLEND_*(input, output)
 static __inline void mmx_avgblend_block(int* output, int* input, int l)
 {
-#ifdef NO_MMX
-    while (l--) {
-        *output = BLEND_AVG(*input++, *output);
-        output++;
-    }
-#else
-    static int mask[2] = {
-        ~((1 << 7) | (1 << 15) | (1 << 23)),
-        ~((1 << 7) | (1 << 15) | (1 << 23))
-    };
-    __asm {
-    mov eax, input
-    mov edi, output
-    mov ecx, l
-    shr ecx, 2
-    align 16
-mmx_avgblend_loop:
-    movq mm0, [eax]
-    movq mm1, [edi]
-    psrlq mm0, 1
-    movq mm2, [eax+8]
-    psrlq mm1, 1
-    movq mm3, [edi+8]
-    psrlq mm2, 1
-    pand mm0, [mask]
-    psrlq mm3, 1
-    pand mm1, [mask]
-    pand mm2, [mask]
-    paddusb mm0, mm1
-    pand mm3, [mask]
-    add eax, 16
-    paddusb mm2, mm3
-
-    movq [edi], mm0
-    movq [edi+8], mm2
-
-    add edi, 16
-
-    dec ecx
-    jnz mmx_avgblend_loop
-    emms
-    }
-    ;
-#endif
+    blend_avg_block(output, input, output, l);
 }
 
 static __inline void mmx_addblend_block(int* output, int* input, int l)
 {
-#ifdef NO_MMX
-    while (l--) {
-        *output = BLEND(*input++, *output);
-        output++;
-    }
-#else
-    __asm {
-    mov eax, input
-    mov edi, output
-    mov ecx, l
-    shr ecx, 2
-    align 16
-mmx_addblend_loop:
-    movq mm0, [eax]
-    movq mm1, [edi]
-    movq mm2, [eax+8]
-    movq mm3, [edi+8]
-    paddusb mm0, mm1
-    paddusb mm2, mm3
-    add eax, 16
-
-    movq [edi], mm0
-    movq [edi+8], mm2
-
-    add edi, 16
-
-    dec ecx
-    jnz mmx_addblend_loop
-    emms
-    }
-    ;
-#endif
+    blend_add_block(output, input, output, l);
 }
 
 static __inline void mmx_mulblend_block(int* output, int* input, int l)
 {
-#ifdef NO_MMX
-    while (l--) {
-        *output = BLEND_MUL(*input++, *output);
-        output++;
-    }
-#else
-    __asm {
-    mov eax, input
-    mov edi, output
-    mov ecx, l
-    shr ecx, 1
-    align 16
-mmx_mulblend_loop:
-    movd mm0, [eax]
-    movd mm1, [edi]
-    movd mm2, [eax+4]
-    punpcklbw mm0, [mmx_blend4_zero]
-    movd mm3, [edi+4]
-    punpcklbw mm1, [mmx_blend4_zero]
-    punpcklbw mm2, [mmx_blend4_zero]
-    pmullw mm0, mm1
-    punpcklbw mm3, [mmx_blend4_zero]
-    psrlw mm0, 8
-    pmullw mm2, mm3
-    packuswb mm0, mm0
-    psrlw mm2, 8
-    packuswb mm2, mm2
-    add eax, 8
-
-    movd [edi], mm0
-    movd [edi+4], mm2
-
-    add edi, 8
-
-    dec ecx
-    jnz mmx_mulblend_loop
-    emms
-    }
-    ;
-#endif
+    blend_mul_block(output, input, output, l);
 }
 
 static void __inline mmx_adjblend_block(int* o, int* in1, int* in2, int len, int v)
 {
-#ifdef NO_MMX
-    while (len--) {
-        *o++ = BLEND_ADJ(*in1++, *in2++, v);
-    }
-#else
-    __asm {
-    movd mm3, [v] // VVVVVVVV
-    mov ecx, len
-
-    packuswb mm3, mm3 // 0000HHVV
-    mov edx, o
-
-    punpcklwd mm3, mm3 // HHVVHHVV
-    mov esi, in1
-
-    movq mm4, [mmx_blend4_revn]
-    punpckldq mm3, mm3 // HHVVHHVV HHVVHHVV
-    
-    pand mm3, [mmx_blendadj_mask]
-    mov edi, in2
-
-    shr ecx, 1
-    psubw mm4, mm3
-    
-    align 16
-_mmx_adjblend_loop:
-    
-    movd mm0, [esi]
-    
-    movd mm1, [edi]
-    punpcklbw mm0, [mmx_blend4_zero]
-    
-    movd mm6, [esi+4]
-    punpcklbw mm1, [mmx_blend4_zero]
-    
-    movd mm7, [edi+4]        
-    punpcklbw mm6, [mmx_blend4_zero]
-
-    pmullw mm0, mm3
-    punpcklbw mm7, [mmx_blend4_zero]
-
-    pmullw mm1, mm4
-    pmullw mm6, mm3
-
-    pmullw mm7, mm4
-    paddw mm0, mm1
-
-    paddw mm6, mm7
-    add edi, 8
-
-    psrlw mm0, 8
-    add esi, 8
-
-    psrlw mm6, 8
-    packuswb mm0, mm0
-    
-    packuswb mm6, mm6
-    movd [edx], mm0
-
-    movd [edx+4], mm6
-    add edx, 8
-    dec ecx
-    jnz _mmx_adjblend_loop
-
-    emms
-    }
-    ;
-#endif
+    blend_adj_block(o, in1, in2, len, v);
 }
 
 class RString {
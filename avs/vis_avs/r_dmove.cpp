@@ -31,13 +31,14 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "../../platform_shim.h"
 #include "avs_eelif.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "r_list.h"
 #include "resource.h"
+#include "smp_pool.h"
 #include <commctrl.h>
 #include <math.h>
 
-#include "timing.h"
 
 #if 0 
 static void __docheck(int xp, int yp, int m_lastw, int m_lasth, int d_x, int d_y)
@@ -58,12 +59,34 @@ static void __docheck(int xp, int yp, int m_lastw, int m_lasth, int d_x, int d_y
 #define C_THISCLASS C_DMoveClass
 #define MOD_NAME "Trans / Dynamic Movement"
 
+extern int g_config_smp_mt;
+
+// copies of the VM, for evaluating bands of grid rows at the same time
+#define DMOVE_MAX_CLONES 15
+// grid points per band at least, so the default grid stays on one thread
+#define DMOVE_MIN_BAND_POINTS 1024
+
+typedef struct {
+    double *x, *y, *d, *r, *alpha;
+} dmoveVars;
+
+typedef struct {
+    AVS_EEL_CLONE eel;
+    dmoveVars vars;
+} dmoveClone;
+
 class C_THISCLASS : public C_RBASE2 {
 protected:
+    int makeClones(int n);
+    void freeClones();
+    void evalRows(intptr_t code, dmoveVars* vars, int y0, int y1);
+    static void evalProc(void* ctx, int task, int ntasks);
+
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_FBOUT | RTRAIT_EEL | (buffern ? RTRAIT_BUFFER(buffern - 1) : 0); }
 
     virtual int smp_getflags() { return 1; }
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
@@ -78,12 +101,13 @@ public:
 
     int m_lastw, m_lasth;
     int m_lastxres, m_lastyres, m_xres, m_yres;
+    int m_lastslices; // per-slice interpolation scratch lives at the end of m_tab
     int* m_wmul;
     int* m_tab;
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_d, *var_b, *var_r, *var_x, *var_y, *var_w, *var_h, *var_alpha;
     int inited;
-    int codehandle[4];
+    intptr_t codehandle[4];
     int need_recompile;
     int buffern;
     int subpixel, rectcoords, blend, wrap, nomove;
@@ -95,6 +119,10 @@ public:
     int h_adj;
     int XRES;
     int YRES;
+    // grid rows are evaluated in smp_begin(), in bands on copies of the VM
+    // when the points don't depend on each other
+    dmoveClone m_clones[DMOVE_MAX_CLONES];
+    int m_nclones, m_nbands;
 };
 
 #define PUT_INT(y)                   \
@@ -204,6 +232,7 @@ C_THISCLASS::C_THISCLASS()
     effect_exp[3].assign("");
 
     m_lastxres = m_lastyres = 0;
+    m_lastslices = 0;
     m_xres = 16;
     m_yres = 16;
     var_b = 0;
@@ -213,6 +242,9 @@ C_THISCLASS::C_THISCLASS()
     wrap = 0;
     buffern = 0;
     nomove = 0;
+    memset(m_clones, 0, sizeof(m_clones));
+    m_nclones = 0;
+    m_nbands = 1;
 }
 
 C_THISCLASS::~C_THISCLASS()
@@ -222,11 +254,12 @@ C_THISCLASS::~C_THISCLASS()
         freeCode(codehandle[x]);
         codehandle[x] = 0;
     }
+    freeClones();
     AVS_EEL_QUITINST();
     if (m_wmul)
-        GlobalFree(m_wmul);
+        fba_free(m_wmul);
     if (m_tab)
-        GlobalFree(m_tab);
+        fba_free(m_tab);
 
     m_tab = 0;
     m_wmul = 0;
@@ -270,21 +303,22 @@ int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat,
     if (YRES > 256)
         YRES = 256;
 
-    if (m_lasth != h || m_lastw != w || !m_tab || !m_wmul || m_lastxres != XRES || m_lastyres != YRES) {
+    if (m_lasth != h || m_lastw != w || !m_tab || !m_wmul || m_lastxres != XRES || m_lastyres != YRES || m_lastslices < max_threads) {
         int y;
+        m_lastslices = max_threads;
         m_lastxres = XRES;
         m_lastyres = YRES;
         m_lastw = w;
         m_lasth = h;
         if (m_wmul)
-            GlobalFree(m_wmul);
-        m_wmul = (int*)GlobalAlloc(GMEM_FIXED, sizeof(int) * h);
+            fba_free(m_wmul);
+        m_wmul = (int*)fba_alloc(sizeof(int) * h, 0);
         for (y = 0; y < h; y++)
             m_wmul[y] = y * w;
         if (m_tab)
-            GlobalFree(m_tab);
+            fba_free(m_tab);
 
-        m_tab = (int*)GlobalAlloc(GMEM_FIXED, (XRES * YRES * 3 + (XRES * 6 + 6) * MAX_SMP_THREADS) * sizeof(int));
+        m_tab = (int*)fba_alloc((XRES * YRES * 3 + (XRES * 6 + 6) * max_threads) * sizeof(int), 0);
     }
 
     if (!__subpixel) {
@@ -309,6 +343,7 @@ int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat,
             inited = 0;
         }
         need_recompile = 0;
+        freeClones();
         for (x = 0; x < 4; x++) {
             freeCode(codehandle[x]);
             codehandle[x] = compileCode(effect_exp[x].get());
@@ -332,76 +367,214 @@ int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat,
     executeCode(codehandle[1], visdata);
     if (isBeat)
         executeCode(codehandle[2], visdata);
-    {
-        int x;
-        int y;
-        int* tabptr = m_tab;
 
-        double xsc = 2.0 / w, ysc = 2.0 / h;
-        double dw2 = ((double)w * 32768.0);
-        double dh2 = ((double)h * 32768.0);
-        double max_screen_d = sqrt((double)(w * w + h * h)) * 0.5;
-
-        double divmax_d = 1.0 / max_screen_d;
+    // bands of grid rows go to copies of the VM when nothing carries from
+    // one point to the next (the same test executeCodeBatch() makes)
+    m_nbands = 1;
+    if (max_threads > 1 && g_config_smp_mt > 1 && XRES * YRES >= 2 * DMOVE_MIN_BAND_POINTS) {
+        NSEEL_LANEVAR lanes[] = {
+            { var_x, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_y, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_d, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_r, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            { var_alpha, NULL, NSEEL_LANE_OUT },
+        };
+        if (NSEEL_code_independent((NSEEL_CODEHANDLE)codehandle[0], lanes, sizeof(lanes) / sizeof(lanes[0]))) {
+            int n = min(g_config_smp_mt, min(DMOVE_MAX_CLONES + 1, min(YRES, XRES * YRES / DMOVE_MIN_BAND_POINTS)));
+            EnterCriticalSection(&rcs);
+            if (makeClones(n - 1))
+                m_nbands = n;
+            LeaveCriticalSection(&rcs);
+        }
+    }
 
-        max_screen_d *= 65536.0;
+    AVS_EEL_IF_BeginExecute(visdata);
+    if (m_nbands > 1) {
+        int r;
+        for (r = 0; r < m_nbands - 1; r++)
+            AVS_EEL_IF_SyncClone(&m_clones[r].eel, 0);
+        C_SmpPool::get()->run(g_config_smp_mt, m_nbands, evalProc, this);
+        AVS_EEL_IF_SyncClone(&m_clones[m_nbands - 2].eel, 1);
+    } else {
+        dmoveVars v = { var_x, var_y, var_d, var_r, var_alpha };
+        evalRows(codehandle[0], &v, 0, YRES);
+    }
+    AVS_EEL_IF_EndExecute();
+    if (!__rectcoords) {
+        // the variables end up as the last point left them, scaled
+        double max_screen_d = sqrt((double)(w * w + h * h)) * 0.5 * 65536.0;
+        *var_d *= max_screen_d;
+        *var_r -= M_PI * 0.5;
+    }
 
-        int yc_pos, yc_dpos, xc_pos, xc_dpos;
-        yc_pos = 0;
-        xc_dpos = (w << 16) / (XRES - 1);
-        yc_dpos = (h << 16) / (YRES - 1);
-        for (y = 0; y < YRES; y++) {
-            xc_pos = 0;
-            for (x = 0; x < XRES; x++) {
-                double xd, yd;
+    return max_threads;
+}
 
-                xd = ((double)xc_pos - dw2) * (1.0 / 65536.0);
-                yd = ((double)yc_pos - dh2) * (1.0 / 65536.0);
+// call with rcs held
+int C_THISCLASS::makeClones(int n)
+{
+    while (m_nclones < n) {
+        dmoveClone* c = m_clones + m_nclones;
+        NSEEL_VMCTX vm = NSEEL_VM_alloc();
+        if (!vm)
+            return 0;
+        c->eel.vm = (intptr_t)vm;
+        c->vars.x = NSEEL_VM_regvar(vm, "x");
+        c->vars.y = NSEEL_VM_regvar(vm, "y");
+        c->vars.d = NSEEL_VM_regvar(vm, "d");
+        c->vars.r = NSEEL_VM_regvar(vm, "r");
+        c->vars.alpha = NSEEL_VM_regvar(vm, "alpha");
+        m_nclones++; // so freeClones() gets it either way
+        if (!AVS_EEL_IF_MakeClone(&c->eel, AVS_EEL_CONTEXTNAME, effect_exp[0].get()))
+            return 0;
+    }
+    return 1;
+}
 
-                xc_pos += xc_dpos;
+void C_THISCLASS::freeClones()
+{
+    int x;
+    for (x = 0; x < m_nclones; x++)
+        AVS_EEL_IF_FreeClone(&m_clones[x].eel);
+    memset(m_clones, 0, sizeof(m_clones));
+    m_nclones = 0;
+}
 
-                *var_x = xd * xsc;
-                *var_y = yd * ysc;
-                *var_d = sqrt(xd * xd + yd * yd) * divmax_d;
-                *var_r = atan2(yd, xd) + M_PI * 0.5;
+void C_THISCLASS::evalProc(void* ctx, int task, int ntasks)
+{
+    C_THISCLASS* t = (C_THISCLASS*)ctx;
+    int y0 = (t->YRES * task) / ntasks;
+    int y1 = (t->YRES * (task + 1)) / ntasks;
+    if (!task) {
+        dmoveVars v = { t->var_x, t->var_y, t->var_d, t->var_r, t->var_alpha };
+        t->evalRows(t->codehandle[0], &v, y0, y1);
+    } else
+        t->evalRows(t->m_clones[task - 1].eel.code, &t->m_clones[task - 1].vars, y0, y1);
+}
 
-                executeCode(codehandle[0], visdata);
+// fills rows [y0, y1) of the grid in m_tab. call between
+// AVS_EEL_IF_BeginExecute() and AVS_EEL_IF_EndExecute()
+void C_THISCLASS::evalRows(intptr_t code, dmoveVars* vars, int y0, int y1)
+{
+    int x;
+    int y;
+    int w = m_lastw, h = m_lasth;
+    int* tabptr = m_tab + y0 * XRES * 3;
+
+    double xsc = 2.0 / w, ysc = 2.0 / h;
+    double dw2 = ((double)w * 32768.0);
+    double dh2 = ((double)h * 32768.0);
+    double max_screen_d = sqrt((double)(w * w + h * h)) * 0.5;
+
+    double divmax_d = 1.0 / max_screen_d;
+
+    max_screen_d *= 65536.0;
+
+    int yc_pos, yc_dpos, xc_pos, xc_dpos;
+    xc_dpos = (w << 16) / (XRES - 1);
+    yc_dpos = (h << 16) / (YRES - 1);
+    yc_pos = y0 * yc_dpos;
+    // a row of the grid per NSEEL_code_execute_batch(); alpha carries over
+    // from point to point unless the code assigns it
+    double px[256], py[256], pd[256], pr[256], palpha[256];
+    NSEEL_LANEVAR lanes[] = {
+        { vars->x, px, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { vars->y, py, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { vars->d, pd, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { vars->r, pr, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { vars->alpha, palpha, NSEEL_LANE_OUT },
+    };
+    for (y = y0; y < y1; y++) {
+        xc_pos = 0;
+        for (x = 0; x < XRES; x++) {
+            double xd, yd;
+
+            xd = ((double)xc_pos - dw2) * (1.0 / 65536.0);
+            yd = ((double)yc_pos - dh2) * (1.0 / 65536.0);
+
+            xc_pos += xc_dpos;
+
+            px[x] = xd * xsc;
+            py[x] = yd * ysc;
+            pd[x] = sqrt(xd * xd + yd * yd) * divmax_d;
+            pr[x] = atan2(yd, xd) + M_PI * 0.5;
+        }
 
-                int tmp1, tmp2;
-                if (!__rectcoords) {
-                    *var_d *= max_screen_d;
-                    *var_r -= M_PI * 0.5;
-                    tmp1 = (int)(dw2 + cos(*var_r) * *var_d);
-                    tmp2 = (int)(dh2 + sin(*var_r) * *var_d);
-                } else {
-                    tmp1 = (int)((*var_x + 1.0) * dw2);
-                    tmp2 = (int)((*var_y + 1.0) * dh2);
-                }
-                if (!__wrap) {
-                    if (tmp1 < 0)
-                        tmp1 = 0;
-                    if (tmp1 > w_adj)
-                        tmp1 = w_adj;
-                    if (tmp2 < 0)
-                        tmp2 = 0;
-                    if (tmp2 > h_adj)
-                        tmp2 = h_adj;
-                }
-                *tabptr++ = tmp1;
-                *tabptr++ = tmp2;
-                double va = *var_alpha;
-                if (va < 0.0)
-                    va = 0.0;
-                else if (va > 1.0)
-                    va = 1.0;
-                int a = (int)(va * 255.0 * 65536.0);
-                *tabptr++ = a;
+        NSEEL_code_execute_batch((NSEEL_CODEHANDLE)code, lanes, sizeof(lanes) / sizeof(lanes[0]), XRES);
+
+        for (x = 0; x < XRES; x++) {
+            int tmp1, tmp2;
+            if (!__rectcoords) {
+                double d = pd[x] * max_screen_d;
+                double r = pr[x] - M_PI * 0.5;
+                tmp1 = (int)(dw2 + cos(r) * d);
+                tmp2 = (int)(dh2 + sin(r) * d);
+            } else {
+                tmp1 = (int)((px[x] + 1.0) * dw2);
+                tmp2 = (int)((py[x] + 1.0) * dh2);
             }
-            yc_pos += yc_dpos;
+            if (!__wrap) {
+                if (tmp1 < 0)
+                    tmp1 = 0;
+                if (tmp1 > w_adj)
+                    tmp1 = w_adj;
+                if (tmp2 < 0)
+                    tmp2 = 0;
+                if (tmp2 > h_adj)
+                    tmp2 = h_adj;
+            }
+            *tabptr++ = tmp1;
+            *tabptr++ = tmp2;
+            double va = palpha[x];
+            if (va < 0.0)
+                va = 0.0;
+            else if (va > 1.0)
+                va = 1.0;
+            int a = (int)(va * 255.0 * 65536.0);
+            *tabptr++ = a;
         }
+        yc_pos += yc_dpos;
     }
+}
 
-    return max_threads;
+// subpixel sampling of one span of a grid cell: the walk is a straight line
+// between the points where it wraps or gets clamped, and each of those runs
+// goes through the line sampler
+static void subpixel_span(unsigned int* out, unsigned int* in, int w, int xp, int yp, int d_x, int d_y, int seek, int w_adj, int h_adj, int wrap)
+{
+    while (seek > 0) {
+        int n, yn;
+        if (wrap) {
+            if (xp < 0)
+                xp += w_adj;
+            else if (xp >= w_adj)
+                xp -= w_adj;
+            if (yp < 0)
+                yp += h_adj;
+            else if (yp >= h_adj)
+                yp -= h_adj;
+        } else {
+            if (xp < 0)
+                xp = 0;
+            else if (xp >= w_adj)
+                xp = w_adj - 1;
+            if (yp < 0)
+                yp = 0;
+            else if (yp >= h_adj)
+                yp = h_adj - 1;
+        }
+        n = blend4_line_run(xp, d_x, w_adj);
+        yn = blend4_line_run(yp, d_y, h_adj);
+        if (n > yn)
+            n = yn;
+        if (n > seek)
+            n = seek;
+        blend4_16_line_block((int*)out, (const int*)in, w, xp, yp, d_x, d_y, n);
+        out += n;
+        xp += n * d_x;
+        yp += n * d_y;
+        seek -= n;
+    }
 }
 
 void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
@@ -572,14 +745,20 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
 
 #endif
 
-#define LOOPS(DO)                                                                                                                 \
-    if (__blend && __subpixel)                                                                                                    \
-        DO(CHECK* out++ = BLEND_ADJ(BLEND4_16(in + (xp >> 16) + (m_wmul[yp >> 16]), w, xp, yp), *blendin++, ap >> 16); ap += d_a) \
-    else if (__blend)                                                                                                             \
-        DO(CHECK* out++ = BLEND_ADJ(in[(xp >> 16) + (m_wmul[yp >> 16])], *blendin++, ap >> 16); ap += d_a)                        \
-    else if (__subpixel)                                                                                                          \
-        DO(CHECK* out++ = BLEND4_16(in + (xp >> 16) + (m_wmul[yp >> 16]), w, xp, yp))                                             \
-    else                                                                                                                          \
+#define LOOPS(DO)                                                                                          \
+    if (__subpixel) {                                                                                      \
+        subpixel_span(out, in, w, xp, yp, d_x, d_y, seek, w_adj, h_adj, __wrap);                          \
+        if (__blend) {                                                                                     \
+            while (seek--) {                                                                               \
+                *out = BLEND_ADJ(*out, *blendin++, ap >> 16);                                              \
+                out++;                                                                                     \
+                ap += d_a;                                                                                 \
+            }                                                                                              \
+        } else                                                                                             \
+            out += seek;                                                                                   \
+    } else if (__blend)                                                                                    \
+        DO(CHECK* out++ = BLEND_ADJ(in[(xp >> 16) + (m_wmul[yp >> 16])], *blendin++, ap >> 16); ap += d_a) \
+    else                                                                                                   \
         DO(CHECK* out++ = in[(xp >> 16) + (m_wmul[yp >> 16])])
 
                                 if (__nomove) {
@@ -699,13 +878,13 @@ static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
         if (g_this->nomove)
             CheckDlgButton(hwndDlg, IDC_NOMOVEMENT, BST_CHECKED);
 
-        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (int)"Current");
+        SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM)"Current");
         {
             int i = 0;
             char txt[64];
             for (i = 0; i < NBUF; i++) {
                 wsprintf(txt, "Buffer %d", i + 1);
-                SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (int)txt);
+                SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_ADDSTRING, 0, (LPARAM)txt);
             }
         }
         SendDlgItemMessage(hwndDlg, IDC_COMBO1, CB_SETCURSEL, (WPARAM)g_this->buffern, 0);
@@ -49,7 +49,7 @@ typedef struct {
     int c;
 } FountainPoint;
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
     float r;
     FountainPoint points[NUM_ROT_HEIGHT][NUM_ROT_DIV];
@@ -59,6 +59,7 @@ public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int, int);
+    virtual int get_traits() { return RTRAIT_GLOBAL; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
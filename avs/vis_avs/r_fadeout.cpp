@@ -33,19 +33,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
 #define C_THISCLASS C_FadeOutClass
 #define MOD_NAME "Trans / Fadeout"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return fadelen ? RTRAIT_POINT : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -140,7 +140,6 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
         return 0;
     if (!fadelen)
         return 0;
-    timingEnter(1);
     if (
 #ifdef NO_MMX
         1
@@ -225,7 +224,6 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
         }
     }
 #endif
-    timingLeave(1);
     return 0;
 }
 
@@ -32,19 +32,24 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
 #define C_THISCLASS C_FastBright
 #define MOD_NAME "Trans / Fast Brightness"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_getflags() { return 1; }
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return dir == 0 || dir == 1 ? RTRAIT_POINT | RTRAIT_LUT : RTRAIT_POINT | RTRAIT_NOOP; }
+    virtual void get_lut(unsigned char lut[4][256]);
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -104,15 +109,65 @@ C_THISCLASS::~C_THISCLASS()
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
-    if (isBeat & 0x80000000)
+    if (smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h) < 1)
         return 0;
+
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if ((isBeat & 0x80000000) || (dir != 0 && dir != 1))
+        return 0;
+    return max_threads;
+}
+
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
+{
+    return 0;
+}
+
+// x2 saturates each channel (alpha too in the MMX version, which doubles all
+// four bytes), /2 shifts all four
+void C_THISCLASS::get_lut(unsigned char lut[4][256])
+{
+    int x, c;
+    for (x = 0; x < 256; x++) {
+        for (c = 0; c < 4; c++)
+            lut[c][x] = dir == 1 ? x >> 1 : x < 128 ? x + x : 255;
+#ifdef NO_MMX
+        if (dir == 0)
+            lut[3][x] = x;
+#endif
+    }
+}
+
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (max_threads < 1)
+        max_threads = 1;
+
+    int start_l = (this_thread * h) / max_threads;
+    int end_l;
+
+    if (this_thread >= max_threads - 1)
+        end_l = h;
+    else
+        end_l = ((this_thread + 1) * h) / max_threads;
+
+    int outh = end_l - start_l;
+    if (outh < 1)
+        return;
+
+    framebuffer += start_l * w;
 #ifdef NO_MMX // the non mmx x2 version really isn't any , in terms faster than normal brightness with no exclusions turned on
     {
         unsigned int* t = (unsigned int*)framebuffer;
         int x;
         unsigned int mask = 0x7F7F7F7F;
 
-        x = w * h / 2;
+        x = w * outh / 2;
         if (dir == 0)
             while (x--) {
                 unsigned int v1 = t[0];
@@ -131,13 +186,20 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
                 t[1] = v2 & mask;
                 t += 2;
             }
+        if ((w * outh) & 1) {
+            unsigned int v = t[0];
+            if (dir == 0)
+                t[0] = tab[0][v & 0xff] | tab[1][(v >> 8) & 0xff] | tab[2][(v >> 16) & 0xff] | (v & 0xff000000);
+            else
+                t[0] = (v >> 1) & mask;
+        }
     }
 #else
     int mask[2] = {
         0x7F7F7F7F,
         0x7F7F7F7F,
     };
-    int l = (w * h);
+    int l = (w * outh);
     if (dir == 0)
         __asm {
 			mov edx, l
@@ -240,7 +302,6 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
                                                    _lr3 : emms
         }
 #endif
-    return 0;
 }
 
 C_RBASE* R_FastBright(char* desc)
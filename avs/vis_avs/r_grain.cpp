@@ -28,6 +28,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
@@ -39,12 +40,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Grain"
 #define C_THISCLASS C_GrainClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_POINT | RTRAIT_RANDOM : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -66,7 +68,7 @@ static HINSTANCE g_hDllInstance; // global DLL instance pointer (not needed in t
 C_THISCLASS::~C_THISCLASS() // set up default configuration
 {
     if (depthBuffer)
-        GlobalFree(depthBuffer);
+        fba_free(depthBuffer);
 }
 
 // configuration read/write
@@ -151,8 +153,8 @@ void C_THISCLASS::reinit(int w, int h)
     int x, y;
     unsigned char* p;
     if (depthBuffer)
-        GlobalFree(depthBuffer);
-    depthBuffer = (unsigned char*)GlobalAlloc(GMEM_FIXED, w * h * 2);
+        fba_free(depthBuffer);
+    depthBuffer = (unsigned char*)fba_alloc(w * h * 2, 0);
     p = depthBuffer;
     if (p)
         for (y = 0; y < h; y++)
@@ -39,7 +39,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Interferences"
 #define C_THISCLASS C_InterferencesClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
@@ -47,6 +47,12 @@ public:
     float GET_FLOAT(unsigned char* data, int pos);
     void PUT_FLOAT(float f, unsigned char* data, int pos);
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits()
+    {
+        if (!enabled || !nPoints)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return RTRAIT_GLOBAL | (!blend && !blendavg ? RTRAIT_FBOUT : 0);
+    }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -39,12 +39,25 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Invert"
 #define C_THISCLASS C_InvertClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_getflags() { return 1; }
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return enabled ? RTRAIT_POINT | RTRAIT_LUT : RTRAIT_POINT | RTRAIT_NOOP; }
+    virtual void get_lut(unsigned char lut[4][256])
+    {
+        int x;
+        for (x = 0; x < 256; x++) {
+            lut[0][x] = lut[1][x] = lut[2][x] = 255 - x;
+            lut[3][x] = x;
+        }
+    }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -98,13 +111,44 @@ int C_THISCLASS::save_config(unsigned char* data) // write configuration to data
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
-    int i = w * h;
-    int* p = framebuffer;
-
-    if (isBeat & 0x80000000)
+    if (smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h) < 1)
         return 0;
-    if (!enabled)
+
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if ((isBeat & 0x80000000) || !enabled)
         return 0;
+    return max_threads;
+}
+
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h) // return value is that of render() for fbstuff etc
+{
+    return 0;
+}
+
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (max_threads < 1)
+        max_threads = 1;
+
+    int start_l = (this_thread * h) / max_threads;
+    int end_l;
+
+    if (this_thread >= max_threads - 1)
+        end_l = h;
+    else
+        end_l = ((this_thread + 1) * h) / max_threads;
+
+    int outh = end_l - start_l;
+    if (outh < 1)
+        return;
+
+    int i = w * outh;
+    int* p = framebuffer + start_l * w;
 
 #ifndef NO_MMX
     int a[2] = { 0xffffff, 0xffffff };
@@ -149,7 +193,6 @@ _mmx_invert_noendloop:
     while (i--)
         *p++ = 0xFFFFFF ^ *p;
 #endif
-    return 0;
 }
 
 // configuration dialog stuff
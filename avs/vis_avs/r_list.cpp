@@ -29,15 +29,20 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "r_list.h"
 #include "../../platform_shim.h"
+#include "color_lut.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "r_unkn.h"
 #include "render.h"
 #include "resource.h"
+#include "smp_pool.h"
 #include "undo.h"
 #include <commctrl.h>
 #include <stdio.h>
+#include <vector>
 
 #include "avs_eelif.h"
+#include "profiler.h"
 
 #define PUT_INT(y)                   \
     data[pos] = (y) & 255;           \
@@ -54,7 +59,8 @@ char* C_RenderListClass::get_desc()
 }
 
 int g_config_seh = 1;
-extern int g_config_smp_mt, g_config_smp;
+extern int g_config_smp_mt, g_config_smp, g_config_tiles;
+C_RenderProbe* g_render_probe;
 
 static char extsigstr[] = "AVS 2.8+ Effect List Config";
 
@@ -129,7 +135,7 @@ void C_RenderListClass::load_config(unsigned char* data, int len)
                 break;
             memcpy(s, data + pos, 32);
             s[32] = 0;
-            t.effect_index = (int)s;
+            t.effect_index = (intptr_t)s;
             pos += 32;
         }
         if (pos + 4 > len)
@@ -211,7 +217,7 @@ int C_RenderListClass::save_config_ex(unsigned char* data, int rootsave)
 
     for (x = 0; x < num_renders; x++) {
         int t;
-        int idx = renders[x].effect_index;
+        intptr_t idx = renders[x].effect_index;
         if (idx == UNKN_ID) {
             C_UnknClass* r = (C_UnknClass*)renders[x].render;
             if (!r->idString[0]) {
@@ -281,6 +287,11 @@ C_RenderListClass::C_RenderListClass(int iroot)
     beat_render = 0;
     beat_render_frames = 1;
     fake_enabled = 0;
+    scale_fb[0] = scale_fb[1] = NULL;
+    scale_w = scale_h = 0;
+    scale_busy = 0;
+    scale_last = 1.0;
+    rscale_ctl_init(&scale_ctl, g_render_scale_budget_ms);
 #ifdef LASER
     if (!iroot)
         line_save = createLineList();
@@ -329,24 +340,7 @@ void C_RenderListClass::unset_n_Context()
 
 void C_RenderListClass::smp_cleanupthreads()
 {
-
-    if (smp_parms.threadTop > 0) {
-        if (smp_parms.hQuitHandle)
-            SetEvent(smp_parms.hQuitHandle);
-
-        WaitForMultipleObjects(smp_parms.threadTop, smp_parms.hThreads, TRUE, INFINITE);
-        int x;
-        for (x = 0; x < smp_parms.threadTop; x++) {
-            CloseHandle(smp_parms.hThreads[x]);
-            CloseHandle(smp_parms.hThreadSignalsDone[x]);
-            CloseHandle(smp_parms.hThreadSignalsStart[x]);
-        }
-    }
-
-    if (smp_parms.hQuitHandle)
-        CloseHandle(smp_parms.hQuitHandle);
-
-    memset(&smp_parms, 0, sizeof(smp_parms));
+    C_SmpPool::shutdown();
 }
 
 void C_RenderListClass::freeBuffers()
@@ -356,7 +350,7 @@ void C_RenderListClass::freeBuffers()
         int x;
         for (x = 0; x < NBUF; x++) {
             if (nb_save[x])
-                GlobalFree(nb_save[x]);
+                fba_free(nb_save[x]);
             nb_save[x] = NULL;
             nbw_save[x] = nbh_save[x] = 0;
         }
@@ -374,6 +368,7 @@ C_RenderListClass::~C_RenderListClass()
 
     // free nb_save
     freeBuffers();
+    free_scale_buffers();
 
     int x;
     for (x = 0; x < 2; x++) {
@@ -390,10 +385,94 @@ static int __inline depthof(int c, int i)
     return i ? 255 - r : r;
 }
 
+void C_RenderListClass::free_scale_buffers()
+{
+    int x;
+    for (x = 0; x < 2; x++) {
+        if (scale_fb[x])
+            fba_free(scale_fb[x]);
+        scale_fb[x] = NULL;
+    }
+    scale_w = scale_h = 0;
+}
+
+// the root's chain at a reduced size: it renders into its own pair of
+// buffers, which persist across frames the way the host's do at full size,
+// and the current one is stretched onto framebuffer
+int C_RenderListClass::render_scaled(int setting, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    int is_preinit = (isBeat & 0x80000000);
+    double scale = setting == RSCALE_AUTO ? scale_ctl.scale : rscale_factor(setting);
+    int sw, sh, t;
+    uint64_t start;
+    rscale_size(w, h, scale, &sw, &sh);
+
+    if (sw == w && sh == h) {
+        // back at full size; framebuffer already holds the last frame
+        free_scale_buffers();
+        start = prof_now_ns();
+        scale_busy = 1;
+        t = render(visdata, isBeat, framebuffer, fbout, w, h);
+        scale_busy = 0;
+    } else {
+        if (sw != scale_w || sh != scale_h || !scale_fb[0]) {
+            // carry the image over, from the old scaled buffer or the full one
+            int* nfb[2];
+            nfb[0] = (int*)fba_alloc(sw * sh * sizeof(int), 0);
+            nfb[1] = (int*)fba_alloc(sw * sh * sizeof(int), 1);
+            if (!nfb[0] || !nfb[1]) {
+                if (nfb[0])
+                    fba_free(nfb[0]);
+                if (nfb[1])
+                    fba_free(nfb[1]);
+                scale_busy = 1;
+                t = render(visdata, isBeat, framebuffer, fbout, w, h);
+                scale_busy = 0;
+                return t;
+            }
+            if (scale_fb[0])
+                rscale_resize(nfb[0], sw, sh, scale_fb[0], scale_w, scale_h);
+            else
+                rscale_resize(nfb[0], sw, sh, framebuffer, w, h);
+            free_scale_buffers();
+            scale_fb[0] = nfb[0];
+            scale_fb[1] = nfb[1];
+            scale_w = sw;
+            scale_h = sh;
+        }
+        start = prof_now_ns();
+        scale_busy = 1;
+        if (render(visdata, isBeat, scale_fb[0], scale_fb[1], sw, sh) & 1) {
+            int* p = scale_fb[0];
+            scale_fb[0] = scale_fb[1];
+            scale_fb[1] = p;
+        }
+        scale_busy = 0;
+        if (!is_preinit) {
+            PROF_ZONE("upscale");
+            rscale_resize(framebuffer, w, h, scale_fb[0], sw, sh);
+        }
+        t = 0;
+    }
+    scale_last = (double)sw / w;
+    if (setting == RSCALE_AUTO && !is_preinit) {
+        scale_ctl.budget_ms = g_render_scale_budget_ms;
+        rscale_ctl_update(&scale_ctl, (prof_now_ns() - start) / 1e6);
+    }
+    return t;
+}
+
 int C_RenderListClass::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     int is_preinit = (isBeat & 0x80000000);
 
+    if (isroot && !scale_busy) {
+        int setting = g_render_scale >= 0 ? g_render_scale : render_scale();
+        if (setting != RSCALE_FULL || scale_fb[0])
+            return render_scaled(setting, visdata, isBeat, framebuffer, fbout, w, h);
+        scale_last = 1.0;
+    }
+
     if (isBeat && beat_render)
         fake_enabled = beat_render_frames;
 
@@ -470,7 +549,7 @@ int C_RenderListClass::render(char visdata[2][2][576], int isBeat, int* framebuf
 #ifndef LASER
         int line_blend_mode_save = g_line_blend_mode;
         if (thisfb)
-            GlobalFree((HGLOBAL)thisfb);
+            fba_free(thisfb);
         thisfb = NULL;
         if (use_clear && (isroot || blendin() != 1))
             memset(framebuffer, 0, w * h * sizeof(int));
@@ -490,19 +569,32 @@ int C_RenderListClass::render(char visdata[2][2][576], int isBeat, int* framebuf
             int t = 0;
             int smp_max_threads;
             C_RBASE2* rb2;
-
-            if (renders[x].has_rbase2 && (smp_max_threads = g_config_smp ? g_config_smp_mt : 0) > 1 && ((rb2 = (C_RBASE2*)renders[x].render)->smp_getflags() & 1)) {
-                if (smp_max_threads > MAX_SMP_THREADS)
-                    smp_max_threads = MAX_SMP_THREADS;
-
-                int nt = smp_max_threads;
-                nt = rb2->smp_begin(nt, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
+            C_RenderProbe* probe = g_render_probe;
+            int prof = prof_enabled();
+            int tile_threads = g_config_smp && g_config_smp_mt > 1 ? g_config_smp_mt : 1;
+            int ntile;
+            if (traits(x) & RTRAIT_NOOP)
+                continue;
+            if (!is_preinit && g_config_tiles && (ntile = tile_run(x, tile_threads)) > 1) {
+                x += render_tiles(x, ntile, visdata, &isBeat, framebuffer, fbout, w, h, &s, tile_threads) - 1;
+                continue;
+            }
+            if (probe)
+                probe->enter(renders[x].render, x);
+            if (prof)
+                prof_begin(renders[x].render->get_desc(), renders[x].render, x);
+            if (renders[x].has_rbase2 & 2)
+                ((C_RBASE3*)renders[x].render)->set_visdata_ex(visdata_ex_for(visdata));
+
+            if ((renders[x].has_rbase2 & 1) && (smp_max_threads = g_config_smp ? g_config_smp_mt : 0) > 1 && ((rb2 = (C_RBASE2*)renders[x].render)->smp_getflags() & 1)) {
+                int nslices = smp_getslices(smp_max_threads, h);
+                int nt = rb2->smp_begin(nslices, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
                 if (!is_preinit && nt > 0) {
-                    if (nt > smp_max_threads)
-                        nt = smp_max_threads;
+                    if (nt > nslices)
+                        nt = nslices;
 
                     // launch threads
-                    smp_Render(nt, rb2, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
+                    smp_Render(smp_max_threads, nt, rb2, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
 
                     t = rb2->smp_finish(visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
                 }
@@ -518,6 +610,10 @@ int C_RenderListClass::render(char visdata[2][2][576], int isBeat, int* framebuf
                     t = renders[x].render->render(visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
                 }
             }
+            if (prof)
+                prof_end();
+            if (probe)
+                probe->leave(renders[x].render, x);
 
             if (t & 1)
                 s ^= 1;
@@ -553,7 +649,7 @@ int C_RenderListClass::render(char visdata[2][2][576], int isBeat, int* framebuf
 // check to see if we're enabled
 if (!use_enabled) {
     if (thisfb)
-        GlobalFree((HGLOBAL)thisfb);
+        fba_free(thisfb);
     thisfb = NULL;
     return 0;
 }
@@ -565,7 +661,7 @@ if (l_w != w || l_h != h || !thisfb) {
     extern int config_reuseonresize;
     int do_resize = config_reuseonresize && !!thisfb && l_w && l_h && !use_clear;
 
-    int* newfb = (int*)GlobalAlloc(do_resize ? GMEM_FIXED : GPTR, w * h * sizeof(int));
+    int* newfb = (int*)fba_alloc(w * h * sizeof(int), !do_resize);
     if (newfb && do_resize) {
         int x, y;
         int dxpos = (l_w << 16) / w;
@@ -585,7 +681,7 @@ if (l_w != w || l_h != h || !thisfb) {
     l_w = w;
     l_h = h;
     if (thisfb)
-        GlobalFree((HGLOBAL)thisfb);
+        fba_free(thisfb);
     thisfb = newfb;
 }
 // handle clear mode
@@ -611,25 +707,16 @@ if (!is_preinit) {
         mmx_avgblend_block(o, tfb, x);
         break;
     case 3:
-        while (x--) {
-            *o = BLEND_MAX(*o, *tfb++);
-            o++;
-        }
+        blend_max_block(o, o, tfb, x);
         break;
     case 4:
         mmx_addblend_block(o, tfb, x);
         break;
     case 5:
-        while (x--) {
-            *o = BLEND_SUB(*o, *tfb++);
-            o++;
-        }
+        blend_sub_block(o, o, tfb, x);
         break;
     case 6:
-        while (x--) {
-            *o = BLEND_SUB(*tfb++, *o);
-            o++;
-        }
+        blend_sub_block(o, tfb, o, x);
         break;
     case 7: {
         int y = h / 2;
@@ -658,10 +745,7 @@ if (!is_preinit) {
         }
     } break;
     case 9:
-        while (x--) {
-            *o = *o ^ *tfb++;
-            o++;
-        }
+        blend_xor_block(o, o, tfb, x);
         break;
     case 10:
         mmx_adjblend_block(o, tfb, o, x, use_inblendval);
@@ -670,10 +754,7 @@ if (!is_preinit) {
         mmx_mulblend_block(o, tfb, x);
         break;
     case 13:
-        while (x--) {
-            *o = BLEND_MIN(*o, *tfb++);
-            o++;
-        }
+        blend_min_block(o, o, tfb, x);
         break;
     case 12: {
         int* buf = (int*)getGlobalBuffer(w, h, bufferin, 0);
@@ -706,19 +787,32 @@ for (x = 0; x < num_renders; x++) {
 
     int smp_max_threads;
     C_RBASE2* rb2;
-
-    if (renders[x].has_rbase2 && (smp_max_threads = g_config_smp ? g_config_smp_mt : 0) > 1 && ((rb2 = (C_RBASE2*)renders[x].render)->smp_getflags() & 1)) {
-        if (smp_max_threads > MAX_SMP_THREADS)
-            smp_max_threads = MAX_SMP_THREADS;
-
-        int nt = smp_max_threads;
-        nt = rb2->smp_begin(nt, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
+    C_RenderProbe* probe = g_render_probe;
+    int prof = prof_enabled();
+    int tile_threads = g_config_smp && g_config_smp_mt > 1 ? g_config_smp_mt : 1;
+    int ntile;
+    if (traits(x) & RTRAIT_NOOP)
+        continue;
+    if (!is_preinit && g_config_tiles && (ntile = tile_run(x, tile_threads)) > 1) {
+        x += render_tiles(x, ntile, visdata, &isBeat, thisfb, fbout, w, h, &s, tile_threads) - 1;
+        continue;
+    }
+    if (probe)
+        probe->enter(renders[x].render, x);
+    if (prof)
+        prof_begin(renders[x].render->get_desc(), renders[x].render, x);
+    if (renders[x].has_rbase2 & 2)
+        ((C_RBASE3*)renders[x].render)->set_visdata_ex(visdata_ex_for(visdata));
+
+    if ((renders[x].has_rbase2 & 1) && (smp_max_threads = g_config_smp ? g_config_smp_mt : 0) > 1 && ((rb2 = (C_RBASE2*)renders[x].render)->smp_getflags() & 1)) {
+        int nslices = smp_getslices(smp_max_threads, h);
+        int nt = rb2->smp_begin(nslices, visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
         if (!is_preinit && nt > 0) {
-            if (nt > smp_max_threads)
-                nt = smp_max_threads;
+            if (nt > nslices)
+                nt = nslices;
 
             // launch threads
-            smp_Render(nt, rb2, visdata, isBeat, s ? fbout : thisfb, s ? thisfb : fbout, w, h);
+            smp_Render(smp_max_threads, nt, rb2, visdata, isBeat, s ? fbout : thisfb, s ? thisfb : fbout, w, h);
 
             t = rb2->smp_finish(visdata, isBeat, s ? fbout : framebuffer, s ? framebuffer : fbout, w, h);
         }
@@ -732,6 +826,10 @@ for (x = 0; x < num_renders; x++) {
     } else {
         t = renders[x].render->render(visdata, isBeat, s ? fbout : thisfb, s ? thisfb : fbout, w, h);
     }
+    if (prof)
+        prof_end();
+    if (probe)
+        probe->leave(renders[x].render, x);
 
     if (t & 1)
         s ^= 1;
@@ -771,25 +869,16 @@ if (!is_preinit) {
         mmx_avgblend_block(o, tfb, x);
         break;
     case 3:
-        while (x--) {
-            *o = BLEND_MAX(*o, *tfb++);
-            o++;
-        }
+        blend_max_block(o, o, tfb, x);
         break;
     case 4:
         mmx_addblend_block(o, tfb, x);
         break;
     case 5:
-        while (x--) {
-            *o = BLEND_SUB(*o, *tfb++);
-            o++;
-        }
+        blend_sub_block(o, o, tfb, x);
         break;
     case 6:
-        while (x--) {
-            *o = BLEND_SUB(*tfb++, *o);
-            o++;
-        }
+        blend_sub_block(o, tfb, o, x);
         break;
     case 7: {
         int y = h / 2;
@@ -818,10 +907,7 @@ if (!is_preinit) {
         }
     } break;
     case 9:
-        while (x--) {
-            *o = *o ^ *tfb++;
-            o++;
-        }
+        blend_xor_block(o, o, tfb, x);
         break;
     case 10:
         mmx_adjblend_block(o, tfb, o, x, use_outblendval);
@@ -830,10 +916,7 @@ if (!is_preinit) {
         mmx_mulblend_block(o, tfb, x);
         break;
     case 13:
-        while (x--) {
-            *o = BLEND_MIN(*o, *tfb++);
-            o++;
-        }
+        blend_min_block(o, o, tfb, x);
         break;
     case 12: {
         int* buf = (int*)getGlobalBuffer(w, h, bufferout, 0);
@@ -924,7 +1007,7 @@ void C_RenderListClass::clearRenders(void)
     num_renders_alloc = 0;
     renders = NULL;
     if (thisfb)
-        GlobalFree((HGLOBAL)thisfb);
+        fba_free(thisfb);
     thisfb = 0;
 }
 
@@ -974,7 +1057,7 @@ void C_RenderListClass::FillBufferCombo(HWND dlg, int ctl)
     char txt[64];
     for (i = 0; i < NBUF; i++) {
         wsprintf(txt, "Buffer %d", i + 1);
-        SendDlgItemMessage(dlg, ctl, CB_ADDSTRING, 0, (int)txt);
+        SendDlgItemMessage(dlg, ctl, CB_ADDSTRING, 0, (LPARAM)txt);
     }
 }
 
@@ -1005,8 +1088,13 @@ BOOL CALLBACK C_RenderListClass::g_DlgProcRoot(HWND hwndDlg, UINT uMsg, WPARAM w
 #endif
         {
 #ifndef LASER
+            static char* scales[] = { "Full size", "75%", "50%", "Automatic (frame time)" };
+            int x;
             if (g_this->clearfb())
                 CheckDlgButton(hwndDlg, IDC_CHECK1, BST_CHECKED);
+            for (x = 0; x < sizeof(scales) / sizeof(scales[0]); x++)
+                SendDlgItemMessage(hwndDlg, IDC_RSCALE, CB_ADDSTRING, 0, (LPARAM)scales[x]);
+            SendDlgItemMessage(hwndDlg, IDC_RSCALE, CB_SETCURSEL, (WPARAM)g_this->render_scale(), 0);
 #endif
         }
         return 1;
@@ -1015,6 +1103,13 @@ BOOL CALLBACK C_RenderListClass::g_DlgProcRoot(HWND hwndDlg, UINT uMsg, WPARAM w
         case IDC_CHECK1:
             g_this->set_clearfb(IsDlgButtonChecked(hwndDlg, IDC_CHECK1));
             break;
+        case IDC_RSCALE:
+            if (HIWORD(wParam) == CBN_SELCHANGE) {
+                int r = SendDlgItemMessage(hwndDlg, IDC_RSCALE, CB_GETCURSEL, 0, 0);
+                if (r != CB_ERR)
+                    g_this->set_render_scale(r);
+            }
+            break;
         }
         break;
     }
@@ -1305,48 +1400,225 @@ int C_RenderListClass::__LoadPresetFromUndo(C_UndoItem& item, int clear)
 
 /// smp fun
 
-void C_RenderListClass::smp_Render(int minthreads, C_RBASE2* render, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+int C_RenderListClass::smp_getslices(int nthreads, int h)
 {
-    int x;
-    smp_parms.nthreads = minthreads;
-    if (!smp_parms.hQuitHandle)
-        smp_parms.hQuitHandle = CreateEvent(NULL, TRUE, FALSE, NULL);
-
-    smp_parms.vis_data_ptr = visdata;
-    smp_parms.isBeat = isBeat;
-    smp_parms.framebuffer = framebuffer;
-    smp_parms.fbout = fbout;
-    smp_parms.w = w;
-    smp_parms.h = h;
-    smp_parms.render = render;
-    for (x = 0; x < minthreads; x++) {
-        if (x >= smp_parms.threadTop) {
-            DWORD id;
-            smp_parms.hThreadSignalsStart[x] = CreateEvent(NULL, FALSE, TRUE, NULL);
-            smp_parms.hThreadSignalsDone[x] = CreateEvent(NULL, FALSE, FALSE, NULL);
-
-            smp_parms.hThreads[x] = CreateThread(NULL, 0, smp_threadProc, (LPVOID)(x), 0, &id);
-            smp_parms.threadTop = x + 1;
-        } else
-            SetEvent(smp_parms.hThreadSignalsStart[x]);
+    int nslices = nthreads * SMP_SLICES_PER_THREAD;
+    if (nslices > h / SMP_MIN_SLICE_LINES)
+        nslices = h / SMP_MIN_SLICE_LINES;
+    if (nslices < nthreads)
+        nslices = nthreads;
+    return nslices;
+}
+
+void C_RenderListClass::smp_Render(int nthreads, int nslices, C_RBASE2* render, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    _s_smp_parms parms;
+    parms.vis_data_ptr = visdata;
+    parms.isBeat = isBeat;
+    parms.framebuffer = framebuffer;
+    parms.fbout = fbout;
+    parms.w = w;
+    parms.h = h;
+    parms.render = render;
+    C_SmpPool::get()->run(nthreads, nslices, smp_sliceProc, &parms);
+}
+
+void C_RenderListClass::smp_sliceProc(void* parm, int slice, int nslices)
+{
+    _s_smp_parms* p = (_s_smp_parms*)parm;
+    p->render->smp_render(slice, nslices, *(char (*)[2][2][576])p->vis_data_ptr,
+        p->isBeat, p->framebuffer, p->fbout, p->w, p->h);
+}
+
+/// tiles
+
+// renders[x]'s traits, RTRAIT_GLOBAL for effects that can't tell
+int C_RenderListClass::traits(int x)
+{
+    if (!(renders[x].has_rbase2 & 4))
+        return RTRAIT_GLOBAL;
+    return ((C_RBASE2*)renders[x].render)->get_traits();
+}
+
+// how many effects from x on can share tiles: local SMP effects, and no-ops
+// between them. with more than one thread only halo-free ones qualify, since
+// effects with a halo make the tiles go in order on this thread. an effect
+// that can change isBeat ends the run, as the smp_begin() calls after it
+// would not see the change
+int C_RenderListClass::tile_run(int x, int nthreads)
+{
+    int n;
+    for (n = 0; n < SMP_TILE_MAX_RUN && x + n < num_renders; n++) {
+        int t = traits(x + n);
+        if (t & RTRAIT_NOOP)
+            continue;
+        if (!(renders[x + n].has_rbase2 & 1) || !(((C_RBASE2*)renders[x + n].render)->smp_getflags() & 1))
+            break;
+        if (RTRAIT_SPATIAL(t) == RTRAIT_GLOBAL || (nthreads > 1 && RTRAIT_HALO(t)))
+            break;
+        if (t & RTRAIT_BEAT)
+            return n + 1;
     }
-    WaitForMultipleObjects(smp_parms.nthreads, smp_parms.hThreadSignalsDone, TRUE, INFINITE);
+    return n;
 }
 
-DWORD WINAPI C_RenderListClass::smp_threadProc(LPVOID parm)
+// renders renders[x .. x + n) by tiles of about SMP_TILE_LINES rows. an
+// effect with a halo runs enough tiles behind the one before it that the
+// rows it reads are final, and the effects after it run enough behind it
+// that nothing it still has to read gets overwritten. without halos the
+// tiles are independent and go to the pool. consecutive RTRAIT_LUT effects
+// are composed, each frame after their smp_begin(), into one table the first
+// of them applies (and gets the time of) in a single pass. *s is the side
+// the chain's current frame is on, as in render(); returns n
+int C_RenderListClass::render_tiles(int x, int n, char visdata[2][2][576], int* isBeat, int* framebuffer, int* fbout, int w, int h, int* s, int nthreads)
 {
-    int which = (int)parm;
-    HANDLE hdls[2] = { smp_parms.hThreadSignalsStart[which], smp_parms.hQuitHandle };
-    for (;;) {
-        if (WaitForMultipleObjects(2, hdls, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
-            return 0;
+    _s_tile_effect effects[SMP_TILE_MAX_RUN];
+    unsigned char luts[SMP_TILE_MAX_RUN / 2][4][256];
+    int nluts = 0, head = -1; // the effect a table would fold into
+    _s_tile_parms parms;
+    C_RenderProbe* probe = g_render_probe;
+    int ntiles = h / SMP_TILE_LINES;
+    if (ntiles < 1)
+        ntiles = 1;
+    const int th = h / ntiles; // the shortest tile
+    int k, m = 0, lag = 0, halo_prev = 0, any_halo = 0;
+
+    for (k = 0; k < n; k++) {
+        C_RBASE2* rb2 = (C_RBASE2*)renders[x + k].render;
+        int f = traits(x + k);
+        if (f & RTRAIT_NOOP)
+            continue;
+        int* fb = *s ? fbout : framebuffer;
+        int* ob = *s ? framebuffer : fbout;
+        if (renders[x + k].has_rbase2 & 2)
+            ((C_RBASE3*)rb2)->set_visdata_ex(visdata_ex_for(visdata));
+        if (probe)
+            probe->enter(rb2, x + k);
+        int nt = rb2->smp_begin(ntiles, visdata, *isBeat, fb, ob, w, h);
+        if (probe)
+            probe->leave(rb2, x + k);
+        if (nt <= 0)
+            continue;
+        int halo = (RTRAIT_HALO(f) + th - 1) / th;
+        if (m)
+            lag += halo + halo_prev;
+        halo_prev = halo;
+        any_halo |= halo;
+        effects[m].render = rb2;
+        effects[m].index = x + k;
+        effects[m].framebuffer = fb;
+        effects[m].fbout = ob;
+        effects[m].lag = lag;
+        effects[m].lut = NULL;
+        effects[m].folded = 0;
+        if (!(f & RTRAIT_LUT))
+            head = -1;
+        else if (head < 0)
+            head = m;
+        else {
+            unsigned char next[4][256];
+            if (!effects[head].lut) {
+                effects[head].lut = luts[nluts++];
+                effects[head].render->get_lut(effects[head].lut);
+            }
+            rb2->get_lut(next);
+            clut_then(effects[head].lut, next);
+            effects[m].folded = 1;
+        }
+        m++;
+        if (f & RTRAIT_FBOUT)
+            *s ^= 1;
+    }
 
-        smp_parms.render->smp_render(which, smp_parms.nthreads,
-            *(char (*)[2][2][576])smp_parms.vis_data_ptr,
+    parms.vis_data_ptr = visdata;
+    parms.isBeat = *isBeat;
+    parms.w = w;
+    parms.h = h;
+    parms.ntiles = ntiles;
+    parms.neffects = m;
+    parms.effects = effects;
+    parms.ns = NULL;
+    if (m && !any_halo && nthreads > 1 && ntiles > 1) {
+        if (!probe)
+            C_SmpPool::get()->run(nthreads, ntiles, tile_proc, &parms);
+        else {
+            // each tile times its effects into its own row; the run's wall
+            // time then goes to the effects in proportion to their sums
+            std::vector<uint64_t> ns((size_t)ntiles * m);
+            parms.ns = ns.data();
+            uint64_t t0 = prof_now_ns();
+            C_SmpPool::get()->run(nthreads, ntiles, tile_proc, &parms);
+            double wall_ms = (double)(prof_now_ns() - t0) / 1e6;
+            uint64_t total = 0;
+            for (size_t i = 0; i < ns.size(); i++)
+                total += ns[i];
+            for (k = 0; k < m; k++) {
+                uint64_t sum = 0;
+                int t;
+                for (t = 0; t < ntiles; t++)
+                    sum += ns[(size_t)t * m + k];
+                probe->add(effects[k].render, effects[k].index, total ? wall_ms * (double)sum / (double)total : 0.0);
+            }
+        }
+    } else if (m) {
+        // wavefront: at each step every effect does the tile its lag puts it on
+        int step;
+        for (step = 0; step < ntiles + lag; step++) {
+            for (k = 0; k < m; k++) {
+                int tile = step - effects[k].lag;
+                if (tile < 0 || tile >= ntiles)
+                    continue;
+                if (probe)
+                    probe->enter(effects[k].render, effects[k].index);
+                tile_render(&parms, &effects[k], tile);
+                if (probe)
+                    probe->leave(effects[k].render, effects[k].index);
+            }
+        }
+    }
 
-            smp_parms.isBeat, smp_parms.framebuffer, smp_parms.fbout, smp_parms.w, smp_parms.h);
-        SetEvent(smp_parms.hThreadSignalsDone[which]);
+    for (k = 0; k < m; k++) {
+        int t = effects[k].render->smp_finish(visdata, *isBeat, effects[k].framebuffer, effects[k].fbout, w, h);
+        if (t & 0x10000000)
+            *isBeat = 1;
+        if (t & 0x20000000)
+            *isBeat = 0;
     }
+    return n;
 }
 
-C_RenderListClass::_s_smp_parms C_RenderListClass::smp_parms;
\ No newline at end of file
+void C_RenderListClass::tile_render(_s_tile_parms* p, _s_tile_effect* e, int tile)
+{
+    if (e->folded)
+        return;
+    int prof = prof_enabled();
+    if (prof)
+        prof_begin(e->render->get_desc(), e->render, e->index);
+    if (e->lut) {
+        int start_l = tile * p->h / p->ntiles;
+        int end_l = tile >= p->ntiles - 1 ? p->h : (tile + 1) * p->h / p->ntiles;
+        clut_apply(e->framebuffer + start_l * p->w, (end_l - start_l) * p->w, e->lut);
+    } else
+        e->render->smp_render(tile, p->ntiles, *(char (*)[2][2][576])p->vis_data_ptr,
+            p->isBeat, e->framebuffer, e->fbout, p->w, p->h);
+    if (prof)
+        prof_end();
+}
+
+void C_RenderListClass::tile_proc(void* parm, int tile, int ntiles)
+{
+    _s_tile_parms* p = (_s_tile_parms*)parm;
+    int k;
+    if (p->ns) {
+        uint64_t* row = p->ns + (size_t)tile * p->neffects;
+        uint64_t t = prof_now_ns();
+        for (k = 0; k < p->neffects; k++) {
+            tile_render(p, &p->effects[k], tile);
+            uint64_t now = prof_now_ns();
+            row[k] = now - t;
+            t = now;
+        }
+    } else
+        for (k = 0; k < p->neffects; k++)
+            tile_render(p, &p->effects[k], tile);
+}
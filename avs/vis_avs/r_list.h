@@ -30,7 +30,10 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _R_LIST_H_
 #define _R_LIST_H_
 
-#define LIST_ID 0xfffffffe
+#include "r_defs.h"
+#include "render_scale.h"
+
+#define LIST_ID ((int)0xfffffffe)
 
 extern unsigned char blendtable[256][256];
 extern BOOL blendtableInited;
@@ -38,6 +41,20 @@ extern BOOL blendtableInited;
 class C_RenderTransitionClass;
 class C_UndoItem;
 
+// Watches the effects render lists run: enter() / leave() bracket each child
+// render, and nest when the child is itself a list. index is the child's slot
+// in its list. add() reports a child timed without the bracket: the effects
+// of a tiled run on the pool get the run's wall time split by what each one
+// spent on the threads. Only for hosts that profile the chain (left NULL
+// otherwise).
+class C_RenderProbe {
+public:
+    virtual void enter(C_RBASE* effect, int index) = 0;
+    virtual void leave(C_RBASE* effect, int index) = 0;
+    virtual void add(C_RBASE* effect, int index, double ms) = 0;
+};
+extern C_RenderProbe* g_render_probe;
+
 class C_RenderListClass : public C_RBASE {
     friend C_RenderTransitionClass;
 
@@ -45,8 +62,8 @@ public:
     typedef struct
     {
         C_RBASE* render;
-        int effect_index;
-        int has_rbase2;
+        intptr_t effect_index; // or the idstring of an APE
+        int has_rbase2; // bit 0: C_RBASE2 SMP route, bit 1: C_RBASE3, bit 2: built in (get_traits())
     } T_RenderListType;
 
 protected:
@@ -65,11 +82,11 @@ protected:
     RString effect_exp[2];
 
     int inited;
-    int codehandle[4];
+    intptr_t codehandle[4];
     int need_recompile;
     CRITICAL_SECTION rcs;
 
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_beat, *var_alphain, *var_alphaout, *var_enabled, *var_clear, *var_w, *var_h;
     int isstart;
 
@@ -78,6 +95,16 @@ protected:
     int beat_render, beat_render_frames;
     int fake_enabled;
 
+    // root only: the chain's own framebuffers below full size, current in
+    // [0], and the controller for RSCALE_AUTO
+    int* scale_fb[2];
+    int scale_w, scale_h;
+    int scale_busy;
+    double scale_last;
+    RSCALE_CTL scale_ctl;
+    int render_scaled(int setting, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    void free_scale_buffers();
+
 #ifdef LASER
     C_LineListBase* line_save;
 #else
@@ -92,31 +119,59 @@ protected:
     int nsaved;
 #endif
 
-#define MAX_SMP_THREADS 8
     // smp stuff
-    void smp_Render(int minthreads, C_RBASE2* render, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    // each smp_render call gets a horizontal slice; lists cut the frame into
+    // several slices per thread so the pool can balance uneven per-row cost
+#define SMP_SLICES_PER_THREAD 4
+#define SMP_MIN_SLICE_LINES 16
+    static int smp_getslices(int nthreads, int h);
+    void smp_Render(int nthreads, int nslices, C_RBASE2* render, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     typedef struct
     {
         void* vis_data_ptr;
-        int nthreads;
         int isBeat;
         int* framebuffer;
         int* fbout;
         int w;
         int h;
         C_RBASE2* render;
-
-        HANDLE hQuitHandle;
-        HANDLE hThreads[MAX_SMP_THREADS];
-        HANDLE hThreadSignalsStart[MAX_SMP_THREADS];
-        HANDLE hThreadSignalsDone[MAX_SMP_THREADS];
-
-        int threadTop;
-
     } _s_smp_parms;
 
-    static _s_smp_parms smp_parms;
-    static DWORD WINAPI smp_threadProc(LPVOID parm);
+    static void smp_sliceProc(void* parm, int slice, int nslices);
+
+    // runs of SMP effects whose traits say they are local go through the
+    // frame a band of rows at a time, every effect of the run on a band
+    // while it is still in cache, instead of each effect over the whole frame.
+    // neighbours that are colour tables (RTRAIT_LUT) become one table
+#define SMP_TILE_LINES 64
+#define SMP_TILE_MAX_RUN 64
+    int traits(int x);
+    int tile_run(int x, int nthreads);
+    int render_tiles(int x, int n, char visdata[2][2][576], int* isBeat, int* framebuffer, int* fbout, int w, int h, int* s, int nthreads);
+    typedef struct
+    {
+        C_RBASE2* render;
+        int index;
+        int* framebuffer; // as this effect sees them
+        int* fbout;
+        int lag; // tiles it runs behind the first effect of the run
+        unsigned char (*lut)[256]; // the tables of it and the ones folded into it, NULL to smp_render()
+        int folded; // its table is in an earlier effect's lut
+    } _s_tile_effect;
+    typedef struct
+    {
+        void* vis_data_ptr;
+        int isBeat;
+        int w;
+        int h;
+        int ntiles;
+        int neffects;
+        _s_tile_effect* effects;
+        uint64_t* ns; // [tile * neffects + effect] when a probe watches the pool, else NULL
+    } _s_tile_parms;
+
+    static void tile_render(_s_tile_parms* p, _s_tile_effect* e, int tile);
+    static void tile_proc(void* parm, int tile, int ntiles);
 
 public:
     static void smp_cleanupthreads();
@@ -174,6 +229,16 @@ public:
         mode |= s << 24;
     }
 
+    // root only, RSCALE_*
+    int render_scale() { return (mode >> 2) & 3; }
+    void set_render_scale(int v)
+    {
+        mode &= ~(3 << 2);
+        mode |= (v & 3) << 2;
+    }
+    // output size fraction the root last rendered at
+    double get_scale() { return scale_last; }
+
     int enabled() { return ((mode & 2) ^ 2) || fake_enabled > 0; }
     void set_enabled(int v)
     {
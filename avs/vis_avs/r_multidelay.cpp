@@ -59,13 +59,14 @@ unsigned long framemem;
 unsigned long oldframemem;
 unsigned int renderid;
 
-class C_DELAY : public C_RBASE {
+class C_DELAY : public C_RBASE2 {
 protected:
 public:
     // standard ape members
     C_DELAY();
     virtual ~C_DELAY();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_POINT; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual char* get_desc();
     virtual void load_config(unsigned char* data, int len);
@@ -51,12 +51,13 @@ typedef struct {
     int ml;
 } apeconfig;
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_POINT; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual char* get_desc();
     virtual void load_config(unsigned char* data, int len);
@@ -159,6 +160,19 @@ C_THISCLASS::~C_THISCLASS()
 {
 }
 
+#ifdef NO_MMX
+// each byte (the top one too) times 1 << sh, saturated like paddusb
+static inline unsigned int mul_bytes_sat(unsigned int v, int sh)
+{
+    unsigned int r = 0;
+    for (int i = 0; i < 32; i += 8) {
+        unsigned int t = ((v >> i) & 0xff) << sh;
+        r |= (t > 0xff ? 0xff : t) << i;
+    }
+    return r;
+}
+#endif
+
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (isBeat & 0x80000000)
@@ -168,6 +182,45 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     __int64 mask;
 
     c = w * h;
+#ifdef NO_MMX
+    unsigned int* p = (unsigned int*)framebuffer;
+    switch (config.ml) {
+    case MD_XI:
+        while (c--) {
+            if (*p)
+                *p = 0xFFFFFF;
+            p++;
+        }
+        break;
+    case MD_XS:
+        while (c--) {
+            if (*p != 0xFFFFFF)
+                *p = 0;
+            p++;
+        }
+        break;
+    case MD_X8:
+    case MD_X4:
+    case MD_X2: {
+        int sh = config.ml == MD_X8 ? 3 : config.ml == MD_X4 ? 2 : 1;
+        while (c--) {
+            *p = mul_bytes_sat(*p, sh);
+            p++;
+        }
+    } break;
+    case MD_X05:
+    case MD_X025:
+    case MD_X0125: {
+        int sh = config.ml == MD_X05 ? 1 : config.ml == MD_X025 ? 2 : 3;
+        unsigned int m = (0xff >> sh) * 0x01010101;
+        while (c--) {
+            *p = (*p >> sh) & m;
+            p++;
+        }
+    } break;
+    }
+    return 0;
+#else
     switch (config.ml) {
     case MD_XI:
         __asm {
@@ -319,6 +372,7 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
 end:
     __asm emms;
     return 0;
+#endif
 }
 
 HWND C_THISCLASS::conf(HINSTANCE hInstance, HWND hwndParent)
@@ -38,12 +38,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define C_THISCLASS C_NFClearClass
 #define MOD_NAME "Render / OnBeat Clear"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return nf ? RTRAIT_POINT : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -114,7 +115,11 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
             cf = df = 0;
             int i = w * h;
             int c = color;
-            if (!blend)
+            if (!blend) {
+#ifdef NO_MMX
+                while (i--)
+                    *framebuffer++ = c;
+#else
                 __asm
                 {
 				mov ecx, i
@@ -122,7 +127,8 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
 				mov eax, c
 				rep stosd
                 }
-                else
+#endif
+            } else
                 {
 #ifdef NO_MMX
                     while (i--) {
@@ -38,12 +38,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Render / Picture"
 #define C_THISCLASS C_PictureClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_GLOBAL : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -271,27 +272,21 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
         persistCount--;
 
     int *p, *d;
-    int i, j;
+    int i;
 
     p = fbout;
     d = framebuffer + w * (h - 1);
     if (blend || (adapt && (isBeat || persistCount)))
         for (i = 0; i < h; i++) {
-            for (j = 0; j < w; j++) {
-                *d = BLEND(*p, *d);
-                d++;
-                p++;
-            }
-            d -= w * 2;
+            blend_add_block(d, p, d, w);
+            p += w;
+            d -= w;
         }
     else if (blendavg || adapt)
         for (i = 0; i < h; i++) {
-            for (j = 0; j < w; j++) {
-                *d = BLEND_AVG(*p, *d);
-                d++;
-                p++;
-            }
-            d -= w * 2;
+            blend_avg_block(d, p, d, w);
+            p += w;
+            d -= w;
         }
     else
         for (i = 0; i < h; i++) {
@@ -33,7 +33,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -43,12 +42,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define C_THISCLASS C_RotBlitClass
 #define MOD_NAME "Trans / Roto Blitter"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_FBOUT; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -258,11 +258,35 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     else                                                     \
         DO_LOOP(if (t >= dt) t -= dt; if (s >= ds) s -= ds; Z)
 
-            if (subpixel && blend)
-                DO_LOOPS(*dest++ = BLEND_AVG(*bdest++, BLEND4_16(src + (s >> 16) + w_mul[t >> 16], w, s, t)))
-            else if (subpixel)
-                DO_LOOPS(*dest++ = BLEND4_16(src + (s >> 16) + w_mul[t >> 16], w, s, t))
-            else if (!blend)
+            if (subpixel) {
+                // sample the straight runs between wraps a line at a time
+                while (x > 0) {
+                    int n, tn;
+                    if (s < 0)
+                        s += ds;
+                    else if (s >= ds)
+                        s -= ds;
+                    if (t < 0)
+                        t += dt;
+                    else if (t >= dt)
+                        t -= dt;
+                    n = blend4_line_run(s, ds_dx, ds);
+                    tn = blend4_line_run(t, dt_dx, dt);
+                    if (n > tn)
+                        n = tn;
+                    if (n > x)
+                        n = x;
+                    blend4_16_line_block((int*)dest, (const int*)src, w, s, t, ds_dx, dt_dx, n);
+                    if (blend) {
+                        blend_avg_block((int*)dest, (const int*)bdest, (const int*)dest, n);
+                        bdest += n;
+                    }
+                    dest += n;
+                    s += n * ds_dx;
+                    t += n * dt_dx;
+                    x -= n;
+                }
+            } else if (!blend)
                 DO_LOOPS(*dest++ = src[(s >> 16) + w_mul[t >> 16]])
             else
                 DO_LOOPS(*dest++ = BLEND_AVG(*bdest++, src[(s >> 16) + w_mul[t >> 16]]))
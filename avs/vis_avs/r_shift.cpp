@@ -34,19 +34,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <commctrl.h>
 #include <math.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
 #define C_THISCLASS C_ShiftClass
 #define MOD_NAME "Trans / Dynamic Shift"
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_FBOUT | RTRAIT_EEL; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -56,11 +56,11 @@ public:
     int blend, subpixel;
 
     int m_lastw, m_lasth;
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_x, *var_y, *var_w, *var_h, *var_b, *var_alpha;
     double max_d;
     int inited;
-    int codehandle[3];
+    intptr_t codehandle[3];
     int need_recompile;
     CRITICAL_SECTION rcs;
 };
@@ -32,25 +32,71 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../platform_shim.h"
 #include "avs_eelif.h"
 #include "r_defs.h"
+#include "smp_pool.h"
 #include "resource.h"
 #include <commctrl.h>
 #include <math.h>
 #if 0 // syntax highlighting
 #include "richedit.h"
 #endif
-#include "timing.h"
 
 #define C_THISCLASS C_SScopeClass
 #define MOD_NAME "Render / SuperScope"
 
-class C_THISCLASS : public C_RBASE {
+extern int g_config_smp_mt;
+
+// points evaluated per NSEEL_code_execute_batch() call
+#define SSCOPE_CHUNK 256
+// copies of the VM, for evaluating ranges of points at the same time
+#define SSCOPE_MAX_CLONES 15
+
+typedef struct {
+    double *i, *v, *x, *y, *skip, *red, *green, *blue, *linesize, *drawmode;
+} sscopeVars;
+
+typedef struct {
+    AVS_EEL_CLONE eel;
+    sscopeVars vars;
+} sscopeClone;
+
+#define SSCOPE_PT_SKIP 1
+#define SSCOPE_PT_LINE 2
+
+typedef struct {
+    int x, y;
+#ifdef LASER
+    float fx, fy;
+#endif
+    int color;
+    int linesize;
+    int flags;
+} sscopePoint;
+
+class C_THISCLASS : public C_RBASE3 {
 protected:
     static BOOL CALLBACK g_DlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+    int makeClones(int n);
+    void freeClones();
+    void evalRange(intptr_t code, sscopeVars* v, int a0, int a1);
+    static void evalProc(void* ctx, int task, int ntasks);
+    void drawPoints(int* framebuffer, int w, int h, int row0, int row1);
+
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_GLOBAL | RTRAIT_EEL; }
+
+#ifdef LASER
+    virtual int smp_getflags() { return 0; }
+#else
+    virtual int smp_getflags() { return 1; }
+#endif
+    virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual void set_visdata_ex(const VisDataEx* vd) { m_vis_ex = vd; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -63,13 +109,29 @@ public:
 
     int color_pos;
 
-    int AVS_EEL_CONTEXTNAME;
+    intptr_t AVS_EEL_CONTEXTNAME;
     double *var_b, *var_x, *var_y, *var_i, *var_n, *var_v, *var_w, *var_h, *var_red, *var_green, *var_blue;
     double *var_skip, *var_linesize, *var_drawmode;
     int inited;
-    int codehandle[4];
+    intptr_t codehandle[4];
     int need_recompile;
     CRITICAL_SECTION rcs;
+
+    // smp stuff. points are evaluated in smp_begin(), on copies of the VM
+    // when they don't depend on each other, and every slice then draws all
+    // of them clipped to its rows, so blending happens in the usual order.
+    sscopeClone m_clones[SSCOPE_MAX_CLONES];
+    int m_nclones;
+    sscopePoint* m_points;
+    int m_npoints, m_points_alloc;
+    unsigned char* m_fa_data;
+    int m_xorv, m_w, m_h, m_nranges;
+
+    // with an extended frame, v comes from m_ex_v (already on the -1..1
+    // scale of the byte path) instead of m_fa_data
+    const VisDataEx* m_vis_ex;
+    float m_ex_v[VISDATA_EX_MAX];
+    int m_ex_n;
 };
 
 #define PUT_INT(y)                   \
@@ -159,12 +221,18 @@ C_THISCLASS::C_THISCLASS()
 #endif
 
     need_recompile = 1;
+    m_vis_ex = NULL;
+    m_ex_n = 0;
     which_ch = 2;
     num_colors = 1;
     memset(colors, 0, sizeof(colors));
     colors[0] = RGB(255, 255, 255);
     color_pos = 0;
     memset(codehandle, 0, sizeof(codehandle));
+    memset(m_clones, 0, sizeof(m_clones));
+    m_nclones = 0;
+    m_points = 0;
+    m_npoints = m_points_alloc = 0;
 
 #ifdef LASER
     effect_exp[0].assign("d=i+v*0.2; r=t+i*$PI*4; x=cos(r)*d; y=sin(r)*d");
@@ -188,10 +256,49 @@ C_THISCLASS::~C_THISCLASS()
         freeCode(codehandle[x]);
         codehandle[x] = 0;
     }
+    freeClones();
     AVS_EEL_QUITINST();
+    if (m_points)
+        GlobalFree(m_points);
+    m_points = 0;
     DeleteCriticalSection(&rcs);
 }
 
+// call with rcs held
+int C_THISCLASS::makeClones(int n)
+{
+    while (m_nclones < n) {
+        sscopeClone* c = m_clones + m_nclones;
+        NSEEL_VMCTX vm = NSEEL_VM_alloc();
+        if (!vm)
+            return 0;
+        c->eel.vm = (intptr_t)vm;
+        c->vars.i = NSEEL_VM_regvar(vm, "i");
+        c->vars.v = NSEEL_VM_regvar(vm, "v");
+        c->vars.x = NSEEL_VM_regvar(vm, "x");
+        c->vars.y = NSEEL_VM_regvar(vm, "y");
+        c->vars.skip = NSEEL_VM_regvar(vm, "skip");
+        c->vars.red = NSEEL_VM_regvar(vm, "red");
+        c->vars.green = NSEEL_VM_regvar(vm, "green");
+        c->vars.blue = NSEEL_VM_regvar(vm, "blue");
+        c->vars.linesize = NSEEL_VM_regvar(vm, "linesize");
+        c->vars.drawmode = NSEEL_VM_regvar(vm, "drawmode");
+        m_nclones++; // so freeClones() gets it either way
+        if (!AVS_EEL_IF_MakeClone(&c->eel, AVS_EEL_CONTEXTNAME, effect_exp[0].get()))
+            return 0;
+    }
+    return 1;
+}
+
+void C_THISCLASS::freeClones()
+{
+    int x;
+    for (x = 0; x < m_nclones; x++)
+        AVS_EEL_IF_FreeClone(&m_clones[x].eel);
+    memset(m_clones, 0, sizeof(m_clones));
+    m_nclones = 0;
+}
+
 static __inline int makeint(double t)
 {
     if (t <= 0.0)
@@ -202,6 +309,19 @@ static __inline int makeint(double t)
 }
 
 int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    if (!smp_begin(1, visdata, isBeat, framebuffer, fbout, w, h))
+        return 0;
+    smp_render(0, 1, visdata, isBeat, framebuffer, fbout, w, h);
+    return smp_finish(visdata, isBeat, framebuffer, fbout, w, h);
+}
+
+int C_THISCLASS::smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    return 0;
+}
+
+int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (need_recompile) {
         EnterCriticalSection(&rcs);
@@ -232,6 +352,7 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
             freeCode(codehandle[x]);
             codehandle[x] = compileCode(effect_exp[x].get());
         }
+        freeClones();
 
         LeaveCriticalSection(&rcs);
     }
@@ -293,66 +414,203 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     executeCode(codehandle[1], visdata);
     if (isBeat)
         executeCode(codehandle[2], visdata);
-    if (codehandle[0]) {
-        int candraw = 0, lx = 0, ly = 0;
+    if (!codehandle[0])
+        return 0;
+
+    int l = (int)*var_n;
+    if (l > 128 * 1024)
+        l = 128 * 1024;
+    if (l < 0)
+        l = 0;
+    if (l > m_points_alloc) {
+        if (m_points)
+            GlobalFree(m_points);
+        m_points_alloc = l;
+        m_points = (sscopePoint*)GlobalAlloc(GMEM_FIXED, l * sizeof(sscopePoint));
+        if (!m_points) {
+            m_points_alloc = 0;
+            return 0;
+        }
+    }
+    m_npoints = l;
+    m_fa_data = fa_data;
+    m_ex_n = 0;
+    if (m_vis_ex) {
+        const VisDataEx* vd = m_vis_ex;
+        int n = ws ? vd->bins : vd->samples, ch = which_ch & 3;
+        if (n > VISDATA_EX_MAX)
+            n = VISDATA_EX_MAX;
+        for (x = 0; x < n; x++) {
+            if (ws) {
+                float m = ch >= 2 ? 0.5f * (vd->spectrum[0][x] + vd->spectrum[1][x]) : vd->spectrum[ch][x];
+                m_ex_v[x] = visdata_ex_spec_curve(m) * (255.0f / 128.0f) - 1.0f;
+            } else
+                m_ex_v[x] = ch >= 2 ? 0.5f * (vd->waveform[0][x] + vd->waveform[1][x]) : vd->waveform[ch][x];
+        }
+        m_ex_n = n;
+    }
+    m_xorv = xorv;
+    m_w = w;
+    m_h = h;
+
+    // ranges of points go to copies of the VM when nothing carries from
+    // one point to the next (the same test executeCodeBatch() makes)
+    m_nranges = 1;
+    if (max_threads > 1 && g_config_smp_mt > 1 && l >= 2 * SSCOPE_CHUNK) {
+        NSEEL_LANEVAR lanes[] = {
+            { var_i, NULL, NSEEL_LANE_IN },
+            { var_v, NULL, NSEEL_LANE_IN },
+            { var_skip, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        };
+        if (NSEEL_code_independent((NSEEL_CODEHANDLE)codehandle[0], lanes, sizeof(lanes) / sizeof(lanes[0]))) {
+            int n = min(g_config_smp_mt, min(SSCOPE_MAX_CLONES + 1, l / SSCOPE_CHUNK));
+            EnterCriticalSection(&rcs);
+            if (makeClones(n - 1))
+                m_nranges = n;
+            LeaveCriticalSection(&rcs);
+        }
+    }
+
+    AVS_EEL_IF_BeginExecute(visdata);
+    if (m_nranges > 1) {
+        int r;
+        for (r = 0; r < m_nranges - 1; r++)
+            AVS_EEL_IF_SyncClone(&m_clones[r].eel, 0);
+        C_SmpPool::get()->run(g_config_smp_mt, m_nranges, evalProc, this);
+        // the variables end up as the last point left them
+        AVS_EEL_IF_SyncClone(&m_clones[m_nranges - 2].eel, 1);
+    } else {
+        sscopeVars v = { var_i, var_v, var_x, var_y, var_skip, var_red, var_green, var_blue, var_linesize, var_drawmode };
+        evalRange(codehandle[0], &v, 0, l);
+    }
+    AVS_EEL_IF_EndExecute();
+
+    return max_threads;
+}
+
+void C_THISCLASS::evalProc(void* ctx, int task, int ntasks)
+{
+    C_THISCLASS* t = (C_THISCLASS*)ctx;
+    int a0 = (int)(((long long)t->m_npoints * task) / ntasks);
+    int a1 = (int)(((long long)t->m_npoints * (task + 1)) / ntasks);
+    if (!task) {
+        sscopeVars v = { t->var_i, t->var_v, t->var_x, t->var_y, t->var_skip, t->var_red, t->var_green, t->var_blue, t->var_linesize, t->var_drawmode };
+        t->evalRange(t->codehandle[0], &v, a0, a1);
+    } else
+        t->evalRange(t->m_clones[task - 1].eel.code, &t->m_clones[task - 1].vars, a0, a1);
+}
+
+void C_THISCLASS::evalRange(intptr_t code, sscopeVars* vars, int a0, int a1)
+{
+    double pi[SSCOPE_CHUNK], pv[SSCOPE_CHUNK], px[SSCOPE_CHUNK], py[SSCOPE_CHUNK], pskip[SSCOPE_CHUNK];
+    double pred[SSCOPE_CHUNK], pgreen[SSCOPE_CHUNK], pblue[SSCOPE_CHUNK], plinesize[SSCOPE_CHUNK], pdrawmode[SSCOPE_CHUNK];
+    // i, v and skip are set per point, the rest carries over unless the
+    // code assigns it (in which case the points can run batched)
+    NSEEL_LANEVAR lanes[] = {
+        { vars->i, pi, NSEEL_LANE_IN },
+        { vars->v, pv, NSEEL_LANE_IN },
+        { vars->skip, pskip, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { vars->x, px, NSEEL_LANE_OUT },
+        { vars->y, py, NSEEL_LANE_OUT },
+        { vars->red, pred, NSEEL_LANE_OUT },
+        { vars->green, pgreen, NSEEL_LANE_OUT },
+        { vars->blue, pblue, NSEEL_LANE_OUT },
+        { vars->linesize, plinesize, NSEEL_LANE_OUT },
+        { vars->drawmode, pdrawmode, NSEEL_LANE_OUT },
+    };
+    int l = m_npoints, w = m_w, h = m_h;
+    int a, k;
+    for (; a0 < a1; a0 += SSCOPE_CHUNK) {
+        int n = a1 - a0 < SSCOPE_CHUNK ? a1 - a0 : SSCOPE_CHUNK;
+        for (k = 0; k < n; k++) {
+            a = a0 + k;
+            if (m_ex_n) {
+                double r = ((double)a * m_ex_n) / l;
+                int r0 = (int)r, r1 = r0 + 1 < m_ex_n ? r0 + 1 : r0;
+                double s1 = r - r0;
+                pv[k] = m_ex_v[r0] * (1.0 - s1) + m_ex_v[r1] * s1;
+            } else {
+                // the last points stop at the last sample rather than read
+                // the byte after the 576
+                double r = (a * 576.0) / l;
+                int r0 = (int)r, r1 = r0 + 1 < 576 ? r0 + 1 : r0;
+                double s1 = r - r0;
+                double yr = (m_fa_data[r0] ^ m_xorv) * (1.0f - s1) + (m_fa_data[r1] ^ m_xorv) * (s1);
+                pv[k] = yr / 128.0 - 1.0;
+            }
+            pi[k] = (double)a / (double)(l - 1);
+            pskip[k] = 0.0;
+        }
+        NSEEL_code_execute_batch((NSEEL_CODEHANDLE)code, lanes, sizeof(lanes) / sizeof(lanes[0]), n);
+        for (k = 0; k < n; k++) {
+            sscopePoint* pt = m_points + a0 + k;
+            pt->x = (int)((px[k] + 1.0) * w * 0.5);
+            pt->y = (int)((py[k] + 1.0) * h * 0.5);
+#ifdef LASER
+            pt->fx = (float)px[k];
+            pt->fy = (float)py[k];
+#endif
+            pt->color = makeint(pblue[k]) | (makeint(pgreen[k]) << 8) | (makeint(pred[k]) << 16);
+            pt->linesize = (int)(plinesize[k] + 0.5);
+            pt->flags = (pskip[k] < 0.00001 ? 0 : SSCOPE_PT_SKIP) | (pdrawmode[k] < 0.00001 ? 0 : SSCOPE_PT_LINE);
+        }
+    }
+}
+
+void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
+{
+    drawPoints(framebuffer, w, h, (this_thread * h) / max_threads, ((this_thread + 1) * h) / max_threads);
+}
+
+void C_THISCLASS::drawPoints(int* framebuffer, int w, int h, int row0, int row1)
+{
+    int candraw = 0, lx = 0, ly = 0;
 #ifdef LASER
-        double dlx = 0.0, dly = 0.0;
+    double dlx = 0.0, dly = 0.0;
 #endif
-        int a;
-        int l = (int)*var_n;
-        if (l > 128 * 1024)
-            l = 128 * 1024;
-        for (a = 0; a < l; a++) {
-            int x, y;
-            double r = (a * 576.0) / l;
-            double s1 = r - (int)r;
-            double yr = (fa_data[(int)r] ^ xorv) * (1.0f - s1) + (fa_data[(int)r + 1] ^ xorv) * (s1);
-            *var_v = yr / 128.0 - 1.0;
-            *var_i = (double)a / (double)(l - 1);
-            *var_skip = 0.0;
-            executeCode(codehandle[0], visdata);
-            x = (int)((*var_x + 1.0) * w * 0.5);
-            y = (int)((*var_y + 1.0) * h * 0.5);
-            if (*var_skip < 0.00001) {
-                int thiscolor = makeint(*var_blue) | (makeint(*var_green) << 8) | (makeint(*var_red) << 16);
-                if (*var_drawmode < 0.00001) {
-                    if (y >= 0 && y < h && x >= 0 && x < w) {
+    int a;
+    for (a = 0; a < m_npoints; a++) {
+        const sscopePoint* pt = m_points + a;
+        int x = pt->x, y = pt->y;
+        if (!(pt->flags & SSCOPE_PT_SKIP)) {
+            int thiscolor = pt->color;
+            if (!(pt->flags & SSCOPE_PT_LINE)) {
+                if (y >= row0 && y < row1 && x >= 0 && x < w) {
 #ifdef LASER
-                        laser_drawpoint((float)*var_x, (float)*var_y, thiscolor);
+                    laser_drawpoint(pt->fx, pt->fy, thiscolor);
 #else
-                        BLEND_LINE(framebuffer + x + y * w, thiscolor);
+                    BLEND_LINE(framebuffer + x + y * w, thiscolor);
 #endif
-                    }
-                } else {
-                    if (candraw) {
+                }
+            } else {
+                if (candraw) {
 #ifdef LASER
-                        LineType l;
-                        l.color = thiscolor;
-                        l.mode = 0;
-                        l.x1 = (float)*var_x;
-                        l.y1 = (float)*var_y;
-                        l.x2 = (float)dlx;
-                        l.y2 = (float)dly;
-                        g_laser_linelist->AddLine(&l);
+                    LineType l;
+                    l.color = thiscolor;
+                    l.mode = 0;
+                    l.x1 = pt->fx;
+                    l.y1 = pt->fy;
+                    l.x2 = (float)dlx;
+                    l.y2 = (float)dly;
+                    g_laser_linelist->AddLine(&l);
 #else
-                        if ((thiscolor & 0xffffff) || (g_line_blend_mode & 0xff) != 1) {
-                            line(framebuffer, lx, ly, x, y, w, h, thiscolor, (int)(*var_linesize + 0.5));
-                        }
+                    // nothing of a line this far from the slice lands in it
+                    int lw = pt->linesize < 1 ? 1 : pt->linesize > 255 ? 255 : pt->linesize;
+                    if (min(y, ly) - lw < row1 && max(y, ly) + lw >= row0 && ((thiscolor & 0xffffff) || (g_line_blend_mode & 0xff) != 1)) {
+                        line_rows(framebuffer, lx, ly, x, y, w, h, thiscolor, pt->linesize, row0, row1);
+                    }
 #endif
-                    } // candraw
-                } // line
-            } // skip
-            candraw = 1;
-            lx = x;
-            ly = y;
+                } // candraw
+            } // line
+        } // skip
+        candraw = 1;
+        lx = x;
+        ly = y;
 #ifdef LASER
-            dlx = *var_x;
-            dly = *var_y;
+        dlx = pt->fx;
+        dly = pt->fy;
 #endif
-        }
     }
-
-    return 0;
 }
 
 C_RBASE* R_SScope(char* desc)
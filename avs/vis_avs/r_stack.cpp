@@ -34,7 +34,6 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -42,12 +41,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define C_THISCLASS C_StackClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_StackClass();
     virtual ~C_StackClass();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return RTRAIT_POINT | RTRAIT_BUFFER(which); }
     virtual char* get_desc();
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -169,13 +169,7 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
                 bf += w;
             }
         } else if (blend == 4) {
-            int x = w * h;
-            int* bf = fbin;
-            while (x-- > 0) {
-                *fbout = BLEND_SUB(*fbout, *bf);
-                fbout++;
-                bf++;
-            }
+            blend_sub_block(fbout, fbout, fbin, w * h);
         } else if (blend == 5) {
             int y = h / 2;
             while (y-- > 0) {
@@ -184,36 +178,13 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
                 fbin += w * 2;
             }
         } else if (blend == 6) {
-            int x = w * h;
-            while (x-- > 0) {
-                *fbout = *fbout ^ *fbin;
-                fbout++;
-                fbin++;
-            }
+            blend_xor_block(fbout, fbout, fbin, w * h);
         } else if (blend == 7) {
-            int x = w * h;
-            int* bf = fbin;
-            while (x-- > 0) {
-                *fbout = BLEND_MAX(*fbout, *bf);
-                fbout++;
-                bf++;
-            }
+            blend_max_block(fbout, fbout, fbin, w * h);
         } else if (blend == 8) {
-            int x = w * h;
-            int* bf = fbin;
-            while (x-- > 0) {
-                *fbout = BLEND_MIN(*fbout, *bf);
-                fbout++;
-                bf++;
-            }
+            blend_min_block(fbout, fbout, fbin, w * h);
         } else if (blend == 9) {
-            int x = w * h;
-            int* bf = fbin;
-            while (x-- > 0) {
-                *fbout = BLEND_SUB(*bf, *fbout);
-                fbout++;
-                bf++;
-            }
+            blend_sub_block(fbout, fbin, fbout, w * h);
         } else if (blend == 10) {
             mmx_mulblend_block(fbout, fbin, w * h);
         } else if (blend == 11) {
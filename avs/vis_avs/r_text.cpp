@@ -28,6 +28,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
@@ -43,7 +44,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Render / Text"
 #define C_THISCLASS C_TextClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
@@ -55,6 +56,7 @@ public:
     void CreateStar(int A);
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_GLOBAL | RTRAIT_RANDOM : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -122,11 +124,11 @@ void C_THISCLASS::reinit(int w, int h)
         DeleteDC(hBitmapDC);
         ReleaseDC(NULL, hDesktopDC);
         if (myBuffer)
-            GlobalFree(myBuffer);
+            fba_free(myBuffer);
     }
 
     // Alloc buffers, select objects, init structures
-    myBuffer = (int*)GlobalAlloc(GMEM_FIXED, w * h * 4);
+    myBuffer = (int*)fba_alloc(w * h * 4, 0);
     hDesktopDC = GetDC(NULL);
     hRetBitmap = CreateCompatibleBitmap(hDesktopDC, w, h);
     hBitmapDC = CreateCompatibleDC(hDesktopDC);
@@ -161,7 +163,7 @@ C_THISCLASS::~C_THISCLASS()
         DeleteDC(hBitmapDC);
         ReleaseDC(NULL, hDesktopDC);
         if (myBuffer)
-            GlobalFree(myBuffer);
+            fba_free(myBuffer);
     }
     if (text)
         GlobalFree(text);
@@ -31,19 +31,25 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define M_PI 3.14159265358979323846
 
 #include "../../platform_shim.h"
+#include "profiler.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
 
 #include "avs_eelif.h"
-#include "timing.h"
+#include "smp_pool.h"
+#include "trans_cache.h"
+#include <atomic>
 #include <math.h>
+#include <thread>
 
 #ifndef LASER
 
 #define C_THISCLASS C_TransTabClass
 #define MOD_NAME "Trans / Movement"
 
+extern int g_config_smp_mt;
+
 #define REFFECT_MIN 3
 #define REFFECT_MAX 23
 
@@ -137,12 +143,353 @@ static inline bool effect_uses_eval(int t)
     return retval;
 }
 
+// a table entry for source position (tx, ty): the offset of the source pixel,
+// plus 5 bit x and y fractions in the high bits in subpixel mode
+static inline int trans_entry(double ty, double tx, int w, int h, int subpixel, int wrap)
+{
+    int oh = (int)ty;
+    int ow = (int)tx;
+    if (subpixel) {
+        int xpartial = (int)(32.0 * (tx - ow));
+        int ypartial = (int)(32.0 * (ty - oh));
+        if (wrap) {
+            ow %= (w - 1);
+            oh %= (h - 1);
+            if (ow < 0)
+                ow += w - 1;
+            if (oh < 0)
+                oh += h - 1;
+        } else {
+            if (ow < 0) {
+                xpartial = 0;
+                ow = 0;
+            }
+            if (ow >= w - 1) {
+                xpartial = 31;
+                ow = w - 2;
+            }
+            if (oh < 0) {
+                ypartial = 0;
+                oh = 0;
+            }
+            if (oh >= h - 1) {
+                ypartial = 31;
+                oh = h - 2;
+            }
+        }
+        return ow + oh * w | (ypartial << 22) | (xpartial << 27);
+    }
+    if (wrap) {
+        ow %= (w);
+        oh %= (h);
+        if (ow < 0)
+            ow += w;
+        if (oh < 0)
+            oh += h;
+    } else {
+        if (ow < 0)
+            ow = 0;
+        if (ow >= w)
+            ow = w - 1;
+        if (oh < 0)
+            oh = 0;
+        if (oh >= h)
+            oh = h - 1;
+    }
+    return ow + oh * w;
+}
+
+// the radial and eval tables are generated in bands of rows on the smp pool.
+// eval bands past the first run on copies of the VM, which is only done when
+// no variable carries from one pixel to the next.
+#define TRANS_MAX_BANDS 16
+#define TRANS_MIN_BAND_ROWS 32
+
+typedef struct {
+    AVS_EEL_CLONE eel; // unused by band 0, which runs on the original VM
+    intptr_t code;
+    double *d, *r, *x, *y;
+} transBand;
+
+typedef struct {
+    C_TransTable* t;
+    int effect, subpixel, wrap, is_rect;
+    int locked; // eval bands run between AVS_EEL_IF_Begin/EndExecute()
+    char (*visdata)[2][576];
+    transBand bands[TRANS_MAX_BANDS];
+} transGen;
+
+static int trans_bands(int nthreads, int h)
+{
+    int n = h / TRANS_MIN_BAND_ROWS;
+    if (n > nthreads)
+        n = nthreads;
+    if (n > TRANS_MAX_BANDS)
+        n = TRANS_MAX_BANDS;
+    return n < 1 ? 1 : n;
+}
+
+static void trans_rows(transGen* g, int band, int y0, int y1)
+{
+    int w = g->t->w, h = g->t->h;
+    int subpixel = g->subpixel, wrap = g->wrap;
+    int* transp = g->t->tab.data() + y0 * w;
+    int x, y;
+
+    if (!effect_uses_eval(g->effect) && g->effect != 32767) {
+        double max_d = sqrt((w * w + h * h) / 4.0);
+        t_reffect* ref = radial_effects[g->effect - REFFECT_MIN];
+        for (y = y0; y < y1; y++) {
+            for (x = 0; x < w; x++) {
+                double r, d;
+                double xd, yd;
+                int xo = 0, yo = 0;
+                xd = x - (w / 2);
+                yd = y - (h / 2);
+                d = sqrt(xd * xd + yd * yd);
+                r = atan2(yd, xd);
+
+                ref(r, d, max_d, xo, yo);
+
+                double tmp1, tmp2;
+                tmp1 = ((h / 2) + sin(r) * d + 0.5) + (yo * h) * (1.0 / 256.0);
+                tmp2 = ((w / 2) + cos(r) * d + 0.5) + (xo * w) * (1.0 / 256.0);
+                *transp++ = trans_entry(tmp1, tmp2, w, h, subpixel, wrap);
+            }
+        }
+        return;
+    }
+
+    transBand* b = g->bands + band;
+    double max_d = sqrt((double)(w * w + h * h)) / 2.0;
+    double divmax_d = 1.0 / max_d;
+    double w2 = w / 2;
+    double h2 = h / 2;
+    double xsc = 1.0 / w2, ysc = 1.0 / h2;
+    // a row per NSEEL_code_execute_batch()
+    std::vector<double> rowbuf((size_t)w * 4);
+    double *px = rowbuf.data(), *py = px + w, *pd = py + w, *pr = pd + w;
+    NSEEL_LANEVAR lanes[] = {
+        { b->x, px, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { b->y, py, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { b->d, pd, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+        { b->r, pr, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+    };
+    for (y = y0; y < y1; y++) {
+        for (x = 0; x < w; x++) {
+            double xd, yd;
+            xd = x - w2;
+            yd = y - h2;
+            px[x] = xd * xsc;
+            py[x] = yd * ysc;
+            pd[x] = sqrt(xd * xd + yd * yd) * divmax_d;
+            pr[x] = atan2(yd, xd) + M_PI * 0.5;
+        }
+
+        if (g->locked)
+            NSEEL_code_execute_batch((NSEEL_CODEHANDLE)b->code, lanes, sizeof(lanes) / sizeof(lanes[0]), w);
+        else
+            executeCodeBatch(b->code, g->visdata, lanes, sizeof(lanes) / sizeof(lanes[0]), w);
+
+        for (x = 0; x < w; x++) {
+            double tmp1, tmp2;
+            if (!g->is_rect) {
+                double d = pd[x] * max_d;
+                double r = pr[x] - M_PI / 2.0;
+                tmp1 = ((h / 2) + sin(r) * d);
+                tmp2 = ((w / 2) + cos(r) * d);
+            } else {
+                tmp1 = ((py[x] + 1.0) * h2);
+                tmp2 = ((px[x] + 1.0) * w2);
+            }
+            if (!subpixel) {
+                tmp1 += 0.5;
+                tmp2 += 0.5;
+            }
+            *transp++ = trans_entry(tmp1, tmp2, w, h, subpixel, wrap);
+        }
+    }
+}
+
+static void trans_band_proc(void* ctx, int task, int ntasks)
+{
+    transGen* g = (transGen*)ctx;
+    int h = g->t->h;
+    trans_rows(g, task, (h * task) / ntasks, (h * (task + 1)) / ntasks);
+}
+
+// fills t->tab for the given table parameters, on up to nthreads threads of
+// the smp pool. subpixel is the effective mode (see smp_begin); a failed eval
+// compile falls back to an identity table and clears t->subpixel.
+static void generate_trans_tab(C_TransTable* t, int effect, int w, int h, int subpixel, int wrap, int is_rect, char* code, char visdata[2][2][576], int nthreads)
+{
+    PROF_ZONE("Trans / Movement table");
+    int p;
+    int *transp, x;
+    transGen g;
+
+    t->w = w;
+    t->h = h;
+    t->subpixel = subpixel;
+    t->independent = 1;
+    t->tab.resize((size_t)w * h);
+
+    memset(&g, 0, sizeof(g));
+    g.t = t;
+    g.effect = effect;
+    g.subpixel = subpixel;
+    g.wrap = wrap;
+    g.is_rect = is_rect;
+    g.visdata = visdata;
+
+    /* generate trans_tab */
+    transp = t->tab.data();
+    x = w * h;
+    p = 0;
+
+    if (effect == 1) {
+        while (x--) {
+            int r = (p++) + (rand() % 3) - 1 + ((rand() % 3) - 1) * w;
+            *transp++ = min(w * h - 1, max(r, 0));
+        }
+    } else if (effect == 2) {
+        int y = h;
+        while (y--) {
+            int x = w;
+            int lp = w / 64;
+            while (x--) {
+                *transp++ = p + lp++;
+                if (lp >= w)
+                    lp -= w;
+            }
+            p += w;
+        }
+    } else if (effect == 7) {
+        int y;
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < w; x++) {
+                if (x & 2 || y & 2) {
+                    *transp++ = x + y * w;
+                } else {
+                    int xp = w / 2 + (((x & ~1) - w / 2) * 7) / 8;
+                    int yp = h / 2 + (((y & ~1) - h / 2) * 7) / 8;
+                    *transp++ = xp + yp * w;
+                }
+            }
+        }
+    } else if (effect >= REFFECT_MIN && effect <= REFFECT_MAX && !effect_uses_eval(effect)) {
+        if (radial_effects[effect - REFFECT_MIN]) {
+            int n = trans_bands(nthreads, h);
+            if (n > 1)
+                C_SmpPool::get()->run(nthreads, n, trans_band_proc, &g);
+            else
+                trans_rows(&g, 0, 0, h);
+        }
+    } else if (effect == 32767 || effect_uses_eval(effect)) {
+        intptr_t AVS_EEL_CONTEXTNAME;
+        AVS_EEL_INITINST();
+        transBand* b = g.bands;
+        double* pw;
+        double* ph;
+        intptr_t codehandle = 0;
+        b->d = registerVar("d");
+        b->r = registerVar("r");
+        b->x = registerVar("x");
+        b->y = registerVar("y");
+        pw = registerVar("sw");
+        ph = registerVar("sh");
+        *pw = w;
+        *ph = h;
+        codehandle = compileCode(code);
+        if (codehandle) {
+            int n = 1;
+            NSEEL_LANEVAR lanes[] = {
+                { b->x, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+                { b->y, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+                { b->d, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+                { b->r, NULL, NSEEL_LANE_IN | NSEEL_LANE_OUT },
+            };
+            b->code = codehandle;
+            // code that carries variables from pixel to pixel neither splits
+            // into bands nor goes into the cache
+            t->independent = NSEEL_code_independent((NSEEL_CODEHANDLE)codehandle, lanes, sizeof(lanes) / sizeof(lanes[0]));
+            if (trans_bands(nthreads, h) > 1) {
+                if (t->independent) {
+                    int want = trans_bands(nthreads, h);
+                    while (n < want) {
+                        transBand* c = g.bands + n;
+                        NSEEL_VMCTX vm = NSEEL_VM_alloc();
+                        if (!vm)
+                            break;
+                        c->eel.vm = (intptr_t)vm;
+                        c->d = NSEEL_VM_regvar(vm, "d");
+                        c->r = NSEEL_VM_regvar(vm, "r");
+                        c->x = NSEEL_VM_regvar(vm, "x");
+                        c->y = NSEEL_VM_regvar(vm, "y");
+                        if (!AVS_EEL_IF_MakeClone(&c->eel, AVS_EEL_CONTEXTNAME, code)) {
+                            AVS_EEL_IF_FreeClone(&c->eel);
+                            break;
+                        }
+                        AVS_EEL_IF_SyncClone(&c->eel, 0);
+                        c->code = c->eel.code;
+                        n++;
+                    }
+                }
+            }
+            if (n > 1) {
+                int k;
+                AVS_EEL_IF_BeginExecute(visdata);
+                g.locked = 1;
+                C_SmpPool::get()->run(nthreads, n, trans_band_proc, &g);
+                AVS_EEL_IF_EndExecute();
+                for (k = 1; k < n; k++)
+                    AVS_EEL_IF_FreeClone(&g.bands[k].eel);
+            } else
+                trans_rows(&g, 0, 0, h);
+        } else {
+            transp = t->tab.data();
+            t->subpixel = 0;
+            for (x = 0; x < w * h; x++)
+                *transp++ = x;
+        }
+        freeCode(codehandle);
+        AVS_EEL_QUITINST();
+    }
+}
+
+// a table generated on its own thread after a setting changed, while the
+// previous one (which still fits the frame) keeps rendering
+struct transJob {
+    std::thread thread;
+    std::atomic<int> done;
+    int seq;
+    C_TransKey key;
+    int subpixel, cacheable;
+    std::vector<char> code;
+    char visdata[2][2][576];
+    std::shared_ptr<C_TransTable> table;
+};
+
+static void trans_job_proc(transJob* j)
+{
+    generate_trans_tab(j->table.get(), j->key.effect, j->key.w, j->key.h, j->subpixel, j->key.wrap, j->key.rect, j->code.empty() ? NULL : j->code.data(), j->visdata, 1);
+    if (j->cacheable && j->table->independent)
+        C_TransCache::get()->insert(j->key, j->table);
+    j->done = 1;
+}
+
 class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits()
+    {
+        if (!effect)
+            return RTRAIT_POINT | RTRAIT_NOOP;
+        return RTRAIT_GLOBAL | RTRAIT_FBOUT | (effect == 32767 || effect_uses_eval(effect) ? RTRAIT_EEL : 0) | (effect == 1 ? RTRAIT_RANDOM : 0);
+    }
 
     virtual int smp_getflags() { return 1; }
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
@@ -154,8 +501,14 @@ public:
     virtual void load_config(unsigned char* data, int len);
     virtual int save_config(unsigned char* data);
 
-    int *trans_tab, trans_tab_w, trans_tab_h, trans_tab_subpixel;
+    void setTable(const C_TransTableRef& table);
+
+    C_TransTableRef trans_table; // shared with C_TransCache
+    const int* trans_tab;
+    int trans_tab_w, trans_tab_h, trans_tab_subpixel;
     int trans_effect;
+    transJob* trans_job;
+    int trans_seq; // bumped whenever a table is asked for
     RString effect_exp;
     int effect_exp_ch;
     int effect, blend;
@@ -303,258 +656,104 @@ C_THISCLASS::C_THISCLASS()
     wrap = 0;
     trans_tab_subpixel = 0;
     effect_exp_ch = 1;
+    trans_job = NULL;
+    trans_seq = 0;
 }
 
 C_THISCLASS::~C_THISCLASS()
 {
-    if (trans_tab)
-        GlobalFree(trans_tab);
+    if (trans_job) {
+        trans_job->thread.join();
+        delete trans_job;
+    }
+    trans_table.reset();
     trans_tab = NULL;
     trans_tab_w = trans_tab_h = 0;
     trans_effect = 0;
     DeleteCriticalSection(&rcs);
 }
 
+void C_THISCLASS::setTable(const C_TransTableRef& table)
+{
+    trans_table = table;
+    trans_tab = table->tab.data();
+    trans_tab_w = table->w;
+    trans_tab_h = table->h;
+    trans_tab_subpixel = table->subpixel;
+}
+
 int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h)
 {
     if (!effect)
         return 0;
 
-    if (!trans_tab || trans_tab_w != w || trans_tab_h != h || effect != trans_effect || effect_exp_ch) {
-        int p;
-        int *transp, x;
-        if (trans_tab)
-            GlobalFree(trans_tab);
-        trans_tab_w = w;
-        trans_tab_h = h;
-        trans_tab = (int*)GlobalAlloc(GMEM_FIXED, trans_tab_w * trans_tab_h * sizeof(int));
-        trans_effect = effect;
-        trans_tab_subpixel = (subpixel && trans_tab_w * trans_tab_h < (1 << 22) && ((trans_effect >= REFFECT_MIN && trans_effect <= REFFECT_MAX && trans_effect != 1 && trans_effect != 2 && trans_effect != 7) || trans_effect == 32767));
-
-        /* generate trans_tab */
-        transp = trans_tab;
-        x = w * h;
-        p = 0;
+    if (trans_job && trans_job->done) {
+        trans_job->thread.join();
+        if (trans_job->seq == trans_seq && trans_job->key.w == w && trans_job->key.h == h)
+            setTable(trans_job->table);
+        delete trans_job;
+        trans_job = NULL;
+    }
 
-        if (trans_effect == 1) {
-            while (x--) {
-                int r = (p++) + (rand() % 3) - 1 + ((rand() % 3) - 1) * w;
-                *transp++ = min(w * h - 1, max(r, 0));
-            }
-        } else if (trans_effect == 2) {
-            int y = h;
-            while (y--) {
-                int x = w;
-                int lp = w / 64;
-                while (x--) {
-                    *transp++ = p + lp++;
-                    if (lp >= w)
-                        lp -= w;
-                }
-                p += w;
-            }
-        } else if (trans_effect == 7) {
-            int y;
-            for (y = 0; y < h; y++) {
-                for (x = 0; x < w; x++) {
-                    if (x & 2 || y & 2) {
-                        *transp++ = x + y * w;
-                    } else {
-                        int xp = w / 2 + (((x & ~1) - w / 2) * 7) / 8;
-                        int yp = h / 2 + (((y & ~1) - h / 2) * 7) / 8;
-                        *transp++ = xp + yp * w;
-                    }
-                }
-            }
-        } else if (trans_effect >= REFFECT_MIN && trans_effect <= REFFECT_MAX && !effect_uses_eval(trans_effect)) {
-            double max_d = sqrt((w * w + h * h) / 4.0);
-            int y;
-            t_reffect* ref = radial_effects[trans_effect - REFFECT_MIN];
-            if (ref)
-                for (y = 0; y < h; y++) {
-                    for (x = 0; x < w; x++) {
-                        double r, d;
-                        double xd, yd;
-                        int ow, oh, xo = 0, yo = 0;
-                        xd = x - (w / 2);
-                        yd = y - (h / 2);
-                        d = sqrt(xd * xd + yd * yd);
-                        r = atan2(yd, xd);
-
-                        ref(r, d, max_d, xo, yo);
-
-                        double tmp1, tmp2;
-                        tmp1 = ((h / 2) + sin(r) * d + 0.5) + (yo * h) * (1.0 / 256.0);
-                        tmp2 = ((w / 2) + cos(r) * d + 0.5) + (xo * w) * (1.0 / 256.0);
-                        oh = (int)tmp1;
-                        ow = (int)tmp2;
-                        if (trans_tab_subpixel) {
-                            int xpartial = (int)(32.0 * (tmp2 - ow));
-                            int ypartial = (int)(32.0 * (tmp1 - oh));
-                            if (wrap) {
-                                ow %= (w - 1);
-                                oh %= (h - 1);
-                                if (ow < 0)
-                                    ow += w - 1;
-                                if (oh < 0)
-                                    oh += h - 1;
-                            } else {
-                                if (ow < 0) {
-                                    xpartial = 0;
-                                    ow = 0;
-                                }
-                                if (ow >= w - 1) {
-                                    xpartial = 31;
-                                    ow = w - 2;
-                                }
-                                if (oh < 0) {
-                                    ypartial = 0;
-                                    oh = 0;
-                                }
-                                if (oh >= h - 1) {
-                                    ypartial = 31;
-                                    oh = h - 2;
-                                }
-                            }
-                            *transp++ = ow + oh * w | (ypartial << 22) | (xpartial << 27);
-                        } else {
-                            if (wrap) {
-                                ow %= (w);
-                                oh %= (h);
-                                if (ow < 0)
-                                    ow += w;
-                                if (oh < 0)
-                                    oh += h;
-                            } else {
-                                if (ow < 0)
-                                    ow = 0;
-                                if (ow >= w)
-                                    ow = w - 1;
-                                if (oh < 0)
-                                    oh = 0;
-                                if (oh >= h)
-                                    oh = h - 1;
-                            }
-                            *transp++ = ow + oh * w;
-                        }
-                    }
-                }
-        } else if (trans_effect == 32767 || effect_uses_eval(trans_effect)) {
-            int AVS_EEL_CONTEXTNAME;
-            AVS_EEL_INITINST();
-            double max_d = sqrt((double)(w * w + h * h)) / 2.0;
-            double divmax_d = 1.0 / max_d;
-            int y;
-            double* d = registerVar("d");
-            double* r = registerVar("r");
-            double* px = registerVar("x");
-            double* py = registerVar("y");
-            double* pw = registerVar("sw");
-            double* ph = registerVar("sh");
-            int codehandle = 0;
-            int offs = 0;
-            int is_rect = trans_effect == 32767 ? rectangular : descriptions[trans_effect].uses_rect;
-            *pw = w;
-            *ph = h;
+    // while the size stays the same, the current table keeps rendering until
+    // a new one is generated in the background, and further changes wait for
+    // that to finish
+    int fits = trans_tab && trans_tab_w == w && trans_tab_h == h;
+    if ((!fits || effect != trans_effect || effect_exp_ch) && !(fits && trans_job)) {
+        int is_eval = effect == 32767 || effect_uses_eval(effect);
+        RString code;
+        C_TransKey key;
+        C_TransTableRef table;
+
+        trans_seq++;
+        trans_effect = effect;
+        effect_exp_ch = 0;
+        if (is_eval) {
             EnterCriticalSection(&rcs);
-            codehandle = compileCode(
-                trans_effect == 32767 ? effect_exp.get() : descriptions[trans_effect].eval_desc);
+            code.assign(effect == 32767 ? effect_exp.get() : descriptions[effect].eval_desc);
             LeaveCriticalSection(&rcs);
-            if (codehandle) {
-                double w2 = w / 2;
-                double h2 = h / 2;
-                double xsc = 1.0 / w2, ysc = 1.0 / h2;
-
-                for (y = 0; y < h; y++) {
-                    for (x = 0; x < w; x++) {
-                        double xd, yd;
-                        int ow, oh;
-                        xd = x - w2;
-                        yd = y - h2;
-                        *px = xd * xsc;
-                        *py = yd * ysc;
-                        *d = sqrt(xd * xd + yd * yd) * divmax_d;
-                        *r = atan2(yd, xd) + M_PI * 0.5;
-
-                        executeCode(codehandle, visdata);
-
-                        double tmp1, tmp2;
-                        if (!is_rect) {
-                            *d *= max_d;
-                            *r -= M_PI / 2.0;
-                            tmp1 = ((h / 2) + sin(*r) * *d);
-                            tmp2 = ((w / 2) + cos(*r) * *d);
-                        } else {
-                            tmp1 = ((*py + 1.0) * h2);
-                            tmp2 = ((*px + 1.0) * w2);
-                        }
-                        if (trans_tab_subpixel) {
-                            oh = (int)tmp1;
-                            ow = (int)tmp2;
-                            int xpartial = (int)(32.0 * (tmp2 - ow));
-                            int ypartial = (int)(32.0 * (tmp1 - oh));
-                            if (wrap) {
-                                ow %= (w - 1);
-                                oh %= (h - 1);
-                                if (ow < 0)
-                                    ow += w - 1;
-                                if (oh < 0)
-                                    oh += h - 1;
-                            } else {
-                                if (ow < 0) {
-                                    xpartial = 0;
-                                    ow = 0;
-                                }
-                                if (ow >= w - 1) {
-                                    xpartial = 31;
-                                    ow = w - 2;
-                                }
-                                if (oh < 0) {
-                                    ypartial = 0;
-                                    oh = 0;
-                                }
-                                if (oh >= h - 1) {
-                                    ypartial = 31;
-                                    oh = h - 2;
-                                }
-                            }
-                            *transp++ = ow + oh * w | (ypartial << 22) | (xpartial << 27);
-                        } else {
-                            tmp1 += 0.5;
-                            tmp2 += 0.5;
-                            oh = (int)tmp1;
-                            ow = (int)tmp2;
-                            if (wrap) {
-                                ow %= (w);
-                                oh %= (h);
-                                if (ow < 0)
-                                    ow += w;
-                                if (oh < 0)
-                                    oh += h;
-                            } else {
-                                if (ow < 0)
-                                    ow = 0;
-                                if (ow >= w)
-                                    ow = w - 1;
-                                if (oh < 0)
-                                    oh = 0;
-                                if (oh >= h)
-                                    oh = h - 1;
-                            }
-                            *transp++ = ow + oh * w;
-                        }
-                    }
-                }
+        }
+        key.effect = effect;
+        key.w = w;
+        key.h = h;
+        key.subpixel = subpixel;
+        key.wrap = wrap;
+        key.rect = is_eval ? (effect == 32767 ? rectangular : descriptions[effect].uses_rect) : 0;
+        key.code_hash = is_eval ? C_TransCache::hashCode(code.get()) : 0;
+        if (is_eval && code.get())
+            key.code = code.get();
+
+        // the fuzzify table is random on purpose, and code that looks at
+        // anything but x/y/d/r has to be evaluated fresh. code that carries
+        // state from pixel to pixel is only found out when it is compiled, so
+        // generate_trans_tab() marks its table and it never gets inserted
+        int cacheable = effect != 1 && !(is_eval && C_TransCache::codeIsVolatile(code.get()));
+        if (cacheable)
+            table = C_TransCache::get()->find(key);
+        if (!table) {
+            int tab_subpixel = (subpixel && w * h < (1 << 22) && ((effect >= REFFECT_MIN && effect <= REFFECT_MAX && effect != 1 && effect != 2 && effect != 7) || effect == 32767));
+            if (fits && effect != 1) {
+                trans_job = new transJob;
+                trans_job->done = 0;
+                trans_job->seq = trans_seq;
+                trans_job->key = key;
+                trans_job->subpixel = tab_subpixel;
+                trans_job->cacheable = cacheable;
+                if (code.get())
+                    trans_job->code.assign(code.get(), code.get() + strlen(code.get()) + 1);
+                memcpy(trans_job->visdata, visdata, sizeof(trans_job->visdata));
+                trans_job->table = std::make_shared<C_TransTable>();
+                trans_job->thread = std::thread(trans_job_proc, trans_job);
             } else {
-                transp = trans_tab;
-                trans_tab_subpixel = 0;
-                for (x = 0; x < w * h; x++)
-                    *transp++ = x;
+                std::shared_ptr<C_TransTable> t = std::make_shared<C_TransTable>();
+                generate_trans_tab(t.get(), effect, w, h, tab_subpixel, wrap, key.rect, code.get(), visdata, max_threads > 1 ? g_config_smp_mt : 1);
+                table = t;
+                if (cacheable && t->independent)
+                    C_TransCache::get()->insert(key, table);
             }
-            freeCode(codehandle);
-            AVS_EEL_QUITINST();
         }
-        effect_exp_ch = 0;
+        if (table)
+            setTable(table);
     }
 
     if (!(isBeat & 0x80000000)) {
@@ -567,6 +766,10 @@ int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat,
                 memcpy(fbout, framebuffer, w * h * sizeof(int));
         }
     }
+    // source mapped pixels land in any row, so slices would race on them
+    // and on the blend of their own rows afterwards: keep it to one
+    if (sourcemapped & 1)
+        return 1;
     return max_threads;
 }
 
@@ -579,7 +782,8 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
 
     unsigned int* inp = (unsigned int*)framebuffer;
     unsigned int* outp;
-    int *transp, x;
+    const int* transp;
+    int x;
 
     if (max_threads < 1)
         max_threads = 1;
@@ -605,7 +809,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
         inp += skip_pix;
         transp += skip_pix;
         if (trans_tab_subpixel) {
-            timingEnter(3);
             while (x--) {
                 fbout[transp[0] & OFFSET_MASK] = BLEND_MAX(inp[0], fbout[transp[0] & OFFSET_MASK]);
                 fbout[transp[1] & OFFSET_MASK] = BLEND_MAX(inp[1], fbout[transp[1] & OFFSET_MASK]);
@@ -614,7 +817,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
                 inp += 4;
                 transp += 4;
             }
-            timingLeave(3);
             x = (w * outh) & 3;
             if (x > 0)
                 while (x--) {
@@ -623,7 +825,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
                 }
         } else {
             {
-                timingEnter(3);
                 while (x--) {
                     fbout[transp[0]] = BLEND_MAX(inp[0], fbout[transp[0]]);
                     fbout[transp[1]] = BLEND_MAX(inp[1], fbout[transp[1]]);
@@ -632,7 +833,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
                     inp += 4;
                     transp += 4;
                 }
-                timingLeave(3);
                 x = (w * outh) & 3;
                 if (x > 0)
                     while (x--) {
@@ -664,54 +864,14 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
         inp += skip_pix;
         outp += skip_pix;
         transp += skip_pix;
-        if (trans_tab_subpixel && blend) {
-            while (x--) {
-                int offs = transp[0] & OFFSET_MASK;
-                outp[0] = BLEND_AVG(inp[0], BLEND4((unsigned int*)framebuffer + offs, w, ((transp[0] >> 24) & (31 << 3)), ((transp[0] >> 19) & (31 << 3))));
-                offs = transp[1] & OFFSET_MASK;
-                outp[1] = BLEND_AVG(inp[1], BLEND4((unsigned int*)framebuffer + offs, w, ((transp[1] >> 24) & (31 << 3)), ((transp[1] >> 19) & (31 << 3))));
-                offs = transp[2] & OFFSET_MASK;
-                outp[2] = BLEND_AVG(inp[2], BLEND4((unsigned int*)framebuffer + offs, w, ((transp[2] >> 24) & (31 << 3)), ((transp[2] >> 19) & (31 << 3))));
-                offs = transp[3] & OFFSET_MASK;
-                outp[3] = BLEND_AVG(inp[3], BLEND4((unsigned int*)framebuffer + offs, w, ((transp[3] >> 24) & (31 << 3)), ((transp[3] >> 19) & (31 << 3))));
-                transp += 4;
-                outp += 4;
-                inp += 4;
-            }
-            x = (w * outh) & 3;
-            while (x--) {
-                int offs = transp[0] & OFFSET_MASK;
-                outp++[0] = BLEND_AVG(inp[0], BLEND4((unsigned int*)framebuffer + offs, w, ((transp[0] >> 24) & (31 << 3)), ((transp[0] >> 19) & (31 << 3))));
-                transp++;
-                inp++;
-            }
-#ifndef NO_MMX
-            __asm emms;
-#endif
-        } else if (trans_tab_subpixel) {
-            while (x--) {
-                int offs = transp[0] & OFFSET_MASK;
-                outp[0] = BLEND4((unsigned int*)framebuffer + offs, w, ((transp[0] >> 24) & (31 << 3)), ((transp[0] >> 19) & (31 << 3)));
-                offs = transp[1] & OFFSET_MASK;
-                outp[1] = BLEND4((unsigned int*)framebuffer + offs, w, ((transp[1] >> 24) & (31 << 3)), ((transp[1] >> 19) & (31 << 3)));
-                offs = transp[2] & OFFSET_MASK;
-                outp[2] = BLEND4((unsigned int*)framebuffer + offs, w, ((transp[2] >> 24) & (31 << 3)), ((transp[2] >> 19) & (31 << 3)));
-                offs = transp[3] & OFFSET_MASK;
-                outp[3] = BLEND4((unsigned int*)framebuffer + offs, w, ((transp[3] >> 24) & (31 << 3)), ((transp[3] >> 19) & (31 << 3)));
-                transp += 4;
-                outp += 4;
-            }
-            x = (w * outh) & 3;
-            while (x--) {
-                int offs = transp[0] & OFFSET_MASK;
-                outp++[0] = BLEND4((unsigned int*)framebuffer + offs, w, ((transp[0] >> 24) & (31 << 3)), ((transp[0] >> 19) & (31 << 3)));
-                transp++;
-            }
+        if (trans_tab_subpixel) {
+            blend4_trans_block((int*)outp, framebuffer, w, transp, w * outh);
+            if (blend)
+                blend_avg_block((int*)outp, (const int*)inp, (const int*)outp, w * outh);
 #ifndef NO_MMX
             __asm emms;
 #endif
         } else if (blend) {
-            timingEnter(3);
             while (x--) {
                 outp[0] = BLEND_AVG(inp[0], framebuffer[transp[0]]);
                 outp[1] = BLEND_AVG(inp[1], framebuffer[transp[1]]);
@@ -721,14 +881,12 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
                 inp += 4;
                 transp += 4;
             }
-            timingLeave(3);
             x = (w * outh) & 3;
             if (x > 0)
                 while (x--) {
                     outp++[0] = BLEND_AVG(inp++[0], framebuffer[transp++[0]]);
                 }
         } else {
-            timingEnter(4);
             while (x--) {
                 outp[0] = framebuffer[transp[0]];
                 outp[1] = framebuffer[transp[1]];
@@ -737,7 +895,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
                 outp += 4;
                 transp += 4;
             }
-            timingLeave(4);
             x = (w * outh) & 3;
             if (x > 0)
                 while (x--) {
@@ -31,6 +31,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../platform_shim.h"
 #include "cfgwnd.h"
 #include "draw.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "r_unkn.h"
 #include "render.h"
@@ -81,7 +82,7 @@ C_RenderTransitionClass::~C_RenderTransitionClass()
     }
     for (x = 0; x < 4; x++) {
         if (fbs[x])
-            GlobalFree(fbs[x]);
+            fba_free(fbs[x]);
         fbs[x] = NULL;
     }
 }
@@ -109,12 +110,12 @@ unsigned int WINAPI C_RenderTransitionClass::m_initThread(LPVOID p)
             d = THREAD_PRIORITY_IDLE;
         SetThreadPriority(GetCurrentThread(), d);
     }
-    int* fb = (int*)GlobalAlloc(GPTR, _this->l_w * _this->l_h * sizeof(int));
+    int* fb = (int*)fba_alloc(_this->l_w * _this->l_h * sizeof(int), 1);
     char last_visdata[2][2][576] = {
         0,
     };
     g_render_effects2->render(last_visdata, 0x80000000, fb, fb, _this->l_w, _this->l_h);
-    GlobalFree((HGLOBAL)fb);
+    fba_free(fb);
 
     _this->_dotransitionflag = 2;
 
@@ -223,7 +224,7 @@ int C_RenderTransitionClass::render(char visdata[2][2][576], int isBeat, int* fr
         if (fbs[0])
             for (x = 0; x < 4; x++) {
                 if (fbs[x]) {
-                    GlobalFree(fbs[x]);
+                    fba_free(fbs[x]);
                     fbs[x] = NULL;
                 }
             }
@@ -241,8 +242,8 @@ int C_RenderTransitionClass::render(char visdata[2][2][576], int isBeat, int* fr
         int x;
         for (x = 0; x < 4; x++) {
             if (fbs[x])
-                GlobalFree(fbs[x]);
-            fbs[x] = (int*)GlobalAlloc(GPTR, l_w * l_h * sizeof(int));
+                fba_free(fbs[x]);
+            fbs[x] = (int*)fba_alloc(l_w * l_h * sizeof(int), 1);
         }
     }
 
@@ -478,7 +479,7 @@ int C_RenderTransitionClass::render(char visdata[2][2][576], int isBeat, int* fr
         start_time = 0;
         for (x = 0; x < 4; x++) {
             if (fbs[x])
-                GlobalFree(fbs[x]);
+                fba_free(fbs[x]);
             fbs[x] = NULL;
         }
         g_render_effects2->clearRenders();
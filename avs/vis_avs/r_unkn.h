@@ -30,7 +30,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _R_UNKN_H_
 #define _R_UNKN_H_
 
-#define UNKN_ID 0xffffffff
+#define UNKN_ID ((int)0xffffffff)
 
 class C_UnknClass : public C_RBASE {
 protected:
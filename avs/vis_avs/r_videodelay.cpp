@@ -40,13 +40,14 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Video Delay"
 #define C_DELAY C_VideoDelayClass
 
-class C_DELAY : public C_RBASE {
+class C_DELAY : public C_RBASE2 {
 protected:
 public:
     // standard ape members
     C_DELAY();
     virtual ~C_DELAY();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_POINT | RTRAIT_FBOUT : RTRAIT_POINT; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual char* get_desc();
     virtual void load_config(unsigned char* data, int len);
@@ -30,11 +30,11 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // alphachannel safe 11/21/99
 
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
 
-#include "timing.h"
 
 #ifndef LASER
 
@@ -56,6 +56,7 @@ public:
     virtual int smp_begin(int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual void smp_render(int this_thread, int max_threads, char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
     virtual int smp_finish(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h); // return value is that of render() for fbstuff etc
+    virtual int get_traits() { return enabled ? RTRAIT_RADIUS(1) | RTRAIT_FBOUT : RTRAIT_POINT | RTRAIT_NOOP; }
 
     unsigned int* lastframe;
     int lastframe_len;
@@ -95,7 +96,7 @@ C_THISCLASS::C_THISCLASS()
 C_THISCLASS::~C_THISCLASS()
 {
     if (lastframe)
-        GlobalFree(lastframe);
+        fba_free(lastframe);
 }
 
 #define _R(x) ((x) & 0xff)
@@ -122,9 +123,9 @@ int C_THISCLASS::smp_begin(int max_threads, char visdata[2][2][576], int isBeat,
 
     if (!lastframe || w * h != lastframe_len) {
         if (lastframe)
-            GlobalFree(lastframe);
+            fba_free(lastframe);
         lastframe_len = w * h;
-        lastframe = (unsigned int*)GlobalAlloc(GPTR, w * h * sizeof(int));
+        lastframe = (unsigned int*)fba_alloc(w * h * sizeof(int), 1);
     }
 
     return max_threads;
@@ -169,7 +170,6 @@ void C_THISCLASS::smp_render(int this_thread, int max_threads, char visdata[2][2
     if (this_thread >= max_threads - 1)
         at_bottom = 1;
 
-    timingEnter(0);
 
     {
 
@@ -588,7 +588,6 @@ mmx_water_loop1:
 #ifndef NO_MMX
     __asm emms;
 #endif
-    timingLeave(0);
 }
 
 C_RBASE* R_Water(char* desc)
@@ -28,6 +28,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "resource.h"
 #include <commctrl.h>
@@ -40,12 +41,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MOD_NAME "Trans / Water Bump"
 #define C_THISCLASS C_WaterBumpClass
 
-class C_THISCLASS : public C_RBASE {
+class C_THISCLASS : public C_RBASE2 {
 protected:
 public:
     C_THISCLASS();
     virtual ~C_THISCLASS();
     virtual int render(char visdata[2][2][576], int isBeat, int* framebuffer, int* fbout, int w, int h);
+    virtual int get_traits() { return enabled ? RTRAIT_GLOBAL | RTRAIT_FBOUT | RTRAIT_RANDOM : RTRAIT_POINT | RTRAIT_NOOP; }
     virtual char* get_desc() { return MOD_NAME; }
     virtual HWND conf(HINSTANCE hInstance, HWND hwndParent);
     virtual void load_config(unsigned char* data, int len);
@@ -95,7 +97,7 @@ C_THISCLASS::~C_THISCLASS()
     int i;
     for (i = 0; i < 2; i++) {
         if (buffers[i])
-            GlobalFree(buffers[i]);
+            fba_free(buffers[i]);
         buffers[i] = NULL;
     }
 }
@@ -323,13 +325,13 @@ int C_THISCLASS::render(char visdata[2][2][576], int isBeat, int* framebuffer, i
     if (buffer_w != w || buffer_h != h) {
         for (i = 0; i < 2; i++) {
             if (buffers[i])
-                GlobalFree(buffers[i]);
+                fba_free(buffers[i]);
             buffers[i] = NULL;
         }
     }
     if (buffers[0] == NULL) {
         for (i = 0; i < 2; i++) {
-            buffers[i] = (int*)GlobalAlloc(GPTR, w * h * sizeof(int));
+            buffers[i] = (int*)fba_alloc(w * h * sizeof(int), 1);
         }
         buffer_w = w;
         buffer_h = h;
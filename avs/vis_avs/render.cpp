@@ -29,7 +29,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "render.h"
 #include "../../platform_shim.h"
-#include "timing.h"
+#include "profiler.h"
 #include "undo.h"
 #include "wa_ipc.h"
 #include "wnd.h"
@@ -74,8 +74,10 @@ void Render_Init(HINSTANCE hDllInstance)
     laser_connect();
     g_laser_linelist = createLineList();
 #endif
-    timingInit();
     {
+        // kept as it always was, so presets look the same. blend_simd can't
+        // reproduce it with vector math, so the multiply / adjustable blends
+        // and BLEND4 samplers stay scalar with this table (see blend_simd.h)
         int i, j;
         for (j = 0; j < 256; j++)
             for (i = 0; i < 256; i++)
@@ -111,6 +113,24 @@ void Render_Init(HINSTANCE hDllInstance)
 
 void Render_Quit(HINSTANCE hDllInstance)
 {
+    if (prof_enabled()) {
+        // trace=1 in the ini: the zones of the last frames go next to
+        // vis_avs.dat, before the effects their names point into are gone
+        char TRACE_FILE[MAX_PATH];
+        char* p = TRACE_FILE;
+        strncpy(TRACE_FILE, (char*)SendMessage(GetWinampHwnd(), WM_WA_IPC, 0, IPC_GETINIFILE), MAX_PATH);
+        p += strlen(TRACE_FILE) - 1;
+        while (p >= TRACE_FILE && *p != '\\')
+            p--;
+#ifdef LASER
+        strcpy(p, "\\plugins\\vis_avs_laser_trace.json");
+#else
+        strcpy(p, "\\plugins\\vis_avs_trace.json");
+#endif
+        prof_enable(0);
+        prof_write_chrome_trace(TRACE_FILE);
+    }
+
     if (g_render_transition)
         delete g_render_transition;
     g_render_transition = NULL;
@@ -141,7 +161,6 @@ void Render_Quit(HINSTANCE hDllInstance)
         delete g_render_library;
     g_render_library = NULL;
 
-    timingPrint();
 #ifdef LASER
     if (g_laser_linelist)
         delete g_laser_linelist;
@@ -0,0 +1,170 @@
+#include "render_scale.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RSCALE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RSCALE_NEON 1
+#endif
+
+int g_render_scale = -1;
+double g_render_scale_budget_ms = 1000.0 / 60.0;
+
+double rscale_factor(int setting)
+{
+    switch (setting) {
+    case RSCALE_75:
+        return 0.75;
+    case RSCALE_50:
+        return 0.5;
+    case RSCALE_AUTO:
+        return 0.0;
+    }
+    return 1.0;
+}
+
+void rscale_size(int w, int h, double scale, int* sw, int* sh)
+{
+    int x = (int)(w * scale + 0.5), y = (int)(h * scale + 0.5);
+    *sw = x < 2 ? 2 : x > w ? w : x;
+    *sh = y < 2 ? 2 : y > h ? h : y;
+}
+
+// (a * (256 - f) + b * f) / 256 on all four channels, two at a time in 0x00ff00ff
+static inline unsigned int lerp_px(unsigned int a, unsigned int b, unsigned int f)
+{
+    unsigned int rb = (((a & 0xff00ff) << 8) + ((b & 0xff00ff) - (a & 0xff00ff)) * f) >> 8;
+    unsigned int ag = ((((a >> 8) & 0xff00ff) << 8) + (((b >> 8) & 0xff00ff) - ((a >> 8) & 0xff00ff)) * f);
+    return (rb & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+// the same over a row
+static void lerp_row(unsigned int* out, const unsigned int* a, const unsigned int* b, int n, int f)
+{
+    int i = 0;
+    if (!f) {
+        memcpy(out, a, n * sizeof(int));
+        return;
+    }
+#if RSCALE_SSE2
+    // a * (256 - f) + b * f stays under 65536, so unsigned 16 bit lanes do
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i fa = _mm_set1_epi16((short)(256 - f)), fb = _mm_set1_epi16((short)f);
+    for (; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), fa), _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), fb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), fa), _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), fb));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+#elif RSCALE_NEON
+    const uint8x8_t fa = vdup_n_u8((uint8_t)(256 - f)), fb = vdup_n_u8((uint8_t)f);
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t va = vld1q_u8((const uint8_t*)(a + i));
+        uint8x16_t vb = vld1q_u8((const uint8_t*)(b + i));
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), fa), vget_low_u8(vb), fb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), fa), vget_high_u8(vb), fb);
+        vst1q_u8((uint8_t*)(out + i), vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = lerp_px(a[i], b[i], f);
+}
+
+// out[x] = row[col[x]] blended with its right neighbour by colw[x], which
+// holds the two weights (256 - f, f) as 16 bit halves
+static void sample_row(unsigned int* out, const unsigned int* row, const int* col, const int* colw, int n)
+{
+    int x = 0;
+#if RSCALE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= n; x += 4) {
+        __m128i r[4];
+        int k;
+        for (k = 0; k < 4; k++) {
+            // a and b side by side, interleaved per channel, times their weights
+            __m128i ab = _mm_loadl_epi64((const __m128i*)(row + col[x + k]));
+            ab = _mm_unpacklo_epi8(_mm_unpacklo_epi8(ab, _mm_srli_si128(ab, 4)), zero);
+            r[k] = _mm_srli_epi32(_mm_madd_epi16(ab, _mm_set1_epi32(colw[x + k])), 8);
+        }
+        __m128i px = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+        _mm_storeu_si128((__m128i*)(out + x), px);
+    }
+#endif
+    for (; x < n; x++)
+        out[x] = lerp_px(row[col[x]], row[col[x] + 1], colw[x] >> 16);
+}
+
+void rscale_resize(int* dst, int dw, int dh, const int* src, int sw, int sh)
+{
+    // separable: each destination row is two source rows blended (kept
+    // while consecutive rows share them), then sampled across. positions
+    // are 16.16 pixel centres, clamped to the edge pixels
+    std::vector<int> col(dw);
+    std::vector<int> colw(dw);
+    std::vector<unsigned int> row(sw + 1);
+    const int dx = (int)(((long long)sw << 16) / dw);
+    const int dy = (int)(((long long)sh << 16) / dh);
+    int x, y, pos;
+    for (x = 0, pos = dx / 2 - 0x8000; x < dw; x++, pos += dx) {
+        int p = pos < 0 ? 0 : pos > ((sw - 1) << 16) ? ((sw - 1) << 16) : pos;
+        col[x] = p >> 16;
+        int f = (p >> 8) & 0xff;
+        colw[x] = (256 - f) | (f << 16);
+    }
+    int have = -1, havef = -1;
+    for (y = 0, pos = dy / 2 - 0x8000; y < dh; y++, pos += dy) {
+        int p = pos < 0 ? 0 : pos > ((sh - 1) << 16) ? ((sh - 1) << 16) : pos;
+        int sy = p >> 16, f = (p >> 8) & 0xff;
+        if (sy != have || f != havef) {
+            const unsigned int* a = (const unsigned int*)src + sy * sw;
+            lerp_row(row.data(), a, f ? a + sw : a, sw, f);
+            row[sw] = row[sw - 1];
+            have = sy;
+            havef = f;
+        }
+        sample_row((unsigned int*)dst + y * dw, row.data(), col.data(), colw.data(), dw);
+    }
+}
+
+void rscale_ctl_init(RSCALE_CTL* c, double budget_ms)
+{
+    c->budget_ms = budget_ms;
+    c->scale = 1.0;
+    c->n = c->pos = 0;
+}
+
+double rscale_ctl_update(RSCALE_CTL* c, double frame_ms)
+{
+    c->ms[c->pos] = (float)frame_ms;
+    c->pos = (c->pos + 1) % RSCALE_WINDOW;
+    if (++c->n < RSCALE_WINDOW)
+        return c->scale;
+
+    float sorted[RSCALE_WINDOW];
+    std::copy(c->ms, c->ms + RSCALE_WINDOW, sorted);
+    const int k = RSCALE_WINDOW * 95 / 100;
+    std::nth_element(sorted, sorted + k, sorted + RSCALE_WINDOW);
+    const double p95 = sorted[k];
+
+    double next = c->scale;
+    if (p95 > c->budget_ms) {
+        // time goes with the pixel count; aim a little under the budget and
+        // round down to sixteenths so small jitter doesn't keep resizing
+        next = c->scale * sqrt(c->budget_ms / p95) * 0.95;
+        next = floor(next * 16.0) / 16.0;
+    } else if (p95 < c->budget_ms * 0.6 && c->scale < 1.0)
+        next = c->scale + 0.125;
+    next = next < RSCALE_MIN ? RSCALE_MIN : next > 1.0 ? 1.0 : next;
+    if (next != c->scale) {
+        c->scale = next;
+        c->n = 0; // the next decision only looks at frames at this scale
+    } else
+        c->n = RSCALE_WINDOW / 2; // keep sliding, with half a window of hysteresis
+    return c->scale;
+}
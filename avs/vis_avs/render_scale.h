@@ -0,0 +1,47 @@
+// Internal render scale: the root list renders its chain at a fraction of
+// the output size and stretches the result back up with a separable
+// bilinear filter, so fill-rate bound presets (Blur, Water, Bump, Movement)
+// cost about scale^2 of their full size time. The scale comes
+// from the preset (root list mode bits 2-3), unless the host overrides it;
+// RSCALE_AUTO lets a frame-time controller pick it.
+
+#ifndef _RENDER_SCALE_H_
+#define _RENDER_SCALE_H_
+
+#define RSCALE_FULL 0
+#define RSCALE_75 1
+#define RSCALE_50 2
+#define RSCALE_AUTO 3
+
+#define RSCALE_MIN 0.25
+#define RSCALE_WINDOW 60 // frames the controller takes its p95 over
+
+// -1 to use each preset's setting, or an RSCALE_* the host forces
+extern int g_render_scale;
+// frame time the auto setting aims to keep the p95 under
+extern double g_render_scale_budget_ms;
+
+// 1.0, 0.75 or 0.5 for a fixed setting, 0 for RSCALE_AUTO
+double rscale_factor(int setting);
+// w x h scaled, rounded to whole pixels, at least 2 x 2 and at most w x h
+void rscale_size(int w, int h, double scale, int* sw, int* sh);
+// bilinear resize of src (sw x sh) onto dst (dw x dh), pixel centres
+// mapped onto each other; both at least 2 x 2, dst can't alias src
+void rscale_resize(int* dst, int dw, int dh, const int* src, int sw, int sh);
+
+typedef struct {
+    double budget_ms;
+    double scale; // the current one, RSCALE_MIN..1
+    float ms[RSCALE_WINDOW];
+    int n; // samples in ms since the last change
+    int pos;
+} RSCALE_CTL;
+
+void rscale_ctl_init(RSCALE_CTL* c, double budget_ms);
+// the time the last frame took; returns the scale for the next one. scales
+// down at once when the p95 of a full window is over budget, by what the
+// pixel count suggests, and back up an eighth at a time once it has been
+// comfortably under for a window
+double rscale_ctl_update(RSCALE_CTL* c, double frame_ms);
+
+#endif // _RENDER_SCALE_H_
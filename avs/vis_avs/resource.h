@@ -393,6 +393,8 @@
 #define IDC_STATIC_TRANS_NONE 1207
 #define IDC_THREADS 1208
 #define IDC_THREADSBORDER 1209
+#define IDC_RSCALE 1210
+#define IDC_RADIUS_LABEL 1211
 #define IDM_DISPLAY 40001
 #define IDM_PRESETS 40002
 #define IDM_TRANS 40003
@@ -410,7 +412,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE 172
 #define _APS_NEXT_COMMAND_VALUE 40011
-#define _APS_NEXT_CONTROL_VALUE 1210
+#define _APS_NEXT_CONTROL_VALUE 1212
 #define _APS_NEXT_SYMED_VALUE 101
 #endif
 #endif
@@ -29,6 +29,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "rlib.h"
 #include "../../platform_shim.h"
+#include "fb_arena.h"
 #include "r_defs.h"
 #include "r_list.h"
 #include "r_unkn.h"
@@ -99,13 +100,28 @@ void C_RLibrary::add_dofx(void* rf, int has_r2)
     NumRetrFuncs++;
 }
 
-// declarations for built-in effects
+// declarations for built-in effects. all of them are C_RBASE2 and answer
+// get_traits(), which the 4 tells the render lists
 #define DECLARE_EFFECT(name)           \
     extern C_RBASE*(name)(char* desc); \
-    add_dofx((void*)name, 0);
+    add_dofx((void*)name, 4);
 #define DECLARE_EFFECT2(name)          \
     extern C_RBASE*(name)(char* desc); \
-    add_dofx((void*)name, 1);
+    add_dofx((void*)name, 4 | 1);
+// C_RBASE3 effects, rendered through render() or the SMP route
+#define DECLARE_EFFECT3(name)          \
+    extern C_RBASE*(name)(char* desc); \
+    add_dofx((void*)name, 4 | 2);
+#define DECLARE_EFFECT3_SMP(name)      \
+    extern C_RBASE*(name)(char* desc); \
+    add_dofx((void*)name, 4 | 2 | 1);
+#ifdef _WIN32
+#define DECLARE_EFFECT_WIN32(name) DECLARE_EFFECT(name)
+#else
+// effects that draw through GDI / Video for Windows keep their slot, so the
+// indices of the ones after them still match; presets load them as unknown
+#define DECLARE_EFFECT_WIN32(name) add_dofx(NULL, 0);
+#endif
 
 void C_RLibrary::initfx(void)
 {
@@ -137,24 +153,24 @@ void C_RLibrary::initfx(void)
     DECLARE_EFFECT(R_Clear);
     DECLARE_EFFECT(R_Mirror);
     DECLARE_EFFECT(R_StarField);
-    DECLARE_EFFECT(R_Text);
+    DECLARE_EFFECT_WIN32(R_Text);
     DECLARE_EFFECT(R_Bump);
     DECLARE_EFFECT(R_Mosaic);
     DECLARE_EFFECT(R_WaterBump);
-    DECLARE_EFFECT(R_AVI);
+    DECLARE_EFFECT_WIN32(R_AVI);
     DECLARE_EFFECT(R_Bpm);
-    DECLARE_EFFECT(R_Picture);
+    DECLARE_EFFECT_WIN32(R_Picture);
     DECLARE_EFFECT(R_DDM);
-    DECLARE_EFFECT(R_SScope);
-    DECLARE_EFFECT(R_Invert);
+    DECLARE_EFFECT3_SMP(R_SScope);
+    DECLARE_EFFECT2(R_Invert);
     DECLARE_EFFECT(R_Onetone);
     DECLARE_EFFECT(R_Timescope);
     DECLARE_EFFECT(R_LineMode);
     DECLARE_EFFECT(R_Interferences);
     DECLARE_EFFECT(R_Shift);
     DECLARE_EFFECT2(R_DMove);
-    DECLARE_EFFECT(R_FastBright);
-    DECLARE_EFFECT(R_DColorMod);
+    DECLARE_EFFECT2(R_FastBright);
+    DECLARE_EFFECT2(R_DColorMod);
 }
 
 static const struct
@@ -183,7 +199,11 @@ void C_RLibrary::initbuiltinape(void)
     _add_dll(0, sym, "Builtin_" #sym, 0)
 #define ADD2(sym, name)              \
     extern C_RBASE* sym(char* desc); \
-    _add_dll(0, sym, name, 0)
+    _add_dll(0, sym, name, 4)
+// the same for one with the C_RBASE2 SMP route
+#define ADD2_SMP(sym, name)          \
+    extern C_RBASE* sym(char* desc); \
+    _add_dll(0, sym, name, 4 | 1)
 #ifdef LASER
     ADD(RLASER_Cone);
     ADD(RLASER_BeatHold);
@@ -191,14 +211,15 @@ void C_RLibrary::initbuiltinape(void)
     ADD(RLASER_Bren); // not including it for now
     ADD(RLASER_Transform);
 #else
-    ADD2(R_ChannelShift, "Channel Shift");
-    ADD2(R_ColorReduction, "Color Reduction");
+    ADD2_SMP(R_ChannelShift, "Channel Shift");
+    ADD2_SMP(R_ColorReduction, "Color Reduction");
     ADD2(R_Multiplier, "Multiplier");
     ADD2(R_VideoDelay, "Holden04: Video Delay");
     ADD2(R_MultiDelay, "Holden05: Multi Delay");
 #endif
 #undef ADD
 #undef ADD2
+#undef ADD2_SMP
 }
 
 void C_RLibrary::_add_dll(HINSTANCE hlib, class C_RBASE*(__cdecl* cre)(char*), char* inf, int is_r2)
@@ -292,32 +313,33 @@ void C_RLibrary::initdll()
     }
 }
 
-int C_RLibrary::GetRendererDesc(int which, char* str)
+intptr_t C_RLibrary::GetRendererDesc(int which, char* str)
 {
     *str = 0;
     if (which >= 0 && which < NumRetrFuncs) {
-        RetrFuncs[which].rf(str);
+        if (RetrFuncs[which].rf)
+            RetrFuncs[which].rf(str);
         return 1;
     }
     if (which >= DLLRENDERBASE) {
         which -= DLLRENDERBASE;
         if (which < NumDLLFuncs) {
             DLLFuncs[which].createfunc(str);
-            return (int)DLLFuncs[which].idstring;
+            return (intptr_t)DLLFuncs[which].idstring;
         }
     }
     return 0;
 }
 
-C_RBASE* C_RLibrary::CreateRenderer(int* which, int* has_r2)
+C_RBASE* C_RLibrary::CreateRenderer(intptr_t* which, int* has_r2)
 {
     if (has_r2)
         *has_r2 = 0;
 
-    if (*which >= 0 && *which < NumRetrFuncs) {
+    if (*which >= 0 && *which < NumRetrFuncs && RetrFuncs[*which].rf) {
         if (has_r2)
             *has_r2 = RetrFuncs[*which].is_r2;
-        return RetrFuncs[*which].rf();
+        return RetrFuncs[*which].rf(NULL);
     }
 
     if (*which == LIST_ID)
@@ -331,24 +353,28 @@ C_RBASE* C_RLibrary::CreateRenderer(int* which, int* has_r2)
                 break;
             if (DLLFuncs[x].idstring) {
                 if (!strncmp(p, DLLFuncs[x].idstring, 32)) {
-                    *which = (int)DLLFuncs[x].idstring;
+                    *which = (intptr_t)DLLFuncs[x].idstring;
+                    // the built-in ones; loaded APEs keep the plain route
+                    if (has_r2 && !DLLFuncs[x].hDllInstance)
+                        *has_r2 = DLLFuncs[x].is_r2;
                     return DLLFuncs[x].createfunc(NULL);
                 }
             }
         }
         for (x = 0; x < sizeof(NamedApeToBuiltinTrans) / sizeof(NamedApeToBuiltinTrans[0]); x++) {
-            if (!strncmp(p, NamedApeToBuiltinTrans[x].id, 32)) {
+            if (!strncmp(p, NamedApeToBuiltinTrans[x].id, 32) && RetrFuncs[NamedApeToBuiltinTrans[x].newidx].rf) {
                 *which = NamedApeToBuiltinTrans[x].newidx;
                 if (has_r2)
                     *has_r2 = RetrFuncs[*which].is_r2;
-                return RetrFuncs[*which].rf();
+                return RetrFuncs[*which].rf(NULL);
             }
         }
     }
-    int r = *which;
+    intptr_t r = *which;
     *which = UNKN_ID;
     C_UnknClass* p = new C_UnknClass();
-    p->SetID(r, (r >= DLLRENDERBASE) ? (char*)r : "");
+    // an APE is saved by its idstring, any id past DLLRENDERBASE will do
+    p->SetID((r >= DLLRENDERBASE) ? DLLRENDERBASE : (int)r, (r >= DLLRENDERBASE) ? (char*)r : (char*)"");
     return (C_RBASE*)p;
 }
 
@@ -383,7 +409,7 @@ C_RLibrary::~C_RLibrary()
     NumDLLFuncs = 0;
 }
 
-HINSTANCE C_RLibrary::GetRendererInstance(int which, HINSTANCE hThisInstance)
+HINSTANCE C_RLibrary::GetRendererInstance(intptr_t which, HINSTANCE hThisInstance)
 {
     if (which < DLLRENDERBASE || which == UNKN_ID || which == LIST_ID)
         return hThisInstance;
@@ -411,11 +437,11 @@ void* getGlobalBuffer(int w, int h, int n, int do_alloc)
 
     if (!g_n_buffers[n] || g_n_buffers_w[n] != w || g_n_buffers_h[n] != h) {
         if (g_n_buffers[n])
-            GlobalFree(g_n_buffers[n]);
+            fba_free(g_n_buffers[n]);
         if (do_alloc) {
             g_n_buffers_w[n] = w;
             g_n_buffers_h[n] = h;
-            return g_n_buffers[n] = GlobalAlloc(GPTR, sizeof(int) * w * h);
+            return g_n_buffers[n] = fba_alloc(sizeof(int) * w * h, 1);
         }
 
         g_n_buffers[n] = NULL;
@@ -30,13 +30,15 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _RLIB_H_
 #define _RLIB_H_
 
+#include "r_defs.h"
+
 #define DLLRENDERBASE 16384
 
 class C_RLibrary {
 protected:
     typedef struct
     {
-        C_RBASE* (*rf)(char* desc = NULL);
+        C_RBASE* (*rf)(char* desc);
         int is_r2;
     } rfStruct;
     rfStruct* RetrFuncs;
@@ -64,9 +66,9 @@ protected:
 public:
     C_RLibrary();
     ~C_RLibrary();
-    C_RBASE* CreateRenderer(int* which, int* has_r2);
-    HINSTANCE GetRendererInstance(int which, HINSTANCE hThisInstance);
-    int GetRendererDesc(int which, char* str);
+    C_RBASE* CreateRenderer(intptr_t* which, int* has_r2);
+    HINSTANCE GetRendererInstance(intptr_t which, HINSTANCE hThisInstance);
+    intptr_t GetRendererDesc(int which, char* str);
     // if which is >= DLLRENDERBASE
     // returns "id" of DLL. which is used to enumerate. str is desc
     // otherwise, returns 1 on success, 0 on error
@@ -0,0 +1,186 @@
+// Portable work-stealing thread pool used to drive C_RBASE2::smp_render.
+// Each worker owns a deque of tasks; it pops from the front of its own deque
+// and, once that runs dry, steals from the back of the others. The calling
+// thread takes part as worker 0 so a job with n threads spawns n-1 workers.
+
+#include "smp_pool.h"
+#include "profiler.h"
+
+static C_SmpPool g_smp_pool;
+
+C_SmpPool* C_SmpPool::get()
+{
+    return &g_smp_pool;
+}
+
+void C_SmpPool::shutdown()
+{
+    g_smp_pool.stop();
+}
+
+C_SmpPool::C_SmpPool()
+    : m_generation(0)
+    , m_active(0)
+    , m_busy(0)
+    , m_quit(false)
+{
+}
+
+C_SmpPool::~C_SmpPool()
+{
+    stop();
+}
+
+void C_SmpPool::stop()
+{
+    std::lock_guard<std::mutex> rl(m_run_lock);
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (size_t x = 0; x < m_workers.size(); x++) {
+        if (m_workers[x]->thread.joinable())
+            m_workers[x]->thread.join();
+        delete m_workers[x];
+    }
+    m_workers.clear();
+    std::lock_guard<std::mutex> l(m_lock);
+    m_quit = false;
+    m_active = 0;
+}
+
+void C_SmpPool::grow(int nworkers)
+{
+    if ((int)m_workers.size() >= nworkers)
+        return;
+    // workers scan m_workers without holding m_lock, so wait until they
+    // have all gone back to sleep before touching the vector
+    std::unique_lock<std::mutex> l(m_lock);
+    m_done.wait(l, [this] { return m_busy == 0; });
+    while ((int)m_workers.size() < nworkers) {
+        Worker* w = new Worker;
+        m_workers.push_back(w);
+        int which = (int)m_workers.size() - 1;
+        if (which > 0)
+            w->thread = std::thread(&C_SmpPool::workerProc, this, which, m_generation);
+    }
+}
+
+bool C_SmpPool::popTask(int which, Task& t)
+{
+    Worker* w = m_workers[which];
+    std::lock_guard<std::mutex> l(w->lock);
+    if (w->tasks.empty())
+        return false;
+    t = w->tasks.front();
+    w->tasks.pop_front();
+    return true;
+}
+
+bool C_SmpPool::stealTask(int which, int nqueues, Task& t)
+{
+    int x;
+    for (x = 1; x < nqueues; x++) {
+        Worker* w = m_workers[(which + x) % nqueues];
+        std::lock_guard<std::mutex> l(w->lock);
+        if (!w->tasks.empty()) {
+            t = w->tasks.back();
+            w->tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void C_SmpPool::execTask(const Task& t)
+{
+    Job* job = t.job;
+    {
+        C_ProfZone zone("smp task", job->ctx, t.index);
+        job->proc(job->ctx, t.index, job->ntasks);
+    }
+    if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // job lives on the caller's stack; only pool state is touched from here on
+        std::lock_guard<std::mutex> l(m_lock);
+        m_done.notify_all();
+    }
+}
+
+void C_SmpPool::workerProc(int which, unsigned int generation)
+{
+    prof_set_thread_name("smp worker");
+    for (;;) {
+        int nqueues;
+        {
+            std::unique_lock<std::mutex> l(m_lock);
+            m_wake.wait(l, [&] { return m_quit || m_generation != generation; });
+            if (m_quit)
+                return;
+            generation = m_generation;
+            nqueues = m_active;
+            if (which >= nqueues)
+                continue;
+            m_busy++;
+        }
+
+        Task t;
+        while (popTask(which, t) || stealTask(which, nqueues, t))
+            execTask(t);
+
+        std::lock_guard<std::mutex> l(m_lock);
+        if (!--m_busy)
+            m_done.notify_all();
+    }
+}
+
+void C_SmpPool::run(int nthreads, int ntasks, TaskProc proc, void* ctx)
+{
+    int x;
+    if (ntasks < 1)
+        return;
+    if (nthreads > ntasks)
+        nthreads = ntasks;
+
+    // a second list rendering concurrently (or a nested call) just runs inline
+    std::unique_lock<std::mutex> rl(m_run_lock, std::try_to_lock);
+    if (nthreads < 2 || !rl.owns_lock()) {
+        for (x = 0; x < ntasks; x++)
+            proc(ctx, x, ntasks);
+        return;
+    }
+
+    grow(nthreads);
+
+    Job job;
+    job.proc = proc;
+    job.ctx = ctx;
+    job.ntasks = ntasks;
+    job.remaining.store(ntasks, std::memory_order_relaxed);
+
+    // deal contiguous slices round-robin so neighbouring slices start on
+    // different workers; expensive regions get spread and stolen as needed
+    for (x = 0; x < ntasks; x++) {
+        Worker* w = m_workers[x % nthreads];
+        std::lock_guard<std::mutex> l(w->lock);
+        Task t = { &job, x };
+        w->tasks.push_back(t);
+    }
+
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_active = nthreads;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    Task t;
+    while (popTask(0, t) || stealTask(0, nthreads, t))
+        execTask(t);
+
+    // out of tasks to take: whatever is left is the barrier wait on the
+    // slowest worker
+    PROF_ZONE("smp wait");
+    std::unique_lock<std::mutex> l(m_lock);
+    m_done.wait(l, [&] { return job.remaining.load(std::memory_order_acquire) == 0; });
+}
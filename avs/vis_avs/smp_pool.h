@@ -0,0 +1,68 @@
+// Portable work-stealing thread pool used to drive C_RBASE2::smp_render.
+// Replaces the per-thread CreateEvent start/done pairs that r_list.cpp used.
+
+#ifndef _SMP_POOL_H_
+#define _SMP_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class C_SmpPool {
+public:
+    typedef void (*TaskProc)(void* ctx, int task, int ntasks);
+
+    // process-wide pool shared by every render list
+    static C_SmpPool* get();
+    // joins all workers; the pool restarts lazily on the next run()
+    static void shutdown();
+
+    C_SmpPool();
+    ~C_SmpPool();
+
+    // runs proc(ctx, i, ntasks) for i in [0, ntasks) on up to nthreads threads
+    // (the calling thread included) and returns once every task is done.
+    // tasks are dealt round-robin to per-worker deques; idle workers steal.
+    void run(int nthreads, int ntasks, TaskProc proc, void* ctx);
+
+    int getNumWorkers() { return (int)m_workers.size(); }
+
+private:
+    struct Job {
+        TaskProc proc;
+        void* ctx;
+        int ntasks;
+        std::atomic<int> remaining;
+    };
+    struct Task {
+        Job* job;
+        int index;
+    };
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void grow(int nworkers);
+    void stop();
+    void workerProc(int which, unsigned int generation);
+    bool popTask(int which, Task& t);
+    bool stealTask(int which, int nqueues, Task& t);
+    void execTask(const Task& t);
+
+    std::vector<Worker*> m_workers; // slot 0 is the calling thread
+    std::mutex m_run_lock; // one job in flight at a time
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    unsigned int m_generation;
+    int m_active; // number of queues the current job was dealt across
+    int m_busy; // workers currently scanning the queues
+    bool m_quit;
+};
+
+#endif // _SMP_POOL_H_
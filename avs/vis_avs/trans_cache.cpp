@@ -0,0 +1,115 @@
+// Process-wide LRU cache of Trans / Movement displacement tables.
+// Entries are shared_ptrs, so evicting a table that an effect is still
+// rendering with only drops the cache's reference to it.
+
+#include "trans_cache.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#define TRANS_CACHE_DEFAULT_BUDGET (128u << 20)
+
+static C_TransCache g_trans_cache;
+
+C_TransCache* C_TransCache::get()
+{
+    return &g_trans_cache;
+}
+
+C_TransCache::C_TransCache()
+    : m_bytes(0)
+    , m_budget(TRANS_CACHE_DEFAULT_BUDGET)
+{
+}
+
+C_TransTableRef C_TransCache::find(const C_TransKey& key)
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->key == key) {
+            if (it != m_entries.begin())
+                m_entries.splice(m_entries.begin(), m_entries, it);
+            return m_entries.front().table;
+        }
+    }
+    return C_TransTableRef();
+}
+
+void C_TransCache::insert(const C_TransKey& key, const C_TransTableRef& table)
+{
+    if (!table)
+        return;
+    size_t bytes = table->tab.size() * sizeof(int);
+    std::lock_guard<std::mutex> l(m_lock);
+    if (bytes > m_budget)
+        return;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->key == key) {
+            m_bytes -= it->bytes;
+            m_entries.erase(it);
+            break;
+        }
+    }
+    m_entries.push_front(Entry { key, table, bytes });
+    m_bytes += bytes;
+    trim();
+}
+
+void C_TransCache::clear()
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+void C_TransCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    m_budget = bytes;
+    trim();
+}
+
+size_t C_TransCache::getBytes()
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_bytes;
+}
+
+void C_TransCache::trim()
+{
+    while (m_bytes > m_budget && !m_entries.empty()) {
+        m_bytes -= m_entries.back().bytes;
+        m_entries.pop_back();
+    }
+}
+
+unsigned int C_TransCache::hashCode(const char* code)
+{
+    unsigned int h = 2166136261u;
+    if (code)
+        while (*code) {
+            h ^= (unsigned char)*code++;
+            h *= 16777619u;
+        }
+    return h ? h : 1;
+}
+
+bool C_TransCache::codeIsVolatile(const char* code)
+{
+    // matched case-insensitively as substrings, so this errs towards not
+    // caching (a variable named "budget" defeats the cache, which is harmless)
+    static const char* const names[] = { "get", "rand", "megabuf", "reg" };
+    if (!code)
+        return false;
+    for (const char* p = code; *p; p++) {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            size_t n = strlen(names[i]);
+            size_t j = 0;
+            while (j < n && p[j] && tolower((unsigned char)p[j]) == names[i][j])
+                j++;
+            if (j == n)
+                return true;
+        }
+    }
+    return false;
+}
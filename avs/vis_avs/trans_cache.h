@@ -0,0 +1,81 @@
+// Process-wide LRU cache of Trans / Movement displacement tables.
+// Tables depend only on their key, so presets that share an effect and
+// resolution (or a preset that is switched away from and back to) reuse the
+// table instead of re-running the per-pixel radial math or eval code.
+
+#ifndef _TRANS_CACHE_H_
+#define _TRANS_CACHE_H_
+
+#include "fb_arena.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct C_TransKey {
+    int effect;
+    int w, h;
+    int subpixel; // requested subpixel mode, before the size/effect checks
+    int wrap;
+    int rect;
+    unsigned int code_hash; // 0 unless the table comes from eval code
+    std::string code; // the code itself, so a hash collision can't match
+
+    bool operator==(const C_TransKey& k) const
+    {
+        return effect == k.effect && w == k.w && h == k.h && subpixel == k.subpixel && wrap == k.wrap && rect == k.rect && code_hash == k.code_hash && code == k.code;
+    }
+};
+
+struct C_TransTable {
+    int w, h;
+    int subpixel; // entries carry 5.5 bit fractional offsets in the high bits
+    int independent; // no eval code, or code that carries nothing from pixel to pixel
+    std::vector<int, fba_allocator<int>> tab; // frame sized, so it comes from the pool
+};
+
+typedef std::shared_ptr<const C_TransTable> C_TransTableRef;
+
+class C_TransCache {
+public:
+    static C_TransCache* get();
+
+    C_TransCache();
+
+    // returns the cached table for key (and marks it most recently used), or
+    // an empty ref on a miss
+    C_TransTableRef find(const C_TransKey& key);
+    // adds a freshly generated table, evicting least recently used entries
+    // until the cache fits its budget again. tables still referenced by an
+    // effect stay alive until that effect drops them.
+    void insert(const C_TransKey& key, const C_TransTableRef& table);
+    void clear();
+
+    void setBudget(size_t bytes);
+    size_t getBytes();
+
+    // FNV-1a over an expression, for C_TransKey::code_hash. never returns 0.
+    static unsigned int hashCode(const char* code);
+    // true if an expression reads state other than the pixel position (audio,
+    // time, rand, global registers or buffers), which makes its table
+    // uncacheable
+    static bool codeIsVolatile(const char* code);
+
+private:
+    struct Entry {
+        C_TransKey key;
+        C_TransTableRef table;
+        size_t bytes;
+    };
+
+    void trim();
+
+    std::mutex m_lock;
+    std::list<Entry> m_entries; // most recently used first
+    size_t m_bytes;
+    size_t m_budget;
+};
+
+#endif // _TRANS_CACHE_H_
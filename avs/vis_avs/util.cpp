@@ -296,6 +296,14 @@ static void _dosetsel(HWND hwndDlg)
                "    which_parm = 5: mouse middle button state (0 up, 1 down)\r\n"
                "    which_parm > 5: (GetAsyncKeyState(which_parm)&0x8000)?1:0\r\n"
                "\r\n"
+               "gettempo(which_parm)\r\n"
+               "  = returns the tempo tracked from the music (0 when the host has no tracker)\r\n"
+               "    which_parm = 0: beats per minute (0 while unknown)\r\n"
+               "    which_parm = 1: position in the current beat (0..1, 0 on the beat)\r\n"
+               "    which_parm = 2: confidence in the tempo (0..1)\r\n"
+               "    which_parm = 3: onset strength of this frame (0..1)\r\n"
+               "    which_parm = 4: beats counted so far\r\n"
+               "\r\n"
 #ifdef AVS_MEGABUF_SUPPORT
                "megabuf(index)\r\n"
                "  = can be used to get or set an item from the 1 million item temp buffer\r\n"
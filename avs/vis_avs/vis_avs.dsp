@@ -175,6 +175,22 @@ SOURCE=.\r_blur.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\blend_simd.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\blend_simd.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\blur_box.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\blur_box.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\r_bpm.cpp
 # End Source File
 # Begin Source File
@@ -203,6 +219,14 @@ SOURCE=.\r_colorfade.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\color_lut.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\color_lut.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\r_colorreduction.cpp
 # End Source File
 # Begin Source File
@@ -239,6 +263,14 @@ SOURCE=.\r_dotpln.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\fb_arena.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\fb_arena.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\r_fadeout.cpp
 # End Source File
 # Begin Source File
@@ -351,6 +383,14 @@ SOURCE=.\r_timescope.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\trans_cache.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\trans_cache.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\r_trans.cpp
 # End Source File
 # Begin Source File
@@ -421,6 +461,10 @@ SOURCE="..\ns-eel\ns-eel.h"
 # End Source File
 # Begin Source File
 
+SOURCE="..\ns-eel\nseel-batch.c"
+# End Source File
+# Begin Source File
+
 SOURCE="..\ns-eel\nseel-caltab.c"
 # End Source File
 # Begin Source File
@@ -450,12 +494,20 @@ SOURCE="..\ns-eel\nseel-eval.c"
 # End Source File
 # Begin Source File
 
+SOURCE="..\ns-eel\nseel-jit.c"
+# End Source File
+# Begin Source File
+
 SOURCE="..\ns-eel\nseel-lextab.c"
 # End Source File
 # Begin Source File
 
 SOURCE="..\ns-eel\nseel-yylex.c"
 # End Source File
+# Begin Source File
+
+SOURCE="..\ns-eel\nseel-vm.c"
+# End Source File
 # End Group
 # Begin Group "Render utils"
 
@@ -482,6 +534,14 @@ SOURCE=.\r_list.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\render_scale.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\render_scale.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\r_transition.cpp
 # End Source File
 # Begin Source File
@@ -591,11 +651,19 @@ SOURCE=.\rlib.cpp
 # End Source File
 # Begin Source File
 
-SOURCE=.\TIMING.C
+SOURCE=.\profiler.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\profiler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\smp_pool.cpp
 # End Source File
 # Begin Source File
 
-SOURCE=.\TIMING.H
+SOURCE=.\smp_pool.h
 # End Source File
 # Begin Source File
 
@@ -603,6 +671,14 @@ SOURCE=.\undo.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\visdata_ex.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\visdata_ex.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\wnd.cpp
 # End Source File
 # End Group
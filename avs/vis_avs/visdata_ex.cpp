@@ -0,0 +1,41 @@
+#include "visdata_ex.h"
+#include <math.h>
+
+const VisDataEx* g_visdata_ex;
+VisTempo g_vis_tempo;
+
+float visdata_ex_spec_curve(float mag)
+{
+    // log(x * 60 / 255 + 1) / log(60) over bytes, as a float curve
+    if (mag <= 0.0f)
+        return 0.0f;
+    if (mag >= 1.0f)
+        return 1.0f;
+    return logf(mag * 60.0f + 1.0f) / logf(60.0f);
+}
+
+void visdata_ex_to_legacy(const VisDataEx* ex)
+{
+    int ch, x;
+    for (ch = 0; ch < 2; ch++) {
+        const float* wave = ex->waveform[ch] + ex->samples - 576;
+        const float* spec = ex->spectrum[ch];
+        for (x = 0; x < 576; x++) {
+            float s = wave[x] * 127.0f;
+            int v = (int)(s < 0.0f ? s - 0.5f : s + 0.5f);
+            ex->legacy[1][ch][x] = (char)(v < -128 ? -128 : v > 127 ? 127 : v);
+
+            int b0 = (int)(((long long)x * ex->bins) / 576);
+            int b1 = (int)(((long long)(x + 1) * ex->bins) / 576);
+            float m = spec[b0];
+            for (b0++; b0 < b1; b0++)
+                if (spec[b0] > m)
+                    m = spec[b0];
+            // the curve is applied to the byte, the way main.cpp's table is
+            int byte = (int)(m * 255.0f);
+            if (byte > 255)
+                byte = 255;
+            ex->legacy[0][ch][x] = (char)(int)(visdata_ex_spec_curve(byte / 255.0f) * 255.0f);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+// Extended audio frame: float waveform and spectrum at 1024-4096 samples /
+// bins per channel instead of the 576 8-bit values of visdata[2][2][576].
+// A host that has one sets g_visdata_ex around its render call; effects
+// derived from C_RBASE3 get it from their list before each render, every
+// other effect keeps getting the legacy bytes, which the host builds from
+// the extended frame once per frame (visdata_ex_to_legacy).
+
+#ifndef _VISDATA_EX_H_
+#define _VISDATA_EX_H_
+
+#define VISDATA_EX_MIN 1024
+#define VISDATA_EX_MAX 4096
+
+typedef struct {
+    int samples; // waveform samples per channel, VISDATA_EX_MIN..MAX
+    int bins; // spectrum bins per channel, spanning 0 .. rate / 2
+    const float* waveform[2]; // the newest samples, oldest first, -1..1
+    const float* spectrum[2]; // linear magnitude, a full scale sine near 1.0
+    const float* bands; // optional log-spaced band vector (0..1), or NULL
+    int num_bands;
+    char (*legacy)[2][576]; // the bytes the legacy effects get this frame
+} VisDataEx;
+
+// the frame being rendered, or NULL when the host only has legacy data
+extern const VisDataEx* g_visdata_ex;
+
+// g_visdata_ex if it belongs to the legacy visdata a list was handed, so a
+// list rendered with other data (or none of the host's) never mixes the two
+static inline const VisDataEx* visdata_ex_for(char visdata[2][2][576])
+{
+    return g_visdata_ex && g_visdata_ex->legacy == visdata ? g_visdata_ex : 0;
+}
+
+// the legacy view of ex into ex->legacy: the newest 576 samples as signed
+// bytes, and the spectrum folded onto 576 entries (peak of the bins each one
+// covers) through main.cpp's log curve
+void visdata_ex_to_legacy(const VisDataEx* ex);
+
+// main.cpp's spectrum curve on a linear magnitude, 0..1 for 0..1
+float visdata_ex_spec_curve(float mag);
+
+// tempo of what is being rendered, for gettempo() in scripts. A host with a
+// beat tracker fills it in before each render; without one it stays zero
+typedef struct {
+    double bpm; // 0 while unknown
+    double phase; // 0..1 through the current beat, 0 on the beat
+    double confidence; // 0..1
+    double onset; // onset strength of this frame, 0..1
+    double beats; // beats counted so far
+} VisTempo;
+
+extern VisTempo g_vis_tempo;
+
+#endif // _VISDATA_EX_H_
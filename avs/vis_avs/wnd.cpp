@@ -31,6 +31,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../platform_shim.h"
 #include "cfgwnd.h"
 #include "draw.h"
+#include "profiler.h"
 #include "r_defs.h"
 #include "render.h"
 #include "resource.h"
@@ -424,7 +425,9 @@ void Wnd_GoFullScreen(HWND hwnd)
     }
 }
 
-int g_config_smp_mt = 2, g_config_smp = 0;
+int g_config_smp_mt = 2, g_config_smp = 0, g_config_tiles = 1;
+// record profiler zones, written out as a Chrome trace by Render_Quit()
+int g_config_trace = 0;
 static char* INI_FILE;
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
@@ -477,7 +480,10 @@ int Wnd_Init(struct winampVisModule* this_mod)
 #else
         g_config_smp = GetPrivateProfileInt(AVS_SECTION, "smp", 0, INI_FILE);
         g_config_smp_mt = GetPrivateProfileInt(AVS_SECTION, "smp_mt", 2, INI_FILE);
+        g_config_tiles = GetPrivateProfileInt(AVS_SECTION, "tiles", 1, INI_FILE);
 #endif
+        g_config_trace = GetPrivateProfileInt(AVS_SECTION, "trace", 0, INI_FILE);
+        prof_enable(g_config_trace);
         need_redock = GetPrivateProfileInt(AVS_SECTION, "cfg_docked", 0, INI_FILE);
         cfg_cfgwnd_x = GetPrivateProfileInt(AVS_SECTION, "cfg_cfgwnd_x", cfg_cfgwnd_x, INI_FILE);
         cfg_cfgwnd_y = GetPrivateProfileInt(AVS_SECTION, "cfg_cfgwnd_y", cfg_cfgwnd_y, INI_FILE);
@@ -639,7 +645,9 @@ void Wnd_Quit(void)
 #else
         WriteInt("smp", g_config_smp);
         WriteInt("smp_mt", g_config_smp_mt);
+        WriteInt("tiles", g_config_tiles);
 #endif
+        WriteInt("trace", g_config_trace);
 #ifdef WA2_EMBED
         WriteInt("wx", myWindowState.r.left);
         WriteInt("wy", myWindowState.r.top);
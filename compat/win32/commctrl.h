@@ -0,0 +1,4 @@
+// Stand-in for the Win32 <commctrl.h> on other platforms: the declarations the
+// legacy sources use from it live in platform_shim.h.
+#pragma once
+#include "../../platform_shim.h"
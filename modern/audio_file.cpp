@@ -0,0 +1,62 @@
+#include "audio_file.h"
+#include "../standalone/wav_read.h"
+#include "fft_analyzer.h"
+#include <algorithm>
+#include <chrono>
+
+FileAudioSource::FileAudioSource(FFTAnalyzer& sink)
+    : m_sink(sink)
+{
+}
+
+FileAudioSource::~FileAudioSource()
+{
+    m_quit = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool FileAudioSource::open(const char* path, int sampleRate, std::string& err)
+{
+    m_rate = sampleRate;
+    m_pcm.clear();
+    m_pushed = 0;
+    if (!wav_read_stereo(path, sampleRate, m_pcm, err))
+        return false;
+    if (m_pcm.empty()) {
+        err = "no audio in file";
+        return false;
+    }
+    return true;
+}
+
+void FileAudioSource::startRealtime(int periodFrames)
+{
+    m_thread = std::thread(&FileAudioSource::feed, this, std::max(periodFrames, 1));
+}
+
+void FileAudioSource::feed(int periodFrames)
+{
+    const auto period = std::chrono::duration<double>((double)periodFrames / m_rate);
+    auto next = std::chrono::steady_clock::now();
+    while (!m_quit && m_pushed < frames()) {
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(next);
+        size_t n = std::min((size_t)periodFrames, frames() - m_pushed);
+        m_sink.push(&m_pcm[m_pushed * 2], n);
+        m_pushed += n;
+    }
+}
+
+bool FileAudioSource::advanceTo(double seconds)
+{
+    size_t target = std::min(frames(), (size_t)std::max(0.0, seconds * m_rate));
+    // blocks well under the analyzer's input ring, each stamped with the
+    // file time just past its last frame
+    while (m_pushed < target) {
+        size_t n = std::min<size_t>(4096, target - m_pushed);
+        m_sink.push(&m_pcm[m_pushed * 2], n, timeNs((double)(m_pushed + n) / m_rate));
+        m_pushed += n;
+    }
+    return seconds * m_rate < (double)frames();
+}
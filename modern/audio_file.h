@@ -0,0 +1,43 @@
+// Decoded audio file as the runner's input
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FFTAnalyzer;
+
+// Decodes the whole WAV file up front to stereo float at the analysis rate.
+// It then either feeds the analyzer on the wall clock like a capture
+// device, or, for offline rendering, exactly as far as each frame's time
+// asks for, stamped on the file's own timeline, so the run goes as fast as
+// frames render.
+class FileAudioSource {
+public:
+    explicit FileAudioSource(FFTAnalyzer& sink);
+    ~FileAudioSource();
+
+    bool open(const char* path, int sampleRate, std::string& err);
+    int sampleRate() const { return m_rate; }
+    double duration() const { return (double)frames() / m_rate; }
+
+    // real-time: a feeder thread pushes periodFrames blocks until the end
+    void startRealtime(int periodFrames);
+    // offline: pushes everything up to seconds into the file; false once
+    // seconds is past the end
+    bool advanceTo(double seconds);
+    // analyzer time of a point in the file, for FFTAnalyzer::compute()
+    static int64_t timeNs(double seconds) { return (int64_t)(seconds * 1e9); }
+
+private:
+    size_t frames() const { return m_pcm.size() / 2; }
+    void feed(int periodFrames);
+
+    FFTAnalyzer& m_sink;
+    std::vector<float> m_pcm; // interleaved stereo
+    int m_rate = 48000;
+    size_t m_pushed = 0; // frames handed to the sink
+    std::atomic<bool> m_quit { false };
+    std::thread m_thread;
+};
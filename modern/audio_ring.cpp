@@ -0,0 +1,71 @@
+#include "audio_ring.h"
+#include <algorithm>
+#include <cstring>
+
+AudioRing::AudioRing(size_t capacityFrames)
+{
+    m_capacity = 64;
+    while (m_capacity < capacityFrames)
+        m_capacity <<= 1;
+    m_mask = m_capacity - 1;
+    m_data.assign(m_capacity * 2, 0.0f);
+}
+
+bool AudioRing::write(const float* in, size_t frames, int64_t timeNs)
+{
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (head + frames - m_tailCache > m_capacity) {
+        m_tailCache = m_tail.load(std::memory_order_acquire);
+        if (head + frames - m_tailCache > m_capacity) {
+            m_dropped.fetch_add(frames, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    size_t at = (size_t)(head & m_mask);
+    size_t first = std::min(frames, m_capacity - at);
+    std::memcpy(&m_data[at * 2], in, first * 2 * sizeof(float));
+    if (first < frames)
+        std::memcpy(&m_data[0], in + first * 2, (frames - first) * 2 * sizeof(float));
+    m_head.store(head + frames, std::memory_order_release);
+
+    // a stamp that doesn't fit is skipped; the reader extrapolates from the
+    // previous one at the sample rate
+    const uint64_t sh = m_stampHead.load(std::memory_order_relaxed);
+    if (sh - m_stampTailCache >= kStamps)
+        m_stampTailCache = m_stampTail.load(std::memory_order_acquire);
+    if (sh - m_stampTailCache < kStamps) {
+        m_stamps[sh % kStamps] = { head + frames, timeNs };
+        m_stampHead.store(sh + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+size_t AudioRing::read(float* out, size_t maxFrames)
+{
+    const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    if (m_headCache - tail < maxFrames)
+        m_headCache = m_head.load(std::memory_order_acquire);
+    size_t frames = (size_t)std::min<uint64_t>(maxFrames, m_headCache - tail);
+    if (!frames)
+        return 0;
+    size_t at = (size_t)(tail & m_mask);
+    size_t first = std::min(frames, m_capacity - at);
+    std::memcpy(out, &m_data[at * 2], first * 2 * sizeof(float));
+    if (first < frames)
+        std::memcpy(out + first * 2, &m_data[0], (frames - first) * 2 * sizeof(float));
+    m_tail.store(tail + frames, std::memory_order_release);
+    return frames;
+}
+
+bool AudioRing::readStamp(Stamp& out)
+{
+    const uint64_t st = m_stampTail.load(std::memory_order_relaxed);
+    if (m_stampHeadCache == st) {
+        m_stampHeadCache = m_stampHead.load(std::memory_order_acquire);
+        if (m_stampHeadCache == st)
+            return false;
+    }
+    out = m_stamps[st % kStamps];
+    m_stampTail.store(st + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,58 @@
+// Wait-free single-producer / single-consumer ring of stereo float frames
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The capture callback writes, one analysis thread reads. Each side owns one
+// index and publishes it with a release store; the other side reads it with
+// an acquire load and keeps a cached copy, so neither ever waits and the
+// shared cache lines only move when the cached copy runs out. Data moves as
+// at most two memcpy spans per call.
+//
+// Every write also records a stamp (frames written so far, time of the last
+// frame) in a small side ring, which lets the reader map frame positions to
+// capture time.
+class AudioRing {
+public:
+    struct Stamp {
+        uint64_t endFrame; // frames written up to and including this block
+        int64_t timeNs; // steady_clock time of that last frame
+    };
+
+    explicit AudioRing(size_t capacityFrames); // rounded up to a power of two
+
+    // producer: all of the block or nothing, so stamps stay exact; false
+    // (and the block counted as dropped) when the reader is too far behind
+    bool write(const float* interleavedStereo, size_t frames, int64_t timeNs);
+
+    // consumer: up to maxFrames of the oldest unread frames
+    size_t read(float* interleavedStereo, size_t maxFrames);
+    // consumer: the oldest unread stamp
+    bool readStamp(Stamp& out);
+
+    size_t capacity() const { return m_capacity; }
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kStamps = 64;
+    static constexpr size_t kLine = 64;
+
+    size_t m_capacity;
+    size_t m_mask;
+    std::vector<float> m_data; // 2 floats per frame
+    Stamp m_stamps[kStamps];
+
+    // producer line
+    alignas(kLine) std::atomic<uint64_t> m_head { 0 };
+    std::atomic<uint64_t> m_stampHead { 0 };
+    uint64_t m_tailCache = 0;
+    uint64_t m_stampTailCache = 0;
+    std::atomic<uint64_t> m_dropped { 0 };
+    // consumer line
+    alignas(kLine) std::atomic<uint64_t> m_tail { 0 };
+    std::atomic<uint64_t> m_stampTail { 0 };
+    uint64_t m_headCache = 0;
+    uint64_t m_stampHeadCache = 0;
+};
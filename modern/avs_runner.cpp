@@ -1,11 +1,16 @@
 // ...existing code moved from standalone/avs_runner.cpp...
+#include "../avs/vis_avs/profiler.h"
 #include "../avs/vis_avs/r_defs.h"
+#include "../avs/vis_avs/render_scale.h"
 #include "../platform_shim.h"
 #include <atomic>
 #include <chrono>
+#include <cfloat>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <thread>
 #include <vector>
 #if AVS_SDL2
@@ -18,10 +23,13 @@
 #endif
 extern "C" unsigned int avs_portable_demo_pixel(unsigned int a, unsigned int b, int mode);
 extern "C" void avs_portable_tick();
+#include "audio_file.h"
 #include "effect_base.h"
 #include "effect_oscstar.h"
 #include "effect_radial.h"
 #include "fft_analyzer.h"
+#include "frame_pipeline.h"
+#include "perf_stats.h"
 #include "preset_io.h"
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -29,43 +37,37 @@ extern "C" void avs_portable_tick();
 #else
 #define AVS_HAVE_FILESYSTEM 0
 #endif
-static std::atomic<float> g_level { 0.0f };
 static FFTAnalyzer g_fft(2048, 64);
 static std::vector<float> g_spec;
 static OscStarParams g_starParams;
+static PerfStats g_perf;
 #if AVS_SDL2
 struct AudioCapture {
     SDL_AudioDeviceID dev = 0;
     std::atomic<bool> ok { false };
+    int rate = 0;
     static void callback(void*, Uint8*, int);
-    void init(const char* deviceName = nullptr);
+    void init(const char* deviceName = nullptr, int periodFrames = 0);
     ~AudioCapture();
 };
+// capture devices that hear what is being played: the monitor source of a
+// PulseAudio (or PipeWire) sink, or the ALSA snd-aloop loopback card
+static bool isLoopbackDevice(const char* name)
+{
+    return name && (std::strstr(name, "Monitor of") || std::strstr(name, "Loopback"));
+}
 void AudioCapture::callback(void* userdata, Uint8* stream, int lenBytes)
 {
     if (!userdata)
         return;
-    int samples = lenBytes / sizeof(float);
-    float* f = (float*)stream;
-    g_fft.push(f, samples / 2);
-    double sum = 0.0;
-    int frames = samples / 2;
-    for (int i = 0; i < frames; ++i) {
-        double L = f[i * 2];
-        double R = f[i * 2 + 1];
-        double m = 0.5 * (L + R);
-        sum += m * m;
-    }
-    if (frames > 0) {
-        double rms = std::sqrt(sum / frames);
-        float prev = g_level.load(std::memory_order_relaxed);
-        float newv = (float)(prev * 0.85 + rms * 0.15);
-        if (newv > 1)
-            newv = 1;
-        g_level.store(newv, std::memory_order_relaxed);
-    }
+    auto start = std::chrono::steady_clock::now();
+    int frames = lenBytes / (int)(2 * sizeof(float));
+    // the callback only hands frames over; levels and spectra are worked out
+    // on the analysis side
+    g_fft.push((const float*)stream, (size_t)frames);
+    g_perf.audio.onCallback(start, std::chrono::steady_clock::now(), frames, ((AudioCapture*)userdata)->rate);
 }
-void AudioCapture::init(const char* deviceName)
+void AudioCapture::init(const char* deviceName, int periodFrames)
 {
     if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
         printf("SDL audio init failed: %s\n", SDL_GetError());
@@ -75,7 +77,7 @@ void AudioCapture::init(const char* deviceName)
     want.freq = 48000;
     want.format = AUDIO_F32SYS;
     want.channels = 2;
-    want.samples = 1024;
+    want.samples = (Uint16)(periodFrames > 0 ? periodFrames : 256);
     want.callback = callback;
     want.userdata = this;
     dev = SDL_OpenAudioDevice(deviceName, 1, &want, &have, 0);
@@ -83,6 +85,8 @@ void AudioCapture::init(const char* deviceName)
         printf("Audio capture open failed: %s\n", SDL_GetError());
         return;
     }
+    rate = have.freq;
+    g_fft.setSampleRate(have.freq);
     SDL_PauseAudioDevice(dev, 0);
     ok.store(true);
     printf("Audio capture started: %d Hz, channels=%d\n", have.freq, have.channels);
@@ -98,11 +102,69 @@ int main(int argc, char** argv)
     printf("AVS portable runner starting (%s mode)\n", AVS_SDL2 ? "SDL2" : "headless");
     const char* requestedDevice = nullptr;
     bool listDevices = false;
+    int pipelineDepth = 2;
+    double latencyBudgetMs = 34.0;
+    int periodFrames = 0; // backend default, 256 frames
+    bool loopback = false;
+    const char* inputPath = nullptr;
+    bool offline = false;
+    double renderScale = 1.0; // 0 for the frame time controller
+    double frameBudgetMs = 1000.0 / 60.0;
+    const char* tracePath = nullptr;
     for (int i = 1; i < argc; ++i) {
         if (!std::strcmp(argv[i], "--list-devices"))
             listDevices = true;
         else if (!std::strcmp(argv[i], "--device") && i + 1 < argc)
             requestedDevice = argv[++i];
+        else if (!std::strcmp(argv[i], "--pipeline-depth") && i + 1 < argc)
+            pipelineDepth = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--latency-budget") && i + 1 < argc)
+            latencyBudgetMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--fft-hop") && i + 1 < argc)
+            g_fft.setHop((size_t)std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--period") && i + 1 < argc)
+            periodFrames = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--loopback"))
+            loopback = true;
+        else if (!std::strcmp(argv[i], "--input") && i + 1 < argc)
+            inputPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--offline"))
+            offline = true;
+        else if (!std::strcmp(argv[i], "--render-scale") && i + 1 < argc) {
+            ++i;
+            renderScale = !std::strcmp(argv[i], "auto") ? 0.0 : std::min(std::max(std::atof(argv[i]), RSCALE_MIN), 1.0);
+        } else if (!std::strcmp(argv[i], "--frame-budget") && i + 1 < argc)
+            frameBudgetMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+            tracePath = argv[++i];
+    }
+    if (tracePath) {
+        // the zones of the last frames on every thread go to tracePath on exit
+        prof_set_thread_name("main");
+        prof_enable(1);
+    }
+    if (offline && !inputPath) {
+        printf("--offline needs --input <file>\n");
+        return 1;
+    }
+#if !AVS_SDL2
+    if (loopback)
+        printf("--loopback needs the SDL2 build; the headless runner does not capture\n");
+#endif
+
+    // audio comes from a file or (further down, once SDL is up) SDL capture
+    const int kSampleRate = 48000;
+    FileAudioSource fileInput(g_fft);
+    if (inputPath) {
+        std::string err;
+        if (!fileInput.open(inputPath, kSampleRate, err)) {
+            printf("Cannot read %s: %s\n", inputPath, err.c_str());
+            return 1;
+        }
+        g_fft.setSampleRate(kSampleRate);
+        printf("Audio input %s: %.1f s%s\n", inputPath, fileInput.duration(), offline ? ", offline" : "");
+        if (!offline)
+            fileInput.startRealtime(periodFrames > 0 ? periodFrames : 256);
     }
     const int W = 640, H = 360;
     std::vector<unsigned int> fb(W * H, 0x00000000);
@@ -112,36 +174,47 @@ int main(int argc, char** argv)
         return 1;
     }
     AudioCapture audio;
-    if (listDevices) {
+    const bool useSdlAudio = !inputPath;
+    if (useSdlAudio && listDevices) {
         int n = SDL_GetNumAudioDevices(SDL_TRUE);
         printf("Capture devices (%d):\n", n);
-        for (int i = 0; i < n; ++i)
-            printf("  [%d] %s\n", i, SDL_GetAudioDeviceName(i, SDL_TRUE));
+        for (int i = 0; i < n; ++i) {
+            const char* nm = SDL_GetAudioDeviceName(i, SDL_TRUE);
+            printf("  [%d] %s%s\n", i, nm, isLoopbackDevice(nm) ? " (loopback)" : "");
+        }
         if (!requestedDevice)
             return 0;
     }
-    if (requestedDevice) {
+    const char* sdlDevice = nullptr;
+    if (useSdlAudio && (requestedDevice || loopback)) {
         int n = SDL_GetNumAudioDevices(SDL_TRUE);
         int useIndex = -1;
-        char* endp = nullptr;
-        long asNum = strtol(requestedDevice, &endp, 10);
-        if (endp && *endp == '\0' && asNum >= 0 && asNum < n)
-            useIndex = (int)asNum;
+        if (requestedDevice) {
+            char* endp = nullptr;
+            long asNum = strtol(requestedDevice, &endp, 10);
+            if (endp && *endp == '\0' && asNum >= 0 && asNum < n)
+                useIndex = (int)asNum;
+        }
+        // with --loopback a name picks among the loopback devices only
         if (useIndex < 0) {
             for (int i = 0; i < n; ++i) {
                 const char* nm = SDL_GetAudioDeviceName(i, SDL_TRUE);
-                if (nm && std::strstr(nm, requestedDevice)) {
+                if (!nm || (loopback && !isLoopbackDevice(nm)))
+                    continue;
+                if (!requestedDevice || std::strstr(nm, requestedDevice)) {
                     useIndex = i;
                     break;
                 }
             }
         }
-        if (useIndex >= 0)
-            audio.init(SDL_GetAudioDeviceName(useIndex, SDL_TRUE));
-        else
-            audio.init(nullptr);
-    } else
-        audio.init(nullptr);
+        if (useIndex >= 0) {
+            sdlDevice = SDL_GetAudioDeviceName(useIndex, SDL_TRUE);
+            printf("Audio capture device: %s\n", sdlDevice);
+        } else if (loopback)
+            printf("No loopback capture device (PulseAudio \"Monitor of\" source or ALSA snd-aloop \"Loopback\"); using the default\n");
+    }
+    if (useSdlAudio)
+        audio.init(sdlDevice, periodFrames);
     SDL_Window* win = SDL_CreateWindow("AVS Portable", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, W, H, SDL_WINDOW_RESIZABLE);
     if (!win) {
         printf("SDL window fail: %s\n", SDL_GetError());
@@ -163,6 +236,7 @@ int main(int argc, char** argv)
 #endif
     uint64_t frame = 0;
     auto lastPrint = std::chrono::steady_clock::now();
+    const auto runStart = lastPrint;
     bool running = true;
     bool showOverlay = true;
     std::string presetPath = "presets/oscstar.json";
@@ -175,6 +249,102 @@ int main(int argc, char** argv)
     osc->params = g_starParams;
     chain.push_back(std::move(radial));
     chain.push_back(std::move(osc));
+    // below full size the chain renders into scaledFb instead, which is
+    // stretched up into the slot; the controller owns the scale in auto mode
+    std::vector<unsigned int> scaledFb;
+    int scaledW = W, scaledH = H;
+    RSCALE_CTL scaleCtl;
+    rscale_ctl_init(&scaleCtl, frameBudgetMs);
+    std::atomic<float> currentScale { (float)(renderScale > 0.0 ? renderScale : 1.0) };
+
+    // effects accumulate into fb across frames; each finished frame is
+    // copied out to its pipeline slot so presentation can run concurrently
+    FramePipeline pipe(W, H, pipelineDepth, latencyBudgetMs, [&](FrameSlot& slot) {
+        auto start = std::chrono::steady_clock::now();
+        const double scale = renderScale > 0.0 ? renderScale : scaleCtl.scale;
+        int sw = W, sh = H;
+        if (scale < 1.0)
+            rscale_size(W, H, scale, &sw, &sh);
+        if (sw != scaledW || sh != scaledH) {
+            // carry the accumulated image over to the new size
+            std::vector<unsigned int> next;
+            if (sw == W && sh == H)
+                rscale_resize((int*)fb.data(), W, H, (const int*)scaledFb.data(), scaledW, scaledH);
+            else {
+                next.resize((size_t)sw * sh);
+                if (scaledW == W && scaledH == H)
+                    rscale_resize((int*)next.data(), sw, sh, (const int*)fb.data(), W, H);
+                else
+                    rscale_resize((int*)next.data(), sw, sh, (const int*)scaledFb.data(), scaledW, scaledH);
+            }
+            scaledFb.swap(next);
+            scaledW = sw;
+            scaledH = sh;
+        }
+        const bool scaled = sw != W || sh != H;
+        FrameContext fctx { scaled ? scaledFb.data() : fb.data(), sw, sh, slot.level, &slot.spectrum, slot.time, slot.frameIndex, slot.beat, slot.bpm, slot.beatPhase };
+        slot.effectMs.clear();
+        for (size_t i = 0; i < chain.size(); ++i) {
+            Effect* eff = chain[i].get();
+            if (!eff->enabled)
+                continue;
+            C_ProfZone zone(eff->name(), eff, (int)i);
+            auto t0 = std::chrono::steady_clock::now();
+            eff->render(fctx);
+            slot.effectMs.push_back({ eff, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count() });
+        }
+        avs_portable_tick();
+        PROF_ZONE("copy out");
+        if (scaled)
+            rscale_resize((int*)slot.pixels.data(), W, H, (const int*)scaledFb.data(), sw, sh);
+        else
+            std::memcpy(slot.pixels.data(), fb.data(), fb.size() * sizeof(uint32_t));
+        if (renderScale <= 0.0)
+            rscale_ctl_update(&scaleCtl, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        currentScale.store((float)scale);
+    });
+    printf("Frame pipeline depth %d, latency budget %.1f ms\n", pipe.depth(), pipe.latencyBudgetMs());
+    if (renderScale <= 0.0)
+        printf("Render scale automatic, frame budget %.1f ms\n", frameBudgetMs);
+    else if (renderScale < 1.0)
+        printf("Render scale %.2f\n", renderScale);
+    double lastRenderMs = 0.0;
+    // shows a finished frame and hands its slot back to the pipeline
+    auto present = [&](FrameSlot* done) {
+        lastRenderMs = done->renderMs;
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPrint > std::chrono::seconds(1)) {
+            printf("frame %llu lvl=%.3f bpm=%.1f fb0=%08X render=%.2fms scale=%.2f latency=%.1fms frame p99=%.2fms render thread %.0f%%\n", (unsigned long long)done->frameIndex, (double)done->level, (double)done->bpm, done->pixels[0], done->renderMs, (double)currentScale.load(), pipe.latencyMs(), g_perf.frameMs.percentile(0.99f), g_perf.renderOccupancy * 100.0f);
+            lastPrint = now;
+        }
+        double uploadMs = 0.0;
+        {
+            PROF_ZONE("present");
+#if AVS_SDL2
+            void* pixels = nullptr;
+            int pitch = 0;
+            auto uploadStart = std::chrono::steady_clock::now();
+            if (SDL_LockTexture(tex, nullptr, &pixels, &pitch) == 0) {
+                for (int y = 0; y < H; ++y)
+                    std::memcpy((uint8_t*)pixels + y * pitch, &done->pixels[(size_t)y * W], W * sizeof(uint32_t));
+                SDL_UnlockTexture(tex);
+            }
+            uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+            SDL_RenderClear(ren);
+            SDL_RenderCopy(ren, tex, nullptr, nullptr);
+#if AVS_IMGUI
+            ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), ren);
+#endif
+            SDL_RenderPresent(ren);
+#else
+            if (!offline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(16));
+#endif
+        }
+        g_perf.onPresented(*done, uploadMs, pipe.latencyMs());
+        pipe.release(done);
+        ++frame;
+    };
     while (running) {
 #if AVS_SDL2
         SDL_Event e;
@@ -195,82 +365,174 @@ int main(int argc, char** argv)
             }
         }
 #endif
-        float lvl = g_level.load(std::memory_order_relaxed);
-        float t = (float)frame * 0.016f;
-        g_fft.compute(g_spec);
-        FrameContext fctx { fb.data(), W, H, lvl, &g_spec, (double)t, frame };
-        for (auto& eff : chain) {
-            if (eff->enabled)
-                eff->render(fctx);
-        }
-        avs_portable_tick();
-        auto now = std::chrono::steady_clock::now();
-        if (now - lastPrint > std::chrono::seconds(1)) {
-            printf("frame %llu lvl=%.3f fb0=%08X\n", (unsigned long long)frame, (double)lvl, fb[0]);
-            lastPrint = now;
-        }
-#if AVS_SDL2
-        void* pixels = nullptr;
-        int pitch = 0;
-        if (SDL_LockTexture(tex, nullptr, &pixels, &pitch) == 0) {
-            for (int y = 0; y < H; ++y)
-                std::memcpy((uint8_t*)pixels + y * pitch, &fb[y * W], W * sizeof(uint32_t));
-            SDL_UnlockTexture(tex);
+        // audio snapshot for the next frame overlaps the frame still rendering
+        PROF_ZONE("frame");
+        FrameSlot* slot = pipe.beginFrame();
+        slot->time = (double)slot->frameIndex * 0.016;
+        int64_t audioAt;
+        if (offline) {
+            // offline frames take their audio from the file timeline
+            if (!fileInput.advanceTo(slot->time))
+                running = false;
+            audioAt = FileAudioSource::timeNs(slot->time);
+        } else
+            audioAt = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(slot->snapshotAt.time_since_epoch()).count();
+        g_fft.compute(g_spec, audioAt);
+        slot->spectrum = g_spec;
+        slot->level = g_fft.level();
+        const BeatTracker::State& beat = g_fft.beat();
+        slot->beat = beat.beat;
+        slot->bpm = beat.locked ? beat.bpm : 0.0f;
+        slot->beatPhase = beat.phase;
+        float lvl = slot->level;
+
+        // collect finished frames until the render thread is idle (depth 2)
+        // or has depth-2 frames queued; the chain is then safe to edit
+        int depth = pipe.effectiveDepth();
+        FrameSlot* done = nullptr;
+        while (pipe.inFlight() > std::max(depth - 2, 0)) {
+            if (done)
+                pipe.release(done);
+            done = pipe.acquire();
         }
-        SDL_RenderClear(ren);
-        SDL_RenderCopy(ren, tex, nullptr, nullptr);
-#if AVS_IMGUI
-        ImGui_ImplSDLRenderer2_NewFrame();
-        ImGui_ImplSDL2_NewFrame();
-        ImGui::NewFrame();
-        if (ImGui::Begin("Chain")) {
-            for (size_t i = 0; i < chain.size(); ++i) {
-                ImGui::PushID((int)i);
-                bool en = chain[i]->enabled;
-                if (ImGui::Checkbox("##en", &en))
-                    chain[i]->enabled = en;
-                ImGui::SameLine();
-                if (ImGui::Selectable(chain[i]->name(), selectedIndex == (int)i))
-                    selectedIndex = (int)i;
-                ImGui::SameLine();
-                if (ImGui::SmallButton("Up") && i > 0) {
-                    std::swap(chain[i - 1], chain[i]);
-                    if ((int)i == selectedIndex)
-                        selectedIndex--;
+#if AVS_SDL2 && AVS_IMGUI
+        {
+            std::lock_guard<std::mutex> chainLock(pipe.chainLock());
+            ImGui_ImplSDLRenderer2_NewFrame();
+            ImGui_ImplSDL2_NewFrame();
+            ImGui::NewFrame();
+            if (ImGui::Begin("Chain")) {
+                for (size_t i = 0; i < chain.size(); ++i) {
+                    ImGui::PushID((int)i);
+                    bool en = chain[i]->enabled;
+                    if (ImGui::Checkbox("##en", &en)) {
+                        chain[i]->enabled = en;
+                        g_perf.markToggle();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Selectable(chain[i]->name(), selectedIndex == (int)i))
+                        selectedIndex = (int)i;
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Up") && i > 0) {
+                        std::swap(chain[i - 1], chain[i]);
+                        if ((int)i == selectedIndex)
+                            selectedIndex--;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Dn") && i + 1 < chain.size()) {
+                        std::swap(chain[i + 1], chain[i]);
+                        if ((int)i == selectedIndex)
+                            selectedIndex++;
+                    }
+                    ImGui::PopID();
                 }
-                ImGui::SameLine();
-                if (ImGui::SmallButton("Dn") && i + 1 < chain.size()) {
-                    std::swap(chain[i + 1], chain[i]);
-                    if ((int)i == selectedIndex)
-                        selectedIndex++;
+            }
+            ImGui::End();
+            if (selectedIndex >= 0 && selectedIndex < (int)chain.size())
+                if (ImGui::Begin("Inspector")) {
+                    chain[selectedIndex]->drawUI();
+                    ImGui::End();
                 }
-                ImGui::PopID();
+            if (ImGui::Begin("Audio")) {
+                ImGui::Text("Level %.3f", lvl);
+                const BeatTracker::State& beat = g_fft.beat();
+                ImGui::Text("Tempo %.1f BPM (confidence %.2f%s)", beat.bpm, beat.confidence, beat.locked ? "" : ", following onsets");
+                ImGui::ProgressBar(beat.phase, ImVec2(-1, 0), beat.beat ? "beat" : "");
+                if (!g_spec.empty())
+                    ImGui::PlotLines("Spectrum", g_spec.data(), (int)g_spec.size(), 0, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+                ImGui::End();
             }
-        }
-        ImGui::End();
-        if (selectedIndex >= 0 && selectedIndex < (int)chain.size())
-            if (ImGui::Begin("Inspector")) {
-                chain[selectedIndex]->drawUI();
+            if (ImGui::Begin("Stats")) {
+                ImGui::Text("Frame %llu", (unsigned long long)frame);
+                ImGui::Text("Pipeline depth %d/%d, latency %.1f ms (budget %.1f)", depth, pipe.depth(), pipe.latencyMs(), pipe.latencyBudgetMs());
+                ImGui::Text("Render %.2f ms", lastRenderMs);
+                ImGui::Text("Render scale %.0f%%%s", currentScale.load() * 100.0f, renderScale > 0.0 ? "" : " (auto)");
                 ImGui::End();
             }
-        if (ImGui::Begin("Audio")) {
-            ImGui::Text("Level %.3f", lvl);
-            if (!g_spec.empty())
-                ImGui::PlotLines("Spectrum", g_spec.data(), (int)g_spec.size(), 0, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
-            ImGui::End();
-        }
-        if (ImGui::Begin("Stats")) {
-            ImGui::Text("Frame %llu", (unsigned long long)frame);
+            if (ImGui::Begin("Performance")) {
+                const RollingSeries& fm = g_perf.frameMs;
+                ImGui::Text("Frame %.2f ms  mean %.2f  p99 %.2f  max %.2f", fm.last(), fm.mean(), fm.percentile(0.99f), fm.max());
+                ImGui::PlotLines("Frame ms", fm.data(), fm.size(), fm.offset(), nullptr, 0.0f, 50.0f, ImVec2(0, 60));
+                float bins[25];
+                fm.histogram(0.0f, 50.0f, bins, 25);
+                ImGui::PlotHistogram("0-50 ms", bins, 25, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+                const RollingSeries& rm = g_perf.renderMs;
+                ImGui::PlotLines("Render ms", rm.data(), rm.size(), rm.offset(), nullptr, 0.0f, 50.0f, ImVec2(0, 40));
+                ImGui::Text("Upload %.2f ms (p99 %.2f)  latency %.1f ms", g_perf.uploadMs.last(), g_perf.uploadMs.percentile(0.99f), g_perf.latencyMs.mean());
+                const RollingSeries& aj = g_perf.audioJitterMs;
+                ImGui::Text("Audio callbacks %.1f/s, jitter max %.2f ms (p99 %.2f)", g_perf.callbacksPerSecond, aj.max(), aj.percentile(0.99f));
+                ImGui::PlotLines("Jitter ms", aj.data(), aj.size(), aj.offset(), nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+                ImGui::ProgressBar(g_perf.renderOccupancy, ImVec2(-FLT_MIN, 0), "render thread");
+                ImGui::ProgressBar(g_perf.audioOccupancy, ImVec2(-FLT_MIN, 0), "audio callback");
+                ImGui::Separator();
+                // unticking an effect shows its marginal cost as the change
+                // in chain render time
+                if (ImGui::BeginTable("effects", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+                    ImGui::TableSetupColumn("On");
+                    ImGui::TableSetupColumn("Effect");
+                    ImGui::TableSetupColumn("ms");
+                    ImGui::TableSetupColumn("p99");
+                    ImGui::TableSetupColumn("share");
+                    ImGui::TableHeadersRow();
+                    float total = rm.mean();
+                    for (size_t i = 0; i < chain.size(); ++i) {
+                        const RollingSeries* es = g_perf.effect(chain[i].get());
+                        ImGui::PushID((int)i);
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        bool en = chain[i]->enabled;
+                        if (ImGui::Checkbox("##on", &en)) {
+                            chain[i]->enabled = en;
+                            g_perf.markToggle();
+                        }
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(chain[i]->name());
+                        ImGui::TableNextColumn();
+                        if (chain[i]->enabled && es) {
+                            float m = es->mean(60);
+                            ImGui::Text("%.3f", m);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%.3f", es->percentile(0.99f));
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%.0f%%", total > 0.0f ? 100.0f * m / total : 0.0f);
+                        } else {
+                            ImGui::TextDisabled("off");
+                            ImGui::TableNextColumn();
+                            ImGui::TableNextColumn();
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::EndTable();
+                }
+                float before, after;
+                if (g_perf.marginalMs(before, after))
+                    ImGui::Text("Since last toggle: render %.2f -> %.2f ms (%+.2f)", before, after, after - before);
+            }
             ImGui::End();
+            ImGui::Render();
         }
-        ImGui::Render();
-        ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), ren);
 #endif
-        SDL_RenderPresent(ren);
-#else
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
-#endif
-        ++frame;
+        pipe.submit(slot);
+        if (depth == 1) {
+            // a frame collected above (while the depth was still 2) is older
+            // than the one just submitted: show it before waiting on that
+            if (done)
+                present(done);
+            done = pipe.acquire();
+        }
+        if (done)
+            present(done);
+    }
+    if (offline) {
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+        printf("Offline: %llu frames, %.1f s of audio in %.2f s (%.1fx real-time)\n", (unsigned long long)frame, frame * 0.016, secs, secs > 0 ? frame * 0.016 / secs : 0.0);
+    }
+    if (tracePath) {
+        prof_enable(0);
+        if (prof_write_chrome_trace(tracePath))
+            printf("Trace written to %s\n", tracePath);
+        else
+            printf("Cannot write trace %s\n", tracePath);
     }
 #if AVS_SDL2
     SDL_Quit();
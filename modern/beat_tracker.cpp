@@ -0,0 +1,321 @@
+#include "beat_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BEAT_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BEAT_NEON 1
+#endif
+
+namespace {
+const double kMinBpm = 60.0;
+const double kMaxBpm = 200.0;
+const float kMinConfidence = 0.15f; // below it beats fall back to onsets
+const double kMinOnsetGap = 0.05; // seconds
+
+float dot(const float* a, const float* b, size_t n)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if BEAT_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif BEAT_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// log-normal preference for tempi near 120 BPM, an octave wide
+double tempoPrior(double bpm)
+{
+    double o = std::log2(bpm / 120.0);
+    return std::exp(-0.5 * o * o);
+}
+}
+
+BeatTracker::BeatTracker(int sampleRate)
+    : m_rate(sampleRate > 0 ? sampleRate : 48000)
+    , m_fft(kWindow)
+{
+    m_window.resize(kWindow);
+    for (int i = 0; i < kWindow; ++i)
+        m_window[i] = 0.5f * (1.f - std::cos(2.f * 3.1415926535f * i / (kWindow - 1)));
+    m_block.resize(kWindow);
+    m_mags.resize(kWindow / 2);
+    m_lin.resize(kEnv);
+    reset();
+}
+
+void BeatTracker::setSampleRate(int rate)
+{
+    m_rate = rate > 0 ? rate : 48000;
+    reset();
+}
+
+void BeatTracker::reset()
+{
+    m_in.assign(kWindow, 0.0f);
+    m_prev.assign(kWindow / 2, 0.0f);
+    m_flux.assign(kEnv, 0.0f);
+    m_env.assign(kEnv, 0.0f);
+    m_frames = m_hops = 0;
+    m_fluxSum = 0.0;
+    m_fluxPeak = 0.0f;
+    m_onsets = m_lastOnsetHop = 0;
+    m_period = m_beatRef = 0.0;
+    m_confidence = 0.0f;
+    m_candidate = 0.0;
+    m_candidateCount = 0;
+    m_lastAt = m_seenOnsets = 0;
+    m_nextBeat = -1.0;
+    m_state = State();
+}
+
+float BeatTracker::flux(const float* mags, float* prev, size_t count)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if BEAT_SSE2
+    __m128 acc = _mm_setzero_ps();
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 c = _mm_sqrt_ps(_mm_loadu_ps(mags + i));
+        acc = _mm_add_ps(acc, _mm_max_ps(_mm_sub_ps(c, _mm_loadu_ps(prev + i)), zero));
+        _mm_storeu_ps(prev + i, c);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif BEAT_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t c = vsqrtq_f32(vld1q_f32(mags + i));
+        acc = vaddq_f32(acc, vmaxq_f32(vsubq_f32(c, vld1q_f32(prev + i)), zero));
+        vst1q_f32(prev + i, c);
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < count; ++i) {
+        float c = std::sqrt(mags[i]);
+        sum += std::max(c - prev[i], 0.0f);
+        prev[i] = c;
+    }
+    return sum;
+}
+
+void BeatTracker::push(const float* mono, size_t frames)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        m_in[(size_t)m_frames & (kWindow - 1)] = mono[i];
+        if (++m_frames % kHop == 0)
+            hop();
+    }
+}
+
+void BeatTracker::hop()
+{
+    // the ring's oldest frame sits where the next one will be written
+    for (size_t i = 0; i < kWindow; ++i)
+        m_block[i] = m_in[(size_t)(m_frames + i) & (kWindow - 1)] * m_window[i];
+    m_fft.magnitudes(m_block.data(), m_mags.data());
+    const float f = flux(m_mags.data(), m_prev.data(), m_mags.size());
+
+    const uint64_t n = m_hops++;
+    const size_t mask = kEnv - 1;
+    if (n >= kMeanHops)
+        m_fluxSum -= m_flux[(size_t)(n - kMeanHops) & mask];
+    m_flux[(size_t)n & mask] = f;
+    m_fluxSum += f;
+    const float mean = (float)(m_fluxSum / (double)std::min<uint64_t>(n + 1, kMeanHops));
+    m_env[(size_t)n & mask] = std::max(f - mean, 0.0f);
+    m_fluxPeak = std::max(f, m_fluxPeak * 0.998f);
+    m_state.onsetStrength = m_fluxPeak > 0.0f ? f / m_fluxPeak : 0.0f;
+
+    // hop c is an onset once kPeakHalf later ones show it was a local peak
+    // well clear of the moving mean
+    if (n >= 2 * kPeakHalf) {
+        const uint64_t c = n - kPeakHalf;
+        const float fc = m_flux[(size_t)c & mask];
+        bool peak = fc > 1.5f * mean && fc > 0.05f * m_fluxPeak;
+        for (uint64_t k = c - kPeakHalf; peak && k <= n; ++k)
+            if (k != c && (k < c ? m_flux[(size_t)k & mask] > fc : m_flux[(size_t)k & mask] >= fc))
+                peak = false;
+        if (peak && (!m_onsets || (double)(c - m_lastOnsetHop) >= kMinOnsetGap * odfRate())) {
+            m_onsets++;
+            m_lastOnsetHop = c;
+        }
+    }
+    if (m_hops % kTempoEvery == 0)
+        estimateTempo();
+}
+
+float BeatTracker::envAt(double n) const
+{
+    if (n < 0.0 || n > (double)(m_hops - 1) || (double)m_hops - n > kEnv - 1)
+        return 0.0f;
+    const uint64_t i = (uint64_t)n;
+    const float t = (float)(n - (double)i);
+    const float a = m_env[(size_t)i & (kEnv - 1)];
+    const float b = i + 1 < m_hops ? m_env[(size_t)(i + 1) & (kEnv - 1)] : a;
+    return a + (b - a) * t;
+}
+
+void BeatTracker::estimateTempo()
+{
+    const size_t len = (size_t)std::min<uint64_t>(m_hops, kEnv);
+    if ((double)len < 4.0 * odfRate())
+        return;
+    for (size_t i = 0; i < len; ++i)
+        m_lin[i] = m_env[(size_t)(m_hops - len + i) & (kEnv - 1)];
+
+    const size_t lmin = std::max<size_t>(2, (size_t)(odfRate() * 60.0 / kMaxBpm));
+    const size_t lmax = (size_t)std::ceil(odfRate() * 60.0 / kMinBpm);
+    const size_t maxLag = std::min(2 * lmax + 2, len / 2);
+    if (lmax + 1 >= maxLag)
+        return;
+    m_acf.assign(maxLag + 1, 0.0f);
+    for (size_t l = 0; l <= maxLag; ++l)
+        m_acf[l] = dot(m_lin.data() + l, m_lin.data(), len - l) / (float)(len - l);
+    if (m_acf[0] <= 0.0f)
+        return;
+
+    // a lag is supported by its own peak and, half as much, its double
+    auto score = [&](size_t l) {
+        double s = m_acf[l] + (2 * l <= maxLag ? 0.5 * m_acf[2 * l] : 0.0);
+        return s * tempoPrior(60.0 * odfRate() / (double)l);
+    };
+    size_t best = lmin;
+    double bestScore = score(lmin);
+    double acfMean = 0.0;
+    for (size_t l = lmin; l <= lmax; ++l) {
+        double s = score(l);
+        if (s > bestScore) {
+            bestScore = s;
+            best = l;
+        }
+        acfMean += m_acf[l];
+    }
+    acfMean /= (double)(lmax - lmin + 1);
+    // the peak is refined on the plain autocorrelation, where it also is
+    // at twice the lag with half the relative error
+    auto refine = [&](size_t l) {
+        const double a0 = m_acf[l - 1], a1 = m_acf[l], a2 = m_acf[l + 1];
+        const double d = a0 - 2.0 * a1 + a2;
+        return (double)l + (d < 0.0 ? std::min(std::max(0.5 * (a0 - a2) / d, -0.5), 0.5) : 0.0);
+    };
+    double lag = refine(best);
+    if (2 * best + 2 <= maxLag) {
+        size_t l2 = 2 * best;
+        if (m_acf[l2 - 1] > m_acf[l2])
+            l2--;
+        else if (m_acf[l2 + 1] > m_acf[l2])
+            l2++;
+        lag = (lag + refine(l2)) / 3.0;
+    }
+    const double conf = m_acf[0] > acfMean ? (m_acf[best] - acfMean) / (m_acf[0] - acfMean) : 0.0;
+    m_confidence = 0.7f * m_confidence + 0.3f * (float)std::min(std::max(conf, 0.0), 1.0);
+
+    // a new tempo has to persist for a second before it replaces the one
+    // being tracked; close ones just pull it along
+    const double period = lag * kHop;
+    bool regrid = m_period <= 0.0;
+    if (m_period <= 0.0) {
+        m_period = period;
+    } else if (std::fabs(period / m_period - 1.0) < 0.04) {
+        m_period += 0.25 * (period - m_period);
+        m_candidateCount = 0;
+    } else {
+        if (m_candidateCount && std::fabs(period / m_candidate - 1.0) < 0.04)
+            m_candidateCount++;
+        else {
+            m_candidate = period;
+            m_candidateCount = 1;
+        }
+        if (m_candidateCount * kTempoEvery >= odfRate()) {
+            m_period = period;
+            m_candidateCount = 0;
+            regrid = true;
+        }
+    }
+
+    // the beat offset whose comb collects the most onset energy over the
+    // last few beats
+    const double lagHops = m_period / kHop;
+    const double newest = (double)(m_hops - 1);
+    const int combs = std::max(1, std::min(8, (int)((double)(len - 1) / lagHops) - 1));
+    const int offsets = (int)std::ceil(lagHops);
+    std::vector<double>& comb = m_comb;
+    comb.assign(offsets, 0.0);
+    int bestOffset = 0;
+    for (int o = 0; o < offsets; ++o) {
+        for (int k = 0; k < combs; ++k)
+            comb[o] += envAt(newest - o - k * lagHops);
+        if (comb[o] > comb[bestOffset])
+            bestOffset = o;
+    }
+    const double c0 = comb[(bestOffset + offsets - 1) % offsets], c1 = comb[bestOffset], c2 = comb[(bestOffset + 1) % offsets];
+    const double cd = c0 - 2.0 * c1 + c2;
+    const double offset = bestOffset + (cd < 0.0 ? 0.5 * (c0 - c2) / cd : 0.0);
+    const double beatFrame = hopFrame(newest - offset);
+
+    if (regrid) {
+        m_beatRef = beatFrame;
+    } else {
+        double err = (beatFrame - m_beatRef) / m_period;
+        err -= std::floor(err + 0.5);
+        // a second order loop: the error that keeps coming back is the
+        // period being off, which the lag resolution alone can't see
+        m_beatRef += 0.3 * err * m_period;
+        m_period += 0.02 * err * m_period;
+    }
+}
+
+const BeatTracker::State& BeatTracker::at(uint64_t frame)
+{
+    State& s = m_state;
+    s.onset = m_onsets != m_seenOnsets;
+    m_seenOnsets = m_onsets;
+    s.beat = false;
+    s.locked = m_period > 0.0 && m_confidence >= kMinConfidence;
+    s.period = m_period;
+    s.bpm = m_period > 0.0 ? (float)(60.0 * m_rate / m_period) : 0.0f;
+    s.confidence = m_confidence;
+
+    const double f = (double)frame;
+    auto gridAfter = [&](double x) { return m_beatRef + std::ceil((x - m_beatRef) / m_period) * m_period; };
+    if (s.locked) {
+        if (m_nextBeat < 0.0 || m_nextBeat < (double)m_lastAt - m_period || frame < m_lastAt)
+            m_nextBeat = gridAfter((double)m_lastAt);
+        if (f >= m_nextBeat) {
+            s.beat = true;
+            // at most one per period, whatever the grid did in between
+            m_nextBeat = gridAfter(std::max(f, m_nextBeat + 0.5 * m_period));
+        }
+    } else {
+        m_nextBeat = -1.0;
+        s.beat = s.onset;
+    }
+    if (s.beat)
+        s.beats++;
+    if (m_period > 0.0) {
+        double p = (f - m_beatRef) / m_period;
+        s.phase = (float)(p - std::floor(p));
+    } else
+        s.phase = 0.0f;
+    m_lastAt = frame;
+    return s;
+}
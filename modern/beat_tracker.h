@@ -0,0 +1,90 @@
+// Beat and tempo tracking on the real FFT
+#pragma once
+#include "real_fft.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Spectral-flux onsets at a fixed hop of the mono input, a tempo from the
+// autocorrelation of the onset envelope, and a beat grid phase-locked to
+// the onsets. Positions are input frames counted since reset(), so the
+// answer does not depend on how often, or how regularly, a host asks.
+// Not thread safe: push() and at() belong to one analysis thread.
+class BeatTracker {
+public:
+    struct State {
+        bool beat = false; // a beat fell between the previous at() and this one
+        bool onset = false; // an onset was detected in the same span
+        bool locked = false; // beats come from the tempo grid, not raw onsets
+        float bpm = 0.0f; // 0 until a tempo has been found
+        float phase = 0.0f; // 0..1 through the current beat, 0 on it
+        float confidence = 0.0f; // 0..1, how periodic the onsets are
+        float onsetStrength = 0.0f; // newest flux against its recent peak, 0..1
+        double period = 0.0; // frames per beat
+        uint64_t beats = 0; // beats reported so far
+    };
+
+    explicit BeatTracker(int sampleRate = 48000);
+    // also forgets everything heard so far
+    void setSampleRate(int rate);
+    void reset();
+
+    void push(const float* mono, size_t frames);
+    // the state at input frame `frame` (at most frames() for anything
+    // meaningful); beat and onset cover the span since the previous call
+    const State& at(uint64_t frame);
+    const State& state() const { return m_state; }
+    uint64_t frames() const { return m_frames; }
+    int sampleRate() const { return m_rate; }
+
+    // half-wave rectified rise of sqrt-compressed magnitudes against prev,
+    // which is then updated to the new ones
+    static float flux(const float* mags, float* prev, size_t count);
+
+private:
+    enum {
+        kWindow = 1024,
+        kHop = 256,
+        kEnv = 2048, // onset envelope length in hops, ~11 s at 48 kHz
+        kMeanHops = 64, // moving mean the threshold and envelope are relative to
+        kPeakHalf = 2, // an onset is the maximum of 2 * kPeakHalf + 1 hops
+        kTempoEvery = 48, // hops between tempo estimates
+    };
+    void hop();
+    void estimateTempo();
+    double odfRate() const { return (double)m_rate / kHop; }
+    // input frame an envelope entry stands for: between the centres of the
+    // two windows whose difference it is
+    double hopFrame(double n) const { return (n + 1) * kHop - kWindow / 2 - kHop / 2; }
+    float envAt(double n) const; // linear interpolation, 0 outside the ring
+
+    int m_rate;
+    RealFFT m_fft;
+    std::vector<float> m_window;
+    std::vector<float> m_in; // mono input ring, kWindow long
+    std::vector<float> m_block;
+    std::vector<float> m_mags;
+    std::vector<float> m_prev; // compressed magnitudes of the previous hop
+    std::vector<float> m_flux; // raw flux ring, kEnv long
+    std::vector<float> m_env; // flux above its moving mean, kEnv long
+    std::vector<float> m_lin; // m_env unrolled for the estimator
+    std::vector<float> m_acf;
+    std::vector<double> m_comb;
+    uint64_t m_frames = 0;
+    uint64_t m_hops = 0;
+    double m_fluxSum = 0.0; // of the last kMeanHops fluxes
+    float m_fluxPeak = 0.0f;
+    uint64_t m_onsets = 0;
+    uint64_t m_lastOnsetHop = 0;
+
+    double m_period = 0.0; // frames
+    double m_beatRef = 0.0; // frame of a beat on the grid
+    float m_confidence = 0.0f;
+    double m_candidate = 0.0; // a tempo away from m_period, waiting to persist
+    int m_candidateCount = 0;
+
+    uint64_t m_lastAt = 0;
+    uint64_t m_seenOnsets = 0;
+    double m_nextBeat = -1.0;
+    State m_state;
+};
@@ -12,6 +12,9 @@ struct FrameContext {
     const std::vector<float>* spectrum = nullptr; // may be null
     double time = 0.0;
     uint64_t frameIndex = 0;
+    bool beat = false; // a beat since the previous frame
+    float bpm = 0.0f; // 0 while the tempo is unknown
+    float beatPhase = 0.0f; // 0..1 through the current beat
 };
 
 class Effect {
@@ -1,5 +1,6 @@
 #include "fft_analyzer.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 
@@ -20,6 +21,7 @@ static size_t nextPow2(size_t v)
 }
 }
 
+#if AVS_USE_ACCELERATE
 struct AccelerateFFTState {
     FFTSetup setup = nullptr;
     int log2n = 0;
@@ -27,16 +29,23 @@ struct AccelerateFFTState {
     std::vector<float> imag;
 };
 static AccelerateFFTState g_accel;
+#endif
 
 FFTAnalyzer::FFTAnalyzer(size_t fftSize, size_t bands)
     : m_fftSize(nextPow2(fftSize))
     , m_bands(bands)
+    , m_input(32768) // ~0.7 s at 48 kHz between two compute() calls
+    , m_fft(m_fftSize)
+    , m_beat(m_rate)
 {
-    m_ring.resize(m_fftSize * 4, 0.0f);
+    m_scratch.resize(1024 * 2);
+    m_hist.assign(m_fftSize * 4, 0.0f);
     m_window.resize(m_fftSize);
     for (size_t i = 0; i < m_fftSize; ++i) {
         m_window[i] = 0.5f * (1.f - std::cos(2.f * 3.1415926535f * i / (m_fftSize - 1)));
     }
+    m_block.resize(m_fftSize);
+    m_mags.resize(m_fftSize / 2);
     platform_init();
 }
 
@@ -53,28 +62,47 @@ void FFTAnalyzer::platform_init()
 #endif
 }
 
-void FFTAnalyzer::push(const float* interleavedStereo, size_t frames)
+int64_t FFTAnalyzer::nowNs()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FFTAnalyzer::push(const float* interleavedStereo, size_t frames, int64_t timeNs)
 {
-    size_t w = m_writeIdx.load(std::memory_order_relaxed);
-    size_t cap = m_ring.size();
-    for (size_t i = 0; i < frames; ++i) {
-        float L = interleavedStereo[i * 2];
-        float R = interleavedStereo[i * 2 + 1];
-        float mono = 0.5f * (L + R);
-        m_ring[(w + i) % cap] = mono;
+    m_input.write(interleavedStereo, frames, timeNs ? timeNs : nowNs());
+}
+
+void FFTAnalyzer::drain()
+{
+    const size_t mask = m_hist.size() - 1;
+    size_t n;
+    while ((n = m_input.read(m_scratch.data(), m_scratch.size() / 2)) > 0) {
+        const size_t at = (size_t)m_histFrames & mask;
+        for (size_t i = 0; i < n; ++i)
+            m_hist[(size_t)(m_histFrames + i) & mask] = 0.5f * (m_scratch[i * 2] + m_scratch[i * 2 + 1]);
+        const size_t first = std::min(n, m_hist.size() - at);
+        m_beat.push(&m_hist[at], first);
+        m_beat.push(&m_hist[0], n - first);
+        m_histFrames += n;
+    }
+    // a stamp may belong to a block written after the read above; it still
+    // maps frames to time, which is all it is used for
+    AudioRing::Stamp st;
+    while (m_input.readStamp(st)) {
+        m_stamp = st;
+        m_haveStamp = true;
     }
-    m_writeIdx.store((w + frames) % cap, std::memory_order_relaxed);
 }
 
+// time is already windowed
 bool FFTAnalyzer::platform_fft(const float* time, std::vector<float>& mags)
 {
-    mags.assign(m_fftSize / 2, 0.0f);
 #if AVS_USE_ACCELERATE
     if (!g_accel.setup)
         return false;
     for (size_t i = 0; i < m_fftSize / 2; ++i) {
-        g_accel.real[i] = time[2 * i] * m_window[2 * i];
-        g_accel.imag[i] = time[2 * i + 1] * m_window[2 * i + 1];
+        g_accel.real[i] = time[2 * i];
+        g_accel.imag[i] = time[2 * i + 1];
     }
     DSPSplitComplex sc { g_accel.real.data(), g_accel.imag.data() };
     vDSP_fft_zip(g_accel.setup, &sc, 1, g_accel.log2n, kFFTDirection_Forward);
@@ -85,41 +113,59 @@ bool FFTAnalyzer::platform_fft(const float* time, std::vector<float>& mags)
     }
     return true;
 #else
-    for (size_t k = 0; k < m_fftSize / 2; ++k) {
-        double sumRe = 0, sumIm = 0;
-        for (size_t n = 0; n < m_fftSize; ++n) {
-            double w = 2 * M_PI * k * n / m_fftSize;
-            double s = time[n] * m_window[n];
-            sumRe += s * std::cos(w);
-            sumIm -= s * std::sin(w);
-        }
-        mags[k] = std::sqrt(sumRe * sumRe + sumIm * sumIm);
-    }
+    m_fft.magnitudes(time, mags.data());
     return true;
 #endif
 }
 
-bool FFTAnalyzer::compute(std::vector<float>& outBands)
+bool FFTAnalyzer::compute(std::vector<float>& outBands, int64_t atNs)
 {
-    size_t w = m_writeIdx.load(std::memory_order_relaxed);
-    if (w < m_fftSize)
+    drain();
+    if (m_histFrames < m_fftSize)
         return false;
-    std::vector<float> block(m_fftSize);
-    size_t cap = m_ring.size();
-    size_t start = (w + cap - m_fftSize) % cap;
-    for (size_t i = 0; i < m_fftSize; ++i) {
-        block[i] = m_ring[(start + i) % cap];
+    uint64_t end = m_histFrames;
+    if (atNs && m_haveStamp) {
+        // frames are m_rate apart; anything not yet captured clamps to the
+        // newest frame, anything already overwritten to the oldest window
+        double df = (double)(atNs - m_stamp.timeNs) * m_rate / 1e9;
+        double at = (double)m_stamp.endFrame + std::floor(df);
+        const uint64_t kept = m_hist.size() - m_fftSize;
+        uint64_t oldest = m_histFrames > kept + m_fftSize ? m_histFrames - kept : m_fftSize;
+        end = at <= (double)oldest ? oldest : at >= (double)m_histFrames ? m_histFrames : (uint64_t)at;
     }
-    std::vector<float> mags;
-    if (!platform_fft(block.data(), mags))
+    m_beat.at(end);
+    const size_t mask = m_hist.size() - 1;
+    const size_t levelFrames = std::min<size_t>(1024, m_fftSize);
+    float sum = 0.0f;
+    for (uint64_t f = end - levelFrames; f < end; ++f)
+        sum += m_hist[(size_t)f & mask] * m_hist[(size_t)f & mask];
+    m_level = std::min(1.0f, m_level * 0.85f + std::sqrt(sum / levelFrames) * 0.15f);
+
+    if (m_haveBands && m_hop && end >= m_lastAt && end - m_lastAt < m_hop) {
+        outBands = m_lastBands;
+        return true;
+    }
+    for (size_t i = 0; i < m_fftSize; ++i)
+        m_block[i] = m_hist[(size_t)(end - m_fftSize + i) & mask] * m_window[i];
+    std::vector<float>& mags = m_mags;
+    if (!platform_fft(m_block.data(), mags))
         return false;
-    outBands.assign(m_bands, 0.0f);
+    m_lastAt = end;
+    logBands(mags.data(), mags.size(), m_bands, outBands);
+    m_lastBands = outBands;
+    m_haveBands = true;
+    return true;
+}
+
+void FFTAnalyzer::logBands(const float* mags, size_t count, size_t bands, std::vector<float>& outBands)
+{
+    outBands.assign(bands, 0.0f);
     double minF = 1.0;
-    double maxF = (double)(m_fftSize / 2 - 1);
+    double maxF = (double)(count - 1);
     auto logMap = [&](double t) { return std::exp(std::log(minF) * (1.0 - t) + std::log(maxF) * t); };
-    for (size_t b = 0; b < m_bands; ++b) {
-        double t0 = (double)b / m_bands;
-        double t1 = (double)(b + 1) / m_bands;
+    for (size_t b = 0; b < bands; ++b) {
+        double t0 = (double)b / bands;
+        double t1 = (double)(b + 1) / bands;
         double f0 = logMap(t0);
         double f1 = logMap(t1);
         if (f0 < 1.0)
@@ -128,8 +174,8 @@ bool FFTAnalyzer::compute(std::vector<float>& outBands)
             f1 = f0 + 1.0;
         size_t i0 = (size_t)f0;
         size_t i1 = (size_t)f1;
-        if (i1 > mags.size())
-            i1 = mags.size();
+        if (i1 > count)
+            i1 = count;
         if (i0 >= i1)
             continue;
         double acc = 0.0;
@@ -144,5 +190,4 @@ bool FFTAnalyzer::compute(std::vector<float>& outBands)
     if (maxv > 0)
         for (float& v : outBands)
             v /= maxv;
-    return true;
 }
@@ -1,21 +1,64 @@
 // FFT analyzer (relocated)
 #pragma once
-#include <atomic>
+#include "audio_ring.h"
+#include "beat_tracker.h"
+#include "real_fft.h"
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
+// push() belongs to the capture thread; everything else to one analysis
+// thread. The two only meet in the lock-free input ring.
 struct FFTAnalyzer {
     explicit FFTAnalyzer(size_t fftSize = 2048, size_t bands = 64);
-    void push(const float* interleavedStereo, size_t frames);
-    bool compute(std::vector<float>& outBands);
+    // a block whose last frame was captured at timeNs (steady_clock); 0
+    // stamps it with the current time
+    void push(const float* interleavedStereo, size_t frames, int64_t timeNs = 0);
+    void setSampleRate(int rate)
+    {
+        m_rate = rate > 0 ? rate : 48000;
+        m_beat.setSampleRate(m_rate);
+    }
+    // bands of the window ending at the frame captured at atNs, or at the
+    // newest frame when atNs is 0 or later than anything captured yet
+    bool compute(std::vector<float>& outBands, int64_t atNs = 0);
+    // smoothed RMS at the end of the last window compute() looked at
+    float level() const { return m_level; }
+    // with a hop, compute() only transforms again once that many new frames
+    // have arrived (fftSize / 2 gives 50% overlap) and returns the previous
+    // bands in between; 0 transforms the newest window on every call
+    void setHop(size_t frames) { m_hop = frames; }
+    uint64_t droppedFrames() const { return m_input.dropped(); }
+    // beat and tempo at the end of the window compute() last looked at
+    const BeatTracker::State& beat() const { return m_beat.state(); }
+
+    static int64_t nowNs();
+    // count magnitudes (bin 0 = DC) averaged into log-spaced bands, scaled
+    // so the loudest band is 1
+    static void logBands(const float* mags, size_t count, size_t bands, std::vector<float>& outBands);
 
 private:
+    void drain();
+
     size_t m_fftSize;
     size_t m_bands;
-    size_t m_channels = 2;
-    std::vector<float> m_ring;
-    std::atomic<size_t> m_writeIdx { 0 };
+    AudioRing m_input;
+    std::vector<float> m_scratch; // stereo frames on their way to m_hist
+    std::vector<float> m_hist; // mono history, a power of two long
+    uint64_t m_histFrames = 0; // frames appended to m_hist so far
+    AudioRing::Stamp m_stamp { 0, 0 }; // newest stamp seen
+    bool m_haveStamp = false;
+    int m_rate = 48000;
+    float m_level = 0.0f;
     std::vector<float> m_window;
+    RealFFT m_fft;
+    std::vector<float> m_block; // windowed input, reused across calls
+    std::vector<float> m_mags;
+    std::vector<float> m_lastBands;
+    size_t m_hop = 0;
+    uint64_t m_lastAt = 0; // window end of the last transform
+    bool m_haveBands = false;
+    BeatTracker m_beat; // sees every frame drain() appends to m_hist
     void platform_init();
     bool platform_fft(const float* time, std::vector<float>& mags);
 };
@@ -0,0 +1,133 @@
+#include "frame_pipeline.h"
+#include "../avs/vis_avs/profiler.h"
+#include <algorithm>
+
+FramePipeline::FramePipeline(int width, int height, int depth, double latencyBudgetMs, RenderFn render)
+    : m_depth(std::clamp(depth, 1, 4))
+    , m_budgetMs(latencyBudgetMs)
+    , m_render(std::move(render))
+    , m_effective(m_depth)
+{
+    // one slot per frame in flight plus the one being presented
+    m_slots.resize((size_t)m_depth + 1);
+    for (auto& s : m_slots)
+        s.pixels.assign((size_t)width * height, 0u);
+    m_state.assign(m_slots.size(), SlotState::Free);
+    m_thread = std::thread(&FramePipeline::renderThread, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+FrameSlot* FramePipeline::beginFrame()
+{
+    std::unique_lock<std::mutex> l(m_lock);
+    size_t idx = 0;
+    m_cv.wait(l, [&] {
+        for (idx = 0; idx < m_state.size(); ++idx)
+            if (m_state[idx] == SlotState::Free)
+                return true;
+        return false;
+    });
+    m_state[idx] = SlotState::Filling;
+    FrameSlot& s = m_slots[idx];
+    s.frameIndex = m_nextIndex++;
+    s.snapshotAt = std::chrono::steady_clock::now();
+    return &s;
+}
+
+void FramePipeline::submit(FrameSlot* slot)
+{
+    size_t idx = (size_t)(slot - m_slots.data());
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_state[idx] = SlotState::Queued;
+        m_queue.push_back(idx);
+        m_order.push_back(idx);
+    }
+    m_cv.notify_all();
+}
+
+FrameSlot* FramePipeline::acquire()
+{
+    std::unique_lock<std::mutex> l(m_lock);
+    if (m_order.empty())
+        return nullptr;
+    size_t idx = m_order.front();
+    m_cv.wait(l, [&] { return m_state[idx] == SlotState::Done; });
+    m_order.pop_front();
+    m_state[idx] = SlotState::Presenting;
+    return &m_slots[idx];
+}
+
+void FramePipeline::release(FrameSlot* slot)
+{
+    size_t idx = (size_t)(slot - m_slots.data());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slot->snapshotAt).count();
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_latencyMs = m_latencyMs > 0.0 ? m_latencyMs * 0.9 + ms * 0.1 : ms;
+        if (m_budgetMs > 0.0) {
+            if (m_latencyMs > m_budgetMs && m_effective > 1)
+                --m_effective;
+            else if (m_latencyMs < m_budgetMs * 0.5 && m_effective < m_depth)
+                ++m_effective;
+        }
+        m_state[idx] = SlotState::Free;
+    }
+    m_cv.notify_all();
+}
+
+int FramePipeline::inFlight() const
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    return (int)m_order.size();
+}
+
+int FramePipeline::effectiveDepth() const
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_effective;
+}
+
+double FramePipeline::latencyMs() const
+{
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_latencyMs;
+}
+
+void FramePipeline::renderThread()
+{
+    prof_set_thread_name("render");
+    for (;;) {
+        size_t idx;
+        {
+            std::unique_lock<std::mutex> l(m_lock);
+            m_cv.wait(l, [&] { return m_quit || !m_queue.empty(); });
+            if (m_quit)
+                return;
+            idx = m_queue.front();
+            m_queue.pop_front();
+        }
+        FrameSlot& s = m_slots[idx];
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> cl(m_chainLock);
+            m_render(s);
+        }
+        s.renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            m_state[idx] = SlotState::Done;
+        }
+        m_cv.notify_all();
+    }
+}
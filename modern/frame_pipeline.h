@@ -0,0 +1,79 @@
+// Frame pipeline: overlaps audio snapshot, effect chain and presentation
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct EffectTiming {
+    const void* effect; // identity of the chain entry
+    float ms;
+};
+
+struct FrameSlot {
+    std::vector<uint32_t> pixels; // finished frame, valid once acquired
+    std::vector<float> spectrum; // audio snapshot taken for this frame
+    float level = 0.0f;
+    bool beat = false;
+    float bpm = 0.0f;
+    float beatPhase = 0.0f;
+    double time = 0.0;
+    uint64_t frameIndex = 0;
+    std::chrono::steady_clock::time_point snapshotAt;
+    double renderMs = 0.0;
+    std::vector<EffectTiming> effectMs; // enabled effects, in chain order
+};
+
+// Runs the effect chain on a dedicated thread. With depth 1 every frame is
+// rendered and presented before the next audio snapshot (the old serial
+// loop); with depth 2 frame N is presented while frame N+1 renders, and the
+// snapshot for N+1 is taken while N is still rendering. The latency budget
+// caps snapshot-to-present time: when the running average exceeds it the
+// pipeline falls back towards serial until it recovers.
+class FramePipeline {
+public:
+    using RenderFn = std::function<void(FrameSlot&)>;
+
+    FramePipeline(int width, int height, int depth, double latencyBudgetMs, RenderFn render);
+    ~FramePipeline();
+
+    FrameSlot* beginFrame(); // blocks until a slot is free
+    void submit(FrameSlot* slot);
+    FrameSlot* acquire(); // oldest submitted frame, blocks until rendered
+    void release(FrameSlot* slot); // after presentation; feeds the latency estimate
+
+    int inFlight() const;
+    int depth() const { return m_depth; }
+    int effectiveDepth() const;
+    double latencyMs() const;
+    double latencyBudgetMs() const { return m_budgetMs; }
+    std::mutex& chainLock() { return m_chainLock; } // held while the chain renders
+
+private:
+    enum class SlotState { Free,
+        Filling,
+        Queued,
+        Done,
+        Presenting };
+    void renderThread();
+
+    int m_depth;
+    double m_budgetMs;
+    RenderFn m_render;
+    std::vector<FrameSlot> m_slots;
+    std::vector<SlotState> m_state;
+    std::deque<size_t> m_queue; // submitted, not yet rendered
+    std::deque<size_t> m_order; // submitted, not yet acquired
+    uint64_t m_nextIndex = 0;
+    int m_effective;
+    double m_latencyMs = 0.0;
+    bool m_quit = false;
+    mutable std::mutex m_lock;
+    std::condition_variable m_cv;
+    std::mutex m_chainLock;
+    std::thread m_thread;
+};
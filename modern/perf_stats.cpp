@@ -0,0 +1,164 @@
+#include "perf_stats.h"
+#include "frame_pipeline.h"
+#include <algorithm>
+#include <cmath>
+
+RollingSeries::RollingSeries(int capacity)
+    : m_values((size_t)std::max(capacity, 1), 0.0f)
+{
+}
+
+void RollingSeries::push(float v)
+{
+    m_values[(size_t)m_next] = v;
+    m_next = (m_next + 1) % (int)m_values.size();
+    if (m_count < (int)m_values.size())
+        ++m_count;
+}
+
+void RollingSeries::clear()
+{
+    m_next = 0;
+    m_count = 0;
+}
+
+float RollingSeries::last() const
+{
+    if (!m_count)
+        return 0.0f;
+    int cap = (int)m_values.size();
+    return m_values[(size_t)((m_next + cap - 1) % cap)];
+}
+
+float RollingSeries::mean(int newest) const
+{
+    int n = newest > 0 ? std::min(newest, m_count) : m_count;
+    if (!n)
+        return 0.0f;
+    int cap = (int)m_values.size();
+    double sum = 0.0;
+    for (int i = 1; i <= n; ++i)
+        sum += m_values[(size_t)((m_next + cap - i) % cap)];
+    return (float)(sum / n);
+}
+
+float RollingSeries::max() const
+{
+    float m = 0.0f;
+    for (int i = 0; i < m_count; ++i)
+        m = std::max(m, m_values[(size_t)i]);
+    return m;
+}
+
+float RollingSeries::percentile(float p) const
+{
+    if (!m_count)
+        return 0.0f;
+    std::vector<float> s(m_values.begin(), m_values.begin() + m_count);
+    size_t k = (size_t)(std::clamp(p, 0.0f, 1.0f) * (float)(m_count - 1) + 0.5f);
+    std::nth_element(s.begin(), s.begin() + (std::ptrdiff_t)k, s.end());
+    return s[k];
+}
+
+void RollingSeries::histogram(float lo, float hi, float* bins, int binCount) const
+{
+    std::fill(bins, bins + binCount, 0.0f);
+    if (binCount <= 0 || hi <= lo)
+        return;
+    // the last bin also collects everything past hi
+    for (int i = 0; i < m_count; ++i) {
+        int b = (int)((m_values[(size_t)i] - lo) / (hi - lo) * (float)binCount);
+        bins[std::clamp(b, 0, binCount - 1)] += 1.0f;
+    }
+}
+
+void AudioCallbackMeter::onCallback(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, int frames, int rate)
+{
+    if (m_haveLast && rate > 0) {
+        double interval = std::chrono::duration<double, std::micro>(start - m_last).count();
+        double period = 1e6 * frames / rate;
+        uint32_t jitter = (uint32_t)std::abs(interval - period);
+        uint32_t prev = m_maxJitterUs.load(std::memory_order_relaxed);
+        while (jitter > prev && !m_maxJitterUs.compare_exchange_weak(prev, jitter, std::memory_order_relaxed)) {
+        }
+    }
+    m_last = start;
+    m_haveLast = true;
+    m_busyUs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), std::memory_order_relaxed);
+    m_callbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioCallbackMeter::drain(uint32_t& maxJitterUs, uint64_t& busyUs, uint32_t& callbacks)
+{
+    maxJitterUs = m_maxJitterUs.exchange(0, std::memory_order_relaxed);
+    busyUs = m_busyUs.exchange(0, std::memory_order_relaxed);
+    callbacks = m_callbacks.exchange(0, std::memory_order_relaxed);
+}
+
+void PerfStats::onPresented(const FrameSlot& done, double upload, double latency)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!m_started) {
+        m_started = true;
+        m_windowStart = now;
+    } else
+        frameMs.push((float)std::chrono::duration<double, std::milli>(now - m_lastPresent).count());
+    m_lastPresent = now;
+
+    renderMs.push((float)done.renderMs);
+    uploadMs.push((float)upload);
+    latencyMs.push((float)latency);
+    for (const EffectTiming& t : done.effectMs)
+        m_effects[t.effect].push(t.ms);
+    if (m_sinceToggle >= 0)
+        ++m_sinceToggle;
+
+    uint32_t jitterUs, callbacks;
+    uint64_t busyUs;
+    audio.drain(jitterUs, busyUs, callbacks);
+    audioJitterMs.push(jitterUs / 1000.0f);
+    m_windowRenderMs += done.renderMs;
+    m_windowAudioUs += (double)busyUs;
+    m_windowCallbacks += callbacks;
+
+    double windowMs = std::chrono::duration<double, std::milli>(now - m_windowStart).count();
+    if (windowMs >= 1000.0) {
+        renderOccupancy = (float)std::min(1.0, m_windowRenderMs / windowMs);
+        audioOccupancy = (float)std::min(1.0, m_windowAudioUs / 1000.0 / windowMs);
+        callbacksPerSecond = (float)(m_windowCallbacks * 1000.0 / windowMs);
+        m_windowRenderMs = 0.0;
+        m_windowAudioUs = 0.0;
+        m_windowCallbacks = 0;
+        m_windowStart = now;
+    }
+}
+
+const RollingSeries* PerfStats::effect(const void* e) const
+{
+    auto it = m_effects.find(e);
+    return it == m_effects.end() ? nullptr : &it->second;
+}
+
+// frames already queued when the chain changes were rendered with the old
+// chain, so averages after a toggle skip that many
+static const int kToggleSettleFrames = 4;
+
+void PerfStats::markToggle()
+{
+    // the baseline is the settled cost of the chain as it was; toggling again
+    // before the last change settled keeps the older baseline
+    if (m_sinceToggle < 0)
+        m_beforeToggle = renderMs.mean();
+    else if (m_sinceToggle > kToggleSettleFrames)
+        m_beforeToggle = renderMs.mean(m_sinceToggle - kToggleSettleFrames);
+    m_sinceToggle = 0;
+}
+
+bool PerfStats::marginalMs(float& before, float& after) const
+{
+    if (m_sinceToggle <= kToggleSettleFrames)
+        return false;
+    before = m_beforeToggle;
+    after = renderMs.mean(m_sinceToggle - kToggleSettleFrames);
+    return true;
+}
@@ -0,0 +1,87 @@
+// Rolling performance counters behind the runner's Performance overlay
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct FrameSlot;
+
+// Fixed-length sample history; once full the oldest sample is overwritten.
+// data()/size()/offset() match ImGui::PlotLines' values/count/values_offset.
+class RollingSeries {
+public:
+    explicit RollingSeries(int capacity = 240);
+    void push(float v);
+    void clear();
+
+    const float* data() const { return m_values.data(); }
+    int size() const { return m_count; }
+    int offset() const { return m_count < (int)m_values.size() ? 0 : m_next; }
+
+    float last() const;
+    float mean(int newest = 0) const; // over the newest n samples, 0 for all
+    float max() const;
+    float percentile(float p) const; // p in [0,1]
+    void histogram(float lo, float hi, float* bins, int binCount) const;
+
+private:
+    std::vector<float> m_values;
+    int m_next = 0;
+    int m_count = 0;
+};
+
+// Audio callback timing, written from the audio thread without locks and
+// drained once per frame. Jitter is how far the interval between two
+// callbacks strays from the buffer period.
+class AudioCallbackMeter {
+public:
+    void onCallback(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, int frames, int rate);
+    // worst jitter and total callback time since the last call, in microseconds
+    void drain(uint32_t& maxJitterUs, uint64_t& busyUs, uint32_t& callbacks);
+
+private:
+    std::atomic<uint32_t> m_maxJitterUs { 0 };
+    std::atomic<uint64_t> m_busyUs { 0 };
+    std::atomic<uint32_t> m_callbacks { 0 };
+    std::chrono::steady_clock::time_point m_last; // audio thread only
+    bool m_haveLast = false;
+};
+
+// Owned by the presenting thread; fed one finished frame at a time.
+class PerfStats {
+public:
+    // done is the frame just presented, uploadMs the time its pixels took to
+    // reach the texture
+    void onPresented(const FrameSlot& done, double uploadMs, double latencyMs);
+    const RollingSeries* effect(const void* e) const;
+
+    // marks a chain edit so marginalMs() compares render cost before and after
+    void markToggle();
+    bool marginalMs(float& before, float& after) const;
+
+    RollingSeries frameMs; // present to present
+    RollingSeries renderMs; // whole chain on the render thread
+    RollingSeries uploadMs;
+    RollingSeries latencyMs; // audio snapshot to present
+    RollingSeries audioJitterMs; // worst per frame
+
+    // busy fraction over the last whole second
+    float renderOccupancy = 0.0f;
+    float audioOccupancy = 0.0f;
+    float callbacksPerSecond = 0.0f;
+
+    AudioCallbackMeter audio;
+
+private:
+    std::unordered_map<const void*, RollingSeries> m_effects;
+    std::chrono::steady_clock::time_point m_lastPresent;
+    std::chrono::steady_clock::time_point m_windowStart;
+    double m_windowRenderMs = 0.0;
+    double m_windowAudioUs = 0.0;
+    uint32_t m_windowCallbacks = 0;
+    bool m_started = false;
+    float m_beforeToggle = 0.0f;
+    int m_sinceToggle = -1;
+};
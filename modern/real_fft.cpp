@@ -0,0 +1,159 @@
+#include "real_fft.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REAL_FFT_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define REAL_FFT_NEON 1
+#endif
+
+RealFFT::RealFFT(size_t n)
+{
+    m_n = 4;
+    while (m_n < n)
+        m_n <<= 1;
+    m_half = m_n / 2;
+
+    int bits = 0;
+    while (((size_t)1 << bits) < m_half)
+        ++bits;
+    m_bitrev.resize(m_half);
+    for (size_t i = 0; i < m_half; ++i) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; ++b)
+            r |= (uint32_t)((i >> b) & 1) << (bits - 1 - b);
+        m_bitrev[i] = r;
+    }
+
+    // twiddles in double so long transforms don't accumulate table error
+    const double pi = 3.14159265358979323846;
+    m_twRe.resize(m_half);
+    m_twIm.resize(m_half);
+    for (size_t h = 1; h < m_half; h <<= 1)
+        for (size_t j = 0; j < h; ++j) {
+            double a = -pi * (double)j / (double)h;
+            m_twRe[h - 1 + j] = (float)std::cos(a);
+            m_twIm[h - 1 + j] = (float)std::sin(a);
+        }
+    m_splitRe.resize(m_half + 1);
+    m_splitIm.resize(m_half + 1);
+    for (size_t k = 0; k <= m_half; ++k) {
+        double a = -2.0 * pi * (double)k / (double)m_n;
+        m_splitRe[k] = (float)std::cos(a);
+        m_splitIm[k] = (float)std::sin(a);
+    }
+    m_re.resize(m_half);
+    m_im.resize(m_half);
+    m_xRe.resize(m_half + 1);
+    m_xIm.resize(m_half + 1);
+}
+
+void RealFFT::complexFFT()
+{
+    float* re = m_re.data();
+    float* im = m_im.data();
+    const size_t n = m_half;
+
+    // spans 1 and 2 have trivial twiddles (1, -i)
+    for (size_t s = 0; s + 1 < n; s += 2) {
+        float ar = re[s], ai = im[s], br = re[s + 1], bi = im[s + 1];
+        re[s] = ar + br;
+        im[s] = ai + bi;
+        re[s + 1] = ar - br;
+        im[s + 1] = ai - bi;
+    }
+    if (n >= 4)
+        for (size_t s = 0; s < n; s += 4) {
+            float ar = re[s], ai = im[s], br = re[s + 2], bi = im[s + 2];
+            re[s] = ar + br;
+            im[s] = ai + bi;
+            re[s + 2] = ar - br;
+            im[s + 2] = ai - bi;
+            // (br, bi) * -i = (bi, -br)
+            ar = re[s + 1];
+            ai = im[s + 1];
+            br = im[s + 3];
+            bi = -re[s + 3];
+            re[s + 1] = ar + br;
+            im[s + 1] = ai + bi;
+            re[s + 3] = ar - br;
+            im[s + 3] = ai - bi;
+        }
+
+    // from span 4 on every block is a whole number of 4-wide vectors
+    for (size_t h = 4; h < n; h <<= 1) {
+        const float* wr = &m_twRe[h - 1];
+        const float* wi = &m_twIm[h - 1];
+        for (size_t s = 0; s < n; s += 2 * h) {
+            float* ar = re + s;
+            float* ai = im + s;
+            float* br = ar + h;
+            float* bi = ai + h;
+            for (size_t j = 0; j < h; j += 4) {
+#if REAL_FFT_SSE2
+                __m128 xr = _mm_loadu_ps(br + j), xi = _mm_loadu_ps(bi + j);
+                __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+                __m128 yr = _mm_loadu_ps(ar + j), yi = _mm_loadu_ps(ai + j);
+                _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+#elif REAL_FFT_NEON
+                float32x4_t xr = vld1q_f32(br + j), xi = vld1q_f32(bi + j);
+                float32x4_t cr = vld1q_f32(wr + j), ci = vld1q_f32(wi + j);
+                float32x4_t tr = vsubq_f32(vmulq_f32(xr, cr), vmulq_f32(xi, ci));
+                float32x4_t ti = vaddq_f32(vmulq_f32(xr, ci), vmulq_f32(xi, cr));
+                float32x4_t yr = vld1q_f32(ar + j), yi = vld1q_f32(ai + j);
+                vst1q_f32(br + j, vsubq_f32(yr, tr));
+                vst1q_f32(bi + j, vsubq_f32(yi, ti));
+                vst1q_f32(ar + j, vaddq_f32(yr, tr));
+                vst1q_f32(ai + j, vaddq_f32(yi, ti));
+#else
+                for (size_t k = j; k < j + 4; ++k) {
+                    float tr = br[k] * wr[k] - bi[k] * wi[k];
+                    float ti = br[k] * wi[k] + bi[k] * wr[k];
+                    br[k] = ar[k] - tr;
+                    bi[k] = ai[k] - ti;
+                    ar[k] += tr;
+                    ai[k] += ti;
+                }
+#endif
+            }
+        }
+    }
+}
+
+void RealFFT::forward(const float* in, float* outRe, float* outIm)
+{
+    for (size_t i = 0; i < m_half; ++i) {
+        uint32_t r = m_bitrev[i];
+        m_re[r] = in[2 * i];
+        m_im[r] = in[2 * i + 1];
+    }
+    complexFFT();
+
+    // Z = FFT(even + i odd); with E = (Z[k] + conj Z[M-k]) / 2 and
+    // O = (Z[k] - conj Z[M-k]) / 2i, X[k] = E + e^(-2 pi i k / n) O
+    const size_t m = m_half;
+    for (size_t k = 0; k <= m; ++k) {
+        size_t k0 = k == m ? 0 : k;
+        size_t k1 = k == 0 ? 0 : m - k;
+        float a = m_re[k0], b = m_im[k0], c = m_re[k1], d = m_im[k1];
+        float er = 0.5f * (a + c), ei = 0.5f * (b - d);
+        float orr = 0.5f * (b + d), oi = -0.5f * (a - c);
+        float wr = m_splitRe[k], wi = m_splitIm[k];
+        outRe[k] = er + wr * orr - wi * oi;
+        outIm[k] = ei + wr * oi + wi * orr;
+    }
+}
+
+void RealFFT::magnitudes(const float* in, float* mags)
+{
+    forward(in, m_xRe.data(), m_xIm.data());
+    for (size_t k = 0; k < m_half; ++k)
+        mags[k] = std::sqrt(m_xRe[k] * m_xRe[k] + m_xIm[k] * m_xIm[k]);
+}
@@ -0,0 +1,33 @@
+// Real-input FFT with precomputed twiddles and SIMD butterflies
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Transforms n real samples as an n/2-point complex FFT over the (even, odd)
+// sample pairs followed by one split pass, so a real block costs about half a
+// complex transform of the same length. Tables and scratch are built once;
+// forward() and magnitudes() never allocate. Not thread-safe per instance.
+class RealFFT {
+public:
+    explicit RealFFT(size_t n); // n is rounded up to a power of two, at least 4
+    size_t size() const { return m_n; }
+
+    // bins 0..n/2 of the unnormalised DFT; re and im hold n/2 + 1 values
+    void forward(const float* in, float* re, float* im);
+    // |X[k]| for bins 0..n/2-1
+    void magnitudes(const float* in, float* mags);
+
+private:
+    void complexFFT(); // in place on m_re / m_im, input in bit-reversed order
+
+    size_t m_n;
+    size_t m_half;
+    std::vector<uint32_t> m_bitrev; // over m_half
+    // butterfly twiddles, stage with span h at [h - 1, 2h - 1)
+    std::vector<float> m_twRe, m_twIm;
+    // split pass twiddles e^(-2 pi i k / n), k in [0, n/2]
+    std::vector<float> m_splitRe, m_splitIm;
+    std::vector<float> m_re, m_im;
+    std::vector<float> m_xRe, m_xIm; // magnitudes() output bins
+};
@@ -8,6 +8,7 @@
   #include <windows.h>
 #else
 // Standard headers
+#include <strings.h>
 #ifdef __cplusplus
   #include <cstdint>
   #include <cstddef>
@@ -17,6 +18,16 @@
   #include <string>
   #include <chrono>
   #include <thread>
+  // before the min/max macros below, which would break these
+  #include <algorithm>
+  #include <cmath>
+  #include <condition_variable>
+  #include <deque>
+  #include <functional>
+  #include <list>
+  #include <memory>
+  #include <mutex>
+  #include <vector>
 #else
   #include <stdint.h>
   #include <stddef.h>
@@ -50,6 +61,7 @@ typedef long LPARAM;
 typedef unsigned long WPARAM;
 typedef long LRESULT;
 typedef unsigned long long ULONG_PTR;
+typedef unsigned long long UINT_PTR;
 typedef DWORD* LPDWORD;
 
 struct RECT { LONG left, top, right, bottom; };
@@ -70,6 +82,11 @@ struct SIZE { LONG cx, cy; };
 #define CALLBACK
 #define WINAPI
 #define APIENTRY
+#define __cdecl
+
+// structured exception handling: C++ exceptions are all that can be caught
+#define __try try
+#define __except(filter) catch (...)
 
 #ifndef __declspec
 #define __declspec(x)
@@ -165,8 +182,10 @@ inline void Sleep(DWORD ms) {
 
 // Message sending stubs (return neutral values). These will be replaced by
 // portable UI/event abstractions or removed entirely.
-inline long SendMessage(HWND, unsigned int, unsigned long, long) { return 0; }
-inline long SendMessage(HWND, unsigned int, unsigned long, unsigned long) { return 0; }
+template <class W, class L>
+inline LRESULT SendMessage(HWND, unsigned int, W, L) { return 0; }
+template <class W, class L>
+inline BOOL PostMessage(HWND, unsigned int, W, L) { return FALSE; }
 inline BOOL SendMessageTimeout(HWND, unsigned int, unsigned long, long, unsigned int, unsigned int, unsigned long*) { return FALSE; }
 
 inline BOOL IsWindow(HWND) { return TRUE; }
@@ -179,21 +198,30 @@ inline int IsDlgButtonChecked(HWND, int) { return 0; }
 inline HWND GetDlgItem(HWND, int) { return (HWND)0x1; }
 inline int SetWindowText(HWND, const char*) { return 0; }
 inline int GetWindowText(HWND, char* buf, int) { if(buf) buf[0]='\0'; return 0; }
-inline long SendDlgItemMessage(HWND, int, unsigned int, unsigned long, unsigned long) { return 0; }
+template <class W, class L>
+inline LRESULT SendDlgItemMessage(HWND, int, unsigned int, W, L) { return 0; }
 inline int GetDlgItemText(HWND, int, char* buf, int max) { if(buf && max>0) buf[0]='\0'; return 0; }
 // Text message constants
 #define WM_GETTEXTLENGTH 0x000E
 
-// Memory allocation stubs for VirtualAlloc/Free; map to malloc/free (no protection flags handled)
+// Memory allocation stubs for VirtualAlloc/Free; map to calloc/free (no
+// protection flags handled). Like the real thing, committed pages and GPTR
+// blocks come back zeroed, which the effects rely on.
 #define MEM_COMMIT 0x00001000
+#define MEM_DECOMMIT 0x4000
+#define MEM_RELEASE 0x8000
 #define PAGE_READWRITE 0x04
-inline LPVOID VirtualAlloc(LPVOID, size_t sz, unsigned long, unsigned long) { return malloc(sz); }
+inline LPVOID VirtualAlloc(LPVOID, size_t sz, unsigned long, unsigned long) { return calloc(1, sz); }
+// the effects only decommit a whole block before allocating its replacement
 inline int VirtualFree(LPVOID p, size_t, unsigned long) { free(p); return 1; }
-#define MEM_RELEASE 0x8000
 // GlobalAlloc/Free simple emulation
-#define GPTR 0
-inline void* GlobalAlloc(unsigned int, size_t sz) { return malloc(sz); }
-inline int GlobalFree(void* p) { free(p); return 0; }
+typedef void* HGLOBAL;
+#define GMEM_FIXED 0
+#define GPTR 0x40
+inline void* GlobalAlloc(unsigned int flags, size_t sz) { return (flags & GPTR) ? calloc(1, sz) : malloc(sz); }
+inline HGLOBAL GlobalFree(void* p) { free(p); return NULL; }
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+#define MoveMemory(d, s, n) memmove((d), (s), (n))
 
 // Synchronization primitives (no-op implementations)
 typedef struct { int dummy; } CRITICAL_SECTION;
@@ -232,14 +260,223 @@ inline void* FindFirstFile(const char*, WIN32_FIND_DATA*) { return (void*)0x1; }
 inline int FindNextFile(void*, WIN32_FIND_DATA*) { return 0; }
 inline int FindClose(void*) { return 0; }
 
+// Integer types / helpers
+#define __int64 long long
+typedef HINSTANCE HMODULE;
+typedef void* HMENU;
+typedef void* HRGN;
+typedef long long INT_PTR;
+typedef INT_PTR (*DLGPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef INT_PTR (*FARPROC)();
+#define FAR
+#ifndef MAKEINTRESOURCE
+#define MAKEINTRESOURCE(i) ((char*)(uintptr_t)(unsigned short)(i))
+#endif
+#define MAKELONG(a, b) ((LONG)(((unsigned short)(a)) | ((DWORD)((unsigned short)(b))) << 16))
+#define MAKEWPARAM(l, h) ((WPARAM)(DWORD)MAKELONG(l, h))
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((unsigned short)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define wsprintf sprintf
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+#define lstrcmpi strcasecmp
+inline int MulDiv(int a, int b, int c) { return c ? (int)(((long long)a * b) / c) : -1; }
+inline char* _itoa(int v, char* buf, int radix)
+{
+    if (radix == 16)
+        sprintf(buf, "%x", v);
+    else
+        sprintf(buf, "%d", v);
+    return buf;
+}
+inline void ExitProcess(UINT code) { exit((int)code); }
+
+// Further messages, notifications and control constants used by the
+// effect configuration dialogs (which are never created off Windows)
+#define WM_DESTROY 0x0002
+#define WM_GETTEXT 0x000D
+#define WM_DRAWITEM 0x002B
+#define WM_NOTIFY 0x004E
+#define WM_TIMER 0x0113
+#define WM_HSCROLL 0x0114
+#define IDOK 1
+#define IDCANCEL 2
+#define BN_CLICKED 0
+#define BST_INDETERMINATE 2
+#define TBM_SETRANGEMIN (WM_USER+7)
+#define TBM_SETRANGEMAX (WM_USER+8)
+#define TBM_SETTICFREQ (WM_USER+20)
+#define TB_ENDTRACK 8
+#define CB_ERR (-1)
+#define CB_GETLBTEXT 0x0148
+#define CB_GETCURSEL 0x0147
+#define CB_RESETCONTENT 0x014B
+#define CBN_SELCHANGE 1
+#define LB_ADDSTRING 0x0180
+#define LB_SETCURSEL 0x0186
+#define LB_GETCURSEL 0x0188
+#define LBN_SELCHANGE 1
+#define TCN_SELCHANGE (-551)
+#define TCIF_TEXT 0x0001
+#define MB_OK 0x0000
+#define EXCEPTION_EXECUTE_HANDLER 1
+
+typedef struct { HWND hwndFrom; ULONG_PTR idFrom; UINT code; } NMHDR, *LPNMHDR;
+typedef struct { UINT mask; DWORD dwState; DWORD dwStateMask; char* pszText; int cchTextMax; int iImage; LPARAM lParam; } TCITEM;
+#define TabCtrl_InsertItem(hwnd, i, item) ((void)(hwnd), (void)(i), (void)(item), -1)
+#define TabCtrl_GetCurSel(hwnd) ((void)(hwnd), -1)
+#define TabCtrl_SetCurSel(hwnd, i) ((void)(hwnd), (void)(i), -1)
+
+inline HWND CreateDialog(HINSTANCE, const char*, HWND, DLGPROC) { return NULL; }
+template <class P>
+inline HWND CreateDialog(HINSTANCE, const char*, HWND, P) { return NULL; }
+template <class P>
+inline INT_PTR DialogBoxParam(HINSTANCE, const char*, HWND, P, LPARAM) { return -1; }
+inline BOOL EndDialog(HWND, INT_PTR) { return TRUE; }
+inline BOOL EnableWindow(HWND, BOOL) { return FALSE; }
+#define SW_HIDE 0
+#define SW_NORMAL 1
+#define SW_SHOWNA 8
+inline BOOL ShowWindow(HWND, int) { return FALSE; }
+inline HWND SetFocus(HWND) { return NULL; }
+inline BOOL InvalidateRect(HWND, const RECT*, BOOL) { return TRUE; }
+inline BOOL GetWindowRect(HWND, RECT* r) { if (r) memset(r, 0, sizeof(*r)); return FALSE; }
+inline BOOL SetDlgItemText(HWND, int, const char*) { return TRUE; }
+inline UINT GetDlgItemInt(HWND, int, BOOL* ok, BOOL) { if (ok) *ok = FALSE; return 0; }
+inline BOOL SetDlgItemInt(HWND, int, UINT, BOOL) { return TRUE; }
+inline UINT_PTR SetTimer(HWND, UINT_PTR id, UINT, void*) { return id; }
+inline BOOL KillTimer(HWND, UINT_PTR) { return TRUE; }
+inline int MessageBox(HWND, const char* text, const char* caption, UINT)
+{
+    fprintf(stderr, "%s: %s\n", caption ? caption : "", text ? text : "");
+    return IDOK;
+}
+
+// Colour / font pickers
+#define CC_RGBINIT 0x1
+#define CC_FULLOPEN 0x2
+typedef struct { DWORD lStructSize; HWND hwndOwner; HWND hInstance; COLORREF rgbResult; COLORREF* lpCustColors; DWORD Flags; LPARAM lCustData; void* lpfnHook; const char* lpTemplateName; } CHOOSECOLOR;
+inline BOOL ChooseColor(CHOOSECOLOR*) { return FALSE; }
+
+// Popup menus
+#define MIIM_ID 0x02
+#define MIIM_TYPE 0x10
+#define MIIM_DATA 0x20
+#define MFT_STRING 0x0
+#define TPM_LEFTBUTTON 0x0
+#define TPM_RIGHTBUTTON 0x2
+#define TPM_LEFTALIGN 0x0
+#define TPM_TOPALIGN 0x0
+#define TPM_NONOTIFY 0x80
+#define TPM_RETURNCMD 0x100
+typedef struct { UINT cbSize; UINT fMask; UINT fType; UINT fState; UINT wID; HMENU hSubMenu; HBITMAP hbmpChecked; HBITMAP hbmpUnchecked; ULONG_PTR dwItemData; char* dwTypeData; UINT cch; } MENUITEMINFO;
+inline HMENU CreatePopupMenu() { return NULL; }
+inline BOOL InsertMenuItem(HMENU, UINT, BOOL, const MENUITEMINFO*) { return FALSE; }
+inline BOOL TrackPopupMenu(HMENU, UINT, int, int, int, HWND, const RECT*) { return FALSE; }
+inline BOOL DestroyMenu(HMENU) { return TRUE; }
+
+// GDI: drawing into dialog controls only
+#define PS_SOLID 0
+#define BS_SOLID 0
+#define TRANSPARENT 1
+#define BLACK_PEN 7
+#define DT_LEFT 0x0
+#define DT_TOP 0x0
+#define DT_CENTER 0x1
+#define DT_RIGHT 0x2
+#define DT_VCENTER 0x4
+#define DT_BOTTOM 0x8
+#define DT_SINGLELINE 0x20
+#define DT_NOCLIP 0x100
+#define BI_RGB 0
+#define DIB_RGB_COLORS 0
+#define COLORONCOLOR 3
+typedef struct { UINT lbStyle; COLORREF lbColor; ULONG_PTR lbHatch; } LOGBRUSH;
+typedef struct { DWORD biSize; LONG biWidth; LONG biHeight; unsigned short biPlanes; unsigned short biBitCount; DWORD biCompression; DWORD biSizeImage; LONG biXPelsPerMeter; LONG biYPelsPerMeter; DWORD biClrUsed; DWORD biClrImportant; } BITMAPINFOHEADER, *LPBITMAPINFOHEADER;
+typedef struct { BYTE rgbBlue, rgbGreen, rgbRed, rgbReserved; } RGBQUAD;
+typedef struct { BITMAPINFOHEADER bmiHeader; RGBQUAD bmiColors[1]; } BITMAPINFO;
+typedef struct { LONG bmType; LONG bmWidth; LONG bmHeight; LONG bmWidthBytes; unsigned short bmPlanes; unsigned short bmBitsPixel; void* bmBits; } BITMAP;
+inline HDC GetDC(HWND) { return NULL; }
+inline int ReleaseDC(HWND, HDC) { return 1; }
+inline HGDIOBJ SelectObject(HDC, HGDIOBJ) { return NULL; }
+inline HGDIOBJ GetStockObject(int) { return NULL; }
+inline int GetObject(HGDIOBJ, int, void*) { return 0; }
+inline HPEN CreatePen(int, int, COLORREF) { return NULL; }
+inline HBRUSH CreateBrushIndirect(const LOGBRUSH*) { return NULL; }
+inline HBRUSH CreateSolidBrush(COLORREF) { return NULL; }
+inline BOOL Rectangle(HDC, int, int, int, int) { return TRUE; }
+inline COLORREF SetTextColor(HDC, COLORREF) { return 0; }
+inline COLORREF SetBkColor(HDC, COLORREF) { return 0; }
+inline int SetBkMode(HDC, int) { return 0; }
+inline int DrawText(HDC, const char*, int, RECT*, UINT) { return 0; }
+inline BOOL GetTextExtentPoint32(HDC, const char*, int, SIZE* sz) { if (sz) sz->cx = sz->cy = 0; return FALSE; }
+inline HBITMAP CreateCompatibleBitmap(HDC, int, int) { return NULL; }
+inline int GetDIBits(HDC, HBITMAP, UINT, UINT, void*, BITMAPINFO*, UINT) { return 0; }
+inline int SetDIBits(HDC, HBITMAP, UINT, UINT, const void*, const BITMAPINFO*, UINT) { return 0; }
+inline int SetStretchBltMode(HDC, int) { return 0; }
+inline BOOL StretchBlt(HDC, int, int, int, int, HDC, int, int, int, int, DWORD) { return FALSE; }
+
+// Files: just enough for the preset reader / writer
+#define GENERIC_READ 0x80000000ul
+#define GENERIC_WRITE 0x40000000ul
+#define FILE_SHARE_READ 0x1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+inline HANDLE CreateFile(const char* name, DWORD access, DWORD, void*, DWORD, DWORD, HANDLE)
+{
+    FILE* fp = fopen(name, (access & GENERIC_WRITE) ? "wb" : "rb");
+    return fp ? (HANDLE)fp : INVALID_HANDLE_VALUE;
+}
+inline DWORD GetFileSize(HANDLE h, DWORD* high)
+{
+    FILE* fp = (FILE*)h;
+    long pos = ftell(fp), len;
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+    if (high)
+        *high = 0;
+    return (DWORD)len;
+}
+inline BOOL ReadFile(HANDLE h, void* buf, DWORD n, DWORD* done, void*)
+{
+    size_t r = fread(buf, 1, n, (FILE*)h);
+    if (done)
+        *done = (DWORD)r;
+    return !ferror((FILE*)h);
+}
+inline BOOL WriteFile(HANDLE h, const void* buf, DWORD n, DWORD* done, void*)
+{
+    size_t r = fwrite(buf, 1, n, (FILE*)h);
+    if (done)
+        *done = (DWORD)r;
+    return r == n;
+}
+inline BOOL CloseHandle(HANDLE h) { return fclose((FILE*)h) == 0; }
+
+// APE plug-in DLLs are not loaded off Windows
+inline HINSTANCE LoadLibrary(const char*) { return NULL; }
+inline FARPROC GetProcAddress(HINSTANCE, const char*) { return NULL; }
+inline BOOL FreeLibrary(HINSTANCE) { return TRUE; }
+
 // Clipboard / etc. left unimplemented (add as needed)
 
-// Fallback min/max if not present
+// Fallback min/max if not present. Modern sources define NOMINMAX (as with
+// windows.h) so the macros don't clobber std::min/std::max; legacy headers
+// they include still get plain functions.
+#if defined(NOMINMAX) && defined(__cplusplus)
+template <class A, class B>
+inline auto max(A a, B b) -> decltype(a > b ? a : b) { return a > b ? a : b; }
+template <class A, class B>
+inline auto min(A a, B b) -> decltype(a < b ? a : b) { return a < b ? a : b; }
+#elif !defined(NOMINMAX)
 #ifndef max
 #define max(a,b) (( (a) > (b) ) ? (a):(b))
 #endif
 #ifndef min
 #define min(a,b) (( (a) < (b) ) ? (a):(b))
 #endif
+#endif // NOMINMAX
 
 #endif // _WIN32
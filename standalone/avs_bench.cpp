@@ -0,0 +1,359 @@
+// Benchmark over the bundled presets: replays a fixed audio stream (a seeded
+// synthetic track, or a WAV file) through every preset at a set of sizes and
+// reports mean / p50 / p99 frame time for the whole chain and for each effect
+// in it, as JSON for regression gates and for comparing SIMD / threading
+// modes. Runs are deterministic: same audio, same rand() seed, and a checksum
+// of the last frame so output changes show up next to timing changes.
+
+#include "../platform_shim.h"
+#include "../avs/vis_avs/avs_eelif.h"
+#include "../avs/vis_avs/blend_simd.h"
+#include "../avs/vis_avs/r_defs.h"
+#include "../avs/vis_avs/r_list.h"
+#include "../avs/vis_avs/rlib.h"
+#include "visdata.h"
+#include "wav_read.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern char g_path[];
+extern int g_config_smp, g_config_smp_mt, g_config_tiles;
+extern C_RLibrary* g_render_library;
+extern C_RenderListClass* g_render_effects;
+
+namespace {
+const int kSampleRate = 44100;
+const double kFps = 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string presets = "avs/vis_avs/presets";
+    const char* audio = nullptr; // synthetic
+    const char* out = "-";
+    const char* match = nullptr;
+    std::vector<std::pair<int, int>> sizes = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+    int frames = 300, warmup = 30;
+    int threads = 0; // hardware concurrency
+    bool tiles = true;
+    int simd = -1; // best
+};
+
+struct Stats {
+    double mean = 0, p50 = 0, p99 = 0;
+};
+
+Stats stats_of(std::vector<double> v)
+{
+    Stats s;
+    if (v.empty())
+        return s;
+    std::sort(v.begin(), v.end());
+    for (double x : v)
+        s.mean += x;
+    s.mean /= v.size();
+    // nearest rank
+    auto rank = [&](double p) { return v[std::min(v.size() - 1, (size_t)std::ceil(p * v.size()) - 1)]; };
+    s.p50 = rank(0.50);
+    s.p99 = rank(0.99);
+    return s;
+}
+
+// per-effect wall time, keyed by the effect's slot path in the chain ("2/0"
+// is the first child of the list in the root's third slot)
+class BenchProbe : public C_RenderProbe {
+public:
+    struct Effect {
+        std::string path, name;
+        std::vector<double> ms; // one entry per timed frame
+        double frame_ms = 0;
+    };
+    std::vector<Effect> effects; // in order of first appearance
+
+    void enter(C_RBASE* effect, int index) override
+    {
+        m_stack.push_back({ index, Clock::now() });
+    }
+    void leave(C_RBASE* effect, int index) override
+    {
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - m_stack.back().start).count();
+        std::string path;
+        for (const Frame& f : m_stack)
+            path += (path.empty() ? "" : "/") + std::to_string(f.index);
+        m_stack.pop_back();
+        record(path, effect, ms);
+    }
+    void add(C_RBASE* effect, int index, double ms) override
+    {
+        std::string path;
+        for (const Frame& f : m_stack)
+            path += std::to_string(f.index) + "/";
+        record(path + std::to_string(index), effect, ms);
+    }
+    void end_frame(bool keep)
+    {
+        for (Effect& e : effects) {
+            if (keep)
+                e.ms.push_back(e.frame_ms);
+            e.frame_ms = 0;
+        }
+    }
+
+private:
+    struct Frame {
+        int index;
+        Clock::time_point start;
+    };
+    void record(const std::string& path, C_RBASE* effect, double ms)
+    {
+        auto it = m_index.find(path);
+        if (it == m_index.end()) {
+            it = m_index.emplace(path, effects.size()).first;
+            effects.push_back({ path, effect->get_desc() ? effect->get_desc() : "" });
+        }
+        effects[it->second].frame_ms += ms;
+    }
+    std::vector<Frame> m_stack;
+    std::unordered_map<std::string, size_t> m_index;
+};
+
+// a deterministic stand-in for music: a 120 bpm kick, a bass line, a chord
+// pad and seeded noise hats, so the beat detector and the spectrum both move
+void synth_audio(double seconds, std::vector<float>& pcm)
+{
+    const int64_t n = (int64_t)(seconds * kSampleRate);
+    pcm.resize(n * 2);
+    const double tau = 6.283185307179586;
+    const double bass[4] = { 55.0, 55.0, 73.42, 65.41 };
+    uint32_t seed = 12345;
+    for (int64_t i = 0; i < n; i++) {
+        double t = (double)i / kSampleRate;
+        double beat = std::fmod(t, 0.5);
+        double kick = std::exp(-beat * 18.0) * std::sin(tau * (45.0 + 80.0 * std::exp(-beat * 30.0)) * beat);
+        double b = 0.25 * std::sin(tau * bass[(int)(t / 2.0) & 3] * t);
+        double pad = 0.08 * (std::sin(tau * 261.63 * t) + std::sin(tau * 329.63 * t) + std::sin(tau * 392.0 * t));
+        seed = seed * 1664525u + 1013904223u;
+        double noise = ((seed >> 9) / 4194304.0 - 1.0) * std::exp(-std::fmod(t + 0.25, 0.5) * 60.0) * 0.3;
+        double l = 0.7 * kick + b + pad + noise, r = 0.7 * kick + b + pad * 0.8 - noise;
+        pcm[i * 2] = (float)std::max(-1.0, std::min(1.0, l));
+        pcm[i * 2 + 1] = (float)std::max(-1.0, std::min(1.0, r));
+    }
+}
+
+std::string json_str(const std::string& s)
+{
+    std::string o = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\')
+            o += '\\', o += (char)c;
+        else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            o += buf;
+        } else
+            o += (char)c;
+    }
+    return o + "\"";
+}
+
+void json_stats(FILE* f, const Stats& s)
+{
+    fprintf(f, "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f", s.mean, s.p50, s.p99);
+}
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: avs_bench [options]\n"
+        "  -presets <dir>    preset directory (avs/vis_avs/presets)\n"
+        "  -match <text>     only presets whose file name contains text\n"
+        "  -audio <wav>      audio to replay (a synthetic track)\n"
+        "  -sizes <list>     frame sizes (640x480,1280x720,1920x1080)\n"
+        "  -frames <n>       timed frames per preset and size (300)\n"
+        "  -warmup <n>       untimed frames first (30)\n"
+        "  -threads <n>      threads for SMP-capable effects, 1 = off (all cores)\n"
+        "  -tiles on|off     run consecutive SMP effects band by band (on)\n"
+        "  -simd <level>     scalar|sse2|avx2|neon (the best this CPU has)\n"
+        "  -o <file>         JSON output, - for stdout (-)\n");
+}
+
+bool parse(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[++i] : nullptr;
+        if (!v)
+            return false;
+        if (!strcmp(a, "-presets"))
+            o.presets = v;
+        else if (!strcmp(a, "-match"))
+            o.match = v;
+        else if (!strcmp(a, "-audio"))
+            o.audio = v;
+        else if (!strcmp(a, "-frames"))
+            o.frames = atoi(v);
+        else if (!strcmp(a, "-warmup"))
+            o.warmup = atoi(v);
+        else if (!strcmp(a, "-threads"))
+            o.threads = atoi(v);
+        else if (!strcmp(a, "-tiles")) {
+            if (strcmp(v, "on") && strcmp(v, "off"))
+                return false;
+            o.tiles = !strcmp(v, "on");
+        } else if (!strcmp(a, "-o"))
+            o.out = v;
+        else if (!strcmp(a, "-sizes")) {
+            o.sizes.clear();
+            for (const char* p = v; *p;) {
+                int w, h, n = 0;
+                if (sscanf(p, "%dx%d%n", &w, &h, &n) != 2 || w <= 0 || h <= 0)
+                    return false;
+                o.sizes.push_back({ w, h });
+                p += n;
+                if (*p == ',')
+                    p++;
+            }
+        } else if (!strcmp(a, "-simd")) {
+            for (int l = BLEND_SIMD_SCALAR; l <= BLEND_SIMD_NEON; l++)
+                if (!strcmp(v, blend_simd_get_name(l)))
+                    o.simd = l;
+            if (o.simd < 0)
+                return false;
+        } else
+            return false;
+    }
+    return o.frames > 0 && o.warmup >= 0 && !o.sizes.empty();
+}
+}
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (!parse(argc, argv, o)) {
+        usage();
+        return 1;
+    }
+
+    std::vector<std::string> presets;
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(o.presets, ec)) {
+        std::string name = e.path().filename().string();
+        if (name.size() > 4 && !strcasecmp(name.c_str() + name.size() - 4, ".avs") && (!o.match || name.find(o.match) != std::string::npos))
+            presets.push_back(name);
+    }
+    if (presets.empty()) {
+        fprintf(stderr, "avs_bench: no presets in %s\n", o.presets.c_str());
+        return 1;
+    }
+    std::sort(presets.begin(), presets.end());
+
+    std::vector<float> pcm;
+    if (o.audio) {
+        std::string err;
+        if (!wav_read_stereo(o.audio, kSampleRate, pcm, err)) {
+            fprintf(stderr, "avs_bench: %s: %s\n", o.audio, err.c_str());
+            return 1;
+        }
+    } else
+        synth_audio((o.warmup + o.frames) / kFps + 1.0, pcm);
+    const int64_t audio_frames = (int64_t)(pcm.size() / 2);
+
+    int simd = o.simd >= 0 ? blend_simd_set_level(o.simd) : blend_simd_set_level(blend_simd_get_best());
+    g_config_smp_mt = o.threads > 0 ? o.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    g_config_smp = g_config_smp_mt > 1;
+    g_config_tiles = o.tiles;
+    snprintf(g_path, 1024, "%s", o.presets.c_str());
+
+    FILE* f = strcmp(o.out, "-") ? fopen(o.out, "w") : stdout;
+    if (!f) {
+        fprintf(stderr, "avs_bench: cannot open %s\n", o.out);
+        return 1;
+    }
+    fprintf(f, "{\n  \"config\": { \"audio\": %s, \"frames\": %d, \"warmup\": %d, \"threads\": %d, \"tiles\": %s, \"simd\": \"%s\" },\n  \"results\": [",
+        json_str(o.audio ? o.audio : "synthetic").c_str(), o.frames, o.warmup, g_config_smp ? g_config_smp_mt : 1, o.tiles ? "true" : "false", blend_simd_get_name(simd));
+
+    AVS_EEL_IF_init();
+    g_render_library = new C_RLibrary();
+    BenchProbe* probe = nullptr;
+    bool first = true;
+    for (const std::string& name : presets) {
+        std::string path = o.presets + "/" + name;
+        for (const auto& size : o.sizes) {
+            const int w = size.first, h = size.second;
+            // a fresh chain per run, so no state leaks between sizes
+            g_render_effects = new C_RenderListClass(1);
+            if (g_render_effects->__LoadPreset((char*)path.c_str(), 1)) {
+                fprintf(stderr, "avs_bench: cannot load %s\n", path.c_str());
+                delete g_render_effects;
+                g_render_effects = NULL;
+                continue;
+            }
+            // after the load: Channel Shift reseeds from the clock in load_config
+            srand(1);
+            std::vector<int> fb_a((size_t)w * h), fb_b((size_t)w * h);
+            int *fb = fb_a.data(), *fb2 = fb_b.data();
+            char visdata[2][2][576];
+            VisDataSource vis;
+            probe = new BenchProbe;
+            g_render_probe = probe;
+
+            std::vector<double> frame_ms;
+            for (int i = 0; i < o.warmup + o.frames; i++) {
+                int64_t end = (int64_t)((double)(i + 1) * kSampleRate / kFps);
+                int beat = vis.compute(pcm.data(), audio_frames, end, visdata);
+                Clock::time_point t0 = Clock::now();
+                if (g_render_effects->render(visdata, beat, fb, fb2, w, h) & 1)
+                    std::swap(fb, fb2);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+                if (i >= o.warmup)
+                    frame_ms.push_back(ms);
+                probe->end_frame(i >= o.warmup);
+            }
+            g_render_probe = NULL;
+
+            // FNV-1a of the visible pixels of the last frame
+            uint32_t sum = 2166136261u;
+            for (size_t p = 0, n = (size_t)w * h; p < n; p++) {
+                uint32_t c = (uint32_t)fb[p] & 0xffffff;
+                for (int k = 0; k < 3; k++, c >>= 8)
+                    sum = (sum ^ (c & 255)) * 16777619u;
+            }
+
+            Stats total = stats_of(frame_ms);
+            fprintf(stderr, "%-50s %4dx%-4d mean %7.3f ms  p50 %7.3f  p99 %7.3f\n", name.c_str(), w, h, total.mean, total.p50, total.p99);
+            fprintf(f, "%s\n    { \"preset\": %s, \"width\": %d, \"height\": %d, \"checksum\": \"%08x\", ",
+                first ? "" : ",", json_str(name).c_str(), w, h, sum);
+            json_stats(f, total);
+            fprintf(f, ",\n      \"effects\": [");
+            for (size_t k = 0; k < probe->effects.size(); k++) {
+                const BenchProbe::Effect& e = probe->effects[k];
+                fprintf(f, "%s\n        { \"path\": \"%s\", \"name\": %s, ", k ? "," : "", e.path.c_str(), json_str(e.name).c_str());
+                json_stats(f, stats_of(e.ms));
+                fprintf(f, " }");
+            }
+            fprintf(f, "%s] }", probe->effects.empty() ? "" : "\n      ");
+            first = false;
+
+            delete probe;
+            delete g_render_effects;
+            g_render_effects = NULL;
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    if (f != stdout)
+        fclose(f);
+
+    delete g_render_library;
+    g_render_library = NULL;
+    AVS_EEL_IF_quit();
+    return 0;
+}
@@ -1,12 +1,338 @@
-// Temporary standalone entry point for macOS/Linux.
-// Currently only exercises a tiny portion of the code to validate build.
+// Headless offline renderer: loads a binary .avs preset into the legacy
+// effects engine, drives it with vis data computed from an audio file and
+// writes the frames as raw RGBA (a single stream, e.g. piped into ffmpeg) or
+// one PNG per frame. Rendering runs as fast as the machine allows.
 
 #include "../platform_shim.h"
+#include "../avs/vis_avs/avs_eelif.h"
+#include "../avs/vis_avs/profiler.h"
+#include "../avs/vis_avs/r_defs.h"
+#include "../avs/vis_avs/r_list.h"
+#include "../avs/vis_avs/rlib.h"
+#include "../modern/beat_tracker.h"
+#include "png_write.h"
+#include "visdata.h"
+#include "wav_read.h"
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main()
+extern char g_path[];
+extern int g_config_smp, g_config_smp_mt, g_config_tiles;
+extern C_RLibrary* g_render_library;
+extern C_RenderListClass* g_render_effects;
+
+namespace {
+const int kSampleRate = 44100;
+
+struct Options {
+    const char* preset = nullptr;
+    const char* audio = nullptr;
+    const char* out = "-";
+    const char* trace = nullptr;
+    const char* beatLog = nullptr;
+    int width = 640, height = 480;
+    double fps = 60.0;
+    long long frames = -1; // whole audio
+    int threads = 0; // hardware concurrency
+    int vis = 0; // extended frame samples, 0 for legacy data only
+    int scale = -1; // RSCALE_*, -1 for the preset's own
+    double budget = 0.0; // ms, 0 for the engine default
+    bool png = false;
+    bool tiles = true;
+    bool trackedBeat = false; // isBeat from the tempo tracker, not main.cpp's detector
+};
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: avs_standalone <preset.avs> <audio.wav> [options]\n"
+        "  -w <width>        frame width (640)\n"
+        "  -h <height>       frame height (480)\n"
+        "  -fps <rate>       frames per second of audio time (60)\n"
+        "  -n <frames>       frames to render (all of the audio)\n"
+        "  -threads <n>      threads for SMP-capable effects (all cores)\n"
+        "  -tiles on|off     run consecutive SMP effects band by band (on)\n"
+        "  -vis <samples>    also hand effects that take it a float frame of\n"
+        "                    1024-4096 samples / bins per channel (off)\n"
+        "  -o <out>          '-' for raw RGBA on stdout, a file for one raw RGBA\n"
+        "                    stream, or a printf pattern such as frame%%05d.png\n"
+        "                    for one file per frame (-)\n"
+        "  -format rgba|png  per-frame file format (png if the pattern ends in .png)\n"
+        "  -scale full|75|50|auto\n"
+        "                    internal render scale, overriding the preset's;\n"
+        "                    auto lowers it while the frame time p95 is over\n"
+        "                    budget (the preset's)\n"
+        "  -budget <ms>      frame time budget for -scale auto (16.7)\n"
+        "  -beat legacy|tempo  isBeat from main.cpp's level detector, or from the\n"
+        "                    tempo tracker's beat grid (legacy)\n"
+        "  -beat-log <file>  write time, beat, onset, bpm, phase and confidence\n"
+        "                    per frame as CSV\n"
+        "  -trace <file>     write a Chrome trace of the last frames' zones (per\n"
+        "                    effect, SMP tasks and waits) to file\n");
+}
+
+// -o goes to snprintf with the frame index, so it may hold exactly one %d
+// (with a width such as %05d) and no other conversion than %%
+bool framePattern(const char* s)
+{
+    int ints = 0;
+    for (; *s; s++) {
+        if (*s != '%')
+            continue;
+        if (*++s == '%')
+            continue;
+        while (*s >= '0' && *s <= '9')
+            s++;
+        if (*s != 'd')
+            return false;
+        ints++;
+    }
+    return ints == 1;
+}
+
+bool parse(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (a[0] != '-' || !a[1]) {
+            if (!o.preset)
+                o.preset = a;
+            else if (!o.audio)
+                o.audio = a;
+            else
+                return false;
+            continue;
+        }
+        if (!v)
+            return false;
+        i++;
+        if (!strcmp(a, "-w"))
+            o.width = atoi(v);
+        else if (!strcmp(a, "-h"))
+            o.height = atoi(v);
+        else if (!strcmp(a, "-fps"))
+            o.fps = atof(v);
+        else if (!strcmp(a, "-n"))
+            o.frames = atoll(v);
+        else if (!strcmp(a, "-threads"))
+            o.threads = atoi(v);
+        else if (!strcmp(a, "-tiles")) {
+            if (strcmp(v, "on") && strcmp(v, "off"))
+                return false;
+            o.tiles = !strcmp(v, "on");
+        } else if (!strcmp(a, "-vis"))
+            o.vis = atoi(v);
+        else if (!strcmp(a, "-o"))
+            o.out = v;
+        else if (!strcmp(a, "-trace"))
+            o.trace = v;
+        else if (!strcmp(a, "-scale")) {
+            static const char* names[] = { "full", "75", "50", "auto" };
+            o.scale = -1;
+            for (int s = 0; s < 4; s++)
+                if (!strcmp(v, names[s]))
+                    o.scale = s;
+            if (o.scale < 0)
+                return false;
+        } else if (!strcmp(a, "-budget"))
+            o.budget = atof(v);
+        else if (!strcmp(a, "-beat-log"))
+            o.beatLog = v;
+        else if (!strcmp(a, "-beat")) {
+            if (strcmp(v, "legacy") && strcmp(v, "tempo"))
+                return false;
+            o.trackedBeat = !strcmp(v, "tempo");
+        }
+        else if (!strcmp(a, "-format")) {
+            if (strcmp(v, "png") && strcmp(v, "rgba"))
+                return false;
+            o.png = !strcmp(v, "png");
+        } else
+            return false;
+    }
+    if (strchr(o.out, '%')) {
+        if (!framePattern(o.out)) {
+            fprintf(stderr, "avs_standalone: the -o pattern needs exactly one %%d, and %%%% for a literal %%\n");
+            return false;
+        }
+        size_t n = strlen(o.out);
+        if (n > 4 && !strcasecmp(o.out + n - 4, ".png"))
+            o.png = true;
+    } else if (o.png) {
+        fprintf(stderr, "avs_standalone: PNG output needs a per-frame pattern for -o\n");
+        return false;
+    }
+    return o.preset && o.audio && o.width > 0 && o.height > 0 && o.fps > 0;
+}
+}
+
+int main(int argc, char** argv)
 {
-    printf("AVS standalone scaffold running. (Rendering loop not yet implemented)\n");
-    // Future: initialize audio capture, preset loading, render loop.
-    return 0;
+    Options o;
+    if (!parse(argc, argv, o)) {
+        usage();
+        return 1;
+    }
+
+    std::vector<float> pcm;
+    std::string err;
+    if (!wav_read_stereo(o.audio, kSampleRate, pcm, err)) {
+        fprintf(stderr, "avs_standalone: %s: %s\n", o.audio, err.c_str());
+        return 1;
+    }
+    const int64_t audio_frames = (int64_t)(pcm.size() / 2);
+    if (o.frames < 0)
+        o.frames = (long long)((double)audio_frames * o.fps / kSampleRate + 0.999);
+
+    g_config_smp_mt = o.threads > 0 ? o.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    g_config_smp = g_config_smp_mt > 1;
+    g_config_tiles = o.tiles;
+
+    // relative resources of the preset resolve against its own directory
+    {
+        std::string dir(o.preset);
+        size_t slash = dir.find_last_of("/\\");
+        dir = slash == std::string::npos ? std::string(".") : dir.substr(0, slash);
+        snprintf(g_path, 1024, "%s", dir.c_str());
+    }
+
+    g_render_scale = o.scale;
+    if (o.budget > 0)
+        g_render_scale_budget_ms = o.budget;
+
+    AVS_EEL_IF_init();
+    g_render_library = new C_RLibrary();
+    g_render_effects = new C_RenderListClass(1);
+    if (g_render_effects->__LoadPreset((char*)o.preset, 1)) {
+        fprintf(stderr, "avs_standalone: cannot load preset %s\n", o.preset);
+        return 1;
+    }
+
+    FILE* stream = nullptr;
+    if (!strchr(o.out, '%')) {
+        stream = strcmp(o.out, "-") ? fopen(o.out, "wb") : stdout;
+        if (!stream) {
+            fprintf(stderr, "avs_standalone: cannot open %s\n", o.out);
+            return 1;
+        }
+    }
+
+    const int w = o.width, h = o.height;
+    std::vector<int> fb_a((size_t)w * h), fb_b((size_t)w * h);
+    int *fb = fb_a.data(), *fb2 = fb_b.data();
+    std::vector<uint8_t> rgba((size_t)w * h * 4);
+    char visdata[2][2][576];
+    VisDataSource vis;
+    if (!vis.setExtended(o.vis)) {
+        fprintf(stderr, "avs_standalone: -vis takes %d..%d samples\n", VISDATA_EX_MIN, VISDATA_EX_MAX);
+        return 1;
+    }
+    BeatTracker tracker(kSampleRate);
+    std::vector<float> mono;
+    int64_t tracked = 0; // frames handed to the tracker
+    FILE* beatLog = nullptr;
+    if (o.beatLog) {
+        if (!(beatLog = fopen(o.beatLog, "w"))) {
+            fprintf(stderr, "avs_standalone: cannot open %s\n", o.beatLog);
+            return 1;
+        }
+        fprintf(beatLog, "frame,time,beat,onset,bpm,phase,confidence\n");
+    }
+
+    if (o.trace) {
+        prof_set_thread_name("render");
+        prof_enable(1);
+    }
+
+    int ret = 0;
+    long long done = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < o.frames; i++) {
+        PROF_ZONE("frame");
+        int64_t end = (int64_t)((double)(i + 1) * kSampleRate / o.fps);
+        int beat;
+        {
+            PROF_ZONE("visdata");
+            beat = vis.compute(pcm.data(), audio_frames, end, visdata);
+        }
+        {
+            PROF_ZONE("tempo");
+            mono.resize((size_t)(end - tracked));
+            for (int64_t f = tracked; f < end; f++)
+                mono[(size_t)(f - tracked)] = f < audio_frames ? 0.5f * (pcm[f * 2] + pcm[f * 2 + 1]) : 0.f;
+            tracker.push(mono.data(), mono.size());
+            tracked = end;
+            const BeatTracker::State& st = tracker.at((uint64_t)end);
+            g_vis_tempo.bpm = st.locked ? st.bpm : 0.0;
+            g_vis_tempo.phase = st.phase;
+            g_vis_tempo.confidence = st.confidence;
+            g_vis_tempo.onset = st.onsetStrength;
+            g_vis_tempo.beats = (double)st.beats;
+            if (o.trackedBeat)
+                beat = st.beat;
+            if (beatLog)
+                fprintf(beatLog, "%lld,%.4f,%d,%d,%.2f,%.3f,%.3f\n", i, (double)end / kSampleRate, st.beat, st.onset, g_vis_tempo.bpm, st.phase, st.confidence);
+        }
+        g_visdata_ex = vis.extended();
+        if (g_render_effects->render(visdata, beat, fb, fb2, w, h) & 1)
+            std::swap(fb, fb2);
+        g_visdata_ex = nullptr;
+        PROF_ZONE("output");
+
+        for (size_t p = 0, n = (size_t)w * h; p < n; p++) {
+            unsigned int c = (unsigned int)fb[p];
+            rgba[p * 4] = (uint8_t)(c >> 16);
+            rgba[p * 4 + 1] = (uint8_t)(c >> 8);
+            rgba[p * 4 + 2] = (uint8_t)c;
+            rgba[p * 4 + 3] = 255;
+        }
+
+        bool ok;
+        if (stream) {
+            ok = fwrite(rgba.data(), 1, rgba.size(), stream) == rgba.size();
+        } else {
+            char name[1024];
+            snprintf(name, sizeof(name), o.out, (int)i);
+            FILE* f = fopen(name, "wb");
+            ok = f && (o.png ? png_write_rgba(f, rgba.data(), w, h) : fwrite(rgba.data(), 1, rgba.size(), f) == rgba.size());
+            if (f && fclose(f))
+                ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "avs_standalone: write failed at frame %lld\n", i);
+            ret = 1;
+            break;
+        }
+        done++;
+    }
+    prof_enable(0);
+    if (beatLog)
+        fclose(beatLog);
+    if (o.trace && !prof_write_chrome_trace(o.trace)) {
+        fprintf(stderr, "avs_standalone: cannot write %s\n", o.trace);
+        ret = 1;
+    }
+    if (stream && stream != stdout)
+        fclose(stream);
+    else if (stream)
+        fflush(stream);
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "avs_standalone: %lld frames at %dx%d in %.2fs (%.1f fps, %.1fx real-time)\n",
+        done, w, h, secs, secs > 0 ? done / secs : 0.0, secs > 0 ? done / o.fps / secs : 0.0);
+    if (g_render_effects->get_scale() < 1.0)
+        fprintf(stderr, "avs_standalone: rendering at %.0f%% of the output size at the end\n", g_render_effects->get_scale() * 100.0);
+
+    delete g_render_effects;
+    g_render_effects = NULL;
+    delete g_render_library;
+    g_render_library = NULL;
+    AVS_EEL_IF_quit();
+    return ret;
 }
@@ -0,0 +1,86 @@
+#include "png_write.h"
+#include <vector>
+
+namespace {
+uint32_t crc_table[256];
+
+struct CrcTableInit {
+    CrcTableInit()
+    {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            crc_table[n] = c;
+        }
+    }
+} s_crcInit;
+
+uint32_t crc32(uint32_t crc, const uint8_t* p, size_t n)
+{
+    crc = ~crc;
+    while (n--)
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void put32(std::vector<uint8_t>& v, uint32_t x)
+{
+    v.push_back((uint8_t)(x >> 24));
+    v.push_back((uint8_t)(x >> 16));
+    v.push_back((uint8_t)(x >> 8));
+    v.push_back((uint8_t)x);
+}
+
+bool write_chunk(FILE* f, const char* type, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> c;
+    c.reserve(data.size() + 12);
+    put32(c, (uint32_t)data.size());
+    c.insert(c.end(), type, type + 4);
+    c.insert(c.end(), data.begin(), data.end());
+    put32(c, crc32(0, c.data() + 4, data.size() + 4));
+    return fwrite(c.data(), 1, c.size(), f) == c.size();
+}
+}
+
+bool png_write_rgba(FILE* f, const uint8_t* rgba, int w, int h)
+{
+    static const uint8_t sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (fwrite(sig, 1, 8, f) != 8)
+        return false;
+
+    std::vector<uint8_t> ihdr;
+    put32(ihdr, (uint32_t)w);
+    put32(ihdr, (uint32_t)h);
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlace
+    if (!write_chunk(f, "IHDR", ihdr))
+        return false;
+
+    // zlib stream of stored blocks over the rows, each led by filter type 0
+    const size_t row = (size_t)w * 4 + 1, raw = row * h;
+    std::vector<uint8_t> z;
+    z.reserve(raw + raw / 65535 * 5 + 16);
+    z.push_back(0x78);
+    z.push_back(0x01);
+    uint32_t a = 1, b = 0;
+    size_t left = raw, pos = 0;
+    do {
+        size_t n = left < 65535 ? left : 65535;
+        z.push_back(left == n ? 1 : 0);
+        z.push_back((uint8_t)n);
+        z.push_back((uint8_t)(n >> 8));
+        z.push_back((uint8_t)~n);
+        z.push_back((uint8_t)(~n >> 8));
+        for (size_t i = 0; i < n; i++, pos++) {
+            size_t x = pos % row;
+            uint8_t v = x ? rgba[(pos / row) * (row - 1) + x - 1] : 0;
+            z.push_back(v);
+            a = (a + v) % 65521;
+            b = (b + a) % 65521;
+        }
+        left -= n;
+    } while (left);
+    put32(z, (b << 16) | a);
+    return write_chunk(f, "IDAT", z) && write_chunk(f, "IEND", {});
+}
@@ -0,0 +1,9 @@
+// Minimal PNG writer: 8 bit RGBA, stored (uncompressed) deflate blocks, so it
+// needs no zlib. Files are large; pipe raw RGBA into an encoder when size
+// matters.
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+// rgba is w * h * 4 bytes, top row first. returns false on a write error
+bool png_write_rgba(FILE* f, const uint8_t* rgba, int w, int h);
@@ -0,0 +1,156 @@
+#include "visdata.h"
+#include "../modern/fft_analyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+VisDataSource::VisDataSource()
+{
+    // same curve main.cpp puts Winamp's spectrum through
+    for (int x = 0; x < 256; x++) {
+        int t = (int)(std::log(x * 60.0 / 255.0 + 1.0) / std::log(60.0) * 255.0);
+        m_logtab[x] = (unsigned char)std::clamp(t, 0, 255);
+    }
+    for (int i = 0; i < FFT_SIZE; i++)
+        m_window[i] = 0.5f * (1.f - std::cos(2.f * 3.1415926535f * i / (FFT_SIZE - 1)));
+    for (int i = 0; i < FFT_SIZE / 2; i++) {
+        m_cos[i] = std::cos(2.0 * 3.14159265358979 * i / FFT_SIZE);
+        m_sin[i] = -std::sin(2.0 * 3.14159265358979 * i / FFT_SIZE);
+    }
+}
+
+// in-place radix-2, FFT_SIZE points
+void VisDataSource::fft(float* re, float* im) const
+{
+    for (int i = 1, j = 0; i < FFT_SIZE; i++) {
+        int bit = FFT_SIZE >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (int len = 2; len <= FFT_SIZE; len <<= 1) {
+        int half = len >> 1, step = FFT_SIZE / len;
+        for (int i = 0; i < FFT_SIZE; i += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = m_cos[k * step], wi = m_sin[k * step];
+                float* ar = re + i + k;
+                float* ai = im + i + k;
+                float br = ar[half] * wr - ai[half] * wi;
+                float bi = ar[half] * wi + ai[half] * wr;
+                ar[half] = *ar - br;
+                ai[half] = *ai - bi;
+                *ar += br;
+                *ai += bi;
+            }
+        }
+    }
+}
+
+bool VisDataSource::setExtended(int samples)
+{
+    if (samples && (samples < VISDATA_EX_MIN || samples > VISDATA_EX_MAX))
+        return false;
+    m_exN = samples;
+    if (!samples)
+        return true;
+    const int n = samples * 2;
+    m_exFFT.reset(new RealFFT((size_t)n));
+    m_exWindow.resize(n);
+    for (int i = 0; i < n; i++)
+        m_exWindow[i] = 0.5f * (1.f - std::cos(2.f * 3.1415926535f * i / (n - 1)));
+    m_exBlock.resize(n);
+    m_exMono.resize(samples);
+    for (int ch = 0; ch < 2; ch++) {
+        m_exWave[ch].assign(samples, 0.f);
+        m_exSpec[ch].assign(samples, 0.f);
+        m_ex.waveform[ch] = m_exWave[ch].data();
+        m_ex.spectrum[ch] = m_exSpec[ch].data();
+    }
+    m_ex.samples = m_ex.bins = samples;
+    m_ex.num_bands = 64;
+    return true;
+}
+
+int VisDataSource::compute(const float* pcm, int64_t frames, int64_t end, char visdata[2][2][576])
+{
+    auto sample = [&](int64_t pos, int ch) { return (pos >= 0 && pos < frames) ? pcm[pos * 2 + ch] : 0.f; };
+
+    if (m_exN) {
+        // a Hann window twice the frame long gives m_exN bins, scaled like
+        // the 576 path so a full scale sine peaks near 1
+        const int n = m_exN * 2;
+        const float scale = 1.f / (n / 4);
+        for (int ch = 0; ch < 2; ch++) {
+            for (int x = 0; x < m_exN; x++)
+                m_exWave[ch][x] = sample(end - m_exN + x, ch);
+            for (int i = 0; i < n; i++)
+                m_exBlock[i] = sample(end - n + i, ch) * m_exWindow[i];
+            m_exFFT->magnitudes(m_exBlock.data(), m_exSpec[ch].data());
+            for (int x = 0; x < m_exN; x++)
+                m_exSpec[ch][x] *= scale;
+        }
+        for (int x = 0; x < m_exN; x++)
+            m_exMono[x] = 0.5f * (m_exSpec[0][x] + m_exSpec[1][x]);
+        FFTAnalyzer::logBands(m_exMono.data(), m_exMono.size(), (size_t)m_ex.num_bands, m_exBands);
+        m_ex.bands = m_exBands.data();
+        m_ex.legacy = visdata;
+        visdata_ex_to_legacy(&m_ex);
+        return detectBeat(visdata);
+    }
+
+    // waveform: the last 576 frames as signed 8 bit
+    for (int ch = 0; ch < 2; ch++) {
+        for (int x = 0; x < 576; x++) {
+            int v = (int)std::lround(sample(end - 576 + x, ch) * 127.f);
+            visdata[1][ch][x] = (char)std::clamp(v, -128, 127);
+        }
+    }
+
+    // spectrum: a windowed FFT of the last FFT_SIZE frames, the lower 512
+    // bins stretched over 576 entries. a full scale sine comes out near 255
+    for (int ch = 0; ch < 2; ch++) {
+        float re[FFT_SIZE], im[FFT_SIZE];
+        for (int i = 0; i < FFT_SIZE; i++) {
+            re[i] = sample(end - FFT_SIZE + i, ch) * m_window[i];
+            im[i] = 0.f;
+        }
+        fft(re, im);
+        for (int x = 0; x < 576; x++) {
+            int k = x * (FFT_SIZE / 2) / 576;
+            float mag = std::sqrt(re[k] * re[k] + im[k] * im[k]) * (255.f / (FFT_SIZE / 4));
+            visdata[0][ch][x] = (char)m_logtab[std::min((int)mag, 255)];
+        }
+    }
+
+    return detectBeat(visdata);
+}
+
+// the beat detector from main.cpp, less the smartbeat refinement
+int VisDataSource::detectBeat(char visdata[2][2][576])
+{
+    int lt[2] = { 0, 0 };
+    for (int ch = 0; ch < 2; ch++)
+        for (int x = 0; x < 576; x++)
+            lt[ch] += std::abs((int)visdata[1][ch][x]);
+    lt[0] = std::max(lt[0], lt[1]);
+
+    int beat = 0;
+    m_peak1 = (m_peak1 * 125 + m_peak2 * 3) / 128;
+    m_beatCnt++;
+    if (lt[0] >= (m_peak1 * 34) / 32 && lt[0] > (576 * 16)) {
+        if (m_beatCnt > 0) {
+            m_beatCnt = 0;
+            beat = 1;
+        }
+        m_peak1 = (lt[0] + m_peak1Peak) / 2;
+        m_peak1Peak = lt[0];
+    } else if (lt[0] > m_peak2) {
+        m_peak2 = lt[0];
+    } else
+        m_peak2 = (m_peak2 * 14) / 16;
+    return beat;
+}
@@ -0,0 +1,42 @@
+// Winamp-style vis data for offline rendering: the 576 spectrum and waveform
+// bytes per channel the effects expect, plus the legacy beat detector, all
+// computed from decoded PCM instead of being handed over by Winamp.
+#pragma once
+#include "../avs/vis_avs/visdata_ex.h"
+#include "../modern/real_fft.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class VisDataSource {
+public:
+    VisDataSource();
+
+    // fills visdata from the stereo frames of pcm (interleaved float, frames
+    // long) that end at frame end; frames outside pcm read as silence.
+    // returns the beat flag for this frame
+    int compute(const float* pcm, int64_t frames, int64_t end, char visdata[2][2][576]);
+
+    // samples per channel of the extended frame (VISDATA_EX_MIN..MAX, bins
+    // the same), 0 for none. with one, compute() builds the legacy bytes
+    // from it. false for a size out of range
+    bool setExtended(int samples);
+    // the frame of the last compute(), null without one
+    const VisDataEx* extended() const { return m_exN ? &m_ex : nullptr; }
+
+private:
+    enum { FFT_SIZE = 1024 };
+    void fft(float* re, float* im) const;
+    int detectBeat(char visdata[2][2][576]);
+
+    unsigned char m_logtab[256];
+    float m_window[FFT_SIZE];
+    float m_cos[FFT_SIZE / 2], m_sin[FFT_SIZE / 2];
+    int m_peak1 = 0, m_peak2 = 0, m_peak1Peak = 0, m_beatCnt = 0;
+
+    int m_exN = 0;
+    std::unique_ptr<RealFFT> m_exFFT; // 2 * m_exN points
+    std::vector<float> m_exWindow, m_exBlock, m_exMono;
+    std::vector<float> m_exWave[2], m_exSpec[2], m_exBands;
+    VisDataEx m_ex {};
+};
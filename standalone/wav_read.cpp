@@ -0,0 +1,116 @@
+#include "wav_read.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+uint32_t le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t le32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+float sample_at(const uint8_t* p, int bits, bool is_float)
+{
+    if (is_float) {
+        if (bits == 32) {
+            float f;
+            memcpy(&f, p, 4);
+            return f;
+        }
+        double d;
+        memcpy(&d, p, 8);
+        return (float)d;
+    }
+    switch (bits) {
+    case 8:
+        return (p[0] - 128) / 128.f;
+    case 16:
+        return (int16_t)le16(p) / 32768.f;
+    case 24:
+        return (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.f;
+    default:
+        return (int32_t)le32(p) / 2147483648.f;
+    }
+}
+}
+
+bool wav_read_stereo(const char* path, int rate, std::vector<float>& pcm, std::string& err)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        err = "cannot open file";
+        return false;
+    }
+    std::vector<uint8_t> file;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        file.insert(file.end(), buf, buf + n);
+    fclose(f);
+
+    if (file.size() < 12 || memcmp(&file[0], "RIFF", 4) || memcmp(&file[8], "WAVE", 4)) {
+        err = "not a RIFF WAVE file";
+        return false;
+    }
+    int channels = 0, bits = 0, src_rate = 0;
+    bool is_float = false;
+    const uint8_t* data = nullptr;
+    size_t data_len = 0;
+    for (size_t pos = 12; pos + 8 <= file.size();) {
+        const uint8_t* c = &file[pos];
+        size_t len = le32(c + 4);
+        size_t avail = file.size() - pos - 8;
+        if (len > avail)
+            len = avail; // truncated file, or a streamed header with a bogus size
+        if (!memcmp(c, "fmt ", 4) && len >= 16) {
+            unsigned tag = le16(c + 8);
+            if (tag == 0xfffe && len >= 40)
+                tag = le16(c + 8 + 24); // WAVE_FORMAT_EXTENSIBLE: first half of the subformat GUID
+            channels = le16(c + 10);
+            src_rate = le32(c + 12);
+            bits = le16(c + 22);
+            if (tag == 3)
+                is_float = true;
+            else if (tag != 1) {
+                err = "unsupported WAVE encoding (only PCM and float)";
+                return false;
+            }
+        } else if (!memcmp(c, "data", 4)) {
+            data = c + 8;
+            data_len = len;
+        }
+        pos += 8 + len + (len & 1);
+    }
+    if (!data || !channels || !src_rate) {
+        err = "missing fmt or data chunk";
+        return false;
+    }
+    if (is_float ? (bits != 32 && bits != 64) : (bits != 8 && bits != 16 && bits != 24 && bits != 32)) {
+        err = "unsupported sample size";
+        return false;
+    }
+
+    const size_t stride = (size_t)channels * (bits / 8);
+    const size_t frames = data_len / stride;
+    std::vector<float> src(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        const uint8_t* p = data + i * stride;
+        src[i * 2] = sample_at(p, bits, is_float);
+        src[i * 2 + 1] = channels > 1 ? sample_at(p + bits / 8, bits, is_float) : src[i * 2];
+    }
+
+    if (src_rate == rate || !frames) {
+        pcm.swap(src);
+        return true;
+    }
+    const size_t out_frames = (size_t)((double)frames * rate / src_rate);
+    const double step = (double)src_rate / rate;
+    pcm.resize(out_frames * 2);
+    for (size_t i = 0; i < out_frames; i++) {
+        double t = i * step;
+        size_t i0 = (size_t)t;
+        size_t i1 = i0 + 1 < frames ? i0 + 1 : i0;
+        float fr = (float)(t - i0);
+        for (int ch = 0; ch < 2; ch++)
+            pcm[i * 2 + ch] = src[i0 * 2 + ch] + (src[i1 * 2 + ch] - src[i0 * 2 + ch]) * fr;
+    }
+    return true;
+}
@@ -0,0 +1,10 @@
+// RIFF WAVE reader for the offline renderer: 8/16/24/32 bit integer PCM and
+// 32/64 bit float, any channel count and rate.
+#pragma once
+#include <string>
+#include <vector>
+
+// reads path as interleaved stereo float at rate (mono is doubled, channels
+// past the second are dropped, other rates are resampled linearly). on
+// failure returns false with a reason in err
+bool wav_read_stereo(const char* path, int rate, std::vector<float>& pcm, std::string& err);
@@ -0,0 +1,120 @@
+// Feeds click tracks through the same path avs_standalone -beat tempo takes:
+// written out as a WAV, read back with wav_read_stereo, mixed to mono and
+// pushed a video frame at a time. Checks the tempo the tracker settles on
+// and the number of beats it reports. Exits non-zero on a miss.
+
+#include "../modern/beat_tracker.h"
+#include "../standalone/wav_read.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int kSampleRate = 44100;
+
+static void put16(FILE* f, unsigned v)
+{
+    fputc(v & 0xff, f);
+    fputc((v >> 8) & 0xff, f);
+}
+
+static void put32(FILE* f, unsigned v)
+{
+    put16(f, v & 0xffff);
+    put16(f, v >> 16);
+}
+
+// mono 16 bit PCM: a 20 ms decaying 1 kHz burst on every beat, silence between
+static bool writeClickTrack(const char* path, double bpm, double seconds)
+{
+    const size_t frames = (size_t)(seconds * kSampleRate);
+    const double period = 60.0 * kSampleRate / bpm;
+    const size_t click = kSampleRate / 50;
+    std::vector<short> pcm(frames, 0);
+    for (double at = 0.0; at < (double)frames; at += period)
+        for (size_t i = 0; i < click && (size_t)at + i < frames; i++) {
+            const double t = (double)i / kSampleRate;
+            pcm[(size_t)at + i] = (short)(20000.0 * std::exp(-t * 200.0) * std::sin(2.0 * 3.14159265358979 * 1000.0 * t));
+        }
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    const unsigned bytes = (unsigned)(frames * 2);
+    fwrite("RIFF", 1, 4, f);
+    put32(f, 36 + bytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put32(f, 16);
+    put16(f, 1); // PCM
+    put16(f, 1); // mono
+    put32(f, kSampleRate);
+    put32(f, kSampleRate * 2);
+    put16(f, 2);
+    put16(f, 16);
+    fwrite("data", 1, 4, f);
+    put32(f, bytes);
+    for (short s : pcm)
+        put16(f, (unsigned short)s);
+    return fclose(f) == 0;
+}
+
+struct Result {
+    float bpm = 0.0f;
+    bool locked = false;
+    uint64_t beats = 0;
+};
+
+static bool track(const char* path, double fps, Result& r)
+{
+    std::vector<float> pcm;
+    std::string err;
+    if (!wav_read_stereo(path, kSampleRate, pcm, err)) {
+        printf("  %s: %s\n", path, err.c_str());
+        return false;
+    }
+    const int64_t frames = (int64_t)(pcm.size() / 2);
+    BeatTracker tracker(kSampleRate);
+    std::vector<float> mono;
+    int64_t tracked = 0;
+    for (long long i = 0; tracked < frames; i++) {
+        const int64_t end = std::min(frames, (int64_t)((double)(i + 1) * kSampleRate / fps));
+        mono.resize((size_t)(end - tracked));
+        for (int64_t f = tracked; f < end; f++)
+            mono[(size_t)(f - tracked)] = 0.5f * (pcm[f * 2] + pcm[f * 2 + 1]);
+        tracker.push(mono.data(), mono.size());
+        tracked = end;
+        const BeatTracker::State& st = tracker.at((uint64_t)end);
+        r.bpm = st.bpm;
+        r.locked = st.locked;
+        r.beats = st.beats;
+    }
+    return true;
+}
+
+int main()
+{
+    // tempo, length, frame rate the host asks at, and the beats it should
+    // count: one per click, give or take the couple heard before it locks
+    static const struct {
+        double bpm, seconds, fps;
+        unsigned beatsMin, beatsMax;
+    } cases[] = {
+        { 120.0, 12.0, 60.0, 22, 24 },
+        { 120.0, 12.0, 23.0, 22, 24 },
+        { 90.0, 16.0, 60.0, 22, 24 },
+        { 140.0, 10.0, 60.0, 21, 24 },
+    };
+    const char* path = "beat_tracker_test.wav";
+    int failures = 0;
+    for (const auto& c : cases) {
+        Result r;
+        bool ok = writeClickTrack(path, c.bpm, c.seconds) && track(path, c.fps, r);
+        ok = ok && r.locked && std::fabs(r.bpm - c.bpm) < 1.0 && r.beats >= c.beatsMin && r.beats <= c.beatsMax;
+        printf("%.0f BPM, %.0f s at %.0f fps: %.2f BPM, %llu beats, %s\n", c.bpm, c.seconds, c.fps, r.bpm, (unsigned long long)r.beats, ok ? "ok" : "FAILED");
+        failures += !ok;
+    }
+    remove(path);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+// Checks every blend_simd kernel against the per-pixel inlines in r_defs.h,
+// bit for bit, at each level this CPU has and with both blend tables the
+// engine ships: the rounded one (portable build) and the truncating one
+// render.cpp fills for the Winamp plugin. Odd lengths, unaligned starts and
+// in-place calls are covered. Exits non-zero on the first mismatch.
+
+#include "../platform_shim.h"
+#include "blend_simd.h"
+#include "r_defs.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static unsigned int g_seed = 0x1234567;
+
+static unsigned int rnd()
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed;
+}
+
+// mostly random, with the saturation and sign edges mixed in
+static unsigned int rnd_pixel()
+{
+    static const unsigned int edges[] = { 0x00000000, 0xffffffff, 0x80808080, 0x7f7f7f7f, 0xff000000, 0x00ffffff, 0x01010101, 0xfefefefe };
+    unsigned int r = rnd();
+    return (r & 3) ? rnd() : edges[(r >> 2) & 7];
+}
+
+static void fill_table(int rounded)
+{
+    int i, j;
+    for (i = 0; i < 256; i++)
+        for (j = 0; j < 256; j++)
+            g_blendtable[i][j] = rounded ? (unsigned char)((i * j + 127) / 255) : (unsigned char)((i / 255.0) * (float)j);
+}
+
+static int g_failures;
+
+static void fail(const char* what, int n, int i, unsigned int got, unsigned int want)
+{
+    if (g_failures++ < 20)
+        printf("  %s: n=%d [%d] got %08x want %08x\n", what, n, i, got, want);
+}
+
+typedef void (*blockProc)(int* out, const int* a, const int* b, int n);
+typedef unsigned int (*refProc)(unsigned int a, unsigned int b, int v);
+
+static unsigned int ref_add(unsigned int a, unsigned int b, int) { return BLEND(a, b); }
+static unsigned int ref_sub(unsigned int a, unsigned int b, int) { return BLEND_SUB(a, b); }
+static unsigned int ref_max(unsigned int a, unsigned int b, int) { return BLEND_MAX(a, b); }
+static unsigned int ref_min(unsigned int a, unsigned int b, int) { return BLEND_MIN(a, b); }
+static unsigned int ref_avg(unsigned int a, unsigned int b, int) { return BLEND_AVG(a, b); }
+static unsigned int ref_xor(unsigned int a, unsigned int b, int) { return a ^ b; }
+static unsigned int ref_mul(unsigned int a, unsigned int b, int) { return BLEND_MUL(a, b); }
+static unsigned int ref_adj(unsigned int a, unsigned int b, int v) { return BLEND_ADJ_NOMMX(a, b, v); }
+
+static const int lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1001 };
+#define NLENGTHS (int)(sizeof(lengths) / sizeof(lengths[0]))
+#define MAXLEN 1001
+
+// inplace: 0 separate output, 1 out == a, 2 out == b
+static void check_block(const char* name, blockProc proc, void (*adj)(int*, const int*, const int*, int, int), refProc ref, int v)
+{
+    int li, offs, inplace;
+    for (li = 0; li < NLENGTHS; li++)
+        for (offs = 0; offs < 4; offs++)
+            for (inplace = 0; inplace < 3; inplace++) {
+                const int n = lengths[li];
+                std::vector<int> a(MAXLEN + 8), b(MAXLEN + 8), out(MAXLEN + 8), want(n + 1);
+                int i;
+                for (i = 0; i < MAXLEN + 8; i++) {
+                    a[i] = (int)rnd_pixel();
+                    b[i] = (int)rnd_pixel();
+                    out[i] = (int)0xdeadbeef;
+                }
+                int *pa = a.data() + offs, *pb = b.data() + offs, *po = out.data() + offs;
+                for (i = 0; i < n; i++)
+                    want[i] = (int)ref((unsigned int)pa[i], (unsigned int)pb[i], v);
+                if (inplace == 1)
+                    po = pa;
+                else if (inplace == 2)
+                    po = pb;
+                const int guard = po[n];
+                if (adj)
+                    adj(po, pa, pb, n, v);
+                else
+                    proc(po, pa, pb, n);
+                for (i = 0; i < n; i++)
+                    if (po[i] != want[i]) {
+                        fail(name, n, i, po[i], want[i]);
+                        break;
+                    }
+                if (po[n] != guard)
+                    fail(name, n, n, po[n], guard);
+            }
+}
+
+static void check_blend4_trans()
+{
+    const int w = 67, h = 23;
+    std::vector<int> src(w * h);
+    int i, k;
+    for (i = 0; i < w * h; i++)
+        src[i] = (int)rnd_pixel();
+    // every fraction pair, then random entries at odd lengths
+    std::vector<int> tab(32 * 32 + MAXLEN), out(32 * 32 + MAXLEN + 4), want(32 * 32 + MAXLEN);
+    int n = 0;
+    for (i = 0; i < 32; i++)
+        for (k = 0; k < 32; k++) {
+            int off = (int)(rnd() % (h - 1)) * w + (int)(rnd() % (w - 1));
+            tab[n++] = off | (i << 27) | (k << 22);
+        }
+    for (i = 0; i < MAXLEN; i++) {
+        int off = (int)(rnd() % (h - 1)) * w + (int)(rnd() % (w - 1));
+        tab[n++] = off | (int)((rnd() & 31) << 27) | (int)((rnd() & 31) << 22);
+    }
+    for (i = 0; i < n; i++) {
+        int t = tab[i];
+        want[i] = (int)BLEND4((unsigned int*)src.data() + (t & ((1 << 22) - 1)), w, (t >> 24) & (31 << 3), (t >> 19) & (31 << 3));
+    }
+    for (k = 0; k < NLENGTHS + 1; k++) {
+        int start = k < NLENGTHS ? 32 * 32 + 3 : 0;
+        int len = k < NLENGTHS ? (lengths[k] < n - start ? lengths[k] : n - start) : 32 * 32;
+        out[len] = 0x5a5a5a5a;
+        blend4_trans_block(out.data(), src.data(), w, tab.data() + start, len);
+        for (i = 0; i < len; i++)
+            if (out[i] != want[start + i]) {
+                fail("blend4_trans", len, i, out[i], want[start + i]);
+                break;
+            }
+        if (out[len] != 0x5a5a5a5a)
+            fail("blend4_trans", len, len, out[len], 0x5a5a5a5a);
+    }
+}
+
+static void check_blend4_16_line()
+{
+    const int w = 131, h = 97;
+    std::vector<int> src(w * h), out(MAXLEN + 4);
+    int i, k, r;
+    for (i = 0; i < w * h; i++)
+        src[i] = (int)rnd_pixel();
+    for (r = 0; r < 40; r++)
+        for (k = 0; k < NLENGTHS; k++) {
+            const int n = lengths[k];
+            // a walk that stays a pixel inside the right and bottom edges
+            int x = (int)(rnd() % ((w - 2) << 16)), y = (int)(rnd() % ((h - 2) << 16));
+            int dx = 0, dy = 0;
+            if (n > 1) {
+                int xe = (int)(rnd() % ((w - 2) << 16)), ye = (int)(rnd() % ((h - 2) << 16));
+                dx = (xe - x) / (n - 1);
+                dy = (ye - y) / (n - 1);
+            }
+            out[n] = 0x5a5a5a5a;
+            blend4_16_line_block(out.data(), src.data(), w, x, y, dx, dy, n);
+            int px = x, py = y;
+            for (i = 0; i < n; i++, px += dx, py += dy) {
+                unsigned int want = BLEND4_16((unsigned int*)src.data() + (px >> 16) + (py >> 16) * w, w, px, py);
+                if ((unsigned int)out[i] != want) {
+                    fail("blend4_16_line", n, i, out[i], want);
+                    break;
+                }
+            }
+            if (out[n] != 0x5a5a5a5a)
+                fail("blend4_16_line", n, n, out[n], 0x5a5a5a5a);
+        }
+}
+
+int main()
+{
+    static const int adj_v[] = { 0, 1, 2, 127, 128, 200, 254, 255 };
+    int table, level, i;
+    const int best = blend_simd_get_best();
+    for (table = 0; table < 2; table++) {
+        fill_table(!table);
+        for (level = BLEND_SIMD_SCALAR; level <= BLEND_SIMD_NEON; level++) {
+            if (level > best || blend_simd_set_level(level) != level)
+                continue;
+            const int before = g_failures;
+            check_block("add", blend_add_block, NULL, ref_add, 0);
+            check_block("sub", blend_sub_block, NULL, ref_sub, 0);
+            check_block("max", blend_max_block, NULL, ref_max, 0);
+            check_block("min", blend_min_block, NULL, ref_min, 0);
+            check_block("avg", blend_avg_block, NULL, ref_avg, 0);
+            check_block("xor", blend_xor_block, NULL, ref_xor, 0);
+            check_block("mul", blend_mul_block, NULL, ref_mul, 0);
+            for (i = 0; i < (int)(sizeof(adj_v) / sizeof(adj_v[0])); i++)
+                check_block("adj", NULL, blend_adj_block, ref_adj, adj_v[i]);
+            check_blend4_trans();
+            check_blend4_16_line();
+            printf("%s table, %s: %s\n", table ? "truncating" : "rounded", blend_simd_get_name(level), g_failures == before ? "ok" : "FAILED");
+        }
+    }
+    return g_failures ? 1 : 0;
+}
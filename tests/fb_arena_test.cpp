@@ -0,0 +1,65 @@
+// Allocates blocks on both sides of FBA_MAP_MIN and checks what fb_arena
+// promises: FBA_ALIGN alignment everywhere, mapped blocks starting (header
+// included) on a FBA_MAP_MIN boundary, zeroed memory when asked for, and a
+// freed block coming back for the next request of its size class. Exits
+// non-zero on a miss.
+
+#include "fb_arena.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static int g_failures;
+
+static void check(bool ok, const char* what, size_t bytes)
+{
+    if (!ok) {
+        printf("%zu bytes: %s\n", bytes, what);
+        g_failures++;
+    }
+}
+
+int main()
+{
+    static const size_t sizes[] = { 0, 1, 4096, 640 * 480 * 4, FBA_MAP_MIN - FBA_ALIGN, FBA_MAP_MIN, 1920 * 1080 * 4, 3 * FBA_MAP_MIN + 17 };
+    const size_t n = sizeof(sizes) / sizeof(sizes[0]);
+    void* blocks[n];
+    size_t x;
+    for (x = 0; x < n; x++) {
+        const size_t bytes = sizes[x];
+        unsigned char* p = (unsigned char*)fba_alloc(bytes, 1);
+        blocks[x] = p;
+        check(p != NULL, "out of memory", bytes);
+        if (!p)
+            continue;
+        check(((uintptr_t)p & (FBA_ALIGN - 1)) == 0, "not FBA_ALIGN aligned", bytes);
+        if (bytes + FBA_ALIGN >= FBA_MAP_MIN)
+            check((((uintptr_t)p - FBA_ALIGN) & (FBA_MAP_MIN - 1)) == 0, "mapping not FBA_MAP_MIN aligned", bytes);
+        size_t i;
+        for (i = 0; i < bytes && !p[i]; i++)
+            ;
+        check(i == bytes, "not zeroed", bytes);
+        memset(p, 0xa5, bytes);
+    }
+
+    // a freed block is handed back, and cleared again when asked
+    for (x = 0; x < n; x++) {
+        const size_t bytes = sizes[x];
+        fba_free(blocks[x]);
+        unsigned char* p = (unsigned char*)fba_alloc(bytes, 1);
+        check(p == blocks[x], "freed block not reused", bytes);
+        size_t i;
+        for (i = 0; p && i < bytes && !p[i]; i++)
+            ;
+        check(p && i == bytes, "reused block not zeroed", bytes);
+        blocks[x] = p;
+    }
+
+    for (x = 0; x < n; x++)
+        fba_free(blocks[x]);
+    fba_trim();
+    fba_free(NULL);
+
+    printf("%s\n", g_failures ? "FAILED" : "ok");
+    return g_failures ? 1 : 0;
+}